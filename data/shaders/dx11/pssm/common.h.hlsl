@@ -53,3 +53,8 @@ struct VS_INPUT
 	float3 tangent : TANGENT;
 	float3 binormal : BINORMAL;
 };
+
+struct VS_INPUT_POSITION
+{
+	float3 position : POSITION;
+};
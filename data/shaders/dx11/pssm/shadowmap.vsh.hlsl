@@ -7,7 +7,7 @@ struct VS_OUTPUT
 	uint instanceID : SV_InstanceID;
 };
 
-VS_OUTPUT main(VS_INPUT input, unsigned int instanceID : SV_InstanceID)
+VS_OUTPUT main(VS_INPUT_POSITION input, unsigned int instanceID : SV_InstanceID)
 {
 	VS_OUTPUT output;
 	float4 pos = mul(float4(input.position, 1), model);
@@ -3,10 +3,6 @@
 const int MAX_SPLITS = 4;
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uv0;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec3 binormal;
 
 out VS_OUTPUT
 {
@@ -48,6 +48,7 @@ Application::AppInfo::AppInfo() :
 	flags.all = 0;
 	flags.fullscreen = 0;
 	flags.cursor = 1;
+	flags.compactVertexFormats = 0;
 #ifdef _DEBUG
 	flags.debug = 1;
 #else
@@ -83,7 +84,12 @@ int Application::run(Application* self, const std::string& commandLine)
 		return EXIT_FAILURE;
 	}
 
-	if (!utils::Utils::exists("data"))
+	// packed assets are preferred, files which are not packed are loaded from the data directory
+	if (utils::Archive::instance().open("data.pack"))
+	{
+		utils::Logger::toLogWithFormat("Archive 'data.pack' is opened, %d files.\n", (int)utils::Archive::instance().getFilesCount());
+	}
+	else if (!utils::Utils::exists("data"))
 	{
 		utils::Logger::toLog("Error: could not find data directory. Probably working directory has not been set correctly (especially if you are running from IDE).\n");
 		return EXIT_FAILURE;
@@ -133,12 +139,16 @@ int Application::run(Application* self, const std::string& commandLine)
 
 	// destroy everything
 	shutdown();
+	geom::Geometry::instance().finishAsyncLoading();
+	m_completionHandlers.clear();
 	MaterialManager::instance().destroy();
+	GeometryCache::instance().destroy();
 	destroyAllDestroyable();
 	destroyGui();
 	destroyD3D11();
 	Texture::cleanup();
 	m_window.destroy();
+	utils::Archive::instance().close();
 	
 	return EXIT_SUCCESS;
 }
@@ -161,6 +171,8 @@ void Application::mainLoop()
 			m_isRunning = false;
 		}
 
+		processCompletionHandlers();
+
 		// pre-render
 		m_pipeline.beginFrame(defaultRenderTarget());
 		m_defaultRasterizer->apply();
@@ -193,6 +205,29 @@ void Application::mainLoop()
 	while (m_isRunning);
 }
 
+void Application::addCompletionHandler(const std::function<bool()>& handler)
+{
+	m_completionHandlers.push_back(handler);
+}
+
+void Application::processCompletionHandlers()
+{
+	for (auto it = m_completionHandlers.begin(); it != m_completionHandlers.end();)
+	{
+		if ((*it)()) it = m_completionHandlers.erase(it);
+		else ++it;
+	}
+}
+
+void Application::waitForCompletionHandlers()
+{
+	while (!m_completionHandlers.empty())
+	{
+		processCompletionHandlers();
+		if (!m_completionHandlers.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
 void Application::exit()
 {
 	m_isRunning = false;
@@ -955,4 +990,9 @@ bool Application::isDebugEnabled() const
 	return m_info.flags.debug != 0;
 }
 
+bool Application::isCompactVertexFormatsEnabled() const
+{
+	return m_info.flags.compactVertexFormats != 0;
+}
+
 }
\ No newline at end of file
@@ -51,6 +51,11 @@ public:
 	int run(Application* self, const std::string& commandLine);
 	void exit();
 	void resize();
+
+	// the handler is called on the render thread once per frame until it returns true
+	void addCompletionHandler(const std::function<bool()>& handler);
+	// blocks until all completion handlers return true
+	void waitForCompletionHandlers();
 	void applyStandardParams(const std::map<std::string, int>& params);
 	void setLegend(const std::string& legend);
 
@@ -60,6 +65,8 @@ public:
 	vector2 getScreenSize() const { return vector2((float)m_info.windowWidth, (float)m_info.windowHeight); }
 
 	bool isDebugEnabled() const;
+	// see AppInfo::flags.compactVertexFormats
+	bool isCompactVertexFormatsEnabled() const;
 	
 	void useDefaultRenderTarget();
 	const std::shared_ptr<RenderTarget>& defaultRenderTarget() const;
@@ -87,6 +94,9 @@ protected:
                 unsigned int fullscreen  : 1;
                 unsigned int cursor      : 1;
                 unsigned int debug       : 1;
+                // Shaders decode compact vertex formats (see geom::Data::CompactVertex and
+                // Geometry3D::getDequantizationMatrix), otherwise they are uploaded as full vertices.
+                unsigned int compactVertexFormats : 1;
             };
             unsigned int all;
         } flags;
@@ -124,6 +134,7 @@ private:
 	unsigned int m_multisamplingQuality;
 	
 	std::list<std::weak_ptr<Destroyable> > m_destroyableList;
+	std::list<std::function<bool()> > m_completionHandlers;
 	
 	std::shared_ptr<Line3D> m_axisX;
 	std::shared_ptr<Line3D> m_axisY;
@@ -158,6 +169,7 @@ private:
 	void setUsingGpuProgram(std::weak_ptr<GpuProgram> program) { m_usingGpuProgram = program; }
 
 	void mainLoop();
+	void processCompletionHandlers();
 };
 
 }
@@ -62,17 +62,48 @@ DXGI_FORMAT getComponentFormat<float>(size_t sz)
 	return DXGI_FORMAT_UNKNOWN;
 }
 
+DXGI_FORMAT getComponentFormat(geom::Data::VertexComponentType type, size_t sz)
+{
+	switch (type)
+	{
+	case geom::Data::COMPONENT_HALF:
+		if (sz == 2) return DXGI_FORMAT_R16_FLOAT;
+		else if (sz == 4) return DXGI_FORMAT_R16G16_FLOAT;
+		else if (sz == 8) return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		return DXGI_FORMAT_UNKNOWN;
+
+	case geom::Data::COMPONENT_UNORM16:
+		if (sz == 2) return DXGI_FORMAT_R16_UNORM;
+		else if (sz == 4) return DXGI_FORMAT_R16G16_UNORM;
+		else if (sz == 8) return DXGI_FORMAT_R16G16B16A16_UNORM;
+		return DXGI_FORMAT_UNKNOWN;
+
+	case geom::Data::COMPONENT_UNORM_10_10_10_2:
+		return DXGI_FORMAT_R10G10B10A2_UNORM;
+	}
+	return getComponentFormat<float>(sz);
+}
+
 Geometry3D::Geometry3D() :
     m_vertexBuffer(0),
+	m_positionsBuffer(0),
+	m_defaultComponentsBuffer(0),
     m_indexBuffer(0),
+	m_culledIndexBuffer(0),
+	m_terrainIndexBuffer(0),
     m_additionalUVsCount(0),
     m_isLoaded(false),
+    m_isLoading(false),
+    m_loadingId(0),
 	m_verticesCount(0),
 	m_indicesCount(0),
 	m_vertexSize(0),
+	m_vertexFormat(geom::Data::VERTEX_FORMAT_FULL),
 	m_id(-1)
 {
-    
+	m_streamStrides[geom::Data::STREAM_POSITIONS] = 0;
+	m_streamStrides[geom::Data::STREAM_ATTRIBUTES] = 0;
+	m_streamStrides[DEFAULT_COMPONENTS_SLOT] = 0;
 }
 
 Geometry3D::~Geometry3D()
@@ -106,7 +137,10 @@ D3D11_BUFFER_DESC Geometry3D::getDefaultIndexBuffer(unsigned int size)
 void Geometry3D::destroy()
 {
 	m_isLoaded = false;
+	m_isLoading = false;
+	m_loadingId++;
     m_inputLayoutInfo.clear();
+	m_positionsInputLayoutInfo.clear();
 	m_inputLayoutCache.clear();
 	
 	if (m_vertexBuffer != 0)
@@ -115,12 +149,41 @@ void Geometry3D::destroy()
 		m_vertexBuffer = 0;
 	}
 
+	if (m_positionsBuffer != 0)
+	{
+		m_positionsBuffer->Release();
+		m_positionsBuffer = 0;
+	}
+
+	if (m_defaultComponentsBuffer != 0)
+	{
+		m_defaultComponentsBuffer->Release();
+		m_defaultComponentsBuffer = 0;
+	}
+
 	if (m_indexBuffer != 0)
 	{
 		m_indexBuffer->Release();
 		m_indexBuffer = 0;
 	}
 
+	if (m_culledIndexBuffer != 0)
+	{
+		m_culledIndexBuffer->Release();
+		m_culledIndexBuffer = 0;
+	}
+
+	if (m_terrainIndexBuffer != 0)
+	{
+		m_terrainIndexBuffer->Release();
+		m_terrainIndexBuffer = 0;
+	}
+	m_indices.clear();
+	m_culledIndices.clear();
+	m_culledIndicesCounts.clear();
+	m_terrainChunks = geom::TerrainChunks();
+	m_terrainDrawCalls.clear();
+
 	m_boundingBoxLine.reset();
 }
 
@@ -128,18 +191,81 @@ bool Geometry3D::init(const std::string& fileName, bool calculateAdjacency)
 {
 	destroy();
 
-	geom::Data data = geom::Geometry::instance().load(fileName);
+	geom::Data data = geom::Geometry::instance().loadMapped(fileName);
 	if (!data.isCorrect())
 	{
 		m_isLoaded = false;
 		utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", fileName.c_str());
 		return m_isLoaded;
 	}
-	m_filename = fileName;
 
+	bool result = init(fileName, data, calculateAdjacency);
+
+	// data is uploaded to GPU, so the mapped file is not necessary anymore
+	data.releaseMapping();
+	return result;
+}
+
+bool Geometry3D::init(const std::string& fileName, const geom::Data& data, bool calculateAdjacency)
+{
+	destroy();
+	m_filename = fileName;
 	return init(data, calculateAdjacency);
 }
 
+void Geometry3D::initAsync(const std::string& fileName, bool calculateAdjacency, const std::function<void(bool)>& onLoaded,
+						   const std::function<void(const geom::Data&)>& onDataLoaded)
+{
+	destroy();
+	if (!isSmartPointer())
+	{
+		geom::Data data = geom::Geometry::instance().loadMapped(fileName);
+		bool result = false;
+		if (data.isCorrect())
+		{
+			if (onDataLoaded) onDataLoaded(data);
+			result = init(fileName, data, calculateAdjacency);
+			data.releaseMapping();
+		}
+		else
+		{
+			utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", fileName.c_str());
+		}
+		if (onLoaded) onLoaded(result);
+		return;
+	}
+
+	m_filename = fileName;
+	m_isLoading = true;
+	unsigned int loadingId = m_loadingId;
+	std::weak_ptr<Geometry3D> weakThis = std::static_pointer_cast<Geometry3D>(shared_from_this());
+	auto data = std::make_shared<std::future<geom::Data> >(geom::Geometry::instance().loadAsync(fileName));
+	Application::instance()->addCompletionHandler([weakThis, data, loadingId, calculateAdjacency, onLoaded, onDataLoaded]()
+	{
+		if (data->wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+		// the object has been destroyed or reinitialized while loading
+		auto geometry = weakThis.lock();
+		if (!geometry || geometry->m_loadingId != loadingId) return true;
+		geometry->m_isLoading = false;
+
+		geom::Data loadedData = data->get();
+		bool result = false;
+		if (loadedData.isCorrect())
+		{
+			if (onDataLoaded) onDataLoaded(loadedData);
+			result = geometry->init(loadedData, calculateAdjacency);
+		}
+		else
+		{
+			utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", geometry->m_filename.c_str());
+		}
+
+		if (onLoaded) onLoaded(result);
+		return true;
+	});
+}
+
 bool Geometry3D::initAsPlane(const geom::PlaneGenerationInfo& info, bool calculateAdjacency)
 {
 	destroy();
@@ -173,11 +299,37 @@ bool Geometry3D::initAsTerrain(const geom::TerrainGenerationInfo& info, bool cal
 		return m_isLoaded;
 	}
 
-	return init(data, calculateAdjacency);
+	if (!init(data, calculateAdjacency)) return false;
+	m_terrainChunks = generator.getChunks();
+	if (!m_terrainChunks.isEmpty())
+	{
+		const Device& device = Application::instance()->getDevice();
+		const std::vector<unsigned int>& indices = m_terrainChunks.getIndexBuffer();
+		D3D11_BUFFER_DESC tibdesc = getDefaultIndexBuffer(indices.size() * sizeof(unsigned int));
+		D3D11_SUBRESOURCE_DATA tibdata;
+		tibdata.pSysMem = indices.data();
+		tibdata.SysMemPitch = 0;
+		tibdata.SysMemSlicePitch = 0;
+		HRESULT hr = device.device->CreateBuffer(&tibdesc, &tibdata, &m_terrainIndexBuffer);
+		if (hr != S_OK)
+		{
+			utils::Logger::toLog("Error: could not create an index buffer.\n");
+			destroy();
+			return false;
+		}
+	}
+	return true;
 }
 
 bool Geometry3D::init(const geom::Data& data, bool calculateAdjacency)
 {
+	// biased unit vectors, restored binormals and quantized positions must be decoded in shaders,
+	// so compact formats are converted to full vertices for applications without such shaders
+	if (data.getVertexFormat() != geom::Data::VERTEX_FORMAT_FULL && !Application::instance()->isCompactVertexFormatsEnabled())
+	{
+		return init(geom::VertexFormatConverter::convert(data, geom::Data::VERTEX_FORMAT_FULL), calculateAdjacency);
+	}
+
 	const Device& device = Application::instance()->getDevice();
 
 	if (calculateAdjacency)
@@ -189,31 +341,91 @@ bool Geometry3D::init(const geom::Data& data, bool calculateAdjacency)
 	m_additionalUVsCount = data.getAdditionalUVsCount();
 	m_meshes = data.getMeshes();
 	m_verticesCount = data.getVerticesCount();
-	m_indicesCount = data.getIndexBuffer().size();
+	m_indicesCount = data.getIndicesCount();
 	m_vertexSize = data.getVertexSize();
+	m_vertexFormat = data.getVertexFormat();
 
 	HRESULT hr = S_OK;
 
-	// input layout
-	m_inputLayoutInfo.resize(data.getVertexComponentsCount());
-	for (size_t component = 0; component < data.getVertexComponentsCount(); component++)
+	// input layout, positions and the rest of components are in separate slots,
+	// so depth-only passes fetch positions only
+	const geom::Data::VertexDeclaration& declaration = data.getVertexDeclaration();
+	m_inputLayoutInfo.reserve(declaration.size());
+	for (size_t component = 0; component < declaration.size(); component++)
 	{
-		size_t offset = data.getVertexComponentOffset(component);
-		size_t componentSize = data.getVertexComponentSize(component);
+		D3D11_INPUT_ELEMENT_DESC desc;
+		desc.SemanticName = data.getSemanticName(component);
+		desc.SemanticIndex = (UINT)declaration[component].semanticIndex;
+		desc.Format = getComponentFormat(declaration[component].type, declaration[component].size);
+		desc.InputSlot = (UINT)declaration[component].stream;
+		desc.AlignedByteOffset = (UINT)declaration[component].offsetInStream;
+		desc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		desc.InstanceDataStepRate = 0;
+		m_inputLayoutInfo.push_back(desc);
+		if (desc.InputSlot == geom::Data::STREAM_POSITIONS) m_positionsInputLayoutInfo.push_back(desc);
+	}
 
-		m_inputLayoutInfo[component].SemanticName = data.getSemanticName(component);
-		m_inputLayoutInfo[component].SemanticIndex = data.getSemanticIndex(component);
-		m_inputLayoutInfo[component].Format = getComponentFormat<float>(componentSize);
-		m_inputLayoutInfo[component].InputSlot = 0;
-		m_inputLayoutInfo[component].AlignedByteOffset = offset;
-		m_inputLayoutInfo[component].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-		m_inputLayoutInfo[component].InstanceDataStepRate = 0;
+	// components which are excluded from vertices are read as zeros from the additional slot
+	// with zero stride, so the same shaders can be used for any vertex declaration
+	unsigned int componentsMask = data.getVertexComponentsMask();
+	auto addDefaultComponent = [this](const char* semanticName)
+	{
+		D3D11_INPUT_ELEMENT_DESC desc;
+		desc.SemanticName = semanticName;
+		desc.SemanticIndex = 0;
+		desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		desc.InputSlot = DEFAULT_COMPONENTS_SLOT;
+		desc.AlignedByteOffset = 0;
+		desc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		desc.InstanceDataStepRate = 0;
+		m_inputLayoutInfo.push_back(desc);
+	};
+	if ((componentsMask & geom::Data::COMPONENTS_NORMAL) == 0) addDefaultComponent("NORMAL");
+	if ((componentsMask & geom::Data::COMPONENTS_TEXCOORD0) == 0) addDefaultComponent("TEXCOORD");
+	if ((componentsMask & geom::Data::COMPONENTS_TANGENT_FRAME) == 0)
+	{
+		addDefaultComponent("TANGENT");
+		if (m_vertexFormat == geom::Data::VERTEX_FORMAT_FULL) addDefaultComponent("BINORMAL");
+	}
+	if (componentsMask != geom::Data::COMPONENTS_ALL)
+	{
+		const float defaultComponents[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		D3D11_BUFFER_DESC dbdesc = getDefaultVertexBuffer(sizeof(defaultComponents));
+		D3D11_SUBRESOURCE_DATA dbdata;
+		dbdata.pSysMem = defaultComponents;
+		dbdata.SysMemPitch = 0;
+		dbdata.SysMemSlicePitch = 0;
+		hr = device.device->CreateBuffer(&dbdesc, &dbdata, &m_defaultComponentsBuffer);
+		if (hr != S_OK)
+		{
+			utils::Logger::toLog("Error: could not create a vertex buffer.\n");
+			return m_isLoaded;
+		}
 	}
 
-	// vertex buffer
-	D3D11_BUFFER_DESC vbdesc = getDefaultVertexBuffer(data.getVertexBuffer().size());
+	// vertex buffers, both streams are split in a single pass into one staging buffer
+	m_streamStrides[geom::Data::STREAM_POSITIONS] = (UINT)data.getVertexStreamStride(geom::Data::STREAM_POSITIONS);
+	m_streamStrides[geom::Data::STREAM_ATTRIBUTES] = (UINT)data.getVertexStreamStride(geom::Data::STREAM_ATTRIBUTES);
+	const size_t positionsSize = m_verticesCount * m_streamStrides[geom::Data::STREAM_POSITIONS];
+	const size_t attributesSize = m_verticesCount * m_streamStrides[geom::Data::STREAM_ATTRIBUTES];
+	std::vector<unsigned char> staging(positionsSize + attributesSize);
+	data.splitVertexStreams(staging.data(), staging.data() + positionsSize);
+
+	D3D11_BUFFER_DESC pbdesc = getDefaultVertexBuffer(positionsSize);
+	D3D11_SUBRESOURCE_DATA pbdata;
+	pbdata.pSysMem = staging.data();
+	pbdata.SysMemPitch = 0;
+	pbdata.SysMemSlicePitch = 0;
+	hr = device.device->CreateBuffer(&pbdesc, &pbdata, &m_positionsBuffer);
+	if (hr != S_OK)
+	{
+		utils::Logger::toLog("Error: could not create a vertex buffer.\n");
+		return m_isLoaded;
+	}
+
+	D3D11_BUFFER_DESC vbdesc = getDefaultVertexBuffer(attributesSize);
 	D3D11_SUBRESOURCE_DATA vbdata;
-	vbdata.pSysMem = data.getVertexBuffer().data();
+	vbdata.pSysMem = staging.data() + positionsSize;
 	vbdata.SysMemPitch = 0;
 	vbdata.SysMemSlicePitch = 0;
 	hr = device.device->CreateBuffer(&vbdesc, &vbdata, &m_vertexBuffer);
@@ -226,7 +438,7 @@ bool Geometry3D::init(const geom::Data& data, bool calculateAdjacency)
 	// index buffer
 	D3D11_BUFFER_DESC ibdesc = getDefaultIndexBuffer(m_indicesCount * sizeof(unsigned int));
 	D3D11_SUBRESOURCE_DATA ibdata;
-	ibdata.pSysMem = data.getIndexBuffer().data();
+	ibdata.pSysMem = data.getIndexData();
 	ibdata.SysMemPitch = 0;
 	ibdata.SysMemSlicePitch = 0;
 	hr = device.device->CreateBuffer(&ibdesc, &ibdata, &m_indexBuffer);
@@ -236,6 +448,27 @@ bool Geometry3D::init(const geom::Data& data, bool calculateAdjacency)
 		return m_isLoaded;
 	}
 
+	// dynamic index buffer for culled clusters
+	bool hasClusters = false;
+	for (size_t i = 0; i < m_meshes.size(); i++) hasClusters |= !m_meshes[i].clusters.empty();
+	if (hasClusters)
+	{
+		const unsigned int* indices = (const unsigned int*)data.getIndexData();
+		m_indices.assign(indices, indices + m_indicesCount);
+		m_culledIndices.reserve(m_indicesCount);
+		m_culledIndicesCounts.resize(m_meshes.size(), 0);
+
+		D3D11_BUFFER_DESC cibdesc = getDefaultIndexBuffer(m_indicesCount * sizeof(unsigned int));
+		cibdesc.Usage = D3D11_USAGE_DYNAMIC;
+		cibdesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		hr = device.device->CreateBuffer(&cibdesc, 0, &m_culledIndexBuffer);
+		if (hr != S_OK)
+		{
+			utils::Logger::toLog("Error: could not create an index buffer.\n");
+			return m_isLoaded;
+		}
+	}
+
 	m_isLoaded = true;
 	initDestroyable();
 	m_id = generateId();
@@ -243,12 +476,12 @@ bool Geometry3D::init(const geom::Data& data, bool calculateAdjacency)
 	return m_isLoaded;
 }
 
-void Geometry3D::bindToGpuProgram(std::shared_ptr<GpuProgram> program)
+void Geometry3D::bindToGpuProgram(std::shared_ptr<GpuProgram> program, bool positionsOnly)
 {
 	auto i = getInputLayoutBindingIndex(program->getId());
 	if (i < 0)
 	{
-		int index = program->bindInputLayoutInfo(m_inputLayoutInfo);
+		int index = program->bindInputLayoutInfo(positionsOnly ? m_positionsInputLayoutInfo : m_inputLayoutInfo);
 		m_inputLayoutCache.push_back(std::make_pair(program->getId(), index));
 	}
 }
@@ -271,6 +504,29 @@ size_t Geometry3D::getMeshesCount() const
     return m_meshes.size();
 }
 
+const bbox3& Geometry3D::getMeshBoundingBox(size_t index) const
+{
+	if (index >= m_meshes.size() || !m_meshes[index].hasBounds()) return m_boundingBox;
+	return m_meshes[index].boundingBox;
+}
+
+bool Geometry3D::isMeshVisible(size_t index, const matrix44& mvp) const
+{
+	if (index >= m_meshes.size()) return false;
+	return getMeshBoundingBox(index).clipstatus(mvp) != bbox3::Outside;
+}
+
+matrix44 Geometry3D::getDequantizationMatrix() const
+{
+	matrix44 m;
+	if (m_vertexFormat == geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED)
+	{
+		m.scale(m_boundingBox.size());
+		m.set_translation(m_boundingBox.vmin);
+	}
+	return m;
+}
+
 void Geometry3D::applyInputLayout()
 {
 	auto gpuProgram = Application::instance()->getUsingGpuProgram();
@@ -282,49 +538,238 @@ void Geometry3D::applyInputLayout()
 	}
 }
 
-void Geometry3D::renderMesh(size_t index, size_t instancesCount)
+void Geometry3D::applyVertexBuffers(bool positionsOnly)
+{
+	const Device& device = Application::instance()->getDevice();
+
+	applyInputLayout();
+	ID3D11Buffer* buffers[DEFAULT_COMPONENTS_SLOT + 1];
+	buffers[geom::Data::STREAM_POSITIONS] = m_positionsBuffer;
+	buffers[geom::Data::STREAM_ATTRIBUTES] = m_vertexBuffer;
+	buffers[DEFAULT_COMPONENTS_SLOT] = m_defaultComponentsBuffer;
+	UINT offsets[DEFAULT_COMPONENTS_SLOT + 1] = { 0, 0, 0 };
+	UINT buffersCount = positionsOnly ? 1 : (m_defaultComponentsBuffer != 0 ? DEFAULT_COMPONENTS_SLOT + 1 : geom::Data::STREAMS_COUNT);
+	device.context->IASetVertexBuffers(0, buffersCount, buffers, m_streamStrides, offsets);
+}
+
+size_t Geometry3D::getLodsCount(size_t index) const
+{
+	if (index >= m_meshes.size()) return 0;
+	return m_meshes[index].lods.size() + 1;
+}
+
+size_t Geometry3D::findLod(size_t index, float maxError) const
+{
+	if (index >= m_meshes.size()) return 0;
+
+	size_t lod = 0;
+	const geom::Data::Lods& lods = m_meshes[index].lods;
+	for (size_t i = 0; i < lods.size() && lods[i].error <= maxError; i++)
+	{
+		lod = i + 1;
+	}
+	return lod;
+}
+
+void Geometry3D::getLodRange(size_t index, size_t lod, size_t& offsetInIB, size_t& indicesCount) const
+{
+	const geom::Data::Mesh& mesh = m_meshes[index];
+	if (lod == 0 || mesh.lods.empty())
+	{
+		offsetInIB = mesh.offsetInIB;
+		indicesCount = mesh.indicesCount;
+		return;
+	}
+
+	const geom::Data::Lod& meshLod = mesh.lods[std::min(lod, mesh.lods.size()) - 1];
+	offsetInIB = meshLod.offsetInIB;
+	indicesCount = meshLod.indicesCount;
+}
+
+void Geometry3D::renderMesh(size_t index, size_t instancesCount, size_t lod)
 {
     if (index >= m_meshes.size()) return;
 
 	const Device& device = Application::instance()->getDevice();
 
-	applyInputLayout();
-	UINT vertexStride = m_vertexSize;
-	UINT vertexOffset = 0;
-	device.context->IASetVertexBuffers(0, 1, &m_vertexBuffer, &vertexStride, &vertexOffset);
+	size_t offsetInIB = 0, indicesCount = 0;
+	getLodRange(index, lod, offsetInIB, indicesCount);
+
+	applyVertexBuffers();
 	device.context->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
     device.context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	if (instancesCount <= 1)
 	{
-		device.context->DrawIndexed(m_meshes[index].indicesCount, m_meshes[index].offsetInIB, 0);
+		device.context->DrawIndexed(indicesCount, offsetInIB, 0);
 	}
 	else
 	{
-		device.context->DrawIndexedInstanced(m_meshes[index].indicesCount, instancesCount, m_meshes[index].offsetInIB, 0, 0);
+		device.context->DrawIndexedInstanced(indicesCount, instancesCount, offsetInIB, 0, 0);
 	}
 }
 
-void Geometry3D::renderAllMeshes(size_t instancesCount)
+void Geometry3D::renderMeshPositions(size_t index, size_t instancesCount, size_t lod)
 {
+	if (index >= m_meshes.size()) return;
+
 	const Device& device = Application::instance()->getDevice();
 
-	applyInputLayout();
-	UINT vertexStride = m_vertexSize;
-	UINT vertexOffset = 0;
-	device.context->IASetVertexBuffers(0, 1, &m_vertexBuffer, &vertexStride, &vertexOffset);
+	size_t offsetInIB = 0, indicesCount = 0;
+	getLodRange(index, lod, offsetInIB, indicesCount);
+
+	applyVertexBuffers(true);
+	device.context->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	device.context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (instancesCount <= 1)
+	{
+		device.context->DrawIndexed(indicesCount, offsetInIB, 0);
+	}
+	else
+	{
+		device.context->DrawIndexedInstanced(indicesCount, instancesCount, offsetInIB, 0, 0);
+	}
+}
+
+void Geometry3D::renderAllMeshes(size_t instancesCount, size_t lod)
+{
+	const Device& device = Application::instance()->getDevice();
+
+	applyVertexBuffers();
 	device.context->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 	device.context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	for (size_t i = 0; i < m_meshes.size(); i++)
 	{
+		size_t offsetInIB = 0, indicesCount = 0;
+		getLodRange(i, lod, offsetInIB, indicesCount);
 		if (instancesCount <= 1)
 		{
-			device.context->DrawIndexed(m_meshes[i].indicesCount, m_meshes[i].offsetInIB, 0);
+			device.context->DrawIndexed(indicesCount, offsetInIB, 0);
+		}
+		else
+		{
+			device.context->DrawIndexedInstanced(indicesCount, instancesCount, offsetInIB, 0, 0);
+		}
+	}
+}
+
+size_t Geometry3D::cullClusters(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition)
+{
+	if (m_culledIndexBuffer == 0) return 0;
+
+	matrix44 mvp = model * viewProjection;
+	matrix44 invModel = model;
+	invModel.invert();
+	vector3 localCameraPosition = invModel.transform_coord(cameraPosition);
+
+	size_t visibleClustersCount = 0;
+	m_culledIndices.clear();
+	for (size_t i = 0; i < m_meshes.size(); i++)
+	{
+		const geom::Data::Mesh& mesh = m_meshes[i];
+		size_t offset = m_culledIndices.size();
+		if (!isMeshVisible(i, mvp))
+		{
+			m_culledIndicesCounts[i] = 0;
+			continue;
+		}
+		if (mesh.clusters.empty())
+		{
+			m_culledIndices.insert(m_culledIndices.end(), m_indices.begin() + mesh.offsetInIB,
+								   m_indices.begin() + mesh.offsetInIB + mesh.indicesCount);
 		}
 		else
 		{
-			device.context->DrawIndexedInstanced(m_meshes[i].indicesCount, instancesCount, m_meshes[i].offsetInIB, 0, 0);
+			for (size_t c = 0; c < mesh.clusters.size(); c++)
+			{
+				const geom::Data::Cluster& cluster = mesh.clusters[c];
+				if (geom::ClusterBuilder::isBackfacing(cluster, localCameraPosition)) continue;
+
+				bbox3 box(cluster.center, vector3(cluster.radius, cluster.radius, cluster.radius));
+				if (box.clipstatus(mvp) == bbox3::Outside) continue;
+
+				m_culledIndices.insert(m_culledIndices.end(), m_indices.begin() + cluster.offsetInIB,
+									   m_indices.begin() + cluster.offsetInIB + cluster.indicesCount);
+				visibleClustersCount++;
+			}
+		}
+		m_culledIndicesCounts[i] = m_culledIndices.size() - offset;
+	}
+
+	if (!m_culledIndices.empty())
+	{
+		const Device& device = Application::instance()->getDevice();
+
+		D3D11_MAPPED_SUBRESOURCE data;
+		data.pData = NULL;
+		data.DepthPitch = data.RowPitch = 0;
+		HRESULT hr = device.context->Map(m_culledIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &data);
+		if (hr != S_OK)
+		{
+			utils::Logger::toLog("Error: could not update an index buffer.\n");
+			std::fill(m_culledIndicesCounts.begin(), m_culledIndicesCounts.end(), 0);
+			return 0;
 		}
+		memcpy(data.pData, m_culledIndices.data(), m_culledIndices.size() * sizeof(unsigned int));
+		device.context->Unmap(m_culledIndexBuffer, 0);
+	}
+
+	return visibleClustersCount;
+}
+
+void Geometry3D::renderCulledMesh(size_t index, size_t instancesCount)
+{
+	if (m_culledIndexBuffer == 0)
+	{
+		renderMesh(index, instancesCount);
+		return;
+	}
+	if (index >= m_meshes.size() || m_culledIndicesCounts[index] == 0) return;
+
+	const Device& device = Application::instance()->getDevice();
+
+	size_t offsetInIB = 0;
+	for (size_t i = 0; i < index; i++) offsetInIB += m_culledIndicesCounts[i];
+	size_t indicesCount = m_culledIndicesCounts[index];
+
+	applyVertexBuffers();
+	device.context->IASetIndexBuffer(m_culledIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	device.context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (instancesCount <= 1)
+	{
+		device.context->DrawIndexed(indicesCount, offsetInIB, 0);
+	}
+	else
+	{
+		device.context->DrawIndexedInstanced(indicesCount, instancesCount, offsetInIB, 0, 0);
+	}
+}
+
+size_t Geometry3D::renderTerrain(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition,
+								 float pixelsPerUnit, float maxPixelError)
+{
+	if (m_terrainChunks.isEmpty())
+	{
+		renderAllMeshes();
+		return 0;
+	}
+
+	matrix44 mvp = model * viewProjection;
+	matrix44 invModel = model;
+	invModel.invert();
+	m_terrainChunks.select(invModel.transform_coord(cameraPosition), mvp, pixelsPerUnit, maxPixelError, m_terrainDrawCalls);
+	if (m_terrainDrawCalls.empty()) return 0;
+
+	const Device& device = Application::instance()->getDevice();
+
+	applyVertexBuffers();
+	device.context->IASetIndexBuffer(m_terrainIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	device.context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	for (size_t i = 0; i < m_terrainDrawCalls.size(); i++)
+	{
+		const geom::TerrainDrawCall& drawCall = m_terrainDrawCalls[i];
+		device.context->DrawIndexed(drawCall.indicesCount, drawCall.offsetInIB, (INT)drawCall.baseVertex);
 	}
+	return m_terrainDrawCalls.size();
 }
 
 void Geometry3D::renderBoundingBox(const matrix44& mvp)
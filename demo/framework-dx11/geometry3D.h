@@ -26,6 +26,8 @@
 #include "geometry.h"
 #include "planegenerator.h"
 #include "terraingenerator.h"
+#include "clusterbuilder.h"
+#include "vertexformat.h"
 
 namespace framework
 {
@@ -45,28 +47,77 @@ public:
 	static D3D11_BUFFER_DESC getDefaultIndexBuffer(unsigned int size);
 	
 	bool init(const std::string& fileName, bool calculateAdjacency = false);
+	// uploads data which has been loaded from the file
+	bool init(const std::string& fileName, const geom::Data& data, bool calculateAdjacency = false);
+	// The file is read and decoded on a worker thread, data is uploaded on the render thread
+	// via the application's completion handlers. onLoaded is called after uploading, onDataLoaded
+	// is called on the render thread with correct decoded data before uploading.
+	// Objects which are not owned by std::shared_ptr are loaded synchronously.
+	void initAsync(const std::string& fileName, bool calculateAdjacency = false, const std::function<void(bool)>& onLoaded = nullptr,
+				   const std::function<void(const geom::Data&)>& onDataLoaded = nullptr);
+	bool isLoaded() const { return m_isLoaded; }
+	bool isLoading() const { return m_isLoading; }
 	bool initAsPlane(const geom::PlaneGenerationInfo& info, bool calculateAdjacency = false);
 	bool initAsTerrain(const geom::TerrainGenerationInfo& info, bool calculateAdjacency = false);
 
-	void bindToGpuProgram(std::shared_ptr<GpuProgram> program);
+	// programs which are bound with positionsOnly (their vertex shaders take POSITION only)
+	// render meshes via renderMeshPositions
+	void bindToGpuProgram(std::shared_ptr<GpuProgram> program, bool positionsOnly = false);
 
 	const std::vector<D3D11_INPUT_ELEMENT_DESC>& getInputLayoutInfo() const { return m_inputLayoutInfo; }
 	const bbox3& getBoundingBox() const { return m_boundingBox; }
+	// bounding box of a mesh in the space of the geometry (see geom::Data::Mesh::boundingBox),
+	// the bounding box of the whole geometry is returned for meshes without bounds
+	const bbox3& getMeshBoundingBox(size_t index) const;
+	// frustum test of a mesh, mvp = model * viewProjection
+	bool isMeshVisible(size_t index, const matrix44& mvp) const;
 
 	const std::vector<geom::Data::TriangleAdjacency>& getAdjacency() const { return m_adjacency; }
     
     size_t getMeshesCount() const;
 	const geom::Data::Meshes& getMeshes() const { return m_meshes; }
-	void renderMesh(size_t index, size_t instancesCount = 1);
-	void renderAllMeshes(size_t instancesCount = 1);
+	// LOD 0 is the mesh itself, LODs which are out of range are clamped to the last one
+	size_t getLodsCount(size_t index) const;
+	// returns the coarsest LOD which error (relative to the mesh size) is not greater than maxError
+	size_t findLod(size_t index, float maxError) const;
+
+	void renderMesh(size_t index, size_t instancesCount = 1, size_t lod = 0);
+	void renderAllMeshes(size_t instancesCount = 1, size_t lod = 0);
+	// renders the mesh with positions only, it's intended for depth-only passes
+	void renderMeshPositions(size_t index, size_t instancesCount = 1, size_t lod = 0);
 	void renderBoundingBox(const matrix44& mvp);
 
+	// gathers clusters which are visible from the camera (frustum and normal cone tests) into
+	// the dynamic index buffer, meshes without clusters are kept entirely. Positions of the camera
+	// are in world space. Returns the number of visible clusters.
+	size_t cullClusters(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition);
+	// renders the result of the last cullClusters call
+	void renderCulledMesh(size_t index, size_t instancesCount = 1);
+	bool hasClusters() const { return m_culledIndexBuffer != 0; }
+
+	// renders chunks of a terrain (see geom::TerrainGenerationInfo::chunkSize) which are visible from the camera,
+	// LODs are selected by screen-space error, pixelsPerUnit = 0.5 * screen height * projection.M22.
+	// The model matrix must not scale the terrain. Terrains without chunks are rendered entirely.
+	// Returns the number of rendered chunks.
+	size_t renderTerrain(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition, 
+						 float pixelsPerUnit, float maxPixelError);
+	bool isChunkedTerrain() const { return !m_terrainChunks.isEmpty(); }
+
 	int getID() const { return m_id; }
 	const std::string& getFilename() const { return m_filename; }
 	size_t getVertexSize() const { return m_vertexSize; }
+	// vertex components except positions (see geom::Data::STREAM_ATTRIBUTES)
 	ID3D11Buffer* getVertexBuffer() const { return m_vertexBuffer; }
+	ID3D11Buffer* getPositionsBuffer() const { return m_positionsBuffer; }
+	geom::Data::VertexFormat getVertexFormat() const { return m_vertexFormat; }
+
+	// transforms quantized positions from [0; 1] to the bounding box space,
+	// it must be applied before the model matrix (identity for not quantized formats)
+	matrix44 getDequantizationMatrix() const;
 
 	void applyInputLayout();
+	// applies the input layout and binds vertex buffers of all streams or the positions stream only
+	void applyVertexBuffers(bool positionsOnly = false);
 
 private:
 	geom::Data::Meshes m_meshes;
@@ -74,23 +125,44 @@ private:
 	size_t m_verticesCount;
 	size_t m_indicesCount;
 	size_t m_vertexSize;
+	geom::Data::VertexFormat m_vertexFormat;
 	bbox3 m_boundingBox;
 
 	std::vector<geom::Data::TriangleAdjacency> m_adjacency;
 
+	// CPU copy of indices is kept for clusters culling only
+	std::vector<unsigned int> m_indices;
+	std::vector<unsigned int> m_culledIndices;
+	std::vector<size_t> m_culledIndicesCounts;
+
+	geom::TerrainChunks m_terrainChunks;
+	std::vector<geom::TerrainDrawCall> m_terrainDrawCalls;
+
 	std::vector<D3D11_INPUT_ELEMENT_DESC> m_inputLayoutInfo;
+	std::vector<D3D11_INPUT_ELEMENT_DESC> m_positionsInputLayoutInfo;
 	ID3D11Buffer* m_vertexBuffer;
+	ID3D11Buffer* m_positionsBuffer;
+	// zeros for components which are absent in vertices, see geom::Data::VertexComponentsMask
+	enum { DEFAULT_COMPONENTS_SLOT = geom::Data::STREAMS_COUNT };
+	ID3D11Buffer* m_defaultComponentsBuffer;
+	UINT m_streamStrides[DEFAULT_COMPONENTS_SLOT + 1];
 	ID3D11Buffer* m_indexBuffer;
+	ID3D11Buffer* m_culledIndexBuffer;
+	// index patterns of terrain chunks
+	ID3D11Buffer* m_terrainIndexBuffer;
 	typedef std::pair<int, int> InputLayoutPair_T;
 	std::list<InputLayoutPair_T> m_inputLayoutCache;
 
 	bool m_isLoaded;
+	bool m_isLoading;
+	unsigned int m_loadingId;
 	std::shared_ptr<Line3D> m_boundingBoxLine;
 
 	std::string m_filename;
 	int m_id;
 
 	bool init(const geom::Data& data, bool calculateAdjacency);
+	void getLodRange(size_t index, size_t lod, size_t& offsetInIB, size_t& indicesCount) const;
 	int getInputLayoutBindingIndex(int programId) const;
 	static int generateId();
 
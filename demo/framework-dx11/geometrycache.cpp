@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "geometrycache.h"
+
+namespace framework
+{
+
+GeometryCache& GeometryCache::instance()
+{
+	static GeometryCache cache;
+	return cache;
+}
+
+GeometryCache::GeometryCache() :
+	m_hitsCount(0),
+	m_missesCount(0)
+{
+}
+
+GeometryCache::~GeometryCache()
+{
+}
+
+std::shared_ptr<Geometry3D> GeometryCache::load(const std::string& fileName, bool calculateAdjacency)
+{
+	PathKey pathKey(utils::Archive::normalizePath(fileName), calculateAdjacency);
+	auto pathIt = m_paths.find(pathKey);
+	if (pathIt != m_paths.end())
+	{
+		std::shared_ptr<Geometry3D> geometry = pathIt->second.lock();
+		if (isUsable(geometry, false)) return hit(geometry);
+	}
+
+	geom::Data data = geom::Geometry::instance().loadMapped(fileName);
+	if (!data.isCorrect())
+	{
+		miss();
+		utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", fileName.c_str());
+		return nullptr;
+	}
+
+	// the same content under another path, the file has been read already but uploading is skipped
+	ContentKey contentKey(data.computeHash(), calculateAdjacency);
+	auto contentIt = m_contents.find(contentKey);
+	if (contentIt != m_contents.end())
+	{
+		std::shared_ptr<Geometry3D> geometry = contentIt->second.lock();
+		if (isUsable(geometry, false))
+		{
+			m_paths[pathKey] = geometry;
+			return hit(geometry);
+		}
+	}
+
+	miss();
+	std::shared_ptr<Geometry3D> geometry(new Geometry3D());
+	bool result = geometry->init(fileName, data, calculateAdjacency);
+	data.releaseMapping();
+	if (!result) return nullptr;
+
+	m_paths[pathKey] = geometry;
+	addContent(contentKey, geometry);
+	return geometry;
+}
+
+std::shared_ptr<Geometry3D> GeometryCache::loadAsync(const std::string& fileName, bool calculateAdjacency, 
+													 const std::function<void(bool)>& onLoaded)
+{
+	PathKey pathKey(utils::Archive::normalizePath(fileName), calculateAdjacency);
+	auto pathIt = m_paths.find(pathKey);
+	std::shared_ptr<Geometry3D> geometry = pathIt != m_paths.end() ? pathIt->second.lock() : nullptr;
+	if (isUsable(geometry, true))
+	{
+		hit(geometry);
+		if (!onLoaded) return geometry;
+
+		std::weak_ptr<Geometry3D> weakGeometry = geometry;
+		Application::instance()->addCompletionHandler([weakGeometry, onLoaded]()
+		{
+			auto geometry = weakGeometry.lock();
+			if (geometry && geometry->isLoading()) return false;
+			onLoaded(geometry && geometry->isLoaded());
+			return true;
+		});
+		return geometry;
+	}
+
+	miss();
+	geometry.reset(new Geometry3D());
+	std::weak_ptr<Geometry3D> weakGeometry = geometry;
+	geometry->initAsync(fileName, calculateAdjacency, onLoaded, [this, weakGeometry, calculateAdjacency](const geom::Data& data)
+	{
+		// the data is in memory already, hashing is cheaper than uploading
+		auto geometry = weakGeometry.lock();
+		if (geometry) addContent(ContentKey(data.computeHash(), calculateAdjacency), geometry);
+	});
+	m_paths[pathKey] = geometry;
+	return geometry;
+}
+
+void GeometryCache::destroy()
+{
+	m_paths.clear();
+	m_contents.clear();
+}
+
+bool GeometryCache::isUsable(const std::shared_ptr<Geometry3D>& geometry, bool isLoadingAllowed)
+{
+	// failed loads are repeated
+	return geometry && (geometry->isLoaded() || (isLoadingAllowed && geometry->isLoading()));
+}
+
+void GeometryCache::addContent(const ContentKey& contentKey, const std::shared_ptr<Geometry3D>& geometry)
+{
+	// the first usable geometry is kept, so paths of copies share it
+	std::weak_ptr<Geometry3D>& entry = m_contents[contentKey];
+	if (!isUsable(entry.lock(), true)) entry = geometry;
+}
+
+std::shared_ptr<Geometry3D> GeometryCache::hit(const std::shared_ptr<Geometry3D>& geometry)
+{
+	m_hitsCount++;
+	utils::Profiler::instance().addToCounter("GeometryCache hits");
+	return geometry;
+}
+
+void GeometryCache::miss()
+{
+	m_missesCount++;
+	utils::Profiler::instance().addToCounter("GeometryCache misses");
+	removeExpired();
+}
+
+void GeometryCache::removeExpired()
+{
+	for (auto it = m_paths.begin(); it != m_paths.end();)
+	{
+		if (it->second.expired()) it = m_paths.erase(it);
+		else ++it;
+	}
+	for (auto it = m_contents.begin(); it != m_contents.end();)
+	{
+		if (it->second.expired()) it = m_contents.erase(it);
+		else ++it;
+	}
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __GEOMETRY_CACHE_H__
+#define __GEOMETRY_CACHE_H__
+
+namespace framework
+{
+
+class Geometry3D;
+
+// Shares geometries between repeated loads. Geometries are found by the path or by the hash 
+// of the loaded data (see geom::Data::computeHash), so copies of a file are uploaded once too. 
+// The cache keeps weak references, a geometry is destroyed as soon as its last owner releases it. 
+// Hits and misses are reported to the profiler ("GeometryCache hits", "GeometryCache misses").
+class GeometryCache
+{
+public:
+	static GeometryCache& instance();
+
+	// Returns nullptr if the geometry could not be loaded. Geometries which are still being loaded
+	// asynchronously are not returned, the file is loaded again. Data is hashed after decoding,
+	// so files are read once, copies are not uploaded.
+	std::shared_ptr<Geometry3D> load(const std::string& fileName, bool calculateAdjacency = false);
+	// The file is loaded asynchronously on a miss (see Geometry3D::initAsync), only paths are compared 
+	// to keep reading of files out of the render thread. Loaded data is registered by its hash for
+	// following synchronous loads. onLoaded is called on hits too, as soon as the shared geometry is loaded.
+	std::shared_ptr<Geometry3D> loadAsync(const std::string& fileName, bool calculateAdjacency = false, 
+										  const std::function<void(bool)>& onLoaded = nullptr);
+
+	size_t getHitsCount() const { return m_hitsCount; }
+	size_t getMissesCount() const { return m_missesCount; }
+
+	void destroy();
+
+private:
+	GeometryCache();
+	~GeometryCache();
+
+	typedef std::pair<std::string, bool> PathKey;
+	typedef std::pair<unsigned long long, bool> ContentKey;
+	std::map<PathKey, std::weak_ptr<Geometry3D> > m_paths;
+	std::map<ContentKey, std::weak_ptr<Geometry3D> > m_contents;
+	size_t m_hitsCount;
+	size_t m_missesCount;
+
+	// loading geometries are usable for asynchronous loads only
+	static bool isUsable(const std::shared_ptr<Geometry3D>& geometry, bool isLoadingAllowed);
+	void addContent(const ContentKey& contentKey, const std::shared_ptr<Geometry3D>& geometry);
+	std::shared_ptr<Geometry3D> hit(const std::shared_ptr<Geometry3D>& geometry);
+	void miss();
+	void removeExpired();
+};
+
+}
+
+#endif
@@ -114,16 +114,14 @@ public:
 
 	HRESULT __stdcall Open(D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, LPCVOID pParentData, LPCVOID *ppData, UINT *pBytes)
 	{
+		// includes are resolved through the archive too
 		std::string path = m_shaderPath + pFileName;
-		std::ifstream includeFile(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-
-		if (includeFile.is_open()) 
+		std::string source;
+		if (utils::Utils::readFileToString(path, source)) 
 		{
-			unsigned int fileSize = (unsigned int)includeFile.tellg();
+			unsigned int fileSize = (unsigned int)source.size() - 1;
 			char* buf = new char[fileSize];
-			includeFile.seekg(0, std::ios::beg);
-			includeFile.read(buf, fileSize);
-			includeFile.close();
+			memcpy(buf, source.data(), fileSize);
 			*ppData = buf;
 			*pBytes = fileSize;
 		}
@@ -30,6 +30,9 @@
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <future>
+#include <chrono>
+#include <thread>
 #include <sstream>
 #include <functional>
 #include <utility>
@@ -53,6 +56,7 @@
 #include "profiler.h"
 #include "inputkeys.h"
 #include "fpscounter.h"
+#include "archive.h"
 #include "profiler.h"
 
 #include "outputd3d11.h"
@@ -80,6 +84,7 @@
 #include "lightManager.h"
 
 #include "materialmanager.h"
+#include "geometrycache.h"
 
 #include "uimanager.h"
 #include "uifactoryd3d11.h"
@@ -55,19 +55,30 @@ namespace
 			return false;
 		}
 
+		// packed images are decoded right from the mapped archive
+		const unsigned char* packedData = 0;
+		size_t packedSize = 0;
+		FIMEMORY* memory = 0;
+		if (utils::Archive::instance().find(fileName, packedData, packedSize))
+		{
+			memory = FreeImage_OpenMemory((BYTE*)packedData, (DWORD)packedSize);
+		}
+
 		FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
-		fif = FreeImage_GetFileType(fileName.c_str(), 0);
+		fif = memory != 0 ? FreeImage_GetFileTypeFromMemory(memory, 0) : FreeImage_GetFileType(fileName.c_str(), 0);
 		if (fif == FIF_UNKNOWN)
 		{
 			fif = FreeImage_GetFIFFromFilename(fileName.c_str());
 		}
 		if (fif == FIF_UNKNOWN)
 		{
+			if (memory != 0) FreeImage_CloseMemory(memory);
 			utils::Logger::toLogWithFormat("Error: format of file '%s' is unknown.\n", fileName.c_str());
 			return false;
 		}
 
-		info.dib = FreeImage_Load(fif, fileName.c_str());
+		info.dib = memory != 0 ? FreeImage_LoadFromMemory(fif, memory, 0) : FreeImage_Load(fif, fileName.c_str());
+		if (memory != 0) FreeImage_CloseMemory(memory);
 		if (info.dib == 0)
 		{
 			utils::Logger::toLogWithFormat("Error: could not load file '%s'.\n", fileName.c_str());
@@ -102,13 +113,21 @@ public:
 			return false;
 		}
 
-		// path to unicode
-		std::wstring unicodeFileName = utils::Utils::toUnicode(fileName);
-
-		// load texture
+		// load texture, packed textures are created right from the mapped archive
 		const Device& device = Application::instance()->getDevice();
 		ID3D11Resource* resource = 0;
-		HRESULT hr = DirectX::CreateDDSTextureFromFile(device.device, unicodeFileName.c_str(), (ID3D11Resource**)&resource, &texture->m_view);
+		HRESULT hr = S_OK;
+		const unsigned char* packedData = 0;
+		size_t packedSize = 0;
+		if (utils::Archive::instance().find(fileName, packedData, packedSize))
+		{
+			hr = DirectX::CreateDDSTextureFromMemory(device.device, packedData, packedSize, (ID3D11Resource**)&resource, &texture->m_view);
+		}
+		else
+		{
+			std::wstring unicodeFileName = utils::Utils::toUnicode(fileName);
+			hr = DirectX::CreateDDSTextureFromFile(device.device, unicodeFileName.c_str(), (ID3D11Resource**)&resource, &texture->m_view);
+		}
 		if (hr != S_OK)
 		{
 			utils::Logger::toLogWithFormat("Error: could not load a texture '%s'.\n", fileName.c_str());
@@ -39,6 +39,7 @@ Application::AppInfo::AppInfo() :
 	flags.vsync = 0;
 	flags.cursor = 1;
 	flags.useStencil = 0;
+	flags.compactVertexFormats = 0;
 	#ifdef _DEBUG
 	flags.debug = 1;
 	#else
@@ -68,7 +69,12 @@ int Application::run(Application* self, const std::string& commandLine)
 		return EXIT_FAILURE;
 	}
 
-	if (!utils::Utils::exists("data"))
+	// packed assets are preferred, files which are not packed are loaded from the data directory
+	if (utils::Archive::instance().open("data.pack"))
+	{
+		utils::Logger::toLogWithFormat("Archive 'data.pack' is opened, %d files.\n", (int)utils::Archive::instance().getFilesCount());
+	}
+	else if (!utils::Utils::exists("data"))
 	{
 		utils::Logger::toLog("Error: could not find data directory. Probably working directory has not been set correctly (especially if you are running from IDE).\n");
 		return EXIT_FAILURE;
@@ -119,11 +125,15 @@ int Application::run(Application* self, const std::string& commandLine)
 	mainLoop();
 
 	shutdown();
+	geom::Geometry::instance().finishAsyncLoading();
+	m_completionHandlers.clear();
 	MaterialManager::instance().destroy();
+	GeometryCache::instance().destroy();
 	destroyAllDestroyable();
 	destroyGui();
 	Texture::cleanup();
 	m_context.destroy();
+	utils::Archive::instance().close();
 
 	return EXIT_SUCCESS;
 }
@@ -146,6 +156,8 @@ void Application::mainLoop()
 			m_isRunning = false;
 		}
 
+		processCompletionHandlers();
+
 		// rendering
 		double curTime = m_timer.getTime();
 		if (m_lastTime == 0) m_lastTime = curTime;
@@ -172,6 +184,29 @@ void Application::mainLoop()
 	}
 }
 
+void Application::addCompletionHandler(const std::function<bool()>& handler)
+{
+	m_completionHandlers.push_back(handler);
+}
+
+void Application::processCompletionHandlers()
+{
+	for (auto it = m_completionHandlers.begin(); it != m_completionHandlers.end();)
+	{
+		if ((*it)()) it = m_completionHandlers.erase(it);
+		else ++it;
+	}
+}
+
+void Application::waitForCompletionHandlers()
+{
+	while (!m_completionHandlers.empty())
+	{
+		processCompletionHandlers();
+		if (!m_completionHandlers.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
 void Application::exit()
 {
 	m_isRunning = false;
@@ -182,6 +217,11 @@ bool Application::isDebugEnabled() const
 	return m_info.flags.debug != 0;
 }
 
+bool Application::isCompactVertexFormatsEnabled() const
+{
+	return m_info.flags.compactVertexFormats != 0;
+}
+
 void Application::resize()
 {
 	gui::UIManager::instance().setScreenSize((size_t)m_info.windowWidth, (size_t)m_info.windowHeight);
@@ -50,7 +50,14 @@ public:
 	int run(Application* self, const std::string& commandLine);
 	void exit();
 	void resize();
+
+	// the handler is called on the render thread once per frame until it returns true
+	void addCompletionHandler(const std::function<bool()>& handler);
+	// blocks until all completion handlers return true
+	void waitForCompletionHandlers();
 	bool isDebugEnabled() const;
+	// see AppInfo::flags.compactVertexFormats
+	bool isCompactVertexFormatsEnabled() const;
 	vector2 getScreenSize();
 
 protected:
@@ -69,6 +76,9 @@ protected:
                 unsigned int cursor      : 1;
                 unsigned int debug       : 1;
 				unsigned int useStencil  : 1;
+				// Shaders decode compact vertex formats (see geom::Data::CompactVertex and
+				// Geometry3D::getDequantizationMatrix), otherwise they are uploaded as full vertices.
+				unsigned int compactVertexFormats : 1;
             };
             unsigned int	 all;
         } flags;
@@ -101,6 +111,7 @@ private:
 	utils::FpsCounter m_fpsCounter;
 
 	std::list<std::weak_ptr<Destroyable> > m_destroyableList;
+	std::list<std::function<bool()> > m_completionHandlers;
 	std::shared_ptr<Line3D> m_axisX;
 	std::shared_ptr<Line3D> m_axisY;
 	std::shared_ptr<Line3D> m_axisZ;
@@ -115,6 +126,7 @@ private:
 	void initInput();
 
 	void mainLoop();
+	void processCompletionHandlers();
 
 	static void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, GLvoid* userParam);
 };
@@ -29,12 +29,49 @@ namespace framework
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
+void getVertexAttribFormat(geom::Data::VertexComponentType type, size_t componentSize, 
+						   GLint& elementsCount, GLenum& glType, GLboolean& normalized)
+{
+	switch (type)
+	{
+	case geom::Data::COMPONENT_HALF:
+		elementsCount = (GLint)(componentSize / sizeof(unsigned short));
+		glType = GL_HALF_FLOAT;
+		normalized = GL_FALSE;
+		break;
+
+	case geom::Data::COMPONENT_UNORM16:
+		elementsCount = (GLint)(componentSize / sizeof(unsigned short));
+		glType = GL_UNSIGNED_SHORT;
+		normalized = GL_TRUE;
+		break;
+
+	case geom::Data::COMPONENT_UNORM_10_10_10_2:
+		elementsCount = 4;
+		glType = GL_UNSIGNED_INT_2_10_10_10_REV;
+		normalized = GL_TRUE;
+		break;
+
+	default:
+		elementsCount = (GLint)(componentSize / sizeof(float));
+		glType = GL_FLOAT;
+		normalized = GL_FALSE;
+	}
+}
+
 Geometry3D::Geometry3D() :
     m_vertexArray(0),
+	m_positionsVertexArray(0),
     m_vertexBuffer(0),
+	m_positionsBuffer(0),
     m_indexBuffer(0),
+	m_culledIndexBuffer(0),
+	m_terrainIndexBuffer(0),
     m_additionalUVsCount(0),
+	m_vertexFormat(geom::Data::VERTEX_FORMAT_FULL),
     m_isLoaded(false),
+    m_isLoading(false),
+    m_loadingId(0),
 	m_verticesCount(0),
 	m_indicesCount(0),
 	m_id(-1)
@@ -55,39 +92,132 @@ void Geometry3D::destroy()
 		m_vertexBuffer = 0;
 	}
 
+	if (m_positionsBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_positionsBuffer);
+		m_positionsBuffer = 0;
+	}
+
 	if (m_indexBuffer != 0)
 	{
 		glDeleteBuffers(1, &m_indexBuffer);
 		m_indexBuffer = 0;
 	}
 
+	if (m_culledIndexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_culledIndexBuffer);
+		m_culledIndexBuffer = 0;
+	}
+	if (m_terrainIndexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_terrainIndexBuffer);
+		m_terrainIndexBuffer = 0;
+	}
+	m_indices.clear();
+	m_culledIndices.clear();
+	m_culledIndicesCounts.clear();
+	m_terrainChunks = geom::TerrainChunks();
+	m_terrainDrawCalls.clear();
+
 	if (m_vertexArray != 0)
 	{
         glDeleteVertexArrays(1, &m_vertexArray);
 		m_vertexArray = 0;
     }
 
+	if (m_positionsVertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_positionsVertexArray);
+		m_positionsVertexArray = 0;
+	}
+
 	m_boundingBoxLine.reset();
 
 	m_isLoaded = false;
+	m_isLoading = false;
+	m_loadingId++;
 }
 
 bool Geometry3D::init(const std::string& fileName, bool calculateAdjacency)
 {
 	destroy();
 
-	geom::Data data = geom::Geometry::instance().load(fileName);
+	geom::Data data = geom::Geometry::instance().loadMapped(fileName);
 	if (!data.isCorrect())
 	{
 		m_isLoaded = false;
 		utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", fileName.c_str());
 		return m_isLoaded;
 	}
-	m_filename = fileName;
 
+	bool result = init(fileName, data, calculateAdjacency);
+
+	// data is uploaded to GPU, so the mapped file is not necessary anymore
+	data.releaseMapping();
+	return result;
+}
+
+bool Geometry3D::init(const std::string& fileName, const geom::Data& data, bool calculateAdjacency)
+{
+	destroy();
+	m_filename = fileName;
 	return init(data, calculateAdjacency);
 }
 
+void Geometry3D::initAsync(const std::string& fileName, bool calculateAdjacency, const std::function<void(bool)>& onLoaded,
+						   const std::function<void(const geom::Data&)>& onDataLoaded)
+{
+	destroy();
+	if (!isSmartPointer())
+	{
+		geom::Data data = geom::Geometry::instance().loadMapped(fileName);
+		bool result = false;
+		if (data.isCorrect())
+		{
+			if (onDataLoaded) onDataLoaded(data);
+			result = init(fileName, data, calculateAdjacency);
+			data.releaseMapping();
+		}
+		else
+		{
+			utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", fileName.c_str());
+		}
+		if (onLoaded) onLoaded(result);
+		return;
+	}
+
+	m_filename = fileName;
+	m_isLoading = true;
+	unsigned int loadingId = m_loadingId;
+	std::weak_ptr<Geometry3D> weakThis = std::static_pointer_cast<Geometry3D>(shared_from_this());
+	auto data = std::make_shared<std::future<geom::Data> >(geom::Geometry::instance().loadAsync(fileName));
+	Application::instance()->addCompletionHandler([weakThis, data, loadingId, calculateAdjacency, onLoaded, onDataLoaded]()
+	{
+		if (data->wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+		// the object has been destroyed or reinitialized while loading
+		auto geometry = weakThis.lock();
+		if (!geometry || geometry->m_loadingId != loadingId) return true;
+		geometry->m_isLoading = false;
+
+		geom::Data loadedData = data->get();
+		bool result = false;
+		if (loadedData.isCorrect())
+		{
+			if (onDataLoaded) onDataLoaded(loadedData);
+			result = geometry->init(loadedData, calculateAdjacency);
+		}
+		else
+		{
+			utils::Logger::toLogWithFormat("Error: could not load geometry from '%s'.\n", geometry->m_filename.c_str());
+		}
+
+		if (onLoaded) onLoaded(result);
+		return true;
+	});
+}
+
 bool Geometry3D::initAsPlane(const geom::PlaneGenerationInfo& info, bool calculateAdjacency)
 {
 	destroy();
@@ -121,51 +251,126 @@ bool Geometry3D::initAsTerrain(const geom::TerrainGenerationInfo& info, bool cal
 		return m_isLoaded;
 	}
 
-	return init(data, calculateAdjacency);
+	if (!init(data, calculateAdjacency)) return false;
+	m_terrainChunks = generator.getChunks();
+	if (!m_terrainChunks.isEmpty())
+	{
+		const std::vector<unsigned int>& indices = m_terrainChunks.getIndexBuffer();
+		glGenBuffers(1, &m_terrainIndexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_terrainIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		if (CHECK_GL_ERROR)
+		{
+			destroy();
+			return false;
+		}
+	}
+	return true;
 }
 
 bool Geometry3D::init(const geom::Data& data, bool calculateAdjacency)
 {
+	// biased unit vectors, restored binormals and quantized positions must be decoded in shaders,
+	// so compact formats are converted to full vertices for applications without such shaders
+	if (data.getVertexFormat() != geom::Data::VERTEX_FORMAT_FULL && !Application::instance()->isCompactVertexFormatsEnabled())
+	{
+		return init(geom::VertexFormatConverter::convert(data, geom::Data::VERTEX_FORMAT_FULL), calculateAdjacency);
+	}
+
 	m_boundingBox = data.getBoundingBox();
 	m_additionalUVsCount = data.getAdditionalUVsCount();
+	m_vertexFormat = data.getVertexFormat();
 	m_meshes = data.getMeshes();
 	m_verticesCount = data.getVerticesCount();
-	m_indicesCount = data.getIndexBuffer().size();
+	m_indicesCount = data.getIndicesCount();
 	if (calculateAdjacency)
 	{
 		m_adjacency = data.calculateAdjacency();
 	}
 
+	// positions and the rest of components are stored in separate vertex buffers,
+	// so depth-only passes fetch positions only. Streams are scattered right into 
+	// the mapped buffers, vertices are not copied in the system memory.
+	const size_t positionsSize = m_verticesCount * data.getVertexStreamStride(geom::Data::STREAM_POSITIONS);
+	const size_t attributesSize = m_verticesCount * data.getVertexStreamStride(geom::Data::STREAM_ATTRIBUTES);
+	const GLbitfield mappingFlags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+	GLuint streamBuffers[geom::Data::STREAMS_COUNT];
+	glGenBuffers(1, &m_positionsBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_positionsBuffer);
+	glBufferData(GL_ARRAY_BUFFER, positionsSize, 0, GL_STATIC_DRAW);
+	unsigned char* positions = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, positionsSize, mappingFlags);
+	streamBuffers[geom::Data::STREAM_POSITIONS] = m_positionsBuffer;
 	glGenBuffers(1, &m_vertexBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-	glGenVertexArrays(1, &m_vertexArray);
-	glBindVertexArray(m_vertexArray);
-	for (size_t component = 0; component < data.getVertexComponentsCount(); component++)
+	glBufferData(GL_ARRAY_BUFFER, attributesSize, 0, GL_STATIC_DRAW);
+	unsigned char* attributes = attributesSize != 0 ? (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, attributesSize, mappingFlags) : 0;
+	streamBuffers[geom::Data::STREAM_ATTRIBUTES] = m_vertexBuffer;
+
+	bool isMapped = positions != 0 && (attributes != 0 || attributesSize == 0);
+	if (isMapped) data.splitVertexStreams(positions, attributes);
+	if (attributes != 0 && glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) isMapped = false;
+	glBindBuffer(GL_ARRAY_BUFFER, m_positionsBuffer);
+	if (positions != 0 && glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) isMapped = false;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (!isMapped)
 	{
-		size_t offset = data.getVertexComponentOffset(component);
-		size_t componentSize = data.getVertexComponentSize(component);
+		utils::Logger::toLog("Error: could not fill vertex buffers.\n");
+		destroy();
+		return false;
+	}
 
-		// vertex declaration
-		glVertexAttribPointer((GLuint)component,
-							  (GLuint)(componentSize / sizeof(float)),
-							  GL_FLOAT,
-							  GL_FALSE,
-							  (GLuint)data.getVertexSize(),
-							  BUFFER_OFFSET(offset));
-		glEnableVertexAttribArray((GLuint)component);
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenVertexArrays(1, &m_positionsVertexArray);
+	// attributes are bound to fixed locations, so shaders don't depend on the vertex declaration.
+	// Attributes which are absent in vertices are disabled, shaders read (0, 0, 0, 1) from them.
+	const geom::Data::VertexDeclaration& declaration = data.getVertexDeclaration();
+	for (size_t component = 0; component < declaration.size(); component++)
+	{
+		GLint elementsCount = 0;
+		GLenum glType = GL_FLOAT;
+		GLboolean normalized = GL_FALSE;
+		getVertexAttribFormat(declaration[component].type, declaration[component].size, elementsCount, glType, normalized);
+		size_t stream = declaration[component].stream;
+		GLuint stride = (GLuint)data.getVertexStreamStride(stream);
+		size_t offset = declaration[component].offsetInStream;
+		GLuint location = (GLuint)declaration[component].location;
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffers[stream]);
+		glBindVertexArray(m_vertexArray);
+		glVertexAttribPointer(location, elementsCount, glType, normalized, stride, BUFFER_OFFSET(offset));
+		glEnableVertexAttribArray(location);
+		if (stream == geom::Data::STREAM_POSITIONS)
+		{
+			glBindVertexArray(m_positionsVertexArray);
+			glVertexAttribPointer(location, elementsCount, glType, normalized, stride, BUFFER_OFFSET(offset));
+			glEnableVertexAttribArray(location);
+		}
 	}
 	glBindVertexArray(0);
-
-	// vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, data.getVertexBuffer().size(), data.getVertexBuffer().data(), GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	
 	// index buffer
 	glGenBuffers(1, &m_indexBuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indicesCount * sizeof(unsigned int), data.getIndexBuffer().data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indicesCount * sizeof(unsigned int), data.getIndexData(), GL_STATIC_DRAW);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+	// dynamic index buffer for culled clusters
+	bool hasClusters = false;
+	for (size_t i = 0; i < m_meshes.size(); i++) hasClusters |= !m_meshes[i].clusters.empty();
+	if (hasClusters)
+	{
+		const unsigned int* indices = (const unsigned int*)data.getIndexData();
+		m_indices.assign(indices, indices + m_indicesCount);
+		m_culledIndices.reserve(m_indicesCount);
+		m_culledIndicesCounts.resize(m_meshes.size(), 0);
+
+		glGenBuffers(1, &m_culledIndexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_culledIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indicesCount * sizeof(unsigned int), 0, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
 	if (CHECK_GL_ERROR)
 	{
 		destroy();
@@ -184,24 +389,103 @@ size_t Geometry3D::getMeshesCount() const
     return m_meshes.size();
 }
 
-void Geometry3D::renderMesh(size_t index, size_t instancesCount)
+const bbox3& Geometry3D::getMeshBoundingBox(size_t index) const
+{
+	if (index >= m_meshes.size() || !m_meshes[index].hasBounds()) return m_boundingBox;
+	return m_meshes[index].boundingBox;
+}
+
+bool Geometry3D::isMeshVisible(size_t index, const matrix44& mvp) const
+{
+	if (index >= m_meshes.size()) return false;
+	return getMeshBoundingBox(index).clipstatus(mvp) != bbox3::Outside;
+}
+
+matrix44 Geometry3D::getDequantizationMatrix() const
+{
+	matrix44 m;
+	if (m_vertexFormat == geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED)
+	{
+		m.scale(m_boundingBox.size());
+		m.set_translation(m_boundingBox.vmin);
+	}
+	return m;
+}
+
+size_t Geometry3D::getLodsCount(size_t index) const
+{
+	if (index >= m_meshes.size()) return 0;
+	return m_meshes[index].lods.size() + 1;
+}
+
+size_t Geometry3D::findLod(size_t index, float maxError) const
+{
+	if (index >= m_meshes.size()) return 0;
+
+	size_t lod = 0;
+	const geom::Data::Lods& lods = m_meshes[index].lods;
+	for (size_t i = 0; i < lods.size() && lods[i].error <= maxError; i++)
+	{
+		lod = i + 1;
+	}
+	return lod;
+}
+
+void Geometry3D::getLodRange(size_t index, size_t lod, size_t& offsetInIB, size_t& indicesCount) const
+{
+	const geom::Data::Mesh& mesh = m_meshes[index];
+	if (lod == 0 || mesh.lods.empty())
+	{
+		offsetInIB = mesh.offsetInIB;
+		indicesCount = mesh.indicesCount;
+		return;
+	}
+
+	const geom::Data::Lod& meshLod = mesh.lods[std::min(lod, mesh.lods.size()) - 1];
+	offsetInIB = meshLod.offsetInIB;
+	indicesCount = meshLod.indicesCount;
+}
+
+void Geometry3D::renderMesh(size_t index, size_t instancesCount, size_t lod)
 {
     if (index >= m_meshes.size() || instancesCount == 0) return;
     
+	size_t offsetInIB = 0, indicesCount = 0;
+	getLodRange(index, lod, offsetInIB, indicesCount);
+
     glBindVertexArray(m_vertexArray);
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
 	if (instancesCount == 1)
 	{
-		glDrawElements(GL_TRIANGLES, (int)m_meshes[index].indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(m_meshes[index].offsetInIB * sizeof(unsigned int)));
+		glDrawElements(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)));
 	}
 	else
 	{
-		glDrawElementsInstanced(GL_TRIANGLES, (int)m_meshes[index].indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(m_meshes[index].offsetInIB * sizeof(unsigned int)), instancesCount);
+		glDrawElementsInstanced(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)), instancesCount);
 	}	
 }
 
-void Geometry3D::renderAllMeshes(size_t instancesCount)
+void Geometry3D::renderMeshPositions(size_t index, size_t instancesCount, size_t lod)
+{
+	if (index >= m_meshes.size() || instancesCount == 0) return;
+
+	size_t offsetInIB = 0, indicesCount = 0;
+	getLodRange(index, lod, offsetInIB, indicesCount);
+
+	glBindVertexArray(m_positionsVertexArray);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	if (instancesCount == 1)
+	{
+		glDrawElements(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)));
+	}
+	else
+	{
+		glDrawElementsInstanced(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)), instancesCount);
+	}
+}
+
+void Geometry3D::renderAllMeshes(size_t instancesCount, size_t lod)
 {
 	if (instancesCount == 0) return;
 
@@ -210,17 +494,125 @@ void Geometry3D::renderAllMeshes(size_t instancesCount)
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
 	for (size_t i = 0; i < m_meshes.size(); i++)
 	{
+		size_t offsetInIB = 0, indicesCount = 0;
+		getLodRange(i, lod, offsetInIB, indicesCount);
 		if (instancesCount == 1)
 		{
-			glDrawElements(GL_TRIANGLES, (int)m_meshes[i].indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(m_meshes[i].offsetInIB * sizeof(unsigned int)));
+			glDrawElements(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)));
 		}
 		else
 		{
-			glDrawElementsInstanced(GL_TRIANGLES, (int)m_meshes[i].indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(m_meshes[i].offsetInIB * sizeof(unsigned int)), instancesCount);
+			glDrawElementsInstanced(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)), instancesCount);
 		}
 	}
 }
 
+size_t Geometry3D::cullClusters(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition)
+{
+	if (m_culledIndexBuffer == 0) return 0;
+
+	matrix44 mvp = model * viewProjection;
+	matrix44 invModel = model;
+	invModel.invert();
+	vector3 localCameraPosition = invModel.transform_coord(cameraPosition);
+
+	size_t visibleClustersCount = 0;
+	m_culledIndices.clear();
+	for (size_t i = 0; i < m_meshes.size(); i++)
+	{
+		const geom::Data::Mesh& mesh = m_meshes[i];
+		size_t offset = m_culledIndices.size();
+		if (!isMeshVisible(i, mvp))
+		{
+			m_culledIndicesCounts[i] = 0;
+			continue;
+		}
+		if (mesh.clusters.empty())
+		{
+			m_culledIndices.insert(m_culledIndices.end(), m_indices.begin() + mesh.offsetInIB,
+								   m_indices.begin() + mesh.offsetInIB + mesh.indicesCount);
+		}
+		else
+		{
+			for (size_t c = 0; c < mesh.clusters.size(); c++)
+			{
+				const geom::Data::Cluster& cluster = mesh.clusters[c];
+				if (geom::ClusterBuilder::isBackfacing(cluster, localCameraPosition)) continue;
+
+				bbox3 box(cluster.center, vector3(cluster.radius, cluster.radius, cluster.radius));
+				if (box.clipstatus(mvp) == bbox3::Outside) continue;
+
+				m_culledIndices.insert(m_culledIndices.end(), m_indices.begin() + cluster.offsetInIB,
+									   m_indices.begin() + cluster.offsetInIB + cluster.indicesCount);
+				visibleClustersCount++;
+			}
+		}
+		m_culledIndicesCounts[i] = m_culledIndices.size() - offset;
+	}
+
+	if (!m_culledIndices.empty())
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_culledIndexBuffer);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_culledIndices.size() * sizeof(unsigned int), m_culledIndices.data());
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	return visibleClustersCount;
+}
+
+void Geometry3D::renderCulledMesh(size_t index, size_t instancesCount)
+{
+	if (m_culledIndexBuffer == 0)
+	{
+		renderMesh(index, instancesCount);
+		return;
+	}
+	if (index >= m_meshes.size() || instancesCount == 0 || m_culledIndicesCounts[index] == 0) return;
+
+	size_t offsetInIB = 0;
+	for (size_t i = 0; i < index; i++) offsetInIB += m_culledIndicesCounts[i];
+	size_t indicesCount = m_culledIndicesCounts[index];
+
+	glBindVertexArray(m_vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_culledIndexBuffer);
+	if (instancesCount == 1)
+	{
+		glDrawElements(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)));
+	}
+	else
+	{
+		glDrawElementsInstanced(GL_TRIANGLES, (int)indicesCount, GL_UNSIGNED_INT, (const GLvoid *)(offsetInIB * sizeof(unsigned int)), instancesCount);
+	}
+}
+
+size_t Geometry3D::renderTerrain(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition,
+								 float pixelsPerUnit, float maxPixelError)
+{
+	if (m_terrainChunks.isEmpty())
+	{
+		renderAllMeshes();
+		return 0;
+	}
+
+	matrix44 mvp = model * viewProjection;
+	matrix44 invModel = model;
+	invModel.invert();
+	m_terrainChunks.select(invModel.transform_coord(cameraPosition), mvp, pixelsPerUnit, maxPixelError, m_terrainDrawCalls);
+	if (m_terrainDrawCalls.empty()) return 0;
+
+	glBindVertexArray(m_vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_terrainIndexBuffer);
+	for (size_t i = 0; i < m_terrainDrawCalls.size(); i++)
+	{
+		const geom::TerrainDrawCall& drawCall = m_terrainDrawCalls[i];
+		glDrawElementsBaseVertex(GL_TRIANGLES, (int)drawCall.indicesCount, GL_UNSIGNED_INT, 
+								 (const GLvoid *)(drawCall.offsetInIB * sizeof(unsigned int)), (GLint)drawCall.baseVertex);
+	}
+	return m_terrainDrawCalls.size();
+}
+
 void Geometry3D::renderBoundingBox(const matrix44& mvp)
 {
 	if (!m_boundingBoxLine)
@@ -27,6 +27,8 @@
 #include "geometry.h"
 #include "planegenerator.h"
 #include "terraingenerator.h"
+#include "clusterbuilder.h"
+#include "vertexformat.h"
 
 namespace framework
 {
@@ -42,42 +44,105 @@ public:
     virtual ~Geometry3D();
 	
 	bool init(const std::string& fileName, bool calculateAdjacency = false);
+	// uploads data which has been loaded from the file
+	bool init(const std::string& fileName, const geom::Data& data, bool calculateAdjacency = false);
+	// The file is read and decoded on a worker thread, data is uploaded on the render thread
+	// via the application's completion handlers. onLoaded is called after uploading, onDataLoaded
+	// is called on the render thread with correct decoded data before uploading.
+	// Objects which are not owned by std::shared_ptr are loaded synchronously.
+	void initAsync(const std::string& fileName, bool calculateAdjacency = false, const std::function<void(bool)>& onLoaded = nullptr,
+				   const std::function<void(const geom::Data&)>& onDataLoaded = nullptr);
+	bool isLoaded() const { return m_isLoaded; }
+	bool isLoading() const { return m_isLoading; }
 	bool initAsTerrain(const geom::TerrainGenerationInfo& info, bool calculateAdjacency = false);
 	bool initAsPlane(const geom::PlaneGenerationInfo& info, bool calculateAdjacency = false);
 
     size_t getMeshesCount() const;
 	const geom::Data::Meshes& getMeshes() const { return m_meshes; }
 	const bbox3& getBoundingBox() const { return m_boundingBox; }
+	// bounding box of a mesh in the space of the geometry (see geom::Data::Mesh::boundingBox),
+	// the bounding box of the whole geometry is returned for meshes without bounds
+	const bbox3& getMeshBoundingBox(size_t index) const;
+	// frustum test of a mesh, mvp = model * viewProjection
+	bool isMeshVisible(size_t index, const matrix44& mvp) const;
 	int getID() const { return m_id; }
 	const std::string& getFilename() const { return m_filename; }
 	const std::vector<geom::Data::TriangleAdjacency>& getAdjacency() const { return m_adjacency; }
 	GLuint getVertexArray() const { return m_vertexArray; }
+	// vertex components except positions (see geom::Data::STREAM_ATTRIBUTES)
 	GLuint getVertexBuffer() const { return m_vertexBuffer; }
-
-    void renderMesh(size_t index, size_t instancesCount = 1);
-	void renderAllMeshes(size_t instancesCount = 1);
+	GLuint getPositionsVertexArray() const { return m_positionsVertexArray; }
+	GLuint getPositionsBuffer() const { return m_positionsBuffer; }
+	geom::Data::VertexFormat getVertexFormat() const { return m_vertexFormat; }
+	
+	// transforms quantized positions from [0; 1] to the bounding box space,
+	// it must be applied before the model matrix (identity for not quantized formats)
+	matrix44 getDequantizationMatrix() const;
+
+	// LOD 0 is the mesh itself, LODs which are out of range are clamped to the last one
+	size_t getLodsCount(size_t index) const;
+	// returns the coarsest LOD which error (relative to the mesh size) is not greater than maxError
+	size_t findLod(size_t index, float maxError) const;
+
+    void renderMesh(size_t index, size_t instancesCount = 1, size_t lod = 0);
+	void renderAllMeshes(size_t instancesCount = 1, size_t lod = 0);
+	// renders the mesh with positions only (vertex attribute 0), it's intended for depth-only passes
+	void renderMeshPositions(size_t index, size_t instancesCount = 1, size_t lod = 0);
 	void renderBoundingBox(const matrix44& mvp);
 
+	// gathers clusters which are visible from the camera (frustum and normal cone tests) into
+	// the dynamic index buffer, meshes without clusters are kept entirely. Positions of the camera
+	// are in world space. Returns the number of visible clusters.
+	size_t cullClusters(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition);
+	// renders the result of the last cullClusters call
+	void renderCulledMesh(size_t index, size_t instancesCount = 1);
+	bool hasClusters() const { return m_culledIndexBuffer != 0; }
+
+	// renders chunks of a terrain (see geom::TerrainGenerationInfo::chunkSize) which are visible from the camera,
+	// LODs are selected by screen-space error, pixelsPerUnit = 0.5 * screen height * projection.M22.
+	// The model matrix must not scale the terrain. Terrains without chunks are rendered entirely.
+	// Returns the number of rendered chunks.
+	size_t renderTerrain(const matrix44& model, const matrix44& viewProjection, const vector3& cameraPosition, 
+						 float pixelsPerUnit, float maxPixelError);
+	bool isChunkedTerrain() const { return !m_terrainChunks.isEmpty(); }
+
 private:
 	GLuint m_vertexArray;
+	GLuint m_positionsVertexArray;
 	GLuint m_vertexBuffer;
+	GLuint m_positionsBuffer;
 	GLuint m_indexBuffer;
+	GLuint m_culledIndexBuffer;
+	// index patterns of terrain chunks
+	GLuint m_terrainIndexBuffer;
 
 	geom::Data::Meshes m_meshes;
 	size_t m_additionalUVsCount;
+	geom::Data::VertexFormat m_vertexFormat;
 	size_t m_verticesCount;
 	size_t m_indicesCount;
 	bbox3 m_boundingBox;
 
 	std::vector<geom::Data::TriangleAdjacency> m_adjacency;
 
+	// CPU copy of indices is kept for clusters culling only
+	std::vector<unsigned int> m_indices;
+	std::vector<unsigned int> m_culledIndices;
+	std::vector<size_t> m_culledIndicesCounts;
+
+	geom::TerrainChunks m_terrainChunks;
+	std::vector<geom::TerrainDrawCall> m_terrainDrawCalls;
+
 	std::string m_filename;
 	int m_id;
 
 	bool m_isLoaded;
+	bool m_isLoading;
+	unsigned int m_loadingId;
 	std::shared_ptr<Line3D> m_boundingBoxLine;
 
 	bool init(const geom::Data& data, bool calculateAdjacency);
+	void getLodRange(size_t index, size_t lod, size_t& offsetInIB, size_t& indicesCount) const;
 	static int generateId();
 	virtual void destroy();
 };
@@ -30,6 +30,9 @@
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <future>
+#include <chrono>
+#include <thread>
 #include <functional>
 #include <sstream>
 
@@ -53,6 +56,7 @@
 #include "profiler.h"
 #include "inputkeys.h"
 #include "fpscounter.h"
+#include "archive.h"
 #include "profiler.h"
 
 #include "destroyable.h"
@@ -70,6 +74,7 @@
 #include "lightManager.h"
 
 #include "materialmanager.h"
+#include "geometrycache.h"
 
 #include "uimanager.h"
 #include "uifactory.h"
@@ -54,19 +54,30 @@ namespace
 			return false;
 		}
 
+		// packed images are decoded right from the mapped archive
+		const unsigned char* packedData = 0;
+		size_t packedSize = 0;
+		FIMEMORY* memory = 0;
+		if (utils::Archive::instance().find(fileName, packedData, packedSize))
+		{
+			memory = FreeImage_OpenMemory((BYTE*)packedData, (DWORD)packedSize);
+		}
+
 		FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
-		fif = FreeImage_GetFileType(fileName.c_str(), 0);
+		fif = memory != 0 ? FreeImage_GetFileTypeFromMemory(memory, 0) : FreeImage_GetFileType(fileName.c_str(), 0);
 		if (fif == FIF_UNKNOWN)
 		{
 			fif = FreeImage_GetFIFFromFilename(fileName.c_str());
 		}
 		if (fif == FIF_UNKNOWN)
 		{
+			if (memory != 0) FreeImage_CloseMemory(memory);
 			utils::Logger::toLogWithFormat("Error: format of file '%s' is unknown.\n", fileName.c_str());
 			return false;
 		}
 
-		info.dib = FreeImage_Load(fif, fileName.c_str());
+		info.dib = memory != 0 ? FreeImage_LoadFromMemory(fif, memory, 0) : FreeImage_Load(fif, fileName.c_str());
+		if (memory != 0) FreeImage_CloseMemory(memory);
 		if (info.dib == 0)
 		{
 			utils::Logger::toLogWithFormat("Error: could not load file '%s'.\n", fileName.c_str());
@@ -212,7 +223,16 @@ public:
         KTX_dimensions dim;
         GLboolean hasMips = 0;
         GLenum error = 0;
-        result = ktxLoadTextureN(fileName.c_str(), &tex, &target, &dim, &hasMips, &error, NULL, NULL);
+        const unsigned char* packedData = 0;
+        size_t packedSize = 0;
+        if (utils::Archive::instance().find(fileName, packedData, packedSize))
+        {
+            result = ktxLoadTextureM(packedData, (GLsizei)packedSize, &tex, &target, &dim, &hasMips, &error, NULL, NULL);
+        }
+        else
+        {
+            result = ktxLoadTextureN(fileName.c_str(), &tex, &target, &dim, &hasMips, &error, NULL, NULL);
+        }
         if (result != KTX_SUCCESS)
         {
 			utils::Logger::toLog(std::string("Error: failed to load a texture, ") + fileName);
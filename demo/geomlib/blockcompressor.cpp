@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "blockcompressor.h"
+
+namespace geom
+{
+
+namespace
+{
+	const size_t MIN_MATCH = 4;
+	const size_t MAX_OFFSET = 65535;
+	const unsigned int HASH_BITS = 14;
+	const size_t WORD_SIZE = 4;
+
+	inline unsigned int readWord(const unsigned char* ptr)
+	{
+		unsigned int v = 0;
+		memcpy(&v, ptr, sizeof(v));
+		return v;
+	}
+
+	inline unsigned int hashWord(unsigned int v)
+	{
+		return (v * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// the tail which doesn't make a whole word is kept in place
+	void shuffle(const unsigned char* src, size_t size, unsigned char* dst)
+	{
+		size_t wordsCount = size / WORD_SIZE;
+		unsigned char* dst0 = dst;
+		unsigned char* dst1 = dst + wordsCount;
+		unsigned char* dst2 = dst + wordsCount * 2;
+		unsigned char* dst3 = dst + wordsCount * 3;
+		for (size_t i = 0; i < wordsCount; i++, src += WORD_SIZE)
+		{
+			dst0[i] = src[0];
+			dst1[i] = src[1];
+			dst2[i] = src[2];
+			dst3[i] = src[3];
+		}
+		memcpy(dst + wordsCount * WORD_SIZE, src, size - wordsCount * WORD_SIZE);
+	}
+
+	void unshuffle(const unsigned char* src, size_t size, unsigned char* dst)
+	{
+		size_t wordsCount = size / WORD_SIZE;
+		const unsigned char* src0 = src;
+		const unsigned char* src1 = src + wordsCount;
+		const unsigned char* src2 = src + wordsCount * 2;
+		const unsigned char* src3 = src + wordsCount * 3;
+		for (size_t i = 0; i < wordsCount; i++, dst += WORD_SIZE)
+		{
+			dst[0] = src0[i];
+			dst[1] = src1[i];
+			dst[2] = src2[i];
+			dst[3] = src3[i];
+		}
+		memcpy(dst, src + wordsCount * WORD_SIZE, size - wordsCount * WORD_SIZE);
+	}
+
+	bool writeLength(unsigned char*& op, const unsigned char* opEnd, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			if (op >= opEnd) return false;
+			*op++ = 255;
+		}
+		if (op >= opEnd) return false;
+		*op++ = (unsigned char)length;
+		return true;
+	}
+
+	bool readLength(const unsigned char*& ip, const unsigned char* ipEnd, size_t maxLength, size_t& length)
+	{
+		unsigned char b = 0;
+		do
+		{
+			if (ip >= ipEnd) return false;
+			b = *ip++;
+			length += b;
+		}
+		while (b == 255 && length <= maxLength);
+		return length <= maxLength;
+	}
+
+	// the last sequence has no match (matchLength is 0)
+	bool writeSequence(unsigned char*& op, const unsigned char* opEnd, const unsigned char* literals, size_t literalsCount, size_t offset, size_t matchLength)
+	{
+		if (op >= opEnd) return false;
+		unsigned char* token = op++;
+		*token = (unsigned char)(std::min(literalsCount, (size_t)15) << 4);
+		if (literalsCount >= 15 && !writeLength(op, opEnd, literalsCount - 15)) return false;
+		if ((size_t)(opEnd - op) < literalsCount) return false;
+		memcpy(op, literals, literalsCount);
+		op += literalsCount;
+		if (matchLength == 0) return true;
+
+		if (opEnd - op < 2) return false;
+		*op++ = (unsigned char)(offset & 0xff);
+		*op++ = (unsigned char)(offset >> 8);
+		size_t length = matchLength - MIN_MATCH;
+		*token |= (unsigned char)std::min(length, (size_t)15);
+		return length < 15 || writeLength(op, opEnd, length - 15);
+	}
+}
+
+bool BlockCompressor::compress(const unsigned char* data, size_t size, std::vector<unsigned char>& result, size_t blockSize)
+{
+	if (size == 0 || blockSize == 0) return false;
+	size_t blocksCount = (size + blockSize - 1) / blockSize;
+
+	// incompressible blocks are stored as is
+	std::vector<std::vector<unsigned char> > blocks(blocksCount);
+	utils::Parallel::forRange(blocksCount, [&](size_t begin, size_t end, size_t)
+	{
+		std::vector<unsigned char> shuffled;
+		for (size_t b = begin; b < end; b++)
+		{
+			const unsigned char* block = data + b * blockSize;
+			size_t blockLength = std::min(blockSize, size - b * blockSize);
+			shuffled.resize(blockLength);
+			shuffle(block, blockLength, shuffled.data());
+			blocks[b].resize(blockLength);
+			size_t compressedSize = compressBlock(shuffled.data(), blockLength, blocks[b].data());
+			if (compressedSize != 0) blocks[b].resize(compressedSize);
+			else blocks[b].assign(block, block + blockLength);
+		}
+	});
+
+	size_t compressedSize = 16 + blocksCount * 4;
+	for (size_t b = 0; b < blocksCount; b++) compressedSize += blocks[b].size();
+	if (compressedSize >= size) return false;
+
+	result.clear();
+	result.reserve(compressedSize);
+	writeLittleEndian64(result, size);
+	writeLittleEndian32(result, (unsigned int)blockSize);
+	writeLittleEndian32(result, (unsigned int)blocksCount);
+	for (size_t b = 0; b < blocksCount; b++) writeLittleEndian32(result, (unsigned int)blocks[b].size());
+	for (size_t b = 0; b < blocksCount; b++) result.insert(result.end(), blocks[b].begin(), blocks[b].end());
+	return true;
+}
+
+unsigned long long BlockCompressor::getDecompressedSize(const unsigned char* data, size_t size)
+{
+	if (size < 16) return 0;
+	unsigned long long resultSize = readLittleEndian64(data);
+	unsigned long long blockSize = readLittleEndian32(data + 8);
+	size_t blocksCount = readLittleEndian32(data + 12);
+	if (resultSize == 0 || blockSize == 0 || blocksCount > (size - 16) / 4) return 0;
+	if ((resultSize + blockSize - 1) / blockSize != blocksCount) return 0;
+	return resultSize;
+}
+
+bool BlockCompressor::decompress(const unsigned char* data, size_t size, unsigned char* result, size_t resultSize)
+{
+	if (resultSize == 0 || getDecompressedSize(data, size) != resultSize) return false;
+	size_t blockSize = readLittleEndian32(data + 8);
+	size_t blocksCount = readLittleEndian32(data + 12);
+
+	std::vector<size_t> offsets(blocksCount + 1);
+	offsets[0] = 16 + blocksCount * 4;
+	for (size_t b = 0; b < blocksCount; b++)
+	{
+		size_t compressedSize = readLittleEndian32(data + 16 + b * 4);
+		if (compressedSize == 0 || compressedSize > std::min(blockSize, resultSize - b * blockSize)) return false;
+		offsets[b + 1] = offsets[b] + compressedSize;
+	}
+	if (offsets[blocksCount] != size) return false;
+
+	std::vector<char> decompressed(blocksCount, 0);
+	utils::Parallel::forRange(blocksCount, [&](size_t begin, size_t end, size_t)
+	{
+		std::vector<unsigned char> shuffled;
+		for (size_t b = begin; b < end; b++)
+		{
+			unsigned char* block = result + b * blockSize;
+			size_t blockLength = std::min(blockSize, resultSize - b * blockSize);
+			size_t compressedSize = offsets[b + 1] - offsets[b];
+			if (compressedSize == blockLength)
+			{
+				memcpy(block, data + offsets[b], blockLength);
+				decompressed[b] = 1;
+				continue;
+			}
+			shuffled.resize(blockLength);
+			if (decompressBlock(data + offsets[b], compressedSize, shuffled.data(), blockLength))
+			{
+				unshuffle(shuffled.data(), blockLength, block);
+				decompressed[b] = 1;
+			}
+		}
+	});
+	return std::find(decompressed.begin(), decompressed.end(), 0) == decompressed.end();
+}
+
+size_t BlockCompressor::compressBlock(const unsigned char* src, size_t size, unsigned char* dst)
+{
+	if (size <= MIN_MATCH) return 0;
+
+	// positions + 1 of the last occurrences of 4-byte sequences, 0 means no occurrence
+	std::vector<unsigned int> table((size_t)1 << HASH_BITS, 0);
+	const unsigned char* ip = src;
+	const unsigned char* anchor = src;
+	const unsigned char* end = src + size;
+	const unsigned char* matchLimit = end - MIN_MATCH;
+	unsigned char* op = dst;
+	const unsigned char* opEnd = dst + size - 1;
+
+	// the step grows while matches are not found, so incompressible data is skipped quickly
+	size_t misses = 0;
+	while (ip <= matchLimit)
+	{
+		unsigned int sequence = readWord(ip);
+		unsigned int& entry = table[hashWord(sequence)];
+		const unsigned char* match = entry != 0 ? src + entry - 1 : 0;
+		bool found = match != 0 && (size_t)(ip - match) <= MAX_OFFSET && readWord(match) == sequence;
+		entry = (unsigned int)(ip - src) + 1;
+		if (!found)
+		{
+			ip += 1 + (misses++ >> 6);
+			continue;
+		}
+
+		size_t length = MIN_MATCH;
+		while (ip + length < end && match[length] == ip[length]) length++;
+		if (!writeSequence(op, opEnd, anchor, (size_t)(ip - anchor), (size_t)(ip - match), length)) return 0;
+		ip += length;
+		anchor = ip;
+		misses = 0;
+	}
+	if (anchor < end && !writeSequence(op, opEnd, anchor, (size_t)(end - anchor), 0, 0)) return 0;
+
+	return (size_t)(op - dst);
+}
+
+bool BlockCompressor::decompressBlock(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize)
+{
+	const unsigned char* ip = src;
+	const unsigned char* ipEnd = src + srcSize;
+	unsigned char* op = dst;
+	unsigned char* opEnd = dst + dstSize;
+	while (op < opEnd)
+	{
+		if (ip >= ipEnd) return false;
+		unsigned char token = *ip++;
+
+		size_t literalsCount = token >> 4;
+		if (literalsCount == 15 && !readLength(ip, ipEnd, dstSize, literalsCount)) return false;
+		if ((size_t)(ipEnd - ip) < literalsCount || (size_t)(opEnd - op) < literalsCount) return false;
+		memcpy(op, ip, literalsCount);
+		ip += literalsCount;
+		op += literalsCount;
+		if (op == opEnd) break;
+
+		if (ipEnd - ip < 2) return false;
+		size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		size_t length = token & 15;
+		if (length == 15 && !readLength(ip, ipEnd, dstSize, length)) return false;
+		length += MIN_MATCH;
+		if (offset == 0 || offset > (size_t)(op - dst) || (size_t)(opEnd - op) < length) return false;
+
+		// matches can overlap the output, so they are copied forward byte by byte
+		const unsigned char* match = op - offset;
+		if (offset >= length)
+		{
+			memcpy(op, match, length);
+			op += length;
+		}
+		else
+		{
+			for (size_t i = 0; i < length; i++) *op++ = *match++;
+		}
+	}
+	return ip == ipEnd;
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __BLOCK_COMPRESSOR_H__
+#define __BLOCK_COMPRESSOR_H__
+
+namespace geom
+{
+
+// Fast LZ77 compression of sections of geom-files. Data is split into blocks 
+// which are compressed independently, so both directions run in parallel.
+// Bytes of 4-byte words are shuffled before compression (all first bytes, 
+// then all second bytes and so on), it groups exponents and high bytes of 
+// floats and indices together and makes them much more compressible.
+//
+// Block format is a sequence of:
+//		1 byte	- token, literals count in high 4 bits, match length - 4 in low 4 bits,
+//				  15 means that the value continues in the following bytes
+//		X bytes	- continuation of literals count (bytes are added until a byte is not 255)
+//		X bytes	- literals
+//		2 bytes	- offset of a match back from the current position (omitted in the last sequence)
+//		X bytes	- continuation of match length
+class BlockCompressor
+{
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+	// Writes a compressed section (see geomformat.h), returns false if the data can't be compressed
+	static bool compress(const unsigned char* data, size_t size, std::vector<unsigned char>& result, size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+	// Returns 0 if the header of a compressed section is incorrect
+	static unsigned long long getDecompressedSize(const unsigned char* data, size_t size);
+	static bool decompress(const unsigned char* data, size_t size, unsigned char* result, size_t resultSize);
+
+private:
+	// returns 0 if compressed block is not smaller than the source one
+	static size_t compressBlock(const unsigned char* src, size_t size, unsigned char* dst);
+	static bool decompressBlock(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize);
+};
+
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "boundscalculator.h"
+#include <random>
+
+namespace geom
+{
+
+namespace
+{
+
+struct Sphere
+{
+	double center[3];
+	double radius;
+};
+
+struct Point
+{
+	double x, y, z;
+
+	Point() : x(0), y(0), z(0) {}
+	Point(double x_, double y_, double z_) : x(x_), y(y_), z(z_) {}
+	explicit Point(const vector3& v) : x(v.x), y(v.y), z(v.z) {}
+
+	Point operator+(const Point& p) const { return Point(x + p.x, y + p.y, z + p.z); }
+	Point operator-(const Point& p) const { return Point(x - p.x, y - p.y, z - p.z); }
+	Point operator*(double s) const { return Point(x * s, y * s, z * s); }
+	double dot(const Point& p) const { return x * p.x + y * p.y + z * p.z; }
+	Point cross(const Point& p) const { return Point(y * p.z - z * p.y, z * p.x - x * p.z, x * p.y - y * p.x); }
+};
+
+// relative threshold of degenerate (collinear or coplanar) configurations
+const double DEGENERACY_EPSILON = 1e-12;
+
+Sphere makeSphere(const Point& center, double radius)
+{
+	Sphere s;
+	s.center[0] = center.x;
+	s.center[1] = center.y;
+	s.center[2] = center.z;
+	s.radius = radius;
+	return s;
+}
+
+bool contains(const Sphere& s, const Point& p, double tolerance)
+{
+	Point d = p - Point(s.center[0], s.center[1], s.center[2]);
+	return sqrt(d.dot(d)) <= s.radius + tolerance;
+}
+
+Sphere sphereFrom2(const Point& a, const Point& b)
+{
+	Point d = b - a;
+	return makeSphere((a + b) * 0.5, 0.5 * sqrt(d.dot(d)));
+}
+
+Sphere sphereFrom3(const Point& a, const Point& b, const Point& c)
+{
+	Point ab = b - a;
+	Point ac = c - a;
+	Point n = ab.cross(ac);
+	double n2 = n.dot(n);
+	double ab2 = ab.dot(ab);
+	double ac2 = ac.dot(ac);
+	if (n2 <= DEGENERACY_EPSILON * ab2 * ac2)
+	{
+		// collinear points, the sphere is spanned by the farthest pair
+		Point bc = c - b;
+		double bc2 = bc.dot(bc);
+		if (ab2 >= ac2 && ab2 >= bc2) return sphereFrom2(a, b);
+		if (ac2 >= bc2) return sphereFrom2(a, c);
+		return sphereFrom2(b, c);
+	}
+	Point offset = (n.cross(ab) * ac2 + ac.cross(n) * ab2) * (0.5 / n2);
+	return makeSphere(a + offset, sqrt(offset.dot(offset)));
+}
+
+Sphere sphereFrom4(const Point& a, const Point& b, const Point& c, const Point& d, double tolerance)
+{
+	Point u = b - a;
+	Point v = c - a;
+	Point w = d - a;
+	Point vw = v.cross(w);
+	double det = 2.0 * u.dot(vw);
+	double scale = sqrt(u.dot(u) * v.dot(v) * w.dot(w));
+	if (fabs(det) <= DEGENERACY_EPSILON * scale)
+	{
+		// coplanar points, the smallest circumscribed circle containing the fourth point is taken
+		const Point* points[4] = { &a, &b, &c, &d };
+		Sphere best = makeSphere(a, std::numeric_limits<double>::max());
+		for (int skip = 0; skip < 4; skip++)
+		{
+			const Point* p[3];
+			for (int i = 0, j = 0; i < 4; i++)
+			{
+				if (i != skip) p[j++] = points[i];
+			}
+			Sphere s = sphereFrom3(*p[0], *p[1], *p[2]);
+			if (s.radius < best.radius && contains(s, *points[skip], tolerance)) best = s;
+		}
+		return best;
+	}
+	Point offset = (vw * u.dot(u) + w.cross(u) * v.dot(v) + u.cross(v) * w.dot(w)) * (1.0 / det);
+	return makeSphere(a + offset, sqrt(offset.dot(offset)));
+}
+
+}
+
+void BoundsCalculator::calculate(DataWriter& writer)
+{
+	const Data& data = writer.getData();
+	Data::Meshes& meshes = writer.getMeshesRef();
+	const unsigned int* indices = data.getIndexData();
+	size_t verticesCount = data.getVerticesCount();
+
+	utils::Parallel::forRange(meshes.size(), [&](size_t begin, size_t end, size_t)
+	{
+		std::vector<size_t> marks(verticesCount, 0);
+		std::vector<vector3> points;
+		for (size_t m = begin; m < end; m++)
+		{
+			Data::Mesh& mesh = meshes[m];
+
+			// collect unique vertices of the mesh, every mesh has its own mark
+			points.clear();
+			size_t meshEnd = std::min(mesh.offsetInIB + mesh.indicesCount, data.getIndicesCount());
+			for (size_t i = mesh.offsetInIB; i < meshEnd; i++)
+			{
+				unsigned int index = indices[i];
+				if (index >= verticesCount || marks[index] == m + 1) continue;
+				marks[index] = m + 1;
+				points.push_back(data.getPosition(index));
+			}
+
+			mesh.boundingBox.begin_extend();
+			for (size_t i = 0; i < points.size(); i++)
+			{
+				mesh.boundingBox.extend(points[i]);
+			}
+			mesh.boundingBox.end_extend();
+
+			calculateBoundingSphere(points, mesh.boundingSphereCenter, mesh.boundingSphereRadius);
+		}
+	});
+}
+
+void BoundsCalculator::calculateBoundingSphere(const std::vector<vector3>& points, vector3& center, float& radius)
+{
+	center = vector3(0, 0, 0);
+	radius = 0.0f;
+	if (points.empty()) return;
+
+	// the expected running time is linear for points in random order only,
+	// the seed is fixed to have reproducible results
+	std::vector<Point> p(points.size());
+	double extent = 0.0;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		p[i] = Point(points[i]);
+		extent = std::max(extent, std::max(fabs(p[i].x), std::max(fabs(p[i].y), fabs(p[i].z))));
+	}
+	std::mt19937 random(12345);
+	std::shuffle(p.begin(), p.end(), random);
+	const double tolerance = 1e-7 * std::max(extent, 1.0);
+
+	// every nested loop fixes one more point on the boundary of the sphere
+	Sphere s = makeSphere(p[0], 0.0);
+	for (size_t i = 1; i < p.size(); i++)
+	{
+		if (contains(s, p[i], tolerance)) continue;
+		s = makeSphere(p[i], 0.0);
+		for (size_t j = 0; j < i; j++)
+		{
+			if (contains(s, p[j], tolerance)) continue;
+			s = sphereFrom2(p[i], p[j]);
+			for (size_t k = 0; k < j; k++)
+			{
+				if (contains(s, p[k], tolerance)) continue;
+				s = sphereFrom3(p[i], p[j], p[k]);
+				for (size_t l = 0; l < k; l++)
+				{
+					if (contains(s, p[l], tolerance)) continue;
+					s = sphereFrom4(p[i], p[j], p[k], p[l], tolerance);
+				}
+			}
+		}
+	}
+
+	// rounding to single precision must not leave any point outside
+	center = vector3((float)s.center[0], (float)s.center[1], (float)s.center[2]);
+	radius = (float)s.radius;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		radius = std::max(radius, (points[i] - center).len());
+	}
+}
+
+}
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "bvh.h"
+
+namespace geom
+{
+
+const size_t BVH_MAX_DEPTH = 64;
+const size_t MIN_TRIANGLES_PER_THREAD = 4096;
+// subtrees with fewer triangles are built on one thread
+const size_t MIN_PARALLEL_SUBTREE_TRIANGLES = 1024;
+const float TRAVERSAL_COST = 1.0f;
+const float INTERSECTION_COST = 1.0f;
+
+namespace
+{
+
+struct Primitive
+{
+	bbox3 boundingBox;
+	vector3 centroid;
+};
+
+struct NodeRange
+{
+	size_t nodeIndex;
+	size_t begin;
+	size_t end;
+	size_t depth;
+};
+
+struct Bin
+{
+	bbox3 boundingBox;
+	size_t count;
+};
+
+float getSurfaceArea(const bbox3& box)
+{
+	vector3 size = box.size();
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void setNodeBounds(Bvh::Node& node, const bbox3& box)
+{
+	node.boundsMin[0] = box.vmin.x; node.boundsMin[1] = box.vmin.y; node.boundsMin[2] = box.vmin.z;
+	node.boundsMax[0] = box.vmax.x; node.boundsMax[1] = box.vmax.y; node.boundsMax[2] = box.vmax.z;
+}
+
+// returns the distance to the box along the line or a value greater than maxT if there is no intersection
+float intersectNode(const Bvh::Node& node, const float* origin, const float* invDirection, float maxT)
+{
+	float tmin = 0.0f;
+	float tmax = maxT;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t1 = (node.boundsMin[axis] - origin[axis]) * invDirection[axis];
+		float t2 = (node.boundsMax[axis] - origin[axis]) * invDirection[axis];
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+	}
+	return tmin <= tmax ? tmin : std::numeric_limits<float>::max();
+}
+
+class BvhBuilder
+{
+public:
+	BvhBuilder(const std::vector<Primitive>& primitives, std::vector<unsigned int>& order, const BvhBuildingInfo& info) :
+		m_primitives(primitives), m_order(order), m_info(info), m_depth(0){}
+
+	// Builds the subtree of the range into nodes, its root must be allocated. Children ranges with
+	// fewer triangles than deferredSize are not built but returned via deferredRanges (if it isn't null).
+	void build(const NodeRange& root, std::vector<Bvh::Node>& nodes, size_t deferredSize, std::vector<NodeRange>* deferredRanges)
+	{
+		std::vector<NodeRange> stack;
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			NodeRange range = stack.back();
+			stack.pop_back();
+			m_depth = std::max(m_depth, range.depth + 1);
+
+			size_t mid = split(range, nodes[range.nodeIndex]);
+			if (mid == range.end) continue;
+
+			size_t childIndex = nodes.size();
+			nodes[range.nodeIndex].offset = (unsigned int)childIndex;
+			nodes[range.nodeIndex].trianglesCount = 0;
+			nodes.resize(nodes.size() + 2);
+
+			NodeRange children[2] = { { childIndex, range.begin, mid, range.depth + 1 },
+									  { childIndex + 1, mid, range.end, range.depth + 1 } };
+			for (int i = 0; i < 2; i++)
+			{
+				if (deferredRanges != nullptr && children[i].end - children[i].begin < deferredSize)
+				{
+					deferredRanges->push_back(children[i]);
+				}
+				else
+				{
+					stack.push_back(children[i]);
+				}
+			}
+		}
+	}
+
+	size_t getDepth() const { return m_depth; }
+
+private:
+	const std::vector<Primitive>& m_primitives;
+	std::vector<unsigned int>& m_order;
+	const BvhBuildingInfo& m_info;
+	size_t m_depth;
+	std::vector<Bin> m_bins;
+
+	// fills bounds of the node and makes it a leaf, returns the end of the range if the node
+	// must remain a leaf, otherwise the range is partitioned and the beginning of the second half is returned
+	size_t split(const NodeRange& range, Bvh::Node& node)
+	{
+		bbox3 box, centroidsBox;
+		box.begin_extend();
+		centroidsBox.begin_extend();
+		for (size_t i = range.begin; i < range.end; i++)
+		{
+			const Primitive& primitive = m_primitives[m_order[i]];
+			box.extend(primitive.boundingBox);
+			centroidsBox.extend(primitive.centroid);
+		}
+		setNodeBounds(node, box);
+		node.offset = (unsigned int)range.begin;
+		node.trianglesCount = (unsigned int)(range.end - range.begin);
+
+		size_t count = range.end - range.begin;
+		if (count <= m_info.maxLeafTrianglesCount || range.depth + 1 >= BVH_MAX_DEPTH) return range.end;
+
+		// the best split plane among bins of all axes
+		const size_t binsCount = std::max(m_info.binsCount, (size_t)2);
+		const float leafCost = INTERSECTION_COST * float(count);
+		float bestCost = leafCost;
+		int bestAxis = -1;
+		size_t bestSplit = 0;
+		float boxArea = getSurfaceArea(box);
+		std::vector<float> rightAreas(binsCount);
+		std::vector<size_t> rightCounts(binsCount);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float minCentroid = (&centroidsBox.vmin.x)[axis];
+			float extent = (&centroidsBox.vmax.x)[axis] - minCentroid;
+			if (extent <= 0.0f) continue;
+
+			m_bins.assign(binsCount, Bin());
+			for (size_t b = 0; b < binsCount; b++)
+			{
+				m_bins[b].boundingBox.begin_extend();
+				m_bins[b].count = 0;
+			}
+			float scale = float(binsCount) / extent;
+			for (size_t i = range.begin; i < range.end; i++)
+			{
+				const Primitive& primitive = m_primitives[m_order[i]];
+				size_t b = std::min(binsCount - 1, (size_t)(((&primitive.centroid.x)[axis] - minCentroid) * scale));
+				m_bins[b].boundingBox.extend(primitive.boundingBox);
+				m_bins[b].count++;
+			}
+
+			// rightAreas[b] and rightCounts[b] describe bins [b; binsCount)
+			bbox3 accumulated;
+			accumulated.begin_extend();
+			size_t accumulatedCount = 0;
+			for (size_t b = binsCount - 1; b > 0; b--)
+			{
+				if (m_bins[b].count != 0) accumulated.extend(m_bins[b].boundingBox);
+				accumulatedCount += m_bins[b].count;
+				rightAreas[b] = accumulatedCount != 0 ? getSurfaceArea(accumulated) : 0.0f;
+				rightCounts[b] = accumulatedCount;
+			}
+
+			accumulated.begin_extend();
+			accumulatedCount = 0;
+			for (size_t b = 1; b < binsCount; b++)
+			{
+				if (m_bins[b - 1].count != 0) accumulated.extend(m_bins[b - 1].boundingBox);
+				accumulatedCount += m_bins[b - 1].count;
+				if (accumulatedCount == 0 || rightCounts[b] == 0) continue;
+
+				float cost = TRAVERSAL_COST + INTERSECTION_COST * (getSurfaceArea(accumulated) * float(accumulatedCount) + 
+																   rightAreas[b] * float(rightCounts[b])) / boxArea;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+		if (bestAxis < 0) return range.end;
+
+		float minCentroid = (&centroidsBox.vmin.x)[bestAxis];
+		float scale = float(binsCount) / ((&centroidsBox.vmax.x)[bestAxis] - minCentroid);
+		auto it = std::partition(m_order.begin() + range.begin, m_order.begin() + range.end, [&](unsigned int index)
+		{
+			const Primitive& primitive = m_primitives[index];
+			size_t b = std::min(binsCount - 1, (size_t)(((&primitive.centroid.x)[bestAxis] - minCentroid) * scale));
+			return b < bestSplit;
+		});
+		return (size_t)(it - m_order.begin());
+	}
+};
+
+}
+
+bool Bvh::build(const Data& data, const BvhBuildingInfo& info)
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_triangleRefs.clear();
+	m_depth = 0;
+	if (!data.isCorrect()) return false;
+
+	// triangles of meshes
+	const unsigned int* indices = data.getIndexData();
+	for (size_t m = 0; m < data.getMeshes().size(); m++)
+	{
+		const Data::Mesh& mesh = data.getMeshes()[m];
+		for (size_t i = mesh.offsetInIB; i + 2 < mesh.offsetInIB + mesh.indicesCount; i += 3)
+		{
+			TriangleRef ref;
+			ref.index = (unsigned int)(i / 3);
+			ref.meshIndex = (unsigned int)m;
+			m_triangleRefs.push_back(ref);
+		}
+	}
+	const size_t trianglesCount = m_triangleRefs.size();
+	if (trianglesCount == 0) return false;
+
+	std::vector<Primitive> primitives(trianglesCount);
+	std::vector<unsigned int> order(trianglesCount);
+	utils::Parallel::forRange(trianglesCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			const unsigned int* triangle = indices + m_triangleRefs[t].index * 3;
+			Primitive& primitive = primitives[t];
+			primitive.boundingBox.begin_extend();
+			for (int k = 0; k < 3; k++) primitive.boundingBox.extend(data.getPosition(triangle[k]));
+			primitive.centroid = primitive.boundingBox.center();
+			order[t] = (unsigned int)t;
+		}
+	}, MIN_TRIANGLES_PER_THREAD);
+
+	// top levels are built on the calling thread until subtrees are small enough to be distributed among threads
+	size_t threadsCount = utils::Parallel::getThreadsCount();
+	size_t subtreeSize = std::max(trianglesCount / (threadsCount * 4), MIN_PARALLEL_SUBTREE_TRIANGLES);
+	bool parallel = threadsCount > 1 && trianglesCount > subtreeSize;
+	m_nodes.reserve(trianglesCount * 2 / std::max(info.maxLeafTrianglesCount, (size_t)1) + 1);
+	m_nodes.resize(1);
+	NodeRange root = { 0, 0, trianglesCount, 0 };
+	std::vector<NodeRange> subtrees;
+	BvhBuilder topBuilder(primitives, order, info);
+	topBuilder.build(root, m_nodes, subtreeSize, parallel ? &subtrees : nullptr);
+	m_depth = topBuilder.getDepth();
+
+	if (!subtrees.empty())
+	{
+		// subtrees occupy disjoint ranges of triangles, every one is built into its own array of nodes
+		std::vector<std::vector<Node>> subtreeNodes(subtrees.size());
+		std::vector<size_t> subtreeDepths(subtrees.size());
+		utils::Parallel::forRange(subtrees.size(), [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				BvhBuilder builder(primitives, order, info);
+				NodeRange range = subtrees[i];
+				range.nodeIndex = 0;
+				subtreeNodes[i].resize(1);
+				builder.build(range, subtreeNodes[i], 0, nullptr);
+				subtreeDepths[i] = builder.getDepth();
+			}
+		});
+
+		// the root of a subtree replaces its placeholder, the rest of nodes are appended
+		for (size_t i = 0; i < subtrees.size(); i++)
+		{
+			std::vector<Node>& nodes = subtreeNodes[i];
+			unsigned int base = (unsigned int)m_nodes.size() - 1;
+			for (size_t n = 0; n < nodes.size(); n++)
+			{
+				if (nodes[n].trianglesCount == 0) nodes[n].offset += base;
+			}
+			m_nodes[subtrees[i].nodeIndex] = nodes[0];
+			m_nodes.insert(m_nodes.end(), nodes.begin() + 1, nodes.end());
+			m_depth = std::max(m_depth, subtreeDepths[i]);
+		}
+	}
+
+	// triangles are stored in the order of leaves
+	m_triangles.resize(trianglesCount);
+	std::vector<TriangleRef> refs(trianglesCount);
+	utils::Parallel::forRange(trianglesCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			refs[t] = m_triangleRefs[order[t]];
+			const unsigned int* triangle = indices + refs[t].index * 3;
+			vector3 v0 = data.getPosition(triangle[0]);
+			m_triangles[t].v0 = v0;
+			m_triangles[t].edge1 = data.getPosition(triangle[1]) - v0;
+			m_triangles[t].edge2 = data.getPosition(triangle[2]) - v0;
+		}
+	}, MIN_TRIANGLES_PER_THREAD);
+	m_triangleRefs.swap(refs);
+
+	return true;
+}
+
+bbox3 Bvh::getBoundingBox() const
+{
+	bbox3 box;
+	if (m_nodes.empty()) return box;
+	box.vmin = vector3(m_nodes[0].boundsMin[0], m_nodes[0].boundsMin[1], m_nodes[0].boundsMin[2]);
+	box.vmax = vector3(m_nodes[0].boundsMax[0], m_nodes[0].boundsMax[1], m_nodes[0].boundsMax[2]);
+	return box;
+}
+
+bool Bvh::findClosestHit(const line3& line, BvhHit& hit) const
+{
+	return traverse<false>(line, hit);
+}
+
+bool Bvh::findAnyHit(const line3& line) const
+{
+	BvhHit hit;
+	return traverse<true>(line, hit);
+}
+
+template<bool AnyHit> bool Bvh::traverse(const line3& line, BvhHit& hit) const
+{
+	if (m_nodes.empty()) return false;
+
+	const float origin[3] = { line.b.x, line.b.y, line.b.z };
+	const float invDirection[3] = { 1.0f / line.m.x, 1.0f / line.m.y, 1.0f / line.m.z };
+	float maxT = 1.0f;
+	bool found = false;
+
+	struct StackEntry
+	{
+		unsigned int nodeIndex;
+		float t;
+	};
+	StackEntry stack[BVH_MAX_DEPTH];
+	size_t stackSize = 0;
+	if (intersectNode(m_nodes[0], origin, invDirection, maxT) > maxT) return false;
+	stack[stackSize++] = { 0, 0.0f };
+
+	while (stackSize != 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		if (entry.t > maxT) continue;
+		const Node& node = m_nodes[entry.nodeIndex];
+
+		if (node.trianglesCount != 0)
+		{
+			// Moller-Trumbore intersection
+			for (unsigned int i = node.offset; i < node.offset + node.trianglesCount; i++)
+			{
+				const Triangle& triangle = m_triangles[i];
+				vector3 p = line.m * triangle.edge2;
+				float det = triangle.edge1 % p;
+				if (det == 0.0f) continue;
+				float invDet = 1.0f / det;
+				vector3 s = line.b - triangle.v0;
+				float u = (s % p) * invDet;
+				if (u < 0.0f || u > 1.0f) continue;
+				vector3 q = s * triangle.edge1;
+				float v = (line.m % q) * invDet;
+				if (v < 0.0f || u + v > 1.0f) continue;
+				float t = (triangle.edge2 % q) * invDet;
+				if (t < 0.0f || t > maxT) continue;
+
+				found = true;
+				if (AnyHit) return true;
+				maxT = t;
+				hit.t = t;
+				hit.u = u;
+				hit.v = v;
+				hit.triangleIndex = m_triangleRefs[i].index;
+				hit.meshIndex = m_triangleRefs[i].meshIndex;
+			}
+			continue;
+		}
+
+		// the closer child is visited first
+		float t1 = intersectNode(m_nodes[node.offset], origin, invDirection, maxT);
+		float t2 = intersectNode(m_nodes[node.offset + 1], origin, invDirection, maxT);
+		unsigned int first = node.offset;
+		unsigned int second = node.offset + 1;
+		if (t2 < t1)
+		{
+			std::swap(t1, t2);
+			std::swap(first, second);
+		}
+		if (t2 <= maxT) stack[stackSize++] = { second, t2 };
+		if (t1 <= maxT) stack[stackSize++] = { first, t1 };
+	}
+	return found;
+}
+
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __BVH_H__
+#define __BVH_H__
+
+namespace geom
+{
+
+struct BvhBuildingInfo
+{
+	// bins of the surface area heuristic along every axis
+	size_t binsCount;
+	// nodes with more triangles are split if the surface area heuristic finds it profitable
+	size_t maxLeafTrianglesCount;
+
+	BvhBuildingInfo() : binsCount(16), maxLeafTrianglesCount(4){}
+};
+
+struct BvhHit
+{
+	// parameter of the line, the hit point is line.ipol(t)
+	float t;
+	// barycentric coordinates of the hit point relative to the second and the third vertices
+	float u;
+	float v;
+	size_t meshIndex;
+	// the triangle starts at triangleIndex * 3 in the index buffer
+	size_t triangleIndex;
+
+	BvhHit() : t(0.0f), u(0.0f), v(0.0f), meshIndex(0), triangleIndex(0){}
+};
+
+// Bounding volume hierarchy over triangles of meshes (LODs and other index ranges are not included).
+// Nodes are built by the binned surface area heuristic, subtrees are built in parallel.
+// Queries are thread-safe, triangles are double-sided.
+class Bvh
+{
+public:
+	// 32 bytes, children of an inner node are adjacent in the array of nodes
+	struct Node
+	{
+		float boundsMin[3];
+		// the first child for inner nodes, the first triangle for leaves
+		unsigned int offset;
+		float boundsMax[3];
+		// 0 for inner nodes
+		unsigned int trianglesCount;
+	};
+
+	Bvh() : m_depth(0){}
+
+	bool build(const Data& data, const BvhBuildingInfo& info = BvhBuildingInfo());
+	bool isEmpty() const { return m_nodes.empty(); }
+	size_t getNodesCount() const { return m_nodes.size(); }
+	size_t getTrianglesCount() const { return m_triangles.size(); }
+	size_t getDepth() const { return m_depth; }
+	bbox3 getBoundingBox() const;
+
+	// the closest intersection of the segment from line.b to line.b + line.m with triangles
+	bool findClosestHit(const line3& line, BvhHit& hit) const;
+	// any intersection of the segment, it's faster than the closest one (e.g. for visibility tests)
+	bool findAnyHit(const line3& line) const;
+
+private:
+	// vertex and edges (v1 - v0, v2 - v0) in the order of leaves
+	struct Triangle
+	{
+		vector3 v0;
+		vector3 edge1;
+		vector3 edge2;
+	};
+
+	struct TriangleRef
+	{
+		unsigned int index;
+		unsigned int meshIndex;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<Triangle> m_triangles;
+	std::vector<TriangleRef> m_triangleRefs;
+	size_t m_depth;
+
+	template<bool AnyHit> bool traverse(const line3& line, BvhHit& hit) const;
+};
+
+}
+
+#endif
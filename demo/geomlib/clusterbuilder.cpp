@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include "clusterbuilder.h"
+
+namespace geom
+{
+
+Data ClusterBuilder::build(const Data& data, const ClusterBuildingInfo& info)
+{
+	if (!data.isCorrect()) return data;
+
+	Data result;
+	DataWriter writer(&result);
+	writer.getMeshesRef() = data.getMeshes();
+	writer.copyVertexDeclaration(data);
+	writer.getVerticesCountRef() = data.getVerticesCount();
+	writer.getBoundingBoxRef() = data.getBoundingBox();
+	writer.getVertexBufferRef().assign(data.getVertexData(), data.getVertexData() + data.getVertexDataSize());
+	writer.getIndexBufferRef().assign(data.getIndexData(), data.getIndexData() + data.getIndicesCount());
+
+	size_t verticesCount = data.getVerticesCount();
+	std::vector<unsigned int>& indices = writer.getIndexBufferRef();
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] >= verticesCount)
+		{
+			writer.getLastErrorRef() = "Cluster building error (index is out of range)";
+			return result;
+		}
+	}
+	if (info.maxVerticesCount < 3 || info.maxTrianglesCount == 0)
+	{
+		writer.getLastErrorRef() = "Cluster building error (incorrect limits of clusters)";
+		return result;
+	}
+
+	// normals orient triangles independently of the winding order
+	Data fullData = VertexFormatConverter::convert(data, Data::VERTEX_FORMAT_FULL, Data::COMPONENTS_ALL);
+	std::vector<vector3> positions(verticesCount);
+	std::vector<vector3> normals(verticesCount);
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		const Data::Vertex* vertex = reinterpret_cast<const Data::Vertex*>(fullData.getVertexData() + v * fullData.getVertexSize());
+		positions[v] = vertex->position;
+		normals[v] = vertex->normal;
+	}
+
+	std::vector<unsigned int> trianglesCounts(verticesCount + 1, 0);
+	std::vector<unsigned int> vertexTriangles;
+	std::vector<unsigned int> clusterMarks(verticesCount, 0);
+	unsigned int clusterMark = 0;
+
+	Data::Meshes& meshes = writer.getMeshesRef();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		Data::Mesh& mesh = meshes[m];
+		mesh.clusters.clear();
+		if (mesh.offsetInIB + mesh.indicesCount > indices.size())
+		{
+			writer.getLastErrorRef() = "Cluster building error (mesh is out of index buffer)";
+			return result;
+		}
+
+		unsigned int* meshIndices = indices.data() + mesh.offsetInIB;
+		size_t trianglesCount = mesh.indicesCount / 3;
+
+		// triangles of vertices, trianglesCounts contains offsets in vertexTriangles after that
+		for (size_t i = 0; i < trianglesCount * 3; i++) trianglesCounts[meshIndices[i] + 1]++;
+		for (size_t v = 0; v < verticesCount; v++) trianglesCounts[v + 1] += trianglesCounts[v];
+		vertexTriangles.resize(trianglesCount * 3);
+		std::vector<unsigned int> filled(trianglesCounts.begin(), trianglesCounts.end() - 1);
+		for (size_t i = 0; i < trianglesCount * 3; i++)
+		{
+			vertexTriangles[filled[meshIndices[i]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<char> isAssigned(trianglesCount, 0);
+		std::vector<unsigned int> output;
+		output.reserve(trianglesCount * 3);
+		std::vector<unsigned int> clusterVertices;
+		size_t cursor = 0;
+		while (true)
+		{
+			// seed of a new cluster
+			while (cursor < trianglesCount && isAssigned[cursor]) cursor++;
+			if (cursor == trianglesCount) break;
+
+			Data::Cluster cluster;
+			cluster.offsetInIB = mesh.offsetInIB + output.size();
+			clusterMark++;
+			clusterVertices.clear();
+			vector3 clusterCenter(0, 0, 0);
+			size_t clusterTriangles = 0;
+
+			int triangle = (int)cursor;
+			while (triangle >= 0)
+			{
+				isAssigned[triangle] = 1;
+				clusterTriangles++;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = meshIndices[triangle * 3 + k];
+					output.push_back(v);
+					if (clusterMarks[v] != clusterMark)
+					{
+						clusterMarks[v] = clusterMark;
+						clusterVertices.push_back(v);
+						clusterCenter += (positions[v] - clusterCenter) * (1.0f / (float)clusterVertices.size());
+					}
+				}
+				if (clusterTriangles == info.maxTrianglesCount) break;
+
+				// the next triangle adds the least number of vertices and it is the closest to the center
+				triangle = -1;
+				int bestNewVertices = 4;
+				float bestDistance = 0.0f;
+				for (size_t i = 0; i < clusterVertices.size(); i++)
+				{
+					unsigned int v = clusterVertices[i];
+					for (unsigned int j = trianglesCounts[v]; j < trianglesCounts[v + 1]; j++)
+					{
+						unsigned int t = vertexTriangles[j];
+						if (isAssigned[t]) continue;
+
+						const unsigned int* tri = meshIndices + t * 3;
+						int newVertices = 0;
+						for (int k = 0; k < 3; k++)
+						{
+							if (clusterMarks[tri[k]] != clusterMark && (k == 0 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1])) newVertices++;
+						}
+						if (clusterVertices.size() + newVertices > info.maxVerticesCount || newVertices > bestNewVertices) continue;
+
+						vector3 d = (positions[tri[0]] + positions[tri[1]] + positions[tri[2]]) * (1.0f / 3.0f) - clusterCenter;
+						float distance = d % d;
+						if (newVertices < bestNewVertices || distance < bestDistance)
+						{
+							triangle = (int)t;
+							bestNewVertices = newVertices;
+							bestDistance = distance;
+						}
+					}
+				}
+			}
+
+			cluster.indicesCount = mesh.offsetInIB + output.size() - cluster.offsetInIB;
+			calculateBounds(positions, normals, output.data() + (cluster.offsetInIB - mesh.offsetInIB), cluster.indicesCount, cluster);
+			mesh.clusters.push_back(cluster);
+		}
+
+		memcpy(meshIndices, output.data(), output.size() * sizeof(unsigned int));
+		std::fill(trianglesCounts.begin(), trianglesCounts.end(), 0);
+	}
+
+	return result;
+}
+
+bool ClusterBuilder::isBackfacing(const Data::Cluster& cluster, const vector3& cameraPosition)
+{
+	vector3 d = cluster.center - cameraPosition;
+	return d % cluster.coneAxis >= cluster.coneCutoff * d.len() + cluster.radius;
+}
+
+void ClusterBuilder::calculateBounds(const std::vector<vector3>& positions, const std::vector<vector3>& normals,
+									 const unsigned int* indices, size_t indicesCount, Data::Cluster& cluster)
+{
+	bbox3 box;
+	box.begin_extend();
+	for (size_t i = 0; i < indicesCount; i++) box.extend(positions[indices[i]]);
+	cluster.center = box.center();
+	cluster.radius = 0.0f;
+	for (size_t i = 0; i < indicesCount; i++)
+	{
+		cluster.radius = std::max(cluster.radius, (positions[indices[i]] - cluster.center).len());
+	}
+
+	// normal cone contains normals of all triangles, triangles are oriented along vertex normals
+	std::vector<vector3> triangleNormals;
+	triangleNormals.reserve(indicesCount / 3);
+	vector3 axis(0, 0, 0);
+	for (size_t t = 0; t < indicesCount / 3; t++)
+	{
+		const unsigned int* tri = indices + t * 3;
+		vector3 n = (positions[tri[1]] - positions[tri[0]]) * (positions[tri[2]] - positions[tri[0]]);
+		if (n.len() <= TINY) continue;
+		n.norm();
+		if (n % (normals[tri[0]] + normals[tri[1]] + normals[tri[2]]) < 0.0f) n = -n;
+		triangleNormals.push_back(n);
+		axis += n;
+	}
+
+	cluster.coneAxis = vector3(0, 0, 0);
+	cluster.coneCutoff = 1.0f;
+	if (axis.len() <= TINY) return;
+	axis.norm();
+
+	float minDot = 1.0f;
+	for (size_t i = 0; i < triangleNormals.size(); i++)
+	{
+		minDot = std::min(minDot, triangleNormals[i] % axis);
+	}
+
+	// the cone is wider than a hemisphere, it can not be culled
+	if (minDot <= 0.0f) return;
+
+	cluster.coneAxis = axis;
+	cluster.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CLUSTER_BUILDER_H__
+#define __CLUSTER_BUILDER_H__
+
+namespace geom
+{
+
+struct ClusterBuildingInfo
+{
+	size_t maxVerticesCount;
+	size_t maxTrianglesCount;
+
+	ClusterBuildingInfo() : maxVerticesCount(64), maxTrianglesCount(124){}
+};
+
+class ClusterBuilder
+{
+public:
+	// Splits every mesh into clusters of spatially close triangles. Triangles of a mesh are
+	// reordered so every cluster occupies a contiguous range of the mesh in the index buffer.
+	static Data build(const Data& data, const ClusterBuildingInfo& info = ClusterBuildingInfo());
+
+	// cameraPosition must be in the space of the mesh
+	static bool isBackfacing(const Data::Cluster& cluster, const vector3& cameraPosition);
+
+private:
+	static void calculateBounds(const std::vector<vector3>& positions, const std::vector<vector3>& normals,
+								const unsigned int* indices, size_t indicesCount, Data::Cluster& cluster);
+};
+
+}
+
+#endif
@@ -34,91 +34,252 @@ const char* TANGENT_SEMANTIC = "TANGENT";
 const char* BINORMAL_SEMANTIC = "BINORMAL";
 
 Data::Data() :
-	m_additionalUVsCount(0),
-	m_verticesCount(0)
+	m_verticesCount(0),
+	m_mappedVertexData(0),
+	m_mappedVertexDataSize(0),
+	m_mappedIndexData(0),
+	m_mappedIndicesCount(0)
 {
-
+	setVertexDeclaration(VERTEX_FORMAT_FULL, 0, COMPONENTS_ALL);
 }
 
 Data::Data(const Data& data):
-	m_additionalUVsCount(data.m_additionalUVsCount),
-	m_verticesCount(data.m_verticesCount),
 	m_meshes(data.m_meshes),
+	m_verticesCount(data.m_verticesCount),
 	m_boundingBox(data.m_boundingBox),
 	m_vertexBuffer(data.m_vertexBuffer),
 	m_indexBuffer(data.m_indexBuffer),
-	m_lastError(data.m_lastError)
+	m_lastError(data.m_lastError),
+	m_mappedFile(data.m_mappedFile),
+	m_mappedVertexData(data.m_mappedVertexData),
+	m_mappedVertexDataSize(data.m_mappedVertexDataSize),
+	m_mappedIndexData(data.m_mappedIndexData),
+	m_mappedIndicesCount(data.m_mappedIndicesCount)
 {
+	copyVertexDeclaration(data);
 }
 
 Data::Data(Data&& data)
 {
-	m_additionalUVsCount = std::move(data.m_additionalUVsCount);
+	copyVertexDeclaration(data);
 	m_verticesCount = std::move(data.m_verticesCount);
 	m_meshes = std::move(data.m_meshes);
 	m_boundingBox = std::move(data.m_boundingBox);
 	m_vertexBuffer = std::move(data.m_vertexBuffer);
 	m_indexBuffer = std::move(data.m_indexBuffer);
 	m_lastError = std::move(data.m_lastError);
+	m_mappedFile = std::move(data.m_mappedFile);
+	m_mappedVertexData = data.m_mappedVertexData;
+	m_mappedVertexDataSize = data.m_mappedVertexDataSize;
+	m_mappedIndexData = data.m_mappedIndexData;
+	m_mappedIndicesCount = data.m_mappedIndicesCount;
+	data.releaseMapping();
+}
+
+void Data::setVertexDeclaration(VertexFormat format, size_t additionalUVsCount, unsigned int componentsMask)
+{
+	m_vertexFormat = format;
+	m_additionalUVsCount = additionalUVsCount;
+	m_componentsMask = componentsMask & COMPONENTS_ALL;
+	m_vertexDeclaration.clear();
+	m_vertexDeclaration.reserve(5 + additionalUVsCount);
+
+	bool isCompact = (format != VERTEX_FORMAT_FULL);
+	auto addComponent = [&](VertexComponentSemantic semantic, size_t semanticIndex, VertexComponentType type, size_t size, size_t location)
+	{
+		VertexComponent component;
+		component.semantic = semantic;
+		component.semanticIndex = semanticIndex;
+		component.type = type;
+		component.size = size;
+		component.offset = m_vertexDeclaration.empty() ? 0 : m_vertexDeclaration.back().offset + m_vertexDeclaration.back().size;
+		component.stream = (semantic == SEMANTIC_POSITION) ? STREAM_POSITIONS : STREAM_ATTRIBUTES;
+		component.offsetInStream = 0;
+		component.location = location;
+		m_vertexDeclaration.push_back(component);
+	};
+
+	if (format == VERTEX_FORMAT_COMPACT_QUANTIZED) addComponent(SEMANTIC_POSITION, 0, COMPONENT_UNORM16, 4 * sizeof(unsigned short), 0);
+	else addComponent(SEMANTIC_POSITION, 0, COMPONENT_FLOAT, sizeof(vector3), 0);
+	if (m_componentsMask & COMPONENTS_NORMAL)
+	{
+		if (isCompact) addComponent(SEMANTIC_NORMAL, 0, COMPONENT_UNORM_10_10_10_2, sizeof(unsigned int), 1);
+		else addComponent(SEMANTIC_NORMAL, 0, COMPONENT_FLOAT, sizeof(vector3), 1);
+	}
+	if (m_componentsMask & COMPONENTS_TEXCOORD0)
+	{
+		if (isCompact) addComponent(SEMANTIC_TEXCOORD, 0, COMPONENT_HALF, 2 * sizeof(unsigned short), 2);
+		else addComponent(SEMANTIC_TEXCOORD, 0, COMPONENT_FLOAT, sizeof(vector2), 2);
+	}
+	if (m_componentsMask & COMPONENTS_TANGENT_FRAME)
+	{
+		if (isCompact)
+		{
+			addComponent(SEMANTIC_TANGENT, 0, COMPONENT_UNORM_10_10_10_2, sizeof(unsigned int), 3);
+		}
+		else
+		{
+			addComponent(SEMANTIC_TANGENT, 0, COMPONENT_FLOAT, sizeof(vector3), 3);
+			addComponent(SEMANTIC_BINORMAL, 0, COMPONENT_FLOAT, sizeof(vector3), 4);
+		}
+	}
+	for (size_t i = 0; i < additionalUVsCount; i++)
+	{
+		if (isCompact) addComponent(SEMANTIC_TEXCOORD, i + 1, COMPONENT_HALF, 2 * sizeof(unsigned short), 5 + i);
+		else addComponent(SEMANTIC_TEXCOORD, i + 1, COMPONENT_FLOAT, sizeof(vector2), 5 + i);
+	}
+
+	// position is the first component, so the rest of components follow it in the vertex
+	m_vertexSize = m_vertexDeclaration.back().offset + m_vertexDeclaration.back().size;
+	m_streamStrides[STREAM_POSITIONS] = m_vertexDeclaration[0].size;
+	m_streamStrides[STREAM_ATTRIBUTES] = m_vertexSize - m_vertexDeclaration[0].size;
+	for (size_t i = 1; i < m_vertexDeclaration.size(); i++)
+	{
+		m_vertexDeclaration[i].offsetInStream = m_vertexDeclaration[i].offset - m_vertexDeclaration[0].size;
+	}
+}
+
+void Data::copyVertexDeclaration(const Data& data)
+{
+	m_vertexFormat = data.m_vertexFormat;
+	m_additionalUVsCount = data.m_additionalUVsCount;
+	m_componentsMask = data.m_componentsMask;
+	m_vertexDeclaration = data.m_vertexDeclaration;
+	m_vertexSize = data.m_vertexSize;
+	for (size_t i = 0; i < STREAMS_COUNT; i++) m_streamStrides[i] = data.m_streamStrides[i];
+}
+
+const Data::VertexDeclaration& Data::getVertexDeclaration() const
+{
+	return m_vertexDeclaration;
+}
+
+unsigned int Data::getVertexComponentsMask() const
+{
+	return m_componentsMask;
+}
+
+int Data::findVertexComponent(VertexComponentSemantic semantic, size_t semanticIndex) const
+{
+	for (size_t i = 0; i < m_vertexDeclaration.size(); i++)
+	{
+		if (m_vertexDeclaration[i].semantic == semantic && m_vertexDeclaration[i].semanticIndex == semanticIndex) return (int)i;
+	}
+	return -1;
 }
 
 size_t Data::getVertexComponentsCount() const
 {
-	return 5 + m_additionalUVsCount;
+	return m_vertexDeclaration.size();
 }
 
 size_t Data::getVertexComponentSize(size_t index) const
 {
-	static Vertex v;
-	if (index == 0) return sizeof(v.position);
-	else if (index == 1) return sizeof(v.normal);
-	else if (index == 2) return sizeof(v.texCoord0);
-	else if (index == 3) return sizeof(v.tangent);
-	else if (index == 4) return sizeof(v.binormal);
-	else if (index >= 5 && index < getVertexComponentsCount()) return sizeof(v.texCoord0);
-	return 0;
+	return index < m_vertexDeclaration.size() ? m_vertexDeclaration[index].size : 0;
 }
 
-size_t Data::getVertexComponentOffset(size_t index) const
+Data::VertexComponentType Data::getVertexComponentType(size_t index) const
 {
-	if (index >= getVertexComponentsCount()) return 0;
+	return index < m_vertexDeclaration.size() ? m_vertexDeclaration[index].type : COMPONENT_FLOAT;
+}
 
-	size_t offset = 0;
-	for (size_t i = 0; i < index; i++) offset += getVertexComponentSize(i);
-	return offset;
+size_t Data::getVertexComponentOffset(size_t index) const
+{
+	return index < m_vertexDeclaration.size() ? m_vertexDeclaration[index].offset : 0;
 }
 
 size_t Data::getVertexSize() const
 {
-	return sizeof(Vertex) + m_additionalUVsCount * sizeof(vector2);
+	return m_vertexSize;
+}
+
+size_t Data::getVertexComponentStream(size_t index) const
+{
+	return index < m_vertexDeclaration.size() ? m_vertexDeclaration[index].stream : (size_t)STREAM_ATTRIBUTES;
+}
+
+size_t Data::getVertexComponentOffsetInStream(size_t index) const
+{
+	return index < m_vertexDeclaration.size() ? m_vertexDeclaration[index].offsetInStream : 0;
+}
+
+size_t Data::getVertexStreamStride(size_t stream) const
+{
+	return stream < STREAMS_COUNT ? m_streamStrides[stream] : 0;
+}
+
+void Data::splitVertexStreams(unsigned char* positions, unsigned char* attributes) const
+{
+	const size_t MIN_VERTICES_PER_THREAD = 16384;
+	const size_t vertexSize = getVertexSize();
+	const size_t positionSize = getVertexStreamStride(STREAM_POSITIONS);
+	const size_t attributesSize = getVertexStreamStride(STREAM_ATTRIBUTES);
+
+	// position is the first component of a vertex
+	const unsigned char* vertices = getVertexData();
+	utils::Parallel::forRange(m_verticesCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const unsigned char* vertex = vertices + i * vertexSize;
+			memcpy(positions + i * positionSize, vertex, positionSize);
+			if (attributesSize != 0) memcpy(attributes + i * attributesSize, vertex + positionSize, attributesSize);
+		}
+	}, MIN_VERTICES_PER_THREAD);
 }
 
 const char* Data::getSemanticName(size_t index) const
 {
-	if (index == 0) return POSITION_SEMANTIC;
-	else if (index == 1) return NORMAL_SEMANTIC;
-	else if (index == 2) return TEXCOORD_SEMANTIC;
-	else if (index == 3) return TANGENT_SEMANTIC;
-	else if (index == 4) return BINORMAL_SEMANTIC;
-	else if (index >= 5 && index < getVertexComponentsCount()) return TEXCOORD_SEMANTIC;
+	if (index >= m_vertexDeclaration.size()) return "";
+	switch (m_vertexDeclaration[index].semantic)
+	{
+	case SEMANTIC_POSITION: return POSITION_SEMANTIC;
+	case SEMANTIC_NORMAL: return NORMAL_SEMANTIC;
+	case SEMANTIC_TEXCOORD: return TEXCOORD_SEMANTIC;
+	case SEMANTIC_TANGENT: return TANGENT_SEMANTIC;
+	case SEMANTIC_BINORMAL: return BINORMAL_SEMANTIC;
+	}
 	return "";
 }
+
 size_t Data::getSemanticIndex(size_t index) const
 {
-	if (index < 5) return 0;
-	return index - 4;
+	return index < m_vertexDeclaration.size() ? m_vertexDeclaration[index].semanticIndex : 0;
+}
+
+vector3 Data::getPosition(size_t vertexIndex) const
+{
+	const unsigned char* ptr = getVertexData() + vertexIndex * getVertexSize();
+	if (m_vertexFormat == VERTEX_FORMAT_COMPACT_QUANTIZED)
+	{
+		const QuantizedVertex* v = reinterpret_cast<const QuantizedVertex*>(ptr);
+		vector3 size = m_boundingBox.size();
+		return vector3(m_boundingBox.vmin.x + size.x * (float(v->position[0]) / 65535.0f),
+					   m_boundingBox.vmin.y + size.y * (float(v->position[1]) / 65535.0f),
+					   m_boundingBox.vmin.z + size.z * (float(v->position[2]) / 65535.0f));
+	}
+
+	// position is the first component in other formats
+	float position[3];
+	memcpy(position, ptr, sizeof(position));
+	return vector3(position[0], position[1], position[2]);
 }
 
 Data& Data::operator=(const Data& data)
 {
 	if (this == &data) return *this;
 
-	m_additionalUVsCount = data.m_additionalUVsCount;
+	copyVertexDeclaration(data);
 	m_verticesCount = data.m_verticesCount;
 	m_meshes = data.m_meshes;
 	m_boundingBox = data.m_boundingBox;
 	m_vertexBuffer = data.m_vertexBuffer;
 	m_indexBuffer = data.m_indexBuffer;
+	m_mappedFile = data.m_mappedFile;
+	m_mappedVertexData = data.m_mappedVertexData;
+	m_mappedVertexDataSize = data.m_mappedVertexDataSize;
+	m_mappedIndexData = data.m_mappedIndexData;
+	m_mappedIndicesCount = data.m_mappedIndicesCount;
 	return *this;
 }
 
@@ -126,12 +287,18 @@ Data& Data::operator=(Data&& data)
 {
 	if (this == &data) return *this;
 
-	m_additionalUVsCount = std::move(data.m_additionalUVsCount);
+	copyVertexDeclaration(data);
 	m_verticesCount = std::move(data.m_verticesCount);
 	m_meshes = std::move(data.m_meshes);
 	m_boundingBox = std::move(data.m_boundingBox);
 	m_vertexBuffer = std::move(data.m_vertexBuffer);
 	m_indexBuffer = std::move(data.m_indexBuffer);
+	m_mappedFile = std::move(data.m_mappedFile);
+	m_mappedVertexData = data.m_mappedVertexData;
+	m_mappedVertexDataSize = data.m_mappedVertexDataSize;
+	m_mappedIndexData = data.m_mappedIndexData;
+	m_mappedIndicesCount = data.m_mappedIndicesCount;
+	data.releaseMapping();
 	return *this;
 }
 
@@ -150,6 +317,11 @@ const Data::Meshes& Data::getMeshes() const
 	return m_meshes;
 }
 
+Data::VertexFormat Data::getVertexFormat() const
+{
+	return m_vertexFormat;
+}
+
 size_t Data::getAdditionalUVsCount() const
 {
 	return m_additionalUVsCount;
@@ -175,6 +347,44 @@ const std::vector<unsigned int>& Data::getIndexBuffer() const
 	return m_indexBuffer;
 }
 
+bool Data::isMapped() const
+{
+	return m_mappedFile.get() != 0;
+}
+
+void Data::releaseMapping()
+{
+	m_mappedFile.reset();
+	m_mappedVertexData = 0;
+	m_mappedVertexDataSize = 0;
+	m_mappedIndexData = 0;
+	m_mappedIndicesCount = 0;
+}
+
+const unsigned char* Data::getVertexData() const
+{
+	if (isMapped()) return m_mappedVertexData;
+	return m_vertexBuffer.data();
+}
+
+size_t Data::getVertexDataSize() const
+{
+	if (isMapped()) return m_mappedVertexDataSize;
+	return m_vertexBuffer.size();
+}
+
+const unsigned int* Data::getIndexData() const
+{
+	if (isMapped()) return m_mappedIndexData;
+	return m_indexBuffer.data();
+}
+
+size_t Data::getIndicesCount() const
+{
+	if (isMapped()) return m_mappedIndicesCount;
+	return m_indexBuffer.size();
+}
+
 int GetAdjacentIndex(int edge[2], int triangle[3])
 {
 	int pnts_tmp[3] = { triangle[0], triangle[1], triangle[2] };
@@ -196,59 +406,207 @@ int GetAdjacentIndex(int edge[2], int triangle[3])
 	return -1;
 }
 
+// two smallest indices of triangles which share an edge or a vertex
+struct TrianglesPair
+{
+	int first;
+	int second;
+
+	TrianglesPair() : first(-1), second(-1){}
+
+	// triangles must be added in ascending order
+	void add(int triangle)
+	{
+		if (first < 0) first = triangle;
+		else if (second < 0 && first != triangle) second = triangle;
+	}
+
+	int getAnother(int triangle) const
+	{
+		return first != triangle ? first : second;
+	}
+};
+
+struct EdgeRecord
+{
+	unsigned long long key;
+	int triangle;
+};
+
+typedef std::unordered_map<unsigned long long, TrianglesPair> EdgesMap;
+
+unsigned long long getEdgeKey(unsigned int v1, unsigned int v2)
+{
+	if (v1 > v2) std::swap(v1, v2);
+	return ((unsigned long long)v1 << 32) | v2;
+}
+
+size_t getEdgeShard(unsigned long long key, size_t shardsCount)
+{
+	// mix vertex indices to distribute neighbouring edges between shards
+	key ^= key >> 29;
+	key *= 0xbf58476d1ce4e5b9ull;
+	key ^= key >> 32;
+	return (size_t)(key % shardsCount);
+}
+
 std::vector<Data::TriangleAdjacency> Data::calculateAdjacency() const
 {
+	// Every triangle is registered in the hash map under its edges, the map keeps two
+	// triangles with the smallest indices per edge, so the adjacent triangle is the first
+	// triangle (excepting the current one) which has the edge, as in brute-force search.
+	// Degenerate edges (with coincident vertices) match any triangle with the vertex.
 	std::vector<TriangleAdjacency> output;
 	if (!isCorrect()) return output;
 
-	size_t trianglesCount = m_indexBuffer.size() / 3;
-	output.reserve(trianglesCount);
-
-	TriangleAdjacency t;
-	int edge[2];
-	int triangle[3];
-	for (size_t i = 0; i < trianglesCount; i++)
-	{
-		t.points[0] = m_indexBuffer[i * 3];
-		t.points[1] = m_indexBuffer[i * 3 + 1];
-		t.points[2] = m_indexBuffer[i * 3 + 2];
-		t.adjacentPoints[0] = -1;
-		t.adjacentPoints[1] = -1;
-		t.adjacentPoints[2] = -1;
-		 
-		for (size_t j = 0; j < trianglesCount; j++)
+	const unsigned int* indices = getIndexData();
+	size_t trianglesCount = getIndicesCount() / 3;
+	output.resize(trianglesCount);
+	if (trianglesCount == 0) return output;
+
+	const size_t MIN_TRIANGLES_PER_THREAD = 4096;
+	size_t threadsCount = utils::Parallel::getThreadsCount();
+	size_t shardsCount = (trianglesCount >= MIN_TRIANGLES_PER_THREAD) ? threadsCount : 1;
+
+	// collect edges of triangles by shards, ranges go in ascending order of triangles
+	std::vector<std::vector<std::vector<EdgeRecord> > > records(threadsCount);
+	std::vector<char> hasDegenerateTriangles(threadsCount, 0);
+	utils::Parallel::forRange(trianglesCount, [&](size_t begin, size_t end, size_t rangeIndex)
+	{
+		std::vector<std::vector<EdgeRecord> >& shards = records[rangeIndex];
+		shards.resize(shardsCount);
+		for (size_t i = 0; i < shardsCount; i++)
 		{
-			if (j == i) continue;
+			shards[i].reserve((end - begin) * 3 / shardsCount + 1);
+		}
 
-			triangle[0] = m_indexBuffer[j * 3];
-			triangle[1] = m_indexBuffer[j * 3 + 1];
-			triangle[2] = m_indexBuffer[j * 3 + 2];
+		for (size_t i = begin; i < end; i++)
+		{
+			const unsigned int* t = indices + i * 3;
+			bool degenerate = (t[0] == t[1] || t[1] == t[2] || t[2] == t[0]);
+			if (degenerate) hasDegenerateTriangles[rangeIndex] = 1;
 
-			if (t.adjacentPoints[0] == -1)
+			for (int k = 0; k < 3; k++)
 			{
-				edge[0] = t.points[0]; edge[1] = t.points[1];
-				t.adjacentPoints[0] = GetAdjacentIndex(edge, triangle);
+				unsigned int v1 = t[k];
+				unsigned int v2 = t[(k + 1) % 3];
+				if (v1 == v2) continue;
+
+				// an edge of a degenerate triangle can be met twice, it's harmless for TrianglesPair
+
+				EdgeRecord record;
+				record.key = getEdgeKey(v1, v2);
+				record.triangle = (int)i;
+				shards[getEdgeShard(record.key, shardsCount)].push_back(record);
 			}
+		}
+	}, MIN_TRIANGLES_PER_THREAD);
 
-			if (t.adjacentPoints[1] == -1)
+	// build edges maps, every shard is processed by its own thread
+	std::vector<EdgesMap> edges(shardsCount);
+	utils::Parallel::forRange(shardsCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t shard = begin; shard < end; shard++)
+		{
+			size_t recordsCount = 0;
+			for (size_t r = 0; r < records.size(); r++)
 			{
-				edge[0] = t.points[1]; edge[1] = t.points[2];
-				t.adjacentPoints[1] = GetAdjacentIndex(edge, triangle);
+				if (!records[r].empty()) recordsCount += records[r][shard].size();
 			}
 
-			if (t.adjacentPoints[2] == -1)
+			EdgesMap& edgesMap = edges[shard];
+			edgesMap.reserve(recordsCount);
+			for (size_t r = 0; r < records.size(); r++)
 			{
-				edge[0] = t.points[2]; edge[1] = t.points[0];
-				t.adjacentPoints[2] = GetAdjacentIndex(edge, triangle);
+				if (records[r].empty()) continue;
+				const std::vector<EdgeRecord>& shardRecords = records[r][shard];
+				for (size_t i = 0; i < shardRecords.size(); i++)
+				{
+					edgesMap[shardRecords[i].key].add(shardRecords[i].triangle);
+				}
+				std::vector<EdgeRecord>().swap(records[r][shard]);
 			}
-
-			if (t.adjacentPoints[0] != -1 && t.adjacentPoints[1] != -1 && t.adjacentPoints[2] != -1) break;
 		}
+	});
 
-		output.push_back(t);
+	// triangles by vertices, it's necessary for degenerate edges only
+	std::unordered_map<unsigned int, TrianglesPair> vertices;
+	if (std::find(hasDegenerateTriangles.begin(), hasDegenerateTriangles.end(), 1) != hasDegenerateTriangles.end())
+	{
+		for (size_t i = 0; i < trianglesCount; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				vertices[indices[i * 3 + k]].add((int)i);
+			}
+		}
 	}
 
+	// find adjacent points
+	utils::Parallel::forRange(trianglesCount, [&](size_t begin, size_t end, size_t)
+	{
+		int edge[2];
+		int triangle[3];
+		for (size_t i = begin; i < end; i++)
+		{
+			TriangleAdjacency& t = output[i];
+			for (int k = 0; k < 3; k++)
+			{
+				t.points[k] = indices[i * 3 + k];
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				edge[0] = t.points[k];
+				edge[1] = t.points[(k + 1) % 3];
+				t.adjacentPoints[k] = -1;
+
+				int adjacentTriangle = -1;
+				if (edge[0] != edge[1])
+				{
+					const EdgesMap& edgesMap = edges[getEdgeShard(getEdgeKey(edge[0], edge[1]), shardsCount)];
+					auto it = edgesMap.find(getEdgeKey(edge[0], edge[1]));
+					if (it != edgesMap.end()) adjacentTriangle = it->second.getAnother((int)i);
+				}
+				else
+				{
+					auto it = vertices.find(edge[0]);
+					if (it != vertices.end()) adjacentTriangle = it->second.getAnother((int)i);
+				}
+				if (adjacentTriangle < 0) continue;
+
+				triangle[0] = indices[adjacentTriangle * 3];
+				triangle[1] = indices[adjacentTriangle * 3 + 1];
+				triangle[2] = indices[adjacentTriangle * 3 + 2];
+				t.adjacentPoints[k] = GetAdjacentIndex(edge, triangle);
+			}
+		}
+	}, MIN_TRIANGLES_PER_THREAD);
+
 	return output;
 }
 
+unsigned long long Data::computeHash() const
+{
+	unsigned long long description[4] = { (unsigned long long)m_vertexFormat, (unsigned long long)m_additionalUVsCount,
+										   (unsigned long long)m_componentsMask, (unsigned long long)m_verticesCount };
+	unsigned long long hash = utils::Utils::computeHash((const unsigned char*)description, sizeof(description));
+	hash = utils::Utils::computeHash(getVertexData(), getVertexDataSize(), hash);
+	hash = utils::Utils::computeHash((const unsigned char*)getIndexData(), getIndicesCount() * sizeof(unsigned int), hash);
+	for (size_t i = 0; i < m_meshes.size(); i++)
+	{
+		const Mesh& mesh = m_meshes[i];
+		unsigned long long range[2] = { (unsigned long long)mesh.offsetInIB, (unsigned long long)mesh.indicesCount };
+		hash = utils::Utils::computeHash((const unsigned char*)range, sizeof(range), hash);
+		const std::string* names[] = { &mesh.material.diffuseMapFilename, &mesh.material.normalMapFilename, 
+									   &mesh.material.specularMapFilename };
+		for (size_t j = 0; j < sizeof(names) / sizeof(names[0]); j++)
+		{
+			// sizes separate names, so ("ab", "") and ("a", "b") differ
+			hash = utils::Utils::computeHash((const unsigned char*)names[j]->c_str(), names[j]->size(), hash + names[j]->size());
+		}
+	}
+	return hash;
+}
+
 }
\ No newline at end of file
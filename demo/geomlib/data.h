@@ -24,15 +24,90 @@
 #ifndef __GEOMETRY_DATA_H__
 #define __GEOMETRY_DATA_H__
 
+namespace utils
+{
+class MemoryMappedFile;
+}
+
 namespace geom
 {
 
 class Data
 {
-	friend class GeometryLoader;
-	friend class GeometryGenerator;
+	friend class DataWriter;
 
 public:
+	enum VertexFormat
+	{
+		// all components are 32-bit floats, see Vertex
+		VERTEX_FORMAT_FULL = 0,
+		// normal and tangent are packed into 10:10:10:2, texture coordinates are
+		// half floats, binormal is not stored, see CompactVertex
+		VERTEX_FORMAT_COMPACT,
+		// the same as VERTEX_FORMAT_COMPACT, but positions are 16-bit values
+		// quantized against the bounding box, see QuantizedVertex
+		VERTEX_FORMAT_COMPACT_QUANTIZED
+	};
+
+	// Vertices can be split into two streams: tightly packed positions for depth-only
+	// rendering and the rest of components, see splitVertexStreams
+	enum VertexStream
+	{
+		STREAM_POSITIONS = 0,
+		STREAM_ATTRIBUTES,
+		STREAMS_COUNT
+	};
+
+	enum VertexComponentType
+	{
+		COMPONENT_FLOAT = 0,
+		COMPONENT_HALF,
+		COMPONENT_UNORM16,
+		COMPONENT_UNORM_10_10_10_2
+	};
+
+	enum VertexComponentSemantic
+	{
+		SEMANTIC_POSITION = 0,
+		SEMANTIC_NORMAL,
+		SEMANTIC_TEXCOORD,
+		SEMANTIC_TANGENT,
+		SEMANTIC_BINORMAL
+	};
+
+	// Optional components of vertices, positions are always present. Additional texture
+	// coordinates are controlled by their number.
+	enum VertexComponentsMask
+	{
+		COMPONENTS_NORMAL = 1,
+		COMPONENTS_TEXCOORD0 = 2,
+		// tangent and binormal (the binormal is not stored in compact formats)
+		COMPONENTS_TANGENT_FRAME = 4,
+		COMPONENTS_ALL = COMPONENTS_NORMAL | COMPONENTS_TEXCOORD0 | COMPONENTS_TANGENT_FRAME
+	};
+
+	struct VertexComponent
+	{
+		VertexComponentSemantic semantic;
+		size_t semanticIndex;
+		VertexComponentType type;
+		// size and offset in a vertex (in bytes)
+		size_t size;
+		size_t offset;
+		// see VertexStream
+		size_t stream;
+		size_t offsetInStream;
+		// binding location which doesn't depend on presence of other components:
+		// 0 - position, 1 - normal, 2 - uv0, 3 - tangent, 4 - binormal, 5 + i - additional uv i
+		size_t location;
+	};
+
+	// Components in order of their placement in a vertex, it's calculated once
+	// for a vertex format, a number of additional UVs and a mask of components.
+	typedef std::vector<VertexComponent> VertexDeclaration;
+
+	// The following structures describe vertices with all components (COMPONENTS_ALL),
+	// vertices without some components have the same order of the rest of them.
 	struct Vertex
 	{                       // indices:
 		vector3 position;   // 0
@@ -42,6 +117,26 @@ public:
 		vector3 binormal;   // 4
 	};
 
+	// Unit vectors are packed as (v * 0.5 + 0.5), the 2-bit component of tangent is 1 if
+	// binormal equals cross(normal, tangent) and 0 otherwise, so shaders restore it as
+	// binormal = cross(normal, tangent.xyz) * (tangent.w * 2.0 - 1.0).
+	struct CompactVertex
+	{                               // indices:
+		vector3 position;           // 0
+		unsigned int normal;        // 1
+		unsigned short texCoord0[2];// 2
+		unsigned int tangent;       // 3
+	};                              // 4 - binormal is not stored
+
+	// Position is restored as boundingBox.vmin + position * boundingBox.size().
+	struct QuantizedVertex
+	{                               // indices:
+		unsigned short position[4]; // 0
+		unsigned int normal;        // 1
+		unsigned short texCoord0[2];// 2
+		unsigned int tangent;       // 3
+	};                              // 4 - binormal is not stored
+
 	struct TriangleAdjacency
 	{
 		int points[3];
@@ -55,12 +150,49 @@ public:
 		std::string specularMapFilename;
 	};
 
+	struct Lod
+	{
+		size_t offsetInIB;
+		size_t indicesCount;
+		// geometric error relative to the diagonal of the bounding box
+		float error;
+		Lod() : offsetInIB(0), indicesCount(0), error(0.0f) {}
+	};
+
+	typedef std::vector<Lod> Lods;
+
+	struct Cluster
+	{
+		size_t offsetInIB;
+		size_t indicesCount;
+		// bounding sphere
+		vector3 center;
+		float radius;
+		// normal cone, the cluster is backfacing for a camera if
+		// dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius
+		vector3 coneAxis;
+		float coneCutoff;
+		Cluster() : offsetInIB(0), indicesCount(0), center(0, 0, 0), radius(0.0f), coneAxis(0, 0, 0), coneCutoff(1.0f) {}
+	};
+
+	typedef std::vector<Cluster> Clusters;
+
 	struct Mesh
 	{
 		size_t offsetInIB;
 		size_t indicesCount;
 		Material material;
-		Mesh() : offsetInIB(0), indicesCount(0) {}
+		// simplified versions of the mesh (LOD 0 is the mesh itself), they share the vertex buffer
+		Lods lods;
+		// contiguous parts of the mesh for fine-grained culling (see ClusterBuilder)
+		Clusters clusters;
+		// bounding volumes of vertices referenced by the mesh (see BoundsCalculator),
+		// negative radius means the bounds have not been calculated
+		bbox3 boundingBox;
+		vector3 boundingSphereCenter;
+		float boundingSphereRadius;
+		Mesh() : offsetInIB(0), indicesCount(0), boundingSphereRadius(-1.0f) {}
+		bool hasBounds() const { return boundingSphereRadius >= 0.0f; }
 	};
 
 	typedef std::vector<Mesh> Meshes;
@@ -74,32 +206,72 @@ public:
 	bool isCorrect() const;
 	const std::string& getLastError() const;
 	const Meshes& getMeshes() const;
+	VertexFormat getVertexFormat() const;
 	size_t getAdditionalUVsCount() const;
 	size_t getVerticesCount() const;
 	const bbox3& getBoundingBox() const;
 	const std::vector<unsigned char>& getVertexBuffer() const;
 	const std::vector<unsigned int>& getIndexBuffer() const;
 
+	// Vertex and index data are accessible via the following methods independently
+	// of the storage. Mapped data (see GeometryLoader::loadMapped) is a read-only view
+	// into a memory-mapped file, its vertex and index buffers above are empty.
+	bool isMapped() const;
+	void releaseMapping();
+	const unsigned char* getVertexData() const;
+	size_t getVertexDataSize() const;
+	const unsigned int* getIndexData() const;
+	size_t getIndicesCount() const;
+
+	const VertexDeclaration& getVertexDeclaration() const;
+	unsigned int getVertexComponentsMask() const;
+	// returns the index of a component in the declaration or -1 if vertices don't have it
+	int findVertexComponent(VertexComponentSemantic semantic, size_t semanticIndex = 0) const;
 	size_t getVertexComponentsCount() const;
 	size_t getVertexComponentSize(size_t index) const;
+	VertexComponentType getVertexComponentType(size_t index) const;
 	size_t getVertexComponentOffset(size_t index) const;
 	size_t getVertexSize() const;
+	size_t getVertexComponentStream(size_t index) const;
+	size_t getVertexComponentOffsetInStream(size_t index) const;
+	size_t getVertexStreamStride(size_t stream) const;
+	// Copies vertex data into the buffers of STREAM_POSITIONS and STREAM_ATTRIBUTES, every buffer must
+	// contain (vertices count * stream stride) bytes. Buffers can be mapped GPU memory.
+	void splitVertexStreams(unsigned char* positions, unsigned char* attributes) const;
 	const char* getSemanticName(size_t index) const;
 	size_t getSemanticIndex(size_t index) const;
+	vector3 getPosition(size_t vertexIndex) const;
 
 	std::vector<TriangleAdjacency> calculateAdjacency() const;
+	// 64-bit hash of vertices, indices and meshes (with materials), equal data from different files
+	// get equal hashes. It is not cryptographic.
+	unsigned long long computeHash() const;
 
 	Data& operator=(const Data& data);
 	Data& operator=(Data&& data);
 
 private:
+	void setVertexDeclaration(VertexFormat format, size_t additionalUVsCount, unsigned int componentsMask);
+	void copyVertexDeclaration(const Data& data);
+
 	Meshes m_meshes;
+	VertexFormat m_vertexFormat;
 	size_t m_additionalUVsCount;
+	unsigned int m_componentsMask;
+	VertexDeclaration m_vertexDeclaration;
+	size_t m_vertexSize;
+	size_t m_streamStrides[STREAMS_COUNT];
 	size_t m_verticesCount;
 	bbox3 m_boundingBox;
 	std::vector<unsigned char> m_vertexBuffer;
 	std::vector<unsigned int> m_indexBuffer;
 	std::string m_lastError;
+
+	std::shared_ptr<utils::MemoryMappedFile> m_mappedFile;
+	const unsigned char* m_mappedVertexData;
+	size_t m_mappedVertexDataSize;
+	const unsigned int* m_mappedIndexData;
+	size_t m_mappedIndicesCount;
 };
 
 
@@ -107,128 +107,82 @@ Data FbxLoader::load(const std::string& filename)
     }
         
     writer.getMeshesRef().resize(meshes.size());
-        
-	std::vector< std::vector<GroupData> > meshesData;
-	meshesData.resize(meshes.size());
-	size_t i = 0;
-	size_t reindexerIndex = 0;
+	std::vector<FbxMesh*> fbxMeshes;
+	fbxMeshes.reserve(meshes.size());
+	size_t meshesCounter = 0;
+	for (auto it = meshes.cbegin(); it != meshes.cend(); ++it, ++meshesCounter)
+	{
+		fbxMeshes.push_back(it->first);
+		writer.getMeshesRef()[meshesCounter].material = it->second;
+	}
+
+	// meshes are independent, so they are reindexed in parallel
+	std::vector<MeshVertices> meshesVertices(fbxMeshes.size());
+	utils::Parallel::forRange(fbxMeshes.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++) reindexing(fbxMeshes[i], meshesVertices[i]);
+	});
+
 	size_t verticesCount = 0;
-    size_t indicesCount = 0;
-	for (auto it = meshes.cbegin(); it != meshes.cend(); ++it, ++i)
-    {
-		reindexing(it->first, meshesData[i], reindexerIndex);
-		for (size_t j = 0; j < meshesData[i].size(); j++)
-		{
-			verticesCount += meshesData[i][j].reindexer.size();
-			indicesCount += meshesData[i][j].polygonIndices.size() * 3;
-		}
+	size_t indicesCount = 0;
+	std::vector<size_t> vertexOffsets(fbxMeshes.size());
+	for (size_t i = 0; i < fbxMeshes.size(); i++)
+	{
+		vertexOffsets[i] = verticesCount;
+		writer.getMeshesRef()[i].offsetInIB = indicesCount;
+		writer.getMeshesRef()[i].indicesCount = meshesVertices[i].indices.size();
+		verticesCount += meshesVertices[i].controlPoints.size();
+		indicesCount += meshesVertices[i].indices.size();
 	}
 		
 	writer.getVerticesCountRef() = verticesCount;
-    writer.getAdditionalUVsCountRef() = getAdditionalUVsCount(meshes);
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, getAdditionalUVsCount(meshes));
         
     size_t vertexSize = data.getVertexSize();
+	// components are addressed by binding locations, absent ones have no floats
+	const Data::VertexDeclaration& declaration = data.getVertexDeclaration();
+	std::vector<ComponentLayout> layout(5 + data.getAdditionalUVsCount());
+	for (size_t component = 0; component < declaration.size(); component++)
+	{
+		layout[declaration[component].location].offset = declaration[component].offset;
+		layout[declaration[component].location].floatsCount = declaration[component].size / sizeof(float);
+	}
         
 	writer.getVertexBufferRef().resize(vertexSize * verticesCount);
     memset(writer.getVertexBufferRef().data(), 0, writer.getVertexBufferRef().size()); // clear
+	writer.getIndexBufferRef().resize(indicesCount);
 
-    size_t meshesCounter = 0;
-	writer.getBoundingBoxRef().begin_extend();
-
-    for (auto it = meshes.cbegin(); it != meshes.cend(); ++it, ++meshesCounter)
-    {
-		size_t vertexCounter = 0;
-		for (size_t j = 0; j < meshesData[meshesCounter].size(); j++)
+	utils::Parallel::forRange(fbxMeshes.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++)
 		{
-			for (std::list<size_t>::iterator it2 = meshesData[meshesCounter][j].polygonIndices.begin(); it2 != meshesData[meshesCounter][j].polygonIndices.end(); ++it2)
+			const MeshVertices& vertices = meshesVertices[i];
+			unsigned char* vertexBuffer = writer.getVertexBufferRef().data() + vertexOffsets[i] * vertexSize;
+			fillVertices(fbxMeshes[i], vertices, layout, vertexSize, vertexBuffer);
+
+			unsigned int* indexBuffer = writer.getIndexBufferRef().data() + writer.getMeshesRef()[i].offsetInIB;
+			for (size_t j = 0; j < vertices.indices.size(); j++)
 			{
-				for (size_t k = 0; k < 3; k++)
-				{
-					int index_k = it->first->GetPolygonVertex(*it2, k);
-					size_t new_index = meshesData[meshesCounter][j].reindexer[(size_t)index_k];
-
-					for (size_t component = 0; component < data.getVertexComponentsCount(); component++)
-					{
-						size_t offset = data.getVertexComponentOffset(component);
-						size_t componentSize = data.getVertexComponentSize(component);
-            
-						// fill vertex buffer
-						if (component == 0) // position
-						{
-							float* ptr = (float*)(writer.getVertexBufferRef().data() + new_index * vertexSize + offset);
-							FbxVector4 vertex = it->first->GetControlPointAt(index_k);
-							ptr[0] = (float)vertex[0];
-							ptr[1] = (float)vertex[1];
-							ptr[2] = (float)vertex[2];
-							writer.getBoundingBoxRef().extend(ptr[0], ptr[1], ptr[2]);
-						}
-						else if (component == 1) // normal
-						{
-							FbxGeometryElementNormal* normalElement = it->first->GetElementNormal();
-							float* ptr = (float*)(writer.getVertexBufferRef().data() + new_index * vertexSize + offset);
-							importComponent<FbxGeometryElementNormal, FbxVector4>(normalElement, ptr, it->first, (*it2) * 3 + k, componentSize / sizeof(float));
-						}
-						else if (component == 2) // uv0
-						{
-							FbxGeometryElementUV* uvElement = it->first->GetElementUV(0);
-							float* ptr = (float*)(writer.getVertexBufferRef().data() + new_index * vertexSize + offset);
-							importComponent<FbxGeometryElementUV, FbxVector2>(uvElement, ptr, it->first, (*it2) * 3 + k, componentSize / sizeof(float));
-						}
-						else if (component == 3) // tangent
-						{
-							FbxGeometryElementTangent* tangentElement = it->first->GetElementTangent();
-							float* ptr = (float*)(writer.getVertexBufferRef().data() + new_index * vertexSize + offset);
-							importComponent<FbxGeometryElementTangent, FbxVector4>(tangentElement, ptr, it->first, (*it2) * 3 + k, componentSize / sizeof(float));
-						}
-						else if (component == 4) // binormal
-						{
-							FbxGeometryElementBinormal* binormalElement = it->first->GetElementBinormal();
-							float* ptr = (float*)(writer.getVertexBufferRef().data() + new_index * vertexSize + offset);
-							importComponent<FbxGeometryElementBinormal, FbxVector4>(binormalElement, ptr, it->first, (*it2) * 3 + k, componentSize / sizeof(float));
-						}
-						else // additional uvs
-						{
-							int uvIndex = (int)component - 4;
-							FbxGeometryElementUV* uvElement = it->first->GetElementUV((int)uvIndex);
-							float* ptr = (float*)(writer.getVertexBufferRef().data() + new_index * vertexSize + offset);
-							importComponent<FbxGeometryElementUV, FbxVector2>(uvElement, ptr, it->first, (*it2) * 3 + k, componentSize / sizeof(float));
-						}
-					}
-				}
+				indexBuffer[j] = (unsigned int)(vertexOffsets[i] + vertices.indices[j]);
 			}
-			vertexCounter += (meshesData[meshesCounter][j].reindexer.size());
 		}
-    }
+	});
 
+	writer.getBoundingBoxRef().begin_extend();
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		const float* position = (const float*)(writer.getVertexBufferRef().data() + v * vertexSize);
+		writer.getBoundingBoxRef().extend(position[0], position[1], position[2]);
+	}
 	writer.getBoundingBoxRef().end_extend();
+	BoundsCalculator::calculate(writer);
 
-	// index buffer
-	writer.getIndexBufferRef().resize(indicesCount);
-  
-    meshesCounter = 0;
-	size_t meshOffsetInIB = 0;
-    for (auto it = meshes.cbegin(); it != meshes.cend(); ++it, ++meshesCounter)
-    {
-		size_t indicesInMesh = 0;
-		for (size_t j = 0; j < meshesData[meshesCounter].size(); j++)
-		{
-			for (std::list<size_t>::iterator it2 = meshesData[meshesCounter][j].polygonIndices.begin(); it2 != meshesData[meshesCounter][j].polygonIndices.end(); ++it2)
-			{
-				for (size_t k = 0; k < 3; k++)
-				{
-					int index_k = it->first->GetPolygonVertex(*it2, k);
-					size_t new_index = meshesData[meshesCounter][j].reindexer[(size_t)index_k];
-					writer.getIndexBufferRef().data()[meshOffsetInIB + indicesInMesh + k] = (unsigned int)new_index;
-				}
-				indicesInMesh += 3;
-			}
-		}
-
-		writer.getMeshesRef()[meshesCounter].indicesCount = indicesInMesh;
-		writer.getMeshesRef()[meshesCounter].offsetInIB = meshOffsetInIB;
-		writer.getMeshesRef()[meshesCounter].material = it->second;
-        meshOffsetInIB += indicesInMesh;
-    }
+	std::vector<size_t> meshesWithoutTangents;
+	for (size_t i = 0; i < fbxMeshes.size(); i++)
+	{
+		if (fbxMeshes[i]->GetElementTangent() == 0 && fbxMeshes[i]->GetElementUV(0) != 0) meshesWithoutTangents.push_back(i);
+	}
+	if (!meshesWithoutTangents.empty()) TangentFrameCalculator::calculate(writer, meshesWithoutTangents);
 		    
     fbxScene->Destroy();	
 	
@@ -376,26 +330,8 @@ bool FbxLoader::checkVertexContent(DataWriter& dataWriter, FbxMesh* mesh)
 			return false;
 		}
     }
-            
-    // tangents
-    FbxLayer* tangentsLayer = mesh->GetLayer(0, FbxLayerElement::EType::eTangent);
-    if (!tangentsLayer)
-    {
-        bool result = mesh->GenerateTangentsData(0, true);
-        if (!result) dataWriter.getLastErrorRef() = "Tangents have not been generated";
-		return false;
-    }
-    else
-    {
-        FbxLayerElementTangent* tangents = tangentsLayer->GetTangents();
-        if (tangents == 0) 
-		{
-			bool result = mesh->GenerateTangentsData(0, true);
-			if (!result) dataWriter.getLastErrorRef() = "Tangents have not been generated";
-			return false;
-		}
-    }
 
+	// absent tangents are calculated after importing (see TangentFrameCalculator)
 	return true;
 }
     
@@ -415,47 +351,75 @@ void FbxLoader::getSmoothingGroup(FbxMesh* mesh, std::vector<int>& group)
     }
 }
 
-void FbxLoader::reindexing(FbxMesh* mesh, std::vector<GroupData>& groups, size_t& reindexerIndex)
+void FbxLoader::reindexing(FbxMesh* mesh, MeshVertices& vertices)
 {
 	std::vector<int> smoothingGroupsPerPolygon;
 	getSmoothingGroup(mesh, smoothingGroupsPerPolygon);
 
-	int newGroupIndex = -1;
-	int prevIndex = -1;
-	for (size_t polygonIndex = 0; polygonIndex < smoothingGroupsPerPolygon.size(); polygonIndex++)
+	// polygons with the same smoothing group which follow each other make a group, 
+	// control points are shared by the polygons of a group only
+	size_t polygonsCount = smoothingGroupsPerPolygon.size();
+	vertices.indices.resize(polygonsCount * 3);
+	vertices.controlPoints.clear();
+	vertices.polygonVertices.clear();
+
+	std::vector<unsigned int> groupVertices(mesh->GetControlPointsCount(), 0);
+	std::vector<size_t> groupMarks(mesh->GetControlPointsCount(), 0);
+	size_t groupMark = 0;
+	for (size_t polygonIndex = 0; polygonIndex < polygonsCount; polygonIndex++)
 	{
-		if (smoothingGroupsPerPolygon[polygonIndex] != prevIndex) newGroupIndex++;
-		prevIndex = smoothingGroupsPerPolygon[polygonIndex];
-		smoothingGroupsPerPolygon[polygonIndex] = newGroupIndex;
+		if (polygonIndex == 0 || smoothingGroupsPerPolygon[polygonIndex] != smoothingGroupsPerPolygon[polygonIndex - 1]) groupMark++;
+
+		for (int k = 0; k < 3; k++)
+		{
+			int index = mesh->GetPolygonVertex((int)polygonIndex, k);
+			if (groupMarks[index] != groupMark)
+			{
+				groupMarks[index] = groupMark;
+				groupVertices[index] = (unsigned int)vertices.controlPoints.size();
+				vertices.controlPoints.push_back(index);
+				vertices.polygonVertices.push_back(0);
+			}
+
+			// the last polygon vertex defines attributes of the vertex
+			unsigned int vertexIndex = groupVertices[index];
+			vertices.polygonVertices[vertexIndex] = (int)polygonIndex * 3 + k;
+			vertices.indices[polygonIndex * 3 + k] = vertexIndex;
+		}
 	}
-		
-	std::vector<int> smoothingGroups = smoothingGroupsPerPolygon;
-	std::vector<int>::iterator it = std::unique(smoothingGroups.begin(), smoothingGroups.end());
-	smoothingGroups.resize(std::distance(smoothingGroups.begin(), it));
+}
 
-	groups.resize(smoothingGroups.size());
+void FbxLoader::fillVertices(FbxMesh* mesh, const MeshVertices& vertices, const std::vector<ComponentLayout>& layout,
+							 size_t vertexSize, unsigned char* vertexBuffer)
+{
+	FbxGeometryElementNormal* normalElement = mesh->GetElementNormal();
+	FbxGeometryElementUV* uvElement = mesh->GetElementUV(0);
+	FbxGeometryElementTangent* tangentElement = mesh->GetElementTangent();
+	FbxGeometryElementBinormal* binormalElement = mesh->GetElementBinormal();
+	std::vector<FbxGeometryElementUV*> additionalUVElements;
+	for (size_t component = 5; component < layout.size(); component++)
+	{
+		additionalUVElements.push_back(mesh->GetElementUV((int)component - 4));
+	}
 
-	for (size_t group = 0; group < smoothingGroups.size(); group++)
+	for (size_t v = 0; v < vertices.controlPoints.size(); v++)
 	{
-		for (size_t polygonIndex = 0; polygonIndex < smoothingGroupsPerPolygon.size(); polygonIndex++)
+		unsigned char* vertex = vertexBuffer + v * vertexSize;
+		int polygonVertex = vertices.polygonVertices[v];
+
+		float* ptr = (float*)(vertex + layout[0].offset);
+		FbxVector4 position = mesh->GetControlPointAt(vertices.controlPoints[v]);
+		ptr[0] = (float)position[0];
+		ptr[1] = (float)position[1];
+		ptr[2] = (float)position[2];
+
+		importComponent<FbxGeometryElementNormal, FbxVector4>(normalElement, (float*)(vertex + layout[1].offset), mesh, polygonVertex, layout[1].floatsCount);
+		importComponent<FbxGeometryElementUV, FbxVector2>(uvElement, (float*)(vertex + layout[2].offset), mesh, polygonVertex, layout[2].floatsCount);
+		importComponent<FbxGeometryElementTangent, FbxVector4>(tangentElement, (float*)(vertex + layout[3].offset), mesh, polygonVertex, layout[3].floatsCount);
+		importComponent<FbxGeometryElementBinormal, FbxVector4>(binormalElement, (float*)(vertex + layout[4].offset), mesh, polygonVertex, layout[4].floatsCount);
+		for (size_t i = 0; i < additionalUVElements.size(); i++)
 		{
-			if (smoothingGroups[group] == smoothingGroupsPerPolygon[polygonIndex])
-			{
-				groups[group].polygonIndices.push_back(polygonIndex);
-
-				int lPolygonSize = mesh->GetPolygonSize(polygonIndex);
-				for(int i = 0; i < lPolygonSize; i++)
-				{
-					int index = mesh->GetPolygonVertex(polygonIndex, i);
-					int newIndex;
-					if (groups[group].reindexer.find(index) == groups[group].reindexer.end())
-					{
-						newIndex = reindexerIndex;
-						groups[group].reindexer.insert(std::make_pair((size_t)index, newIndex));
-						reindexerIndex++;
-					}
-				}
-			}
+			importComponent<FbxGeometryElementUV, FbxVector2>(additionalUVElements[i], (float*)(vertex + layout[5 + i].offset), mesh, polygonVertex, layout[5 + i].floatsCount);
 		}
 	}
 }
@@ -34,21 +34,34 @@ public:
 	virtual ~FbxLoader();
 	
 	virtual Data load(const std::string& filename);
+	virtual bool isThreadSafe() const { return false; }
 
 private:
 	FbxManager* m_manager;
 
-	struct GroupData
+	// vertices of a mesh in the order of the output
+	struct MeshVertices
 	{
-		std::list<size_t> polygonIndices;
-		std::map<size_t, size_t> reindexer;
+		std::vector<unsigned int> indices;
+		std::vector<int> controlPoints;
+		// polygon vertex (polygon * 3 + k) which defines attributes of a vertex
+		std::vector<int> polygonVertices;
+	};
+
+	struct ComponentLayout
+	{
+		size_t offset;
+		size_t floatsCount;
+		ComponentLayout() : offset(0), floatsCount(0) {}
 	};
 
 	void processFbxNode(DataWriter& dataWriter, FbxNode* node, std::list<std::pair<FbxMesh*, Data::Material> >& meshes);
 	size_t getAdditionalUVsCount(const std::list<std::pair<FbxMesh*, Data::Material> >& meshes);
     bool checkVertexContent(DataWriter& dataWriter, FbxMesh* mesh);
 	void getSmoothingGroup(FbxMesh* mesh, std::vector<int>& group);
-	void reindexing(FbxMesh* mesh, std::vector<GroupData>& groups, size_t& reindexerIndex);
+	void reindexing(FbxMesh* mesh, MeshVertices& vertices);
+	void fillVertices(FbxMesh* mesh, const MeshVertices& vertices, const std::vector<ComponentLayout>& layout,
+					  size_t vertexSize, unsigned char* vertexBuffer);
 	std::string getTextureName(FbxSurfaceMaterial* material, const std::string& textureType);
 
 	template <typename ElementType, typename VectorType> 
@@ -31,12 +31,19 @@ Geometry::Geometry()
 {
 	registerLoader<GeomLoader>("geom");
 	registerSaver<GeomSaver>("geom");
+	registerLoader<ObjLoader>("obj");
+	registerLoader<PlyLoader>("ply");
 
 	#ifdef _USE_FBX
 	registerLoader<FbxLoader>("fbx");
 	#endif
 }
 
+Geometry::~Geometry()
+{
+	finishAsyncLoading();
+}
+
 std::shared_ptr<GeometryLoader> Geometry::getLoader(const std::string& extention) const
 {
 	if (m_loaders.find(extention) == m_loaders.end()) return std::shared_ptr<GeometryLoader>(new GeometryLoader());
@@ -57,7 +64,52 @@ Data Geometry::load(const std::string& filepath)
 		GeometryLoader loader;
 		return loader.load(filepath);
 	}
-	return getLoader(ext)->load(filepath);
+
+	auto loader = getLoader(ext);
+	if (loader->isThreadSafe()) return loader->load(filepath);
+
+	std::lock_guard<std::mutex> lock(m_serialLoadingMutex);
+	return loader->load(filepath);
+}
+
+Data Geometry::loadMapped(const std::string& filepath)
+{
+	std::string ext = utils::Utils::getExtention(filepath);
+	if (ext.empty())
+	{
+		GeometryLoader loader;
+		return loader.loadMapped(filepath);
+	}
+
+	auto loader = getLoader(ext);
+	if (loader->isThreadSafe()) return loader->loadMapped(filepath);
+
+	std::lock_guard<std::mutex> lock(m_serialLoadingMutex);
+	return loader->loadMapped(filepath);
+}
+
+std::future<Data> Geometry::loadAsync(const std::string& filepath)
+{
+	auto task = std::make_shared<std::packaged_task<Data()> >([this, filepath]()
+	{
+		return load(filepath);
+	});
+	std::future<Data> result = task->get_future();
+
+	std::lock_guard<std::mutex> lock(m_threadPoolMutex);
+	if (!m_threadPool) m_threadPool.reset(new utils::ThreadPool());
+	m_threadPool->enqueue([task]() { (*task)(); });
+	return result;
+}
+
+void Geometry::finishAsyncLoading()
+{
+	std::shared_ptr<utils::ThreadPool> threadPool;
+	{
+		std::lock_guard<std::mutex> lock(m_threadPoolMutex);
+		threadPool.swap(m_threadPool);
+	}
+	threadPool.reset();
 }
 
 bool Geometry::save(const Data& data, const std::string& filepath)
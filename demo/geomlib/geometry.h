@@ -28,13 +28,18 @@
 #include "geometryloader.h"
 #include "geometrysaver.h"
 
+namespace utils
+{
+class ThreadPool;
+}
+
 namespace geom
 {
 
 class Geometry
 {
 	Geometry();
-	~Geometry(){}
+	~Geometry();
 
 public:
 	static Geometry& instance()
@@ -59,12 +64,24 @@ public:
 
 	std::shared_ptr<GeometrySaver> getSaver(const std::string& extention) const;
 
+	// loading can be called from several threads, loaders which are not thread-safe
+	// (see GeometryLoader::isThreadSafe) process their files one by one
 	Data load(const std::string& filepath);
+	Data loadMapped(const std::string& filepath);
 	bool save(const Data& data, const std::string& filepath);
 
+	// reads and decodes the file on a worker thread
+	std::future<Data> loadAsync(const std::string& filepath);
+	// waits for all asynchronous loads and releases worker threads
+	void finishAsyncLoading();
+
 private:
 	std::map<std::string, std::shared_ptr<GeometryLoader> > m_loaders;
 	std::map<std::string, std::shared_ptr<GeometrySaver> > m_savers;
+
+	std::shared_ptr<utils::ThreadPool> m_threadPool;
+	std::mutex m_threadPoolMutex;
+	std::mutex m_serialLoadingMutex;
 };
 
 
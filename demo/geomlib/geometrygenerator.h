@@ -24,6 +24,8 @@
 #ifndef __GEOMETRY_GENERATOR_H__
 #define __GEOMETRY_GENERATOR_H__
 
+#include "datawriter.h"
+
 namespace geom
 {
 
@@ -36,22 +38,7 @@ public:
 	virtual Data generate();
 
 protected:
-	class DataWriter
-	{
-	public:
-		DataWriter(Data* data) : m_data(data) {}
-
-		std::string& getLastErrorRef() { return m_data->m_lastError; }
-		Data::Meshes& getMeshesRef() { return m_data->m_meshes; }
-		size_t& getAdditionalUVsCountRef() { return m_data->m_additionalUVsCount; }
-		size_t& getVerticesCountRef() { return m_data->m_verticesCount; }
-		bbox3& getBoundingBoxRef() { return m_data->m_boundingBox; }
-		std::vector<unsigned char>& getVertexBufferRef() { return m_data->m_vertexBuffer; }
-		std::vector<unsigned int>& getIndexBufferRef() { return m_data->m_indexBuffer; }
-
-	private:
-		Data* m_data;
-	};
+	typedef geom::DataWriter DataWriter;
 };
 
 }
@@ -35,4 +35,9 @@ Data GeometryLoader::load(const std::string& filename)
 	return data;
 }
 
+Data GeometryLoader::loadMapped(const std::string& filename)
+{
+	return load(filename);
+}
+
 }
\ No newline at end of file
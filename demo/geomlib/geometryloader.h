@@ -24,6 +24,8 @@
 #ifndef __GEOMETRY_LOADER_H__
 #define __GEOMETRY_LOADER_H__
 
+#include "datawriter.h"
+
 namespace geom
 {
 
@@ -35,23 +37,15 @@ public:
 	
 	virtual Data load(const std::string& filename);
 
+	// Loads data as a zero-copy view into the memory-mapped file if the format allows it,
+	// otherwise falls back to load().
+	virtual Data loadMapped(const std::string& filename);
+
+	// loaders which keep a state between loads must return false
+	virtual bool isThreadSafe() const { return true; }
+
 protected:
-	class DataWriter
-	{
-	public:
-		DataWriter(Data* data) : m_data(data) {}
-
-		std::string& getLastErrorRef() { return m_data->m_lastError; }
-		Data::Meshes& getMeshesRef() { return m_data->m_meshes; }
-		size_t& getAdditionalUVsCountRef() { return m_data->m_additionalUVsCount; }
-		size_t& getVerticesCountRef() { return m_data->m_verticesCount; }
-		bbox3& getBoundingBoxRef() { return m_data->m_boundingBox; }
-		std::vector<unsigned char>& getVertexBufferRef() { return m_data->m_vertexBuffer; }
-		std::vector<unsigned int>& getIndexBufferRef() { return m_data->m_indexBuffer; }
-
-	private:
-		Data* m_data;
-	};
+	typedef geom::DataWriter DataWriter;
 };
 
 }
@@ -27,7 +27,7 @@
 namespace geom
 {
 
-// Format description:
+// Format v1 description (obsolete, can be only read):
 //
 // 4 bytes		- magic number
 // 3 x 4 bytes	- bounding box min (x, y, z)
@@ -44,8 +44,167 @@ namespace geom
 //		4 bytes	- number of indices in a mesh (in bytes)
 // X bytes		- vertex buffer
 // Y bytes		- index buffer
+//
+// All integer fields of v1 have size of size_t, so 64-bit builds wrote 8 bytes instead of 4.
+
+const unsigned int MAGIC_GEOM_V1 = 0x12345002;
+
+// Format v2 description (all fields are little-endian):
+//
+// header:
+//		4 bytes	- magic number
+//		4 bytes	- format version
+//		4 bytes	- number of sections
+//		4 bytes	- reserved
+// for each section:
+//		4 bytes	- type of a section
+//		4 bytes	- flags of a section
+//		8 bytes	- offset of a section from the beginning of the file (in bytes)
+//		8 bytes	- size of a section (in bytes)
+//		8 bytes	- reserved
+// sections data, each section starts at the offset aligned to GEOM_SECTION_ALIGNMENT
+//
+// Sections:
+// GEOM_SECTION_VERTEX_DECLARATION
+//		4 bytes	- components count in vertex declaration
+//		4 bytes	- number of additional UVs
+//		4 bytes	- size of vertex (in bytes)
+//		4 bytes	- number of vertices
+//		for each vertex component (see Data::VertexDeclaration):
+//			4 bytes	- size of a vertex component (in bytes)
+//			4 bytes	- offset of a vertex component (in bytes)
+//		4 bytes	- vertex format (see Data::VertexFormat)
+//		4 bytes	- mask of vertex components (see Data::VertexComponentsMask), optional,
+//				  vertices have all components if it's absent
+// GEOM_SECTION_VERTICES
+//		X bytes	- vertex buffer
+// GEOM_SECTION_INDICES
+//		Y bytes	- index buffer (32-bit indices)
+// GEOM_SECTION_MESHES
+//		4 bytes	- number of meshes
+//		for each mesh:
+//			4 bytes	- offset of a mesh in index buffer (in indices)
+//			4 bytes	- number of indices in a mesh
+// GEOM_SECTION_MATERIALS (optional, materials are read from .material file if absent)
+//		4 bytes	- number of meshes
+//		for each mesh:
+//			3 x 4 bytes	- offsets of diffuse, normal and specular map names in the string table
+//		4 bytes	- size of the string table (in bytes)
+//		X bytes	- string table, null-terminated strings, the empty string is at offset 0
+// GEOM_SECTION_BOUNDS
+//		3 x 4 bytes	- bounding box min (x, y, z)
+//		3 x 4 bytes	- bounding box max (x, y, z)
+// GEOM_SECTION_EXTRAS
+//		reserved for application specific data
+// GEOM_SECTION_LODS (optional)
+//		4 bytes	- number of meshes
+//		for each mesh:
+//			4 bytes	- number of LODs (excepting the mesh itself)
+//			for each LOD:
+//				4 bytes	- offset of a LOD in index buffer (in indices)
+//				4 bytes	- number of indices in a LOD
+//				4 bytes	- geometric error of a LOD (float)
+// GEOM_SECTION_CLUSTERS (optional)
+//		4 bytes	- number of meshes
+//		for each mesh:
+//			4 bytes	- number of clusters
+//			for each cluster:
+//				4 bytes		- offset of a cluster in index buffer (in indices)
+//				4 bytes		- number of indices in a cluster
+//				4 x 4 bytes	- bounding sphere (center x, y, z, radius)
+//				4 x 4 bytes	- normal cone (axis x, y, z, cutoff)
+// GEOM_SECTION_MESH_BOUNDS (optional, calculated on loading if absent)
+//		4 bytes	- number of meshes
+//		for each mesh:
+//			3 x 4 bytes	- bounding box min (x, y, z)
+//			3 x 4 bytes	- bounding box max (x, y, z)
+//			4 x 4 bytes	- bounding sphere (center x, y, z, radius)
+//
+// Sections of unknown types are skipped by the loader.
+//
+// Compressed sections (GEOM_SECTION_FLAG_COMPRESSED is set in flags of a section):
+//		8 bytes	- size of the uncompressed section (in bytes)
+//		4 bytes	- size of a block before compression (in bytes), the last block can be smaller
+//		4 bytes	- number of blocks
+//		for each block:
+//			4 bytes	- size of a compressed block (in bytes), blocks of the uncompressed size are stored as is
+//		blocks data (see BlockCompressor)
+// Blocks are independent, so they are compressed and decompressed in parallel.
+
+const unsigned int MAGIC_GEOM_V2 = 0x12345003;
+const unsigned int GEOM_FORMAT_VERSION = 2;
+const unsigned int GEOM_HEADER_SIZE = 16;
+const unsigned int GEOM_SECTION_ENTRY_SIZE = 32;
+const unsigned int GEOM_SECTION_ALIGNMENT = 16;
+
+enum GeomSectionType
+{
+	GEOM_SECTION_VERTEX_DECLARATION = 1,
+	GEOM_SECTION_VERTICES,
+	GEOM_SECTION_INDICES,
+	GEOM_SECTION_MESHES,
+	GEOM_SECTION_MATERIALS,
+	GEOM_SECTION_BOUNDS,
+	GEOM_SECTION_EXTRAS,
+	GEOM_SECTION_LODS,
+	GEOM_SECTION_CLUSTERS,
+	GEOM_SECTION_MESH_BOUNDS
+};
+
+enum GeomSectionFlags
+{
+	GEOM_SECTION_FLAG_COMPRESSED = 1 << 0
+};
+
+struct GeomSection
+{
+	unsigned int type;
+	unsigned int flags;
+	unsigned long long offset;
+	unsigned long long size;
+
+	GeomSection() : type(0), flags(0), offset(0), size(0) {}
+};
+
+inline size_t alignGeomSection(size_t offset)
+{
+	return (offset + GEOM_SECTION_ALIGNMENT - 1) & ~(size_t)(GEOM_SECTION_ALIGNMENT - 1);
+}
 
-const size_t MAGIC_GEOM = 0x12345002;
+inline void writeLittleEndian32(std::vector<unsigned char>& buffer, unsigned int value)
+{
+	for (int i = 0; i < 4; i++) buffer.push_back((unsigned char)((value >> (i * 8)) & 0xff));
+}
+
+inline void writeLittleEndian64(std::vector<unsigned char>& buffer, unsigned long long value)
+{
+	for (int i = 0; i < 8; i++) buffer.push_back((unsigned char)((value >> (i * 8)) & 0xff));
+}
+
+inline void writeLittleEndianFloat(std::vector<unsigned char>& buffer, float value)
+{
+	unsigned int v = 0;
+	memcpy(&v, &value, sizeof(v));
+	writeLittleEndian32(buffer, v);
+}
+
+inline unsigned int readLittleEndian32(const unsigned char* ptr)
+{
+	return (unsigned int)ptr[0] | ((unsigned int)ptr[1] << 8) | ((unsigned int)ptr[2] << 16) | ((unsigned int)ptr[3] << 24);
+}
+
+inline unsigned long long readLittleEndian64(const unsigned char* ptr)
+{
+	return (unsigned long long)readLittleEndian32(ptr) | ((unsigned long long)readLittleEndian32(ptr + 4) << 32);
+}
+
+inline float readLittleEndianFloat(const unsigned char* ptr)
+{
+	unsigned int v = readLittleEndian32(ptr);
+	float value = 0;
+	memcpy(&value, &v, sizeof(value));
+	return value;
+}
 
 }
 
@@ -29,122 +29,612 @@
 namespace geom
 {
 
+namespace
+{
+	// ranges are read from files, so their ends are not summed to avoid overflows
+	bool isRangeInside(size_t offset, size_t count, size_t totalCount)
+	{
+		return offset <= totalCount && count <= totalCount - offset;
+	}
+}
+
+class GeomReader
+{
+public:
+	GeomReader(const unsigned char* data, size_t size) : m_data(data), m_size(size), m_offset(0) {}
+
+	template<typename T> bool read(T& value)
+	{
+		if (sizeof(T) > m_size - m_offset) return false;
+		memcpy(&value, m_data + m_offset, sizeof(T));
+		m_offset += sizeof(T);
+		return true;
+	}
+
+	const unsigned char* skip(size_t size)
+	{
+		if (size > m_size - m_offset) return 0;
+		const unsigned char* ptr = m_data + m_offset;
+		m_offset += size;
+		return ptr;
+	}
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_offset;
+};
+
 Data GeomLoader::load(const std::string& filename)
+{
+	return loadFile(filename, false);
+}
+
+Data GeomLoader::loadMapped(const std::string& filename)
+{
+	return loadFile(filename, true);
+}
+
+Data GeomLoader::loadFile(const std::string& filename, bool keepMapping)
 {
 	Data data;
 	DataWriter writer(&data);
 
-	FILE* fp = 0;
-	size_t filesize = 0;
-	fp = fopen(filename.c_str(), "rb");
-	if (!fp)
+	// packed files are parsed in-place, the mapping of the archive is shared
+	std::shared_ptr<utils::MemoryMappedFile> file;
+	const unsigned char* fileData = 0;
+	size_t fileSize = 0;
+	if (utils::Archive::instance().find(filename, fileData, fileSize))
+	{
+		file = utils::Archive::instance().getMappedFile();
+	}
+	else
+	{
+		file.reset(new utils::MemoryMappedFile());
+		if (!file->open(filename))
+		{
+			writer.getLastErrorRef() = std::string("Could not open file '") + filename + "'";
+			return data;
+		}
+		fileData = file->getData();
+		fileSize = file->getSize();
+	}
+
+	Payload payload;
+	if (!parse(fileData, fileSize, writer, payload))
 	{
-		writer.getLastErrorRef() = std::string("Could not open file '") + filename + "'";
 		return data;
 	}
 
-	size_t magic = 0;
-	fread(&magic, sizeof(magic), 1, fp);
-	if (magic != MAGIC_GEOM)
+	// index data has to be aligned to be accessed in-place, decompressed data can't be mapped
+	bool isAligned = ((size_t)payload.indexData % sizeof(unsigned int)) == 0;
+	if (keepMapping && isAligned && payload.decompressedData.empty())
+	{
+		writer.setMapping(file, payload.vertexData, payload.vertexDataSize, payload.indexData, payload.indicesCount);
+	}
+	else
+	{
+		writer.getVertexBufferRef().assign(payload.vertexData, payload.vertexData + payload.vertexDataSize);
+		writer.getIndexBufferRef().resize(payload.indicesCount);
+		memcpy(writer.getIndexBufferRef().data(), payload.indexData, payload.indicesCount * sizeof(unsigned int));
+	}
+	file.reset();
+
+	// files written before bounds of meshes were introduced
+	if (!payload.hasMeshBounds)
+	{
+		BoundsCalculator::calculate(writer);
+	}
+
+	// files written before materials were embedded
+	if (!payload.hasMaterials)
+	{
+		loadMaterial(utils::Utils::trimExtention(filename) + ".material", writer);
+	}
+
+	return data;
+}
+
+bool GeomLoader::parse(const unsigned char* fileData, size_t fileSize, DataWriter& writer, Payload& payload)
+{
+	unsigned int magic = fileSize >= sizeof(magic) ? readLittleEndian32(fileData) : 0;
+	if (magic == MAGIC_GEOM_V2)
+	{
+		return parseV2(fileData, fileSize, writer, payload);
+	}
+	else if (magic == MAGIC_GEOM_V1)
+	{
+		// v1 files have platform-dependent fields, try 32-bit layout at first
+		if (parseV1<unsigned int>(fileData, fileSize, writer, payload)) return true;
+		std::string error = writer.getLastErrorRef();
+		writer.getLastErrorRef().clear();
+		writer.getMeshesRef().clear();
+
+		if (parseV1<unsigned long long>(fileData, fileSize, writer, payload)) return true;
+		if (sizeof(size_t) == sizeof(unsigned int)) writer.getLastErrorRef() = error;
+		return false;
+	}
+
+	writer.getLastErrorRef() = "Unrecognized (or obsolete) format of geom-file";
+	return false;
+}
+
+bool GeomLoader::checkVertexDeclaration(size_t componentsCount, size_t vertexSize, DataWriter& writer)
+{
+	const Data& data = writer.getData();
+	if (componentsCount != data.getVertexComponentsCount())
+	{
+		writer.getLastErrorRef() = "Incorrect format of geom-file (componentsCount)";
+		return false;
+	}
+	if (vertexSize != data.getVertexSize())
+	{
+		writer.getLastErrorRef() = "Geom importer error: Incorrect format of geom-file (vertexSize)";
+		return false;
+	}
+	return true;
+}
+
+bool GeomLoader::checkMeshes(size_t indicesCount, DataWriter& writer)
+{
+	const Data::Meshes& meshes = writer.getMeshesRef();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		if (!isRangeInside(meshes[m].offsetInIB, meshes[m].indicesCount, indicesCount))
+		{
+			writer.getLastErrorRef() = "Incorrect format of geom-file (meshes)";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool GeomLoader::parseV2(const unsigned char* fileData, size_t fileSize, DataWriter& writer, Payload& payload)
+{
+	const std::string eofError = "Incorrect format of geom-file (unexpected end of file)";
+	if (fileSize < GEOM_HEADER_SIZE)
+	{
+		writer.getLastErrorRef() = eofError;
+		return false;
+	}
+
+	unsigned int version = readLittleEndian32(fileData + 4);
+	if (version != GEOM_FORMAT_VERSION)
+	{
+		writer.getLastErrorRef() = "Unsupported version of geom-file";
+		return false;
+	}
+
+	size_t sectionsCount = readLittleEndian32(fileData + 8);
+	if (sectionsCount > (fileSize - GEOM_HEADER_SIZE) / GEOM_SECTION_ENTRY_SIZE)
+	{
+		writer.getLastErrorRef() = eofError;
+		return false;
+	}
+
+	std::vector<GeomSection> sections(sectionsCount);
+	for (size_t i = 0; i < sectionsCount; i++)
+	{
+		const unsigned char* entry = fileData + GEOM_HEADER_SIZE + i * GEOM_SECTION_ENTRY_SIZE;
+		sections[i].type = readLittleEndian32(entry);
+		sections[i].flags = readLittleEndian32(entry + 4);
+		sections[i].offset = readLittleEndian64(entry + 8);
+		sections[i].size = readLittleEndian64(entry + 16);
+		if (sections[i].offset > fileSize || sections[i].size > fileSize - sections[i].offset)
+		{
+			writer.getLastErrorRef() = eofError;
+			return false;
+		}
+	}
+
+	// compressed sections are decompressed into the payload, the others are accessed in-place
+	std::vector<const unsigned char*> sectionsData(sectionsCount);
+	if (!decompressSections(fileData, sections, sectionsData, writer, payload)) return false;
+
+	auto findSection = [&](unsigned int type) -> const GeomSection*
+	{
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			if (sections[i].type == type) return &sections[i];
+		}
+		return 0;
+	};
+	auto getSectionData = [&](const GeomSection* section) -> const unsigned char*
+	{
+		return sectionsData[section - sections.data()];
+	};
+
+	// vertex declaration
+	const GeomSection* declaration = findSection(GEOM_SECTION_VERTEX_DECLARATION);
+	if (declaration == 0 || declaration->size < 16)
+	{
+		writer.getLastErrorRef() = "Incorrect format of geom-file (vertex declaration)";
+		return false;
+	}
+	const unsigned char* ptr = getSectionData(declaration);
+	size_t componentsCount = readLittleEndian32(ptr);
+	size_t additionalUVsCount = readLittleEndian32(ptr + 4);
+	size_t vertexSize = readLittleEndian32(ptr + 8);
+	writer.getVerticesCountRef() = readLittleEndian32(ptr + 12);
+	if (componentsCount > declaration->size / 8 || declaration->size < 16 + componentsCount * 8 + 4 || additionalUVsCount > componentsCount)
+	{
+		writer.getLastErrorRef() = eofError;
+		return false;
+	}
+	unsigned int vertexFormat = readLittleEndian32(ptr + 16 + componentsCount * 8);
+	// the mask of components follows the vertex format, files without it have all components
+	unsigned int componentsMask = Data::COMPONENTS_ALL;
+	if (declaration->size >= 16 + componentsCount * 8 + 8) componentsMask = readLittleEndian32(ptr + 20 + componentsCount * 8);
+	if (vertexFormat > Data::VERTEX_FORMAT_COMPACT_QUANTIZED || (componentsMask & ~Data::COMPONENTS_ALL) != 0)
+	{
+		writer.getLastErrorRef() = "Incorrect format of geom-file (vertex format)";
+		return false;
+	}
+	writer.setVertexDeclaration((Data::VertexFormat)vertexFormat, additionalUVsCount, componentsMask);
+
+	// older files of compact formats declare binormals of zero size, they are skipped
+	size_t storedComponentsCount = 0;
+	for (size_t c = 0; c < componentsCount; c++)
+	{
+		if (readLittleEndian32(ptr + 16 + c * 8) != 0) storedComponentsCount++;
+	}
+	if (!checkVertexDeclaration(storedComponentsCount, vertexSize, writer)) return false;
+	for (size_t c = 0, index = 0; c < componentsCount; c++)
+	{
+		size_t vcs = readLittleEndian32(ptr + 16 + c * 8);
+		size_t vco = readLittleEndian32(ptr + 16 + c * 8 + 4);
+		if (vcs == 0) continue;
+		if (vcs != writer.getData().getVertexComponentSize(index))
+		{
+			writer.getLastErrorRef() = "Incorrect format of geom-file (size of component %d)";
+			return false;
+		}
+		if (vco != writer.getData().getVertexComponentOffset(index))
+		{
+			writer.getLastErrorRef() = "Incorrect format of geom-file (offset of component %d)";
+			return false;
+		}
+		index++;
+	}
+
+	// meshes
+	const GeomSection* meshes = findSection(GEOM_SECTION_MESHES);
+	size_t meshesCount = (meshes != 0 && meshes->size >= 4) ? readLittleEndian32(getSectionData(meshes)) : 0;
+	if (meshesCount == 0 || meshes->size < 4 + meshesCount * 8)
+	{
+		writer.getLastErrorRef() = "Incorrect number of meshes";
+		return false;
+	}
+	writer.getMeshesRef().resize(meshesCount);
+	ptr = getSectionData(meshes) + 4;
+	for (size_t m = 0; m < meshesCount; m++, ptr += 8)
+	{
+		writer.getMeshesRef()[m].offsetInIB = readLittleEndian32(ptr);
+		writer.getMeshesRef()[m].indicesCount = readLittleEndian32(ptr + 4);
+	}
+
+	// bounds
+	const GeomSection* bounds = findSection(GEOM_SECTION_BOUNDS);
+	if (bounds != 0 && bounds->size >= 24)
+	{
+		ptr = getSectionData(bounds);
+		writer.getBoundingBoxRef().vmin = vector3(readLittleEndianFloat(ptr), readLittleEndianFloat(ptr + 4), readLittleEndianFloat(ptr + 8));
+		writer.getBoundingBoxRef().vmax = vector3(readLittleEndianFloat(ptr + 12), readLittleEndianFloat(ptr + 16), readLittleEndianFloat(ptr + 20));
+	}
+
+	// vertex and index buffers
+	const GeomSection* vertices = findSection(GEOM_SECTION_VERTICES);
+	const GeomSection* indices = findSection(GEOM_SECTION_INDICES);
+	if (vertices == 0 || indices == 0 || vertices->size != (unsigned long long)writer.getVerticesCountRef() * vertexSize)
+	{
+		writer.getLastErrorRef() = "Incorrect format of geom-file (vertex or index buffer)";
+		return false;
+	}
+	payload.vertexData = getSectionData(vertices);
+	payload.vertexDataSize = (size_t)vertices->size;
+	payload.indexData = reinterpret_cast<const unsigned int*>(getSectionData(indices));
+	payload.indicesCount = (size_t)indices->size / sizeof(unsigned int);
+	if (!checkMeshes(payload.indicesCount, writer)) return false;
+
+	// LODs
+	const GeomSection* lods = findSection(GEOM_SECTION_LODS);
+	if (lods != 0)
+	{
+		const std::string lodsError = "Incorrect format of geom-file (LODs)";
+		const unsigned char* end = getSectionData(lods) + lods->size;
+		ptr = getSectionData(lods);
+		if (lods->size < 4 || readLittleEndian32(ptr) != meshesCount)
+		{
+			writer.getLastErrorRef() = lodsError;
+			return false;
+		}
+		ptr += 4;
+		for (size_t m = 0; m < meshesCount; m++)
+		{
+			if (end - ptr < 4 || readLittleEndian32(ptr) > (size_t)(end - ptr - 4) / 12)
+			{
+				writer.getLastErrorRef() = lodsError;
+				return false;
+			}
+			size_t lodsCount = readLittleEndian32(ptr);
+			ptr += 4;
+
+			Data::Lods& meshLods = writer.getMeshesRef()[m].lods;
+			meshLods.resize(lodsCount);
+			for (size_t i = 0; i < lodsCount; i++, ptr += 12)
+			{
+				meshLods[i].offsetInIB = readLittleEndian32(ptr);
+				meshLods[i].indicesCount = readLittleEndian32(ptr + 4);
+				meshLods[i].error = readLittleEndianFloat(ptr + 8);
+				if (!isRangeInside(meshLods[i].offsetInIB, meshLods[i].indicesCount, payload.indicesCount))
+				{
+					writer.getLastErrorRef() = lodsError;
+					return false;
+				}
+			}
+		}
+	}
+
+	// clusters
+	const GeomSection* clusters = findSection(GEOM_SECTION_CLUSTERS);
+	if (clusters != 0)
+	{
+		const std::string clustersError = "Incorrect format of geom-file (clusters)";
+		const unsigned char* end = getSectionData(clusters) + clusters->size;
+		ptr = getSectionData(clusters);
+		if (clusters->size < 4 || readLittleEndian32(ptr) != meshesCount)
+		{
+			writer.getLastErrorRef() = clustersError;
+			return false;
+		}
+		ptr += 4;
+		for (size_t m = 0; m < meshesCount; m++)
+		{
+			if (end - ptr < 4 || readLittleEndian32(ptr) > (size_t)(end - ptr - 4) / 40)
+			{
+				writer.getLastErrorRef() = clustersError;
+				return false;
+			}
+			size_t clustersCount = readLittleEndian32(ptr);
+			ptr += 4;
+
+			Data::Clusters& meshClusters = writer.getMeshesRef()[m].clusters;
+			meshClusters.resize(clustersCount);
+			for (size_t i = 0; i < clustersCount; i++, ptr += 40)
+			{
+				Data::Cluster& cluster = meshClusters[i];
+				cluster.offsetInIB = readLittleEndian32(ptr);
+				cluster.indicesCount = readLittleEndian32(ptr + 4);
+				cluster.center = vector3(readLittleEndianFloat(ptr + 8), readLittleEndianFloat(ptr + 12), readLittleEndianFloat(ptr + 16));
+				cluster.radius = readLittleEndianFloat(ptr + 20);
+				cluster.coneAxis = vector3(readLittleEndianFloat(ptr + 24), readLittleEndianFloat(ptr + 28), readLittleEndianFloat(ptr + 32));
+				cluster.coneCutoff = readLittleEndianFloat(ptr + 36);
+				if (!isRangeInside(cluster.offsetInIB, cluster.indicesCount, payload.indicesCount))
+				{
+					writer.getLastErrorRef() = clustersError;
+					return false;
+				}
+			}
+		}
+	}
+
+	// bounds of meshes
+	const GeomSection* meshBounds = findSection(GEOM_SECTION_MESH_BOUNDS);
+	if (meshBounds != 0)
+	{
+		ptr = getSectionData(meshBounds);
+		if (meshBounds->size < 4 + meshesCount * 40 || readLittleEndian32(ptr) != meshesCount)
+		{
+			writer.getLastErrorRef() = "Incorrect format of geom-file (bounds of meshes)";
+			return false;
+		}
+		ptr += 4;
+		for (size_t m = 0; m < meshesCount; m++, ptr += 40)
+		{
+			Data::Mesh& mesh = writer.getMeshesRef()[m];
+			mesh.boundingBox.vmin = vector3(readLittleEndianFloat(ptr), readLittleEndianFloat(ptr + 4), readLittleEndianFloat(ptr + 8));
+			mesh.boundingBox.vmax = vector3(readLittleEndianFloat(ptr + 12), readLittleEndianFloat(ptr + 16), readLittleEndianFloat(ptr + 20));
+			mesh.boundingSphereCenter = vector3(readLittleEndianFloat(ptr + 24), readLittleEndianFloat(ptr + 28), readLittleEndianFloat(ptr + 32));
+			mesh.boundingSphereRadius = readLittleEndianFloat(ptr + 36);
+		}
+		payload.hasMeshBounds = true;
+	}
+
+	// materials
+	const GeomSection* materials = findSection(GEOM_SECTION_MATERIALS);
+	if (materials != 0)
+	{
+		static const char* materialsError = "Incorrect format of geom-file (materials)";
+		ptr = getSectionData(materials);
+		size_t tableOffset = 4 + meshesCount * 12;
+		if (materials->size < tableOffset + 4 || readLittleEndian32(ptr) != meshesCount)
+		{
+			writer.getLastErrorRef() = materialsError;
+			return false;
+		}
+		size_t tableSize = readLittleEndian32(ptr + tableOffset);
+		const char* table = (const char*)(ptr + tableOffset + 4);
+		if (tableSize == 0 || materials->size < tableOffset + 4 + tableSize || table[tableSize - 1] != 0)
+		{
+			writer.getLastErrorRef() = materialsError;
+			return false;
+		}
+		ptr += 4;
+		for (size_t m = 0; m < meshesCount; m++, ptr += 12)
+		{
+			unsigned int offsets[3] = { readLittleEndian32(ptr), readLittleEndian32(ptr + 4), readLittleEndian32(ptr + 8) };
+			if (offsets[0] >= tableSize || offsets[1] >= tableSize || offsets[2] >= tableSize)
+			{
+				writer.getLastErrorRef() = materialsError;
+				return false;
+			}
+			Data::Material& material = writer.getMeshesRef()[m].material;
+			material.diffuseMapFilename = table + offsets[0];
+			material.normalMapFilename = table + offsets[1];
+			material.specularMapFilename = table + offsets[2];
+		}
+		payload.hasMaterials = true;
+	}
+
+	return true;
+}
+
+bool GeomLoader::decompressSections(const unsigned char* fileData, std::vector<GeomSection>& sections, 
+									std::vector<const unsigned char*>& sectionsData, DataWriter& writer, Payload& payload)
+{
+	// offsets of sections in the decompressed data keep the alignment of the file
+	std::vector<size_t> offsets(sections.size(), 0);
+	size_t decompressedSize = 0;
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		sectionsData[i] = fileData + sections[i].offset;
+		if ((sections[i].flags & GEOM_SECTION_FLAG_COMPRESSED) == 0) continue;
+
+		unsigned long long size = BlockCompressor::getDecompressedSize(sectionsData[i], (size_t)sections[i].size);
+		if (size == 0 || size > (unsigned long long)((size_t)-1 - decompressedSize - GEOM_SECTION_ALIGNMENT))
+		{
+			writer.getLastErrorRef() = "Incorrect format of geom-file (compressed section)";
+			return false;
+		}
+		offsets[i] = decompressedSize;
+		decompressedSize = alignGeomSection(decompressedSize + (size_t)size);
+	}
+	if (decompressedSize == 0) return true;
+
+	payload.decompressedData.resize(decompressedSize);
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		if ((sections[i].flags & GEOM_SECTION_FLAG_COMPRESSED) == 0) continue;
+
+		unsigned char* data = payload.decompressedData.data() + offsets[i];
+		size_t size = (size_t)BlockCompressor::getDecompressedSize(sectionsData[i], (size_t)sections[i].size);
+		if (!BlockCompressor::decompress(sectionsData[i], (size_t)sections[i].size, data, size))
+		{
+			writer.getLastErrorRef() = "Incorrect format of geom-file (compressed section)";
+			return false;
+		}
+		sectionsData[i] = data;
+		sections[i].size = size;
+	}
+	return true;
+}
+
+template<typename SizeType>
+bool GeomLoader::parseV1(const unsigned char* fileData, size_t fileSize, DataWriter& writer, Payload& payload)
+{
+	const std::string eofError = "Incorrect format of geom-file (unexpected end of file)";
+	GeomReader reader(fileData, fileSize);
+
+	SizeType magic = 0;
+	if (!reader.read(magic) || magic != MAGIC_GEOM_V1)
 	{
 		writer.getLastErrorRef() = "Unrecognized (or obsolete) format of geom-file";
-		fclose(fp);
-		return data;
+		return false;
 	}
 
 	float fbuf[3] = { 0, 0, 0 };
-	fread(&fbuf, sizeof(fbuf), 1, fp);
 	float fbuf2[3] = { 0, 0, 0 };
-	fread(&fbuf2, sizeof(fbuf2), 1, fp);
+	if (!reader.read(fbuf) || !reader.read(fbuf2))
+	{
+		writer.getLastErrorRef() = eofError;
+		return false;
+	}
 	writer.getBoundingBoxRef().vmin = vector3(fbuf[0], fbuf[1], fbuf[2]);
 	writer.getBoundingBoxRef().vmax = vector3(fbuf2[0], fbuf2[1], fbuf2[2]);
 
 	// vertex declaration
-	size_t componentsCount = 0;
-	fread(&componentsCount, sizeof(componentsCount), 1, fp);
-	fread(&writer.getAdditionalUVsCountRef(), sizeof(writer.getAdditionalUVsCountRef()), 1, fp);
-	size_t vertexSize = 0;
-	fread(&vertexSize, sizeof(vertexSize), 1, fp);
-	if (componentsCount != data.getVertexComponentsCount())
+	SizeType componentsCount = 0;
+	SizeType additionalUVsCount = 0;
+	SizeType vertexSize = 0;
+	if (!reader.read(componentsCount) || !reader.read(additionalUVsCount) || !reader.read(vertexSize))
 	{
-		writer.getLastErrorRef() = "Incorrect format of geom-file (componentsCount)";
-		fclose(fp);
-		return data;
+		writer.getLastErrorRef() = eofError;
+		return false;
 	}
-	if (vertexSize != data.getVertexSize())
+	if (additionalUVsCount > componentsCount)
 	{
-		writer.getLastErrorRef() = "Geom importer error: Incorrect format of geom-file (vertexSize)";
-		fclose(fp);
-		return data;
+		writer.getLastErrorRef() = "Incorrect format of geom-file (componentsCount)";
+		return false;
 	}
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, (size_t)additionalUVsCount);
+	if (!checkVertexDeclaration((size_t)componentsCount, (size_t)vertexSize, writer)) return false;
 	for (size_t c = 0; c < componentsCount; c++)
 	{
-		size_t vcs = 0;
-		fread(&vcs, sizeof(vcs), 1, fp);
-		size_t vco = 0;
-		fread(&vco, sizeof(vco), 1, fp);
-		if (vcs != data.getVertexComponentSize(c))
+		SizeType vcs = 0;
+		SizeType vco = 0;
+		if (!reader.read(vcs) || !reader.read(vco))
+		{
+			writer.getLastErrorRef() = eofError;
+			return false;
+		}
+		if (vcs != writer.getData().getVertexComponentSize(c))
 		{
 			writer.getLastErrorRef() = "Incorrect format of geom-file (size of component %d)";
-			fclose(fp);
-			return data;
+			return false;
 		}
-		if (vco != data.getVertexComponentOffset(c))
+		if (vco != writer.getData().getVertexComponentOffset(c))
 		{
 			writer.getLastErrorRef() = "Incorrect format of geom-file (offset of component %d)";
-			fclose(fp);
-			return data;
+			return false;
 		}
 	}
 
-	size_t meshesCount = 0;
-	fread(&meshesCount, sizeof(meshesCount), 1, fp);
-	if (meshesCount == 0)
+	SizeType meshesCount = 0;
+	reader.read(meshesCount);
+	if (meshesCount == 0 || meshesCount > fileSize)
 	{
 		writer.getLastErrorRef() = "Incorrect number of meshes";
-		fclose(fp);
-		return data;
+		return false;
 	}
 
 	// meshes
-	writer.getMeshesRef().resize(meshesCount);
+	writer.getMeshesRef().resize((size_t)meshesCount);
 	for (size_t m = 0; m < meshesCount; m++)
 	{
-		fread(&writer.getMeshesRef()[m].offsetInIB, sizeof(writer.getMeshesRef()[m].offsetInIB), 1, fp);
-		fread(&writer.getMeshesRef()[m].indicesCount, sizeof(writer.getMeshesRef()[m].indicesCount), 1, fp);
+		SizeType offsetInIB = 0;
+		SizeType indicesCount = 0;
+		if (!reader.read(offsetInIB) || !reader.read(indicesCount))
+		{
+			writer.getLastErrorRef() = eofError;
+			return false;
+		}
+		writer.getMeshesRef()[m].offsetInIB = (size_t)offsetInIB;
+		writer.getMeshesRef()[m].indicesCount = (size_t)indicesCount;
 	}
 
 	// vertex buffer
-	size_t vbsize = 0;
-	fread(&vbsize, sizeof(vbsize), 1, fp);
-	writer.getVertexBufferRef().resize(vbsize);
-	fread(writer.getVertexBufferRef().data(), sizeof(unsigned char), vbsize, fp);
-	writer.getVerticesCountRef() = vbsize / vertexSize;
+	SizeType vbsize = 0;
+	if (!reader.read(vbsize) || vbsize > fileSize || (payload.vertexData = reader.skip((size_t)vbsize)) == 0)
+	{
+		writer.getLastErrorRef() = eofError;
+		return false;
+	}
+	payload.vertexDataSize = (size_t)vbsize;
+	writer.getVerticesCountRef() = (size_t)(vbsize / vertexSize);
 
 	// index buffer
-	size_t ibsize = 0;
-	fread(&ibsize, sizeof(ibsize), 1, fp);
-	size_t indicesCount = ibsize / sizeof(unsigned int);
-	writer.getIndexBufferRef().resize(indicesCount);
-	fread(writer.getIndexBufferRef().data(), sizeof(unsigned int), indicesCount, fp);
-
-	fclose(fp);
+	SizeType ibsize = 0;
+	const unsigned char* ibdata = 0;
+	if (!reader.read(ibsize) || ibsize > fileSize || (ibdata = reader.skip((size_t)ibsize)) == 0)
+	{
+		writer.getLastErrorRef() = eofError;
+		return false;
+	}
+	payload.indexData = reinterpret_cast<const unsigned int*>(ibdata);
+	payload.indicesCount = (size_t)ibsize / sizeof(unsigned int);
 
-	loadMaterial(utils::Utils::trimExtention(filename) + ".material", writer);
-	
-	return data;
+	return checkMeshes(payload.indicesCount, writer);
 }
 
 void GeomLoader::loadMaterial(const std::string& filename, DataWriter& dataWriter)
 {
-	std::ifstream matFile(filename);
-	if (!matFile.is_open()) return;
+	std::string matFile;
+	if (!utils::Utils::readFileToString(filename, matFile)) return;
 
+	// the string is null-terminated by readFileToString
 	Json::Value root;
 	Json::Reader reader;
-	bool parsingSuccessful = reader.parse(matFile, root);
-	matFile.close();
-	if (!parsingSuccessful) return;
+	if (!reader.parse(matFile.c_str(), matFile.c_str() + matFile.size() - 1, root)) return;
 
 	for (size_t i = 0; i < root.size(); i++)
 	{
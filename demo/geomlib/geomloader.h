@@ -34,8 +34,30 @@ public:
 	virtual ~GeomLoader(){}
 	
 	virtual Data load(const std::string& filename);
+	virtual Data loadMapped(const std::string& filename);
 
 private:
+	struct Payload
+	{
+		const unsigned char* vertexData;
+		size_t vertexDataSize;
+		const unsigned int* indexData;
+		size_t indicesCount;
+		bool hasMeshBounds;
+		bool hasMaterials;
+		std::vector<unsigned char> decompressedData;
+		Payload() : vertexData(0), vertexDataSize(0), indexData(0), indicesCount(0), hasMeshBounds(false), hasMaterials(false) {}
+	};
+
+	Data loadFile(const std::string& filename, bool keepMapping);
+	bool parse(const unsigned char* fileData, size_t fileSize, DataWriter& dataWriter, Payload& payload);
+	bool parseV2(const unsigned char* fileData, size_t fileSize, DataWriter& dataWriter, Payload& payload);
+	bool decompressSections(const unsigned char* fileData, std::vector<GeomSection>& sections, 
+							std::vector<const unsigned char*>& sectionsData, DataWriter& dataWriter, Payload& payload);
+	template<typename SizeType> 
+	bool parseV1(const unsigned char* fileData, size_t fileSize, DataWriter& dataWriter, Payload& payload);
+	bool checkVertexDeclaration(size_t componentsCount, size_t vertexSize, DataWriter& dataWriter);
+	bool checkMeshes(size_t indicesCount, DataWriter& dataWriter);
 	void loadMaterial(const std::string& filename, DataWriter& dataWriter);
 };
 
@@ -23,99 +23,225 @@
 
 #include "stdafx.h"
 #include "geomsaver.h"
-#include "json/json.h"
 
 namespace geom
 {
 
 bool GeomSaver::save(const Data& data, const std::string& filename)
 {
-	FILE* fp = 0;
-	fp = fopen(filename.c_str(), "wb");
-	if (!fp)
+	// vertex declaration
+	std::vector<unsigned char> declaration;
+	size_t componentsCount = data.getVertexComponentsCount();
+	writeLittleEndian32(declaration, (unsigned int)componentsCount);
+	writeLittleEndian32(declaration, (unsigned int)data.getAdditionalUVsCount());
+	writeLittleEndian32(declaration, (unsigned int)data.getVertexSize());
+	writeLittleEndian32(declaration, (unsigned int)data.getVerticesCount());
+	for (size_t c = 0; c < componentsCount; c++)
 	{
-		return false;
+		writeLittleEndian32(declaration, (unsigned int)data.getVertexComponentSize(c));
+		writeLittleEndian32(declaration, (unsigned int)data.getVertexComponentOffset(c));
 	}
+	writeLittleEndian32(declaration, (unsigned int)data.getVertexFormat());
+	writeLittleEndian32(declaration, data.getVertexComponentsMask());
 
-	fwrite(&MAGIC_GEOM, sizeof(MAGIC_GEOM), 1, fp);
-
-	float fbuf[3] = { data.getBoundingBox().vmin.x, data.getBoundingBox().vmin.y, data.getBoundingBox().vmin.z };
-	fwrite(&fbuf, sizeof(fbuf), 1, fp);
-	float fbuf2[3] = { data.getBoundingBox().vmax.x, data.getBoundingBox().vmax.y, data.getBoundingBox().vmax.z };
-	fwrite(&fbuf2, sizeof(fbuf2), 1, fp);
-
-	size_t componentsCount = data.getVertexComponentsCount();
-	fwrite(&componentsCount, sizeof(componentsCount), 1, fp);
-
-	size_t uvs = data.getAdditionalUVsCount();
-	fwrite(&uvs, sizeof(uvs), 1, fp);
+	// meshes
+	std::vector<unsigned char> meshes;
+	size_t meshesCount = data.getMeshes().size();
+	writeLittleEndian32(meshes, (unsigned int)meshesCount);
+	for (size_t m = 0; m < meshesCount; m++)
+	{
+		writeLittleEndian32(meshes, (unsigned int)data.getMeshes()[m].offsetInIB);
+		writeLittleEndian32(meshes, (unsigned int)data.getMeshes()[m].indicesCount);
+	}
 
-	size_t vertexSize = data.getVertexSize();
-	fwrite(&vertexSize, sizeof(vertexSize), 1, fp);
+	// LODs
+	std::vector<unsigned char> lods;
+	bool hasLods = false;
+	writeLittleEndian32(lods, (unsigned int)meshesCount);
+	for (size_t m = 0; m < meshesCount; m++)
+	{
+		const Data::Lods& meshLods = data.getMeshes()[m].lods;
+		writeLittleEndian32(lods, (unsigned int)meshLods.size());
+		for (size_t i = 0; i < meshLods.size(); i++)
+		{
+			writeLittleEndian32(lods, (unsigned int)meshLods[i].offsetInIB);
+			writeLittleEndian32(lods, (unsigned int)meshLods[i].indicesCount);
+			writeLittleEndianFloat(lods, meshLods[i].error);
+			hasLods = true;
+		}
+	}
 
-	for (size_t c = 0; c < componentsCount; c++)
+	// clusters
+	std::vector<unsigned char> clusters;
+	bool hasClusters = false;
+	writeLittleEndian32(clusters, (unsigned int)meshesCount);
+	for (size_t m = 0; m < meshesCount; m++)
 	{
-		size_t vcs = data.getVertexComponentSize(c);
-		fwrite(&vcs, sizeof(vcs), 1, fp);
-		size_t vco = data.getVertexComponentOffset(c);
-		fwrite(&vco, sizeof(vco), 1, fp);
+		const Data::Clusters& meshClusters = data.getMeshes()[m].clusters;
+		writeLittleEndian32(clusters, (unsigned int)meshClusters.size());
+		for (size_t i = 0; i < meshClusters.size(); i++)
+		{
+			const Data::Cluster& cluster = meshClusters[i];
+			writeLittleEndian32(clusters, (unsigned int)cluster.offsetInIB);
+			writeLittleEndian32(clusters, (unsigned int)cluster.indicesCount);
+			writeLittleEndianFloat(clusters, cluster.center.x);
+			writeLittleEndianFloat(clusters, cluster.center.y);
+			writeLittleEndianFloat(clusters, cluster.center.z);
+			writeLittleEndianFloat(clusters, cluster.radius);
+			writeLittleEndianFloat(clusters, cluster.coneAxis.x);
+			writeLittleEndianFloat(clusters, cluster.coneAxis.y);
+			writeLittleEndianFloat(clusters, cluster.coneAxis.z);
+			writeLittleEndianFloat(clusters, cluster.coneCutoff);
+			hasClusters = true;
+		}
 	}
 
-	size_t meshesCount = data.getMeshes().size();
-	fwrite(&meshesCount, sizeof(meshesCount), 1, fp);
+	// materials, equal names share an entry of the string table
+	std::vector<unsigned char> materials;
+	std::vector<unsigned char> stringTable(1, 0);
+	std::map<std::string, unsigned int> stringOffsets;
+	auto addString = [&](const std::string& str) -> unsigned int
+	{
+		if (str.empty()) return 0;
+		auto it = stringOffsets.find(str);
+		if (it != stringOffsets.end()) return it->second;
+		unsigned int offset = (unsigned int)stringTable.size();
+		stringTable.insert(stringTable.end(), str.begin(), str.end());
+		stringTable.push_back(0);
+		stringOffsets[str] = offset;
+		return offset;
+	};
+	writeLittleEndian32(materials, (unsigned int)meshesCount);
 	for (size_t m = 0; m < meshesCount; m++)
 	{
-		fwrite(&data.getMeshes()[m].offsetInIB, sizeof(data.getMeshes()[m].offsetInIB), 1, fp);
-		fwrite(&data.getMeshes()[m].indicesCount, sizeof(data.getMeshes()[m].indicesCount), 1, fp);
+		const Data::Material& material = data.getMeshes()[m].material;
+		writeLittleEndian32(materials, addString(material.diffuseMapFilename));
+		writeLittleEndian32(materials, addString(material.normalMapFilename));
+		writeLittleEndian32(materials, addString(material.specularMapFilename));
 	}
+	writeLittleEndian32(materials, (unsigned int)stringTable.size());
+	materials.insert(materials.end(), stringTable.begin(), stringTable.end());
 
-	size_t vbsize = data.getVertexBuffer().size();
-	fwrite(&vbsize, sizeof(vbsize), 1, fp);
-	fwrite(data.getVertexBuffer().data(), vbsize, 1, fp);
+	// bounds of meshes
+	std::vector<unsigned char> meshBounds;
+	bool hasMeshBounds = true;
+	writeLittleEndian32(meshBounds, (unsigned int)meshesCount);
+	for (size_t m = 0; m < meshesCount; m++)
+	{
+		const Data::Mesh& mesh = data.getMeshes()[m];
+		hasMeshBounds &= mesh.hasBounds();
+		writeLittleEndianFloat(meshBounds, mesh.boundingBox.vmin.x);
+		writeLittleEndianFloat(meshBounds, mesh.boundingBox.vmin.y);
+		writeLittleEndianFloat(meshBounds, mesh.boundingBox.vmin.z);
+		writeLittleEndianFloat(meshBounds, mesh.boundingBox.vmax.x);
+		writeLittleEndianFloat(meshBounds, mesh.boundingBox.vmax.y);
+		writeLittleEndianFloat(meshBounds, mesh.boundingBox.vmax.z);
+		writeLittleEndianFloat(meshBounds, mesh.boundingSphereCenter.x);
+		writeLittleEndianFloat(meshBounds, mesh.boundingSphereCenter.y);
+		writeLittleEndianFloat(meshBounds, mesh.boundingSphereCenter.z);
+		writeLittleEndianFloat(meshBounds, mesh.boundingSphereRadius);
+	}
 
-	size_t ibsize = data.getIndexBuffer().size() * sizeof(unsigned int);
-	fwrite(&ibsize, sizeof(ibsize), 1, fp);
-	fwrite(data.getIndexBuffer().data(), ibsize, 1, fp);
+	// bounds
+	std::vector<unsigned char> bounds;
+	const bbox3& bbox = data.getBoundingBox();
+	writeLittleEndianFloat(bounds, bbox.vmin.x);
+	writeLittleEndianFloat(bounds, bbox.vmin.y);
+	writeLittleEndianFloat(bounds, bbox.vmin.z);
+	writeLittleEndianFloat(bounds, bbox.vmax.x);
+	writeLittleEndianFloat(bounds, bbox.vmax.y);
+	writeLittleEndianFloat(bounds, bbox.vmax.z);
+
+	std::vector<SectionData> sections;
+	addSection(sections, GEOM_SECTION_VERTEX_DECLARATION, declaration.data(), declaration.size());
+	addSection(sections, GEOM_SECTION_VERTICES, data.getVertexData(), data.getVertexDataSize());
+	addSection(sections, GEOM_SECTION_INDICES, data.getIndexData(), data.getIndicesCount() * sizeof(unsigned int));
+	addSection(sections, GEOM_SECTION_MESHES, meshes.data(), meshes.size());
+	addSection(sections, GEOM_SECTION_BOUNDS, bounds.data(), bounds.size());
+	if (hasLods) addSection(sections, GEOM_SECTION_LODS, lods.data(), lods.size());
+	if (hasClusters) addSection(sections, GEOM_SECTION_CLUSTERS, clusters.data(), clusters.size());
+	if (hasMeshBounds) addSection(sections, GEOM_SECTION_MESH_BOUNDS, meshBounds.data(), meshBounds.size());
+	// materials are always written, even empty ones must not be replaced by a .material file on loading
+	addSection(sections, GEOM_SECTION_MATERIALS, materials.data(), materials.size());
+
+	std::vector<std::vector<unsigned char> > compressedData;
+	if (m_compressionEnabled) compressSections(sections, compressedData);
+	return writeSections(sections, filename);
+}
 
-	fclose(fp);
+void GeomSaver::addSection(std::vector<SectionData>& sections, unsigned int type, const void* data, size_t size)
+{
+	SectionData sectionData;
+	sectionData.section.type = type;
+	sectionData.section.size = size;
+	sectionData.data = reinterpret_cast<const unsigned char*>(data);
+	sections.push_back(sectionData);
+}
 
-	saveMaterial(data, utils::Utils::trimExtention(filename) + ".material");
+void GeomSaver::compressSections(std::vector<SectionData>& sections, std::vector<std::vector<unsigned char> >& compressedData)
+{
+	// small sections are not worth decompression on loading
+	const size_t MIN_COMPRESSED_SIZE = 4096;
+	compressedData.resize(sections.size());
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		size_t size = (size_t)sections[i].section.size;
+		if (size < MIN_COMPRESSED_SIZE || !BlockCompressor::compress(sections[i].data, size, compressedData[i])) continue;
 
-	return true;
+		sections[i].section.flags |= GEOM_SECTION_FLAG_COMPRESSED;
+		sections[i].section.size = compressedData[i].size();
+		sections[i].data = compressedData[i].data();
+	}
 }
 
-void GeomSaver::saveMaterial(const Data& data, const std::string& filename)
+bool GeomSaver::writeSections(std::vector<SectionData>& sections, const std::string& filename)
 {
-	bool hasMaterial = false;
-	auto meshes = data.getMeshes();
-	for (size_t i = 0; i < meshes.size(); i++)
+	// layout of sections
+	size_t offset = alignGeomSection(GEOM_HEADER_SIZE + sections.size() * GEOM_SECTION_ENTRY_SIZE);
+	for (size_t i = 0; i < sections.size(); i++)
 	{
-		if (!meshes[i].material.diffuseMapFilename.empty() ||
-			!meshes[i].material.normalMapFilename.empty() ||
-			!meshes[i].material.specularMapFilename.empty()) hasMaterial = true;
+		sections[i].section.offset = offset;
+		offset = alignGeomSection(offset + (size_t)sections[i].section.size);
 	}
 
-	if (hasMaterial)
+	std::vector<unsigned char> header;
+	writeLittleEndian32(header, MAGIC_GEOM_V2);
+	writeLittleEndian32(header, GEOM_FORMAT_VERSION);
+	writeLittleEndian32(header, (unsigned int)sections.size());
+	writeLittleEndian32(header, 0);
+	for (size_t i = 0; i < sections.size(); i++)
 	{
-		FILE* fp = 0;
-		fp = fopen(filename.c_str(), "w");
-		if (!fp) return;
+		writeLittleEndian32(header, sections[i].section.type);
+		writeLittleEndian32(header, sections[i].section.flags);
+		writeLittleEndian64(header, sections[i].section.offset);
+		writeLittleEndian64(header, sections[i].section.size);
+		writeLittleEndian64(header, 0);
+	}
+	header.resize(alignGeomSection(header.size()), 0);
 
-		Json::Value root;
-		for (size_t i = 0; i < meshes.size(); i++)
+	FILE* fp = 0;
+	fp = fopen(filename.c_str(), "wb");
+	if (!fp)
+	{
+		return false;
+	}
+
+	static const unsigned char padding[GEOM_SECTION_ALIGNMENT] = { 0 };
+	bool result = fwrite(header.data(), header.size(), 1, fp) == 1;
+	for (size_t i = 0; i < sections.size() && result; i++)
+	{
+		size_t size = (size_t)sections[i].section.size;
+		if (size == 0) continue;
+		result = fwrite(sections[i].data, size, 1, fp) == 1;
+		size_t paddingSize = alignGeomSection(size) - size;
+		if (result && paddingSize != 0 && i + 1 < sections.size())
 		{
-			Json::Value mat;
-			mat["diffuseMap"] = meshes[i].material.diffuseMapFilename;
-			mat["normalMap"] = meshes[i].material.normalMapFilename;
-			mat["specularMap"] = meshes[i].material.specularMapFilename;
-			root.append(mat);
+			result = fwrite(padding, paddingSize, 1, fp) == 1;
 		}
-		Json::StyledWriter writer;
-		std::string data = writer.write(root);
-		fwrite(data.c_str(), data.length(), 1, fp);
-
-		fclose(fp);
 	}
+
+	fclose(fp);
+	return result;
 }
 
 }
\ No newline at end of file
@@ -30,13 +30,27 @@ namespace geom
 class GeomSaver : public GeometrySaver
 {
 public:
-	GeomSaver(){}
+	GeomSaver() : m_compressionEnabled(false){}
 	virtual ~GeomSaver(){}
 	
 	virtual bool save(const Data& data, const std::string& filename);
 
+	// large sections are compressed by BlockCompressor, it's disabled by default
+	void setCompressionEnabled(bool enabled) { m_compressionEnabled = enabled; }
+	bool isCompressionEnabled() const { return m_compressionEnabled; }
+
 private:
-	void saveMaterial(const Data& data, const std::string& filename);
+	struct SectionData
+	{
+		GeomSection section;
+		const unsigned char* data;
+	};
+
+	void addSection(std::vector<SectionData>& sections, unsigned int type, const void* data, size_t size);
+	void compressSections(std::vector<SectionData>& sections, std::vector<std::vector<unsigned char> >& compressedData);
+	bool writeSections(std::vector<SectionData>& sections, const std::string& filename);
+
+	bool m_compressionEnabled;
 };
 
 }
@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "heightfield.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define HEIGHTFIELD_USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace geom
+{
+
+const size_t HEIGHTFIELD_MAX_LEVELS = 40;
+const size_t MIN_ROWS_PER_THREAD = 64;
+// threads are created per call, so a range must outweigh the cost of starting a thread (tens of microseconds)
+const size_t MIN_POINTS_PER_THREAD = 65536;
+
+namespace
+{
+
+// returns the distance to the box along the line or a value greater than maxT if there is no intersection
+float intersectBox(const float* boxMin, const float* boxMax, const float* origin, const float* invDirection, float maxT)
+{
+	float tmin = 0.0f;
+	float tmax = maxT;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t1 = (boxMin[axis] - origin[axis]) * invDirection[axis];
+		float t2 = (boxMax[axis] - origin[axis]) * invDirection[axis];
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+	}
+	return tmin <= tmax ? tmin : std::numeric_limits<float>::max();
+}
+
+// Moller-Trumbore intersection, triangles are double-sided
+bool intersectTriangle(const line3& line, const vector3& v0, const vector3& v1, const vector3& v2, float maxT, float& t)
+{
+	vector3 edge1 = v1 - v0;
+	vector3 edge2 = v2 - v0;
+	vector3 p = line.m * edge2;
+	float det = edge1 % p;
+	if (det == 0.0f) return false;
+	float invDet = 1.0f / det;
+	vector3 s = line.b - v0;
+	float u = (s % p) * invDet;
+	if (u < 0.0f || u > 1.0f) return false;
+	vector3 q = s * edge1;
+	float v = (line.m % q) * invDet;
+	if (v < 0.0f || u + v > 1.0f) return false;
+	t = (edge2 % q) * invDet;
+	return t >= 0.0f && t <= maxT;
+}
+
+}
+
+bool Heightfield::init(const TerrainGenerationInfo& info)
+{
+	m_heights.clear();
+	m_levels.clear();
+
+	// the grid of TerrainGenerator
+	size_t width = 0, height = 0;
+	if (info.chunkSize != 0)
+	{
+		if ((info.chunkSize & (info.chunkSize - 1)) != 0 || info.heightmapWidth <= info.chunkSize || info.heightmapHeight <= info.chunkSize) return false;
+		width = (info.heightmapWidth - 1) / info.chunkSize * info.chunkSize + 1;
+		height = (info.heightmapHeight - 1) / info.chunkSize * info.chunkSize + 1;
+	}
+	else
+	{
+		width = (info.heightmapWidth % 2 == 0) ? info.heightmapWidth : info.heightmapWidth - 1;
+		height = (info.heightmapHeight % 2 == 0) ? info.heightmapHeight : info.heightmapHeight - 1;
+	}
+	if (width < 2 || height < 2 || info.heightmap.size() < info.heightmapWidth * info.heightmapHeight * getHeightmapSampleSize(info.heightmapFormat)) return false;
+
+	m_samplesCountX = width;
+	m_samplesCountY = height;
+	m_origin = vector2(-0.5f * info.size.x, -0.5f * info.size.y);
+	m_step = vector2(info.size.x / float(width - 1), info.size.y / float(height - 1));
+	m_invStep = vector2(1.0f / m_step.x, 1.0f / m_step.y);
+
+	m_heights.resize(width * height);
+	Level firstLevel;
+	firstLevel.width = width - 1;
+	firstLevel.height = height - 1;
+	firstLevel.ranges.resize(firstLevel.width * firstLevel.height);
+	m_levels.push_back(std::move(firstLevel));
+
+	// rows of heights must be ready for the row of cells above them, so rows of cells 
+	// are processed after all heights
+	utils::Parallel::forRange(height, [this, &info](size_t begin, size_t end, size_t)
+	{
+		for (size_t y = begin; y < end; y++)
+		{
+			for (size_t x = 0; x < m_samplesCountX; x++)
+			{
+				m_heights[y * m_samplesCountX + x] = info.size.z * (info.getSample(x, y) - 0.5f);
+			}
+		}
+	}, MIN_ROWS_PER_THREAD);
+
+	utils::Parallel::forRange(height - 1, [this](size_t begin, size_t end, size_t)
+	{
+		Level& level = m_levels[0];
+		for (size_t y = begin; y < end; y++)
+		{
+			const float* row = &m_heights[y * m_samplesCountX];
+			const float* nextRow = row + m_samplesCountX;
+			for (size_t x = 0; x < level.width; x++)
+			{
+				HeightRange& range = level.ranges[y * level.width + x];
+				range.minHeight = std::min(std::min(row[x], row[x + 1]), std::min(nextRow[x], nextRow[x + 1]));
+				range.maxHeight = std::max(std::max(row[x], row[x + 1]), std::max(nextRow[x], nextRow[x + 1]));
+			}
+		}
+	}, MIN_ROWS_PER_THREAD);
+
+	while (m_levels.back().width > 1 || m_levels.back().height > 1)
+	{
+		const Level& previous = m_levels.back();
+		Level level;
+		level.width = (previous.width + 1) / 2;
+		level.height = (previous.height + 1) / 2;
+		level.ranges.resize(level.width * level.height);
+		for (size_t y = 0; y < level.height; y++)
+		{
+			for (size_t x = 0; x < level.width; x++)
+			{
+				HeightRange range = previous.ranges[(2 * y) * previous.width + 2 * x];
+				for (size_t j = 2 * y; j < std::min(2 * y + 2, previous.height); j++)
+				{
+					for (size_t i = 2 * x; i < std::min(2 * x + 2, previous.width); i++)
+					{
+						range.minHeight = std::min(range.minHeight, previous.ranges[j * previous.width + i].minHeight);
+						range.maxHeight = std::max(range.maxHeight, previous.ranges[j * previous.width + i].maxHeight);
+					}
+				}
+				level.ranges[y * level.width + x] = range;
+			}
+		}
+		m_levels.push_back(std::move(level));
+	}
+	return true;
+}
+
+bbox3 Heightfield::getBoundingBox() const
+{
+	if (m_levels.empty()) return bbox3();
+
+	const HeightRange& range = m_levels.back().ranges[0];
+	bbox3 box;
+	box.vmin = vector3(m_origin.x, range.minHeight, m_origin.y);
+	box.vmax = vector3(m_origin.x + m_step.x * float(m_samplesCountX - 1), range.maxHeight, m_origin.y + m_step.y * float(m_samplesCountY - 1));
+	return box;
+}
+
+float Heightfield::getHeight(float x, float z) const
+{
+	if (m_heights.empty()) return 0.0f;
+
+	// NaN coordinates are clamped to 0 as well
+	const float maxX = float(m_samplesCountX - 1);
+	const float maxY = float(m_samplesCountY - 1);
+	float gx = (x - m_origin.x) * m_invStep.x;
+	float gy = (z - m_origin.y) * m_invStep.y;
+	gx = gx > 0.0f ? gx : 0.0f;
+	gy = gy > 0.0f ? gy : 0.0f;
+	gx = gx < maxX ? gx : maxX;
+	gy = gy < maxY ? gy : maxY;
+	size_t cx = (size_t)(gx < maxX - 1.0f ? gx : maxX - 1.0f);
+	size_t cy = (size_t)(gy < maxY - 1.0f ? gy : maxY - 1.0f);
+	float fx = gx - float(cx);
+	float fy = gy - float(cy);
+
+	const float* h = &m_heights[cy * m_samplesCountX + cx];
+	float h0 = h[0] + (h[1] - h[0]) * fx;
+	float h1 = h[m_samplesCountX] + (h[m_samplesCountX + 1] - h[m_samplesCountX]) * fx;
+	return h0 + (h1 - h0) * fy;
+}
+
+void Heightfield::getHeights(const vector2* points, size_t pointsCount, float* heights) const
+{
+	static_assert(sizeof(vector2) == 2 * sizeof(float), "Points must be tightly packed");
+	if (m_heights.empty())
+	{
+		std::fill(heights, heights + pointsCount, 0.0f);
+		return;
+	}
+
+	utils::Parallel::forRange(pointsCount, [this, points, heights](size_t begin, size_t end, size_t)
+	{
+		getHeightsRange(points, begin, end, heights);
+	}, MIN_POINTS_PER_THREAD);
+}
+
+void Heightfield::getHeightsRange(const vector2* points, size_t begin, size_t end, float* heights) const
+{
+	size_t i = begin;
+#ifdef HEIGHTFIELD_USE_SSE2
+	// 4 points at once, the same operations as in getHeight (there are no gathers in SSE2, so
+	// heights are fetched one by one)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 originX = _mm_set1_ps(m_origin.x);
+	const __m128 originY = _mm_set1_ps(m_origin.y);
+	const __m128 invStepX = _mm_set1_ps(m_invStep.x);
+	const __m128 invStepY = _mm_set1_ps(m_invStep.y);
+	const __m128 maxX = _mm_set1_ps(float(m_samplesCountX - 1));
+	const __m128 maxY = _mm_set1_ps(float(m_samplesCountY - 1));
+	const __m128 maxCellX = _mm_set1_ps(float(m_samplesCountX - 2));
+	const __m128 maxCellY = _mm_set1_ps(float(m_samplesCountY - 2));
+	const size_t rowSize = m_samplesCountX;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 p01 = _mm_loadu_ps(&points[i].x);
+		__m128 p23 = _mm_loadu_ps(&points[i + 2].x);
+		__m128 gx = _mm_mul_ps(_mm_sub_ps(_mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0)), originX), invStepX);
+		__m128 gy = _mm_mul_ps(_mm_sub_ps(_mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1)), originY), invStepY);
+		gx = _mm_min_ps(_mm_max_ps(gx, zero), maxX);
+		gy = _mm_min_ps(_mm_max_ps(gy, zero), maxY);
+		__m128i cx = _mm_cvttps_epi32(_mm_min_ps(gx, maxCellX));
+		__m128i cy = _mm_cvttps_epi32(_mm_min_ps(gy, maxCellY));
+		__m128 fx = _mm_sub_ps(gx, _mm_cvtepi32_ps(cx));
+		__m128 fy = _mm_sub_ps(gy, _mm_cvtepi32_ps(cy));
+
+		int cellsX[4], cellsY[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(cellsX), cx);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(cellsY), cy);
+		const float* h[4];
+		for (int k = 0; k < 4; k++) h[k] = &m_heights[(size_t)cellsY[k] * rowSize + (size_t)cellsX[k]];
+		__m128 h00 = _mm_setr_ps(h[0][0], h[1][0], h[2][0], h[3][0]);
+		__m128 h10 = _mm_setr_ps(h[0][1], h[1][1], h[2][1], h[3][1]);
+		__m128 h01 = _mm_setr_ps(h[0][rowSize], h[1][rowSize], h[2][rowSize], h[3][rowSize]);
+		__m128 h11 = _mm_setr_ps(h[0][rowSize + 1], h[1][rowSize + 1], h[2][rowSize + 1], h[3][rowSize + 1]);
+
+		__m128 h0 = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h10, h00), fx));
+		__m128 h1 = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(h11, h01), fx));
+		_mm_storeu_ps(heights + i, _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fy)));
+	}
+#endif
+	for (; i < end; i++)
+	{
+		heights[i] = getHeight(points[i].x, points[i].y);
+	}
+}
+
+bool Heightfield::findClosestHit(const line3& line, HeightfieldHit& hit) const
+{
+	return traverse<false>(line, hit);
+}
+
+bool Heightfield::findAnyHit(const line3& line) const
+{
+	HeightfieldHit hit;
+	return traverse<true>(line, hit);
+}
+
+template<bool AnyHit> bool Heightfield::traverse(const line3& line, HeightfieldHit& hit) const
+{
+	if (m_levels.empty()) return false;
+
+	const float origin[3] = { line.b.x, line.b.y, line.b.z };
+	const float invDirection[3] = { 1.0f / line.m.x, 1.0f / line.m.y, 1.0f / line.m.z };
+	float maxT = 1.0f;
+	bool found = false;
+
+	// a texel (x, y) of a level covers cells [x << level, (x + 1) << level) along every axis
+	struct StackEntry
+	{
+		unsigned int level;
+		unsigned int x;
+		unsigned int y;
+		float t;
+	};
+	auto intersectTexel = [&](unsigned int level, unsigned int x, unsigned int y) -> float
+	{
+		const Level& l = m_levels[level];
+		const HeightRange& range = l.ranges[y * l.width + x];
+		size_t cellsX = m_levels[0].width;
+		size_t cellsY = m_levels[0].height;
+		float boxMin[3] = { m_origin.x + m_step.x * float(size_t(x) << level), range.minHeight, m_origin.y + m_step.y * float(size_t(y) << level) };
+		float boxMax[3] = { m_origin.x + m_step.x * float(std::min(size_t(x + 1) << level, cellsX)), range.maxHeight, 
+							m_origin.y + m_step.y * float(std::min(size_t(y + 1) << level, cellsY)) };
+		return intersectBox(boxMin, boxMax, origin, invDirection, maxT);
+	};
+
+	// every visited texel adds 4 children at most
+	StackEntry stack[HEIGHTFIELD_MAX_LEVELS * 3 + 1];
+	size_t stackSize = 0;
+	unsigned int topLevel = (unsigned int)(m_levels.size() - 1);
+	float topT = intersectTexel(topLevel, 0, 0);
+	if (topT > maxT) return false;
+	stack[stackSize++] = { topLevel, 0, 0, topT };
+
+	while (stackSize != 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		if (entry.t > maxT) continue;
+
+		if (entry.level == 0)
+		{
+			// triangles of a cell as in the mesh of TerrainGenerator
+			size_t x = entry.x;
+			size_t y = entry.y;
+			auto getPoint = [this](size_t px, size_t py)
+			{
+				return vector3(m_origin.x + m_step.x * float(px), m_heights[py * m_samplesCountX + px], m_origin.y + m_step.y * float(py));
+			};
+			vector3 v00 = getPoint(x, y);
+			vector3 v10 = getPoint(x + 1, y);
+			vector3 v01 = getPoint(x, y + 1);
+			vector3 v11 = getPoint(x + 1, y + 1);
+			const vector3* triangles[2][3] = { { &v00, &v01, &v11 }, { &v11, &v10, &v00 } };
+			for (int i = 0; i < 2; i++)
+			{
+				float t = 0.0f;
+				const vector3& v0 = *triangles[i][0];
+				const vector3& v1 = *triangles[i][1];
+				const vector3& v2 = *triangles[i][2];
+				if (!intersectTriangle(line, v0, v1, v2, maxT, t)) continue;
+
+				found = true;
+				if (AnyHit) return true;
+				maxT = t;
+				hit.t = t;
+				hit.normal = (v1 - v0) * (v2 - v0);
+				if (hit.normal.y < 0.0f) hit.normal = hit.normal * -1.0f;
+				hit.normal.norm();
+			}
+			continue;
+		}
+
+		// children are pushed from the farthest to the closest one
+		const Level& childLevel = m_levels[entry.level - 1];
+		StackEntry children[4];
+		size_t childrenCount = 0;
+		for (unsigned int y = entry.y * 2; y < std::min(entry.y * 2 + 2, (unsigned int)childLevel.height); y++)
+		{
+			for (unsigned int x = entry.x * 2; x < std::min(entry.x * 2 + 2, (unsigned int)childLevel.width); x++)
+			{
+				float t = intersectTexel(entry.level - 1, x, y);
+				if (t > maxT) continue;
+				StackEntry child = { entry.level - 1, x, y, t };
+				size_t j = childrenCount++;
+				for (; j > 0 && children[j - 1].t < t; j--) children[j] = children[j - 1];
+				children[j] = child;
+			}
+		}
+		for (size_t i = 0; i < childrenCount; i++) stack[stackSize++] = children[i];
+	}
+	return found;
+}
+
+}
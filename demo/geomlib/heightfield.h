@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __HEIGHTFIELD_H__
+#define __HEIGHTFIELD_H__
+
+#include "terraingenerator.h"
+
+namespace geom
+{
+
+struct HeightfieldHit
+{
+	// parameter of the line, the hit point is line.ipol(t)
+	float t;
+	// normal of the hit triangle, it's directed upwards
+	vector3 normal;
+
+	HeightfieldHit() : t(0.0f){}
+};
+
+// Height queries over the grid of a terrain generated by TerrainGenerator with the same info,
+// coordinates are in the space of the terrain (x and z along the grid, y is the height).
+// Heights are sampled bilinearly, rays are tested against triangles of the terrain mesh.
+// Ray queries descend the min-max pyramid of heights (every level halves the resolution of 
+// the previous one, a texel stores the range of heights over its cells). Queries are thread-safe.
+class Heightfield
+{
+public:
+	Heightfield() : m_samplesCountX(0), m_samplesCountY(0){}
+
+	bool init(const TerrainGenerationInfo& info);
+	bool isEmpty() const { return m_heights.empty(); }
+	size_t getSamplesCountX() const { return m_samplesCountX; }
+	size_t getSamplesCountY() const { return m_samplesCountY; }
+	size_t getLevelsCount() const { return m_levels.size(); }
+	bbox3 getBoundingBox() const;
+
+	// points out of the terrain get heights of the nearest border
+	float getHeight(float x, float z) const;
+	// heights of points (x, z), large batches are processed on several threads with SSE2
+	void getHeights(const vector2* points, size_t pointsCount, float* heights) const;
+
+	// the closest intersection of the segment from line.b to line.b + line.m with the terrain
+	bool findClosestHit(const line3& line, HeightfieldHit& hit) const;
+	// any intersection of the segment, it's faster than the closest one (e.g. for visibility tests)
+	bool findAnyHit(const line3& line) const;
+
+private:
+	struct HeightRange
+	{
+		float minHeight;
+		float maxHeight;
+	};
+
+	struct Level
+	{
+		size_t width;
+		size_t height;
+		std::vector<HeightRange> ranges;
+	};
+
+	size_t m_samplesCountX;
+	size_t m_samplesCountY;
+	// position of the first sample, distances between samples and inverse ones
+	vector2 m_origin;
+	vector2 m_step;
+	vector2 m_invStep;
+	std::vector<float> m_heights;
+	// the first level contains ranges of cells, the last one is 1x1
+	std::vector<Level> m_levels;
+
+	void getHeightsRange(const vector2* points, size_t begin, size_t end, float* heights) const;
+	template<bool AnyHit> bool traverse(const line3& line, HeightfieldHit& hit) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "meshbuilder.h"
+
+namespace geom
+{
+
+void MeshBuilder::build(Input& input, DataWriter& writer)
+{
+	if (input.normals.empty()) calculateNormals(input, input.normals);
+	bool hasUVs = !input.uvs.empty();
+
+	size_t verticesCount = input.positions.size();
+	writer.getVerticesCountRef() = verticesCount;
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, 0, hasUVs ? Data::COMPONENTS_ALL : Data::COMPONENTS_NORMAL);
+	const Data& data = writer.getData();
+	size_t vertexSize = data.getVertexSize();
+
+	// sources of components, in the order of the vertex declaration
+	struct ComponentSource
+	{
+		size_t offset;
+		const float* data;
+		size_t floatsCount;
+	};
+	std::vector<ComponentSource> sources;
+	const Data::VertexDeclaration& declaration = data.getVertexDeclaration();
+	for (size_t c = 0; c < declaration.size(); c++)
+	{
+		ComponentSource source;
+		source.offset = declaration[c].offset;
+		source.floatsCount = declaration[c].size / sizeof(float);
+		switch (declaration[c].semantic)
+		{
+		case Data::SEMANTIC_POSITION: source.data = &input.positions[0].x; break;
+		case Data::SEMANTIC_NORMAL: source.data = &input.normals[0].x; break;
+		case Data::SEMANTIC_TEXCOORD: source.data = &input.uvs[0].x; break;
+		default: continue;
+		}
+		sources.push_back(source);
+	}
+
+	writer.getVertexBufferRef().resize(verticesCount * vertexSize);
+	std::vector<bbox3> boxes(utils::Parallel::getThreadsCount());
+	std::vector<char> hasBoxes(boxes.size(), 0);
+	utils::Parallel::forRange(verticesCount, [&](size_t begin, size_t end, size_t rangeIndex)
+	{
+		unsigned char* vertexBuffer = writer.getVertexBufferRef().data();
+		for (size_t v = begin; v < end; v++)
+		{
+			for (size_t c = 0; c < sources.size(); c++)
+			{
+				memcpy(vertexBuffer + v * vertexSize + sources[c].offset, sources[c].data + v * sources[c].floatsCount, sources[c].floatsCount * sizeof(float));
+			}
+		}
+
+		bbox3& box = boxes[rangeIndex];
+		box.begin_extend();
+		for (size_t v = begin; v < end; v++) box.extend(input.positions[v]);
+		box.end_extend();
+		hasBoxes[rangeIndex] = 1;
+	}, 1024);
+
+	writer.getBoundingBoxRef().begin_extend();
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		if (hasBoxes[i]) writer.getBoundingBoxRef().extend(boxes[i]);
+	}
+	writer.getBoundingBoxRef().end_extend();
+
+	writer.getIndexBufferRef().swap(input.indices);
+	writer.getMeshesRef().swap(input.meshes);
+	std::vector<vector3>().swap(input.positions);
+	std::vector<vector3>().swap(input.normals);
+	std::vector<vector2>().swap(input.uvs);
+
+	// tangent frames are calculated from the vertex buffer
+	if (hasUVs) TangentFrameCalculator::calculate(writer);
+	BoundsCalculator::calculate(writer);
+}
+
+void MeshBuilder::calculateNormals(const Input& input, std::vector<vector3>& normals)
+{
+	// cross products of edges are weighted by areas of triangles
+	normals.assign(input.positions.size(), vector3(0.0f, 0.0f, 0.0f));
+	const unsigned int* indices = input.indices.data();
+	for (size_t i = 0; i + 2 < input.indices.size(); i += 3)
+	{
+		const vector3& p0 = input.positions[indices[i]];
+		vector3 normal = (input.positions[indices[i + 1]] - p0) * (input.positions[indices[i + 2]] - p0);
+		normals[indices[i]] += normal;
+		normals[indices[i + 1]] += normal;
+		normals[indices[i + 2]] += normal;
+	}
+
+	utils::Parallel::forRange(normals.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			if (normals[v].lensquared() > 0.0f) normals[v].norm();
+			else normals[v] = vector3(0.0f, 1.0f, 0.0f);
+		}
+	}, 1024);
+}
+
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __MESH_BUILDER_H__
+#define __MESH_BUILDER_H__
+
+namespace geom
+{
+
+// Builds data of the full vertex format from separate vertex attributes of source 
+// formats (OBJ, PLY). Absent normals are calculated from triangles, tangent frames 
+// are calculated if texture coordinates are present, otherwise they are not stored.
+class MeshBuilder
+{
+public:
+	struct Input
+	{
+		std::vector<vector3> positions;
+		// optional, the same size as positions
+		std::vector<vector3> normals;
+		// optional, the same size as positions
+		std::vector<vector2> uvs;
+		// indices must be validated by loaders
+		std::vector<unsigned int> indices;
+		Data::Meshes meshes;
+	};
+
+	// buffers of the input are released while building
+	static void build(Input& input, DataWriter& writer);
+
+private:
+	static void calculateNormals(const Input& input, std::vector<vector3>& normals);
+};
+
+}
+
+#endif
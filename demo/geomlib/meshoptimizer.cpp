@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include "meshoptimizer.h"
+
+namespace geom
+{
+
+// parameters of vertex cache optimization (T. Forsyth, "Linear-Speed Vertex Cache Optimisation")
+const size_t VERTEX_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float getVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0) return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// vertices of the last triangle have fixed score to avoid using them in strips
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			const float scaler = 1.0f / (float)(VERTEX_CACHE_SIZE - 3);
+			score = powf(1.0f - (float)(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+
+	// vertices with a few remaining triangles are preferable
+	score += VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+Data MeshOptimizer::optimize(const Data& data, const MeshOptimizationInfo& info)
+{
+	if (!data.isCorrect()) return data;
+
+	Data result;
+	DataWriter writer(&result);
+	writer.getMeshesRef() = data.getMeshes();
+	writer.copyVertexDeclaration(data);
+	writer.getVerticesCountRef() = data.getVerticesCount();
+	writer.getBoundingBoxRef() = data.getBoundingBox();
+	writer.getVertexBufferRef().assign(data.getVertexData(), data.getVertexData() + data.getVertexDataSize());
+	writer.getIndexBufferRef().assign(data.getIndexData(), data.getIndexData() + data.getIndicesCount());
+
+	std::vector<unsigned int>& indices = writer.getIndexBufferRef();
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] >= data.getVerticesCount())
+		{
+			writer.getLastErrorRef() = "Mesh optimization error (index is out of range)";
+			return result;
+		}
+	}
+
+	// LODs are optimized as separate meshes, clusters are optimized independently
+	// to keep their ranges in the index buffer
+	std::vector<std::pair<size_t, size_t> > ranges;
+	const Data::Meshes& meshes = result.getMeshes();
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].clusters.empty())
+		{
+			ranges.push_back(std::make_pair(meshes[i].offsetInIB, meshes[i].indicesCount));
+		}
+		for (size_t c = 0; c < meshes[i].clusters.size(); c++)
+		{
+			ranges.push_back(std::make_pair(meshes[i].clusters[c].offsetInIB, meshes[i].clusters[c].indicesCount));
+		}
+		for (size_t lod = 0; lod < meshes[i].lods.size(); lod++)
+		{
+			ranges.push_back(std::make_pair(meshes[i].lods[lod].offsetInIB, meshes[i].lods[lod].indicesCount));
+		}
+	}
+
+	// every range is optimized in its own vertex index space, so per-vertex data of the optimizers
+	// has the size of the range (e.g. 64 vertices of a cluster) instead of the whole vertex buffer
+	const unsigned int UNUSED_VERTEX = std::numeric_limits<unsigned int>::max();
+	std::vector<unsigned int> localVertices(data.getVerticesCount(), UNUSED_VERTEX);
+	std::vector<unsigned int> rangeVertices;
+	std::vector<unsigned int> rangeIndices;
+	std::vector<unsigned int> sourceIndices;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (ranges[i].first + ranges[i].second > indices.size())
+		{
+			writer.getLastErrorRef() = "Mesh optimization error (mesh is out of index buffer)";
+			return result;
+		}
+
+		unsigned int* meshIndices = indices.data() + ranges[i].first;
+		size_t indicesCount = ranges[i].second;
+		rangeVertices.clear();
+		rangeIndices.resize(indicesCount);
+		for (size_t j = 0; j < indicesCount; j++)
+		{
+			unsigned int& localVertex = localVertices[meshIndices[j]];
+			if (localVertex == UNUSED_VERTEX)
+			{
+				localVertex = (unsigned int)rangeVertices.size();
+				rangeVertices.push_back(meshIndices[j]);
+			}
+			rangeIndices[j] = localVertex;
+		}
+
+		if (info.optimizeVertexCache)
+		{
+			// source order is kept if it is already better (e.g. for hand-made strips)
+			sourceIndices.assign(rangeIndices.begin(), rangeIndices.end());
+			optimizeVertexCache(rangeIndices.data(), indicesCount, rangeVertices.size());
+			if (calculateCacheMisses(rangeIndices.data(), indicesCount, rangeVertices.size(), STATISTICS_CACHE_SIZE) >
+				calculateCacheMisses(sourceIndices.data(), indicesCount, rangeVertices.size(), STATISTICS_CACHE_SIZE))
+			{
+				rangeIndices.swap(sourceIndices);
+			}
+		}
+		if (info.optimizeOverdraw)
+		{
+			optimizeOverdraw(data, rangeVertices.data(), rangeVertices.size(), rangeIndices.data(), indicesCount);
+		}
+
+		for (size_t j = 0; j < indicesCount; j++)
+		{
+			meshIndices[j] = rangeVertices[rangeIndices[j]];
+		}
+		for (size_t v = 0; v < rangeVertices.size(); v++)
+		{
+			localVertices[rangeVertices[v]] = UNUSED_VERTEX;
+		}
+	}
+
+	if (info.optimizeVertexFetch)
+	{
+		optimizeVertexFetch(writer, result.getVertexSize());
+	}
+
+	return result;
+}
+
+float MeshOptimizer::calculateACMR(const Data& data, size_t cacheSize)
+{
+	size_t trianglesCount = data.getIndicesCount() / 3;
+	if (trianglesCount == 0) return 0.0f;
+	return (float)calculateCacheMisses(data, cacheSize) / (float)trianglesCount;
+}
+
+float MeshOptimizer::calculateATVR(const Data& data, size_t cacheSize)
+{
+	if (data.getVerticesCount() == 0) return 0.0f;
+	return (float)calculateCacheMisses(data, cacheSize) / (float)data.getVerticesCount();
+}
+
+size_t MeshOptimizer::calculateCacheMisses(const Data& data, size_t cacheSize)
+{
+	if (!data.isCorrect()) return 0;
+
+	// every mesh is drawn separately, so the cache is invalidated between meshes
+	size_t misses = 0;
+	const Data::Meshes& meshes = data.getMeshes();
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].offsetInIB + meshes[i].indicesCount > data.getIndicesCount()) continue;
+		misses += calculateCacheMisses(data.getIndexData() + meshes[i].offsetInIB, meshes[i].indicesCount, 
+									   data.getVerticesCount(), cacheSize);
+	}
+	return misses;
+}
+
+size_t MeshOptimizer::calculateCacheMisses(const unsigned int* indices, size_t indicesCount, size_t verticesCount, size_t cacheSize)
+{
+	if (cacheSize == 0) return indicesCount;
+
+	// FIFO cache simulation, a vertex is in the cache if less than cacheSize
+	// vertices have been transformed after it
+	std::vector<size_t> timestamps(verticesCount, 0);
+	size_t timestamp = cacheSize + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < indicesCount; i++)
+	{
+		unsigned int index = indices[i];
+		if (index >= verticesCount) continue;
+		if (timestamp - timestamps[index] > cacheSize)
+		{
+			timestamps[index] = timestamp++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t indicesCount, size_t verticesCount)
+{
+	size_t trianglesCount = indicesCount / 3;
+	if (trianglesCount < 2) return;
+
+	// triangles of every vertex, the first remainingTriangles[v] of them are not emitted yet
+	std::vector<unsigned int> remainingTriangles(verticesCount, 0);
+	for (size_t i = 0; i < trianglesCount * 3; i++)
+	{
+		remainingTriangles[indices[i]]++;
+	}
+	std::vector<size_t> offsets(verticesCount, 0);
+	for (size_t v = 1; v < verticesCount; v++)
+	{
+		offsets[v] = offsets[v - 1] + remainingTriangles[v - 1];
+	}
+	std::vector<unsigned int> vertexTriangles(trianglesCount * 3);
+	std::vector<unsigned int> filled(verticesCount, 0);
+	for (size_t i = 0; i < trianglesCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		vertexTriangles[offsets[v] + filled[v]] = (unsigned int)(i / 3);
+		filled[v]++;
+	}
+
+	std::vector<int> cachePositions(verticesCount, -1);
+	std::vector<float> vertexScores(verticesCount);
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		vertexScores[v] = getVertexScore(-1, remainingTriangles[v]);
+	}
+
+	std::vector<float> triangleScores(trianglesCount);
+	int bestTriangle = -1;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < trianglesCount; t++)
+	{
+		const unsigned int* tri = indices + t * 3;
+		triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+		if (triangleScores[t] > bestScore)
+		{
+			bestScore = triangleScores[t];
+			bestTriangle = (int)t;
+		}
+	}
+
+	std::vector<unsigned int> output(trianglesCount * 3);
+	std::vector<char> emitted(trianglesCount, 0);
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	cache.reserve(VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(VERTEX_CACHE_SIZE + 3);
+	size_t emittedCount = 0;
+	size_t cursor = 0;
+	while (bestTriangle >= 0)
+	{
+		const unsigned int* tri = indices + bestTriangle * 3;
+		emitted[bestTriangle] = 1;
+		memcpy(output.data() + emittedCount * 3, tri, 3 * sizeof(unsigned int));
+		emittedCount++;
+
+		// remove the triangle from the lists of remaining triangles
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			unsigned int* vtris = vertexTriangles.data() + offsets[v];
+			unsigned int* vtrisEnd = vtris + remainingTriangles[v];
+			unsigned int* it = std::find(vtris, vtrisEnd, (unsigned int)bestTriangle);
+			if (it != vtrisEnd)
+			{
+				std::swap(*it, *(vtrisEnd - 1));
+				remainingTriangles[v]--;
+			}
+		}
+
+		// vertices of the triangle go to the top of the cache
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(newCache.begin(), newCache.end(), tri[k]) == newCache.end()) newCache.push_back(tri[k]);
+		}
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2]) newCache.push_back(cache[i]);
+		}
+
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			unsigned int v = newCache[i];
+			cachePositions[v] = (i < VERTEX_CACHE_SIZE) ? (int)i : -1;
+			vertexScores[v] = getVertexScore(cachePositions[v], remainingTriangles[v]);
+		}
+
+		// update scores of triangles which use vertices from the cache
+		bestTriangle = -1;
+		bestScore = -1.0f;
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			unsigned int v = newCache[i];
+			const unsigned int* vtris = vertexTriangles.data() + offsets[v];
+			for (size_t j = 0; j < remainingTriangles[v]; j++)
+			{
+				unsigned int t = vtris[j];
+				const unsigned int* vt = indices + t * 3;
+				triangleScores[t] = vertexScores[vt[0]] + vertexScores[vt[1]] + vertexScores[vt[2]];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = (int)t;
+				}
+			}
+		}
+
+		if (newCache.size() > VERTEX_CACHE_SIZE) newCache.resize(VERTEX_CACHE_SIZE);
+		cache.swap(newCache);
+
+		// dead end, continue from the first not emitted triangle
+		if (bestTriangle < 0)
+		{
+			while (cursor < trianglesCount && emitted[cursor] != 0) cursor++;
+			if (cursor < trianglesCount) bestTriangle = (int)cursor;
+		}
+	}
+
+	memcpy(indices, output.data(), trianglesCount * 3 * sizeof(unsigned int));
+}
+
+void MeshOptimizer::optimizeOverdraw(const Data& data, const unsigned int* vertices, size_t verticesCount, 
+									 unsigned int* indices, size_t indicesCount)
+{
+	// Triangles are split into clusters at hard boundaries of the vertex cache (all vertices
+	// of a triangle miss the cache), so reordering of clusters keeps ACMR almost the same.
+	// Clusters which face outwards from the center of the mesh are drawn first, they likely 
+	// occlude the others (P. Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+	size_t trianglesCount = indicesCount / 3;
+	if (trianglesCount < 2) return;
+
+	std::vector<size_t> clusters;
+	std::vector<size_t> timestamps(verticesCount, 0);
+	size_t timestamp = STATISTICS_CACHE_SIZE + 1;
+	for (size_t t = 0; t < trianglesCount; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (timestamp - timestamps[v] > STATISTICS_CACHE_SIZE)
+			{
+				timestamps[v] = timestamp++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3) clusters.push_back(t);
+	}
+	if (clusters.size() < 2) return;
+
+	vector3 meshCenter(0, 0, 0);
+	float meshArea = 0.0f;
+	std::vector<vector3> centers(clusters.size());
+	std::vector<vector3> normals(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : trianglesCount;
+		vector3 center(0, 0, 0);
+		vector3 normal(0, 0, 0);
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < end; t++)
+		{
+			vector3 p0 = data.getPosition(vertices[indices[t * 3]]);
+			vector3 p1 = data.getPosition(vertices[indices[t * 3 + 1]]);
+			vector3 p2 = data.getPosition(vertices[indices[t * 3 + 2]]);
+			vector3 n = (p1 - p0) * (p2 - p0);
+			float a = n.len();
+			center += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		meshCenter += center;
+		meshArea += area;
+		centers[c] = (area > 0.0f) ? center * (1.0f / area) : data.getPosition(vertices[indices[clusters[c] * 3]]);
+		normals[c] = normal;
+		normals[c].norm();
+	}
+	if (meshArea > 0.0f) meshCenter *= (1.0f / meshArea);
+
+	std::vector<float> sortKeys(clusters.size());
+	std::vector<size_t> order(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		sortKeys[c] = (centers[c] - meshCenter) % normals[c];
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t c1, size_t c2)
+	{
+		return sortKeys[c1] > sortKeys[c2];
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(trianglesCount * 3);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		size_t c = order[i];
+		size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : trianglesCount;
+		output.insert(output.end(), indices + clusters[c] * 3, indices + end * 3);
+	}
+	memcpy(indices, output.data(), trianglesCount * 3 * sizeof(unsigned int));
+}
+
+void MeshOptimizer::optimizeVertexFetch(DataWriter& writer, size_t vertexSize)
+{
+	std::vector<unsigned int>& indices = writer.getIndexBufferRef();
+	size_t verticesCount = writer.getVerticesCountRef();
+
+	const unsigned int UNUSED_VERTEX = std::numeric_limits<unsigned int>::max();
+	std::vector<unsigned int> remap(verticesCount, UNUSED_VERTEX);
+	unsigned int nextVertex = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int& index = indices[i];
+		if (remap[index] == UNUSED_VERTEX) remap[index] = nextVertex++;
+		index = remap[index];
+	}
+
+	// unused vertices are kept at the end
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		if (remap[v] == UNUSED_VERTEX) remap[v] = nextVertex++;
+	}
+
+	std::vector<unsigned char>& vertexBuffer = writer.getVertexBufferRef();
+	std::vector<unsigned char> output(vertexBuffer.size());
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		memcpy(output.data() + remap[v] * vertexSize, vertexBuffer.data() + v * vertexSize, vertexSize);
+	}
+	vertexBuffer.swap(output);
+}
+
+}
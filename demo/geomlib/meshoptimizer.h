@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+
+namespace geom
+{
+
+struct MeshOptimizationInfo
+{
+	// reorder triangles of every mesh for post-transform vertex cache
+	bool optimizeVertexCache;
+	// reorder clusters of triangles to draw outer surfaces first
+	bool optimizeOverdraw;
+	// reorder vertices in order of the first use
+	bool optimizeVertexFetch;
+
+	MeshOptimizationInfo() : optimizeVertexCache(true), optimizeOverdraw(true), optimizeVertexFetch(true){}
+};
+
+class MeshOptimizer
+{
+public:
+	// FIFO cache size which is used to calculate statistics
+	static const size_t STATISTICS_CACHE_SIZE = 32;
+
+	static Data optimize(const Data& data, const MeshOptimizationInfo& info = MeshOptimizationInfo());
+
+	// average cache miss ratio, the number of transformed vertices per triangle
+	static float calculateACMR(const Data& data, size_t cacheSize = STATISTICS_CACHE_SIZE);
+	// average transform to vertex ratio, the number of transformed vertices per vertex
+	static float calculateATVR(const Data& data, size_t cacheSize = STATISTICS_CACHE_SIZE);
+
+private:
+	static size_t calculateCacheMisses(const Data& data, size_t cacheSize);
+	static size_t calculateCacheMisses(const unsigned int* indices, size_t indicesCount, size_t verticesCount, size_t cacheSize);
+	static void optimizeVertexCache(unsigned int* indices, size_t indicesCount, size_t verticesCount);
+	// indices refer to vertices of the range, positions are taken from data by vertices[index]
+	static void optimizeOverdraw(const Data& data, const unsigned int* vertices, size_t verticesCount, 
+								 unsigned int* indices, size_t indicesCount);
+	static void optimizeVertexFetch(DataWriter& writer, size_t vertexSize);
+};
+
+}
+
+#endif
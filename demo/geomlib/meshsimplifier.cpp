@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include "meshsimplifier.h"
+#include <queue>
+
+namespace geom
+{
+
+// symmetric 4x4 matrix of a quadric error (M. Garland, P. Heckbert, "Surface Simplification
+// Using Quadric Error Metrics"), weight is the sum of weights of planes
+struct Quadric
+{
+	double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+	double weight;
+
+	Quadric() : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0), weight(0) {}
+
+	void addPlane(const vector3& n, float d, float w)
+	{
+		double x = n.x, y = n.y, z = n.z, dd = d;
+		a00 += w * x * x; a01 += w * x * y; a02 += w * x * z; a03 += w * x * dd;
+		a11 += w * y * y; a12 += w * y * z; a13 += w * y * dd;
+		a22 += w * z * z; a23 += w * z * dd;
+		a33 += w * dd * dd;
+		weight += w;
+	}
+
+	void add(const Quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		weight += q.weight;
+	}
+
+	double evaluate(const vector3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+				   a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+				   a22 * z * z + 2.0 * a23 * z + a33;
+		return e > 0.0 ? e : 0.0;
+	}
+};
+
+struct Collapse
+{
+	double cost;
+	unsigned int from;
+	unsigned int to;
+	unsigned int fromVersion;
+	unsigned int toVersion;
+
+	bool operator>(const Collapse& c) const { return cost > c.cost; }
+};
+
+// border edges are penalized to keep silhouettes of open meshes
+const float BORDER_WEIGHT = 10.0f;
+
+class QuadricSimplifier
+{
+public:
+	QuadricSimplifier(const std::vector<vector3>& positions, const std::vector<unsigned int>& positionIds,
+					  const std::vector<unsigned int>& positionVerticesOffsets, const std::vector<unsigned int>& positionVertices,
+					  const std::vector<vector3>& normals, const std::vector<vector2>& uvs) :
+		m_positions(positions), m_positionIds(positionIds), m_positionVerticesOffsets(positionVerticesOffsets),
+		m_positionVertices(positionVertices), m_normals(normals), m_uvs(uvs), m_aliveTriangles(0)
+	{
+	}
+
+	void init(const unsigned int* indices, size_t indicesCount)
+	{
+		// vertices are welded by positions, so seams do not tear during simplification
+		m_corners.clear();
+		m_triangles.clear();
+		m_localIds.clear();
+		std::unordered_map<unsigned int, unsigned int> localIds;
+		for (size_t t = 0; t < indicesCount / 3; t++)
+		{
+			unsigned int ids[3];
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int positionId = m_positionIds[indices[t * 3 + k]];
+				auto it = localIds.find(positionId);
+				if (it == localIds.end())
+				{
+					it = localIds.insert(std::make_pair(positionId, (unsigned int)m_localIds.size())).first;
+					m_localIds.push_back(positionId);
+				}
+				ids[k] = it->second;
+			}
+			if (ids[0] == ids[1] || ids[1] == ids[2] || ids[2] == ids[0]) continue;
+
+			m_corners.insert(m_corners.end(), indices + t * 3, indices + t * 3 + 3);
+			m_triangles.insert(m_triangles.end(), ids, ids + 3);
+		}
+
+		size_t verticesCount = m_localIds.size();
+		size_t trianglesCount = m_triangles.size() / 3;
+		m_quadrics.assign(verticesCount, Quadric());
+		m_versions.assign(verticesCount, 0);
+		m_isVertexAlive.assign(verticesCount, 1);
+		m_vertexTriangles.assign(verticesCount, std::vector<unsigned int>());
+		m_isTriangleAlive.assign(trianglesCount, 1);
+		m_aliveTriangles = trianglesCount;
+
+		std::unordered_map<unsigned long long, int> edges;
+		for (size_t t = 0; t < trianglesCount; t++)
+		{
+			const unsigned int* tri = m_triangles.data() + t * 3;
+			vector3 n = getTriangleNormal(tri[0], tri[1], tri[2]);
+			float area = n.len();
+			if (area > 0.0f) n *= (1.0f / area);
+			float d = -(n % getPosition(tri[0]));
+			for (int k = 0; k < 3; k++)
+			{
+				m_quadrics[tri[k]].addPlane(n, d, area);
+				m_vertexTriangles[tri[k]].push_back((unsigned int)t);
+				edges[getEdgeKey(tri[k], tri[(k + 1) % 3])]++;
+			}
+		}
+
+		// planes which are perpendicular to border edges
+		for (size_t t = 0; t < trianglesCount; t++)
+		{
+			const unsigned int* tri = m_triangles.data() + t * 3;
+			vector3 n = getTriangleNormal(tri[0], tri[1], tri[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v1 = tri[k];
+				unsigned int v2 = tri[(k + 1) % 3];
+				if (edges[getEdgeKey(v1, v2)] != 1) continue;
+
+				vector3 edge = getPosition(v2) - getPosition(v1);
+				vector3 borderNormal = edge * n;
+				borderNormal.norm();
+				float d = -(borderNormal % getPosition(v1));
+				float w = edge.len() * edge.len() * BORDER_WEIGHT;
+				m_quadrics[v1].addPlane(borderNormal, d, w);
+				m_quadrics[v2].addPlane(borderNormal, d, w);
+			}
+		}
+
+		m_collapses = CollapsesQueue();
+		for (auto it = edges.begin(); it != edges.end(); ++it)
+		{
+			unsigned int v1 = (unsigned int)(it->first >> 32);
+			unsigned int v2 = (unsigned int)(it->first & 0xffffffff);
+			addCollapses(v1, v2);
+		}
+	}
+
+	// returns the maximum error of performed collapses
+	float simplify(size_t targetTrianglesCount, float maxError)
+	{
+		float error = 0.0f;
+		double maxErrorSq = (double)maxError * (double)maxError;
+		while (m_aliveTriangles > targetTrianglesCount && !m_collapses.empty())
+		{
+			Collapse c = m_collapses.top();
+			if (!m_isVertexAlive[c.from] || !m_isVertexAlive[c.to] ||
+				m_versions[c.from] != c.fromVersion || m_versions[c.to] != c.toVersion)
+			{
+				m_collapses.pop();
+				continue;
+			}
+			
+			double weight = m_quadrics[c.from].weight + m_quadrics[c.to].weight;
+			double errorSq = weight > 0.0 ? c.cost / weight : 0.0;
+			if (errorSq > maxErrorSq) break;
+
+			m_collapses.pop();
+			if (!canCollapse(c.from, c.to)) continue;
+
+			collapse(c.from, c.to);
+			error = std::max(error, (float)sqrt(errorSq));
+		}
+		return error;
+	}
+
+	void getIndices(std::vector<unsigned int>& indices) const
+	{
+		for (size_t t = 0; t < m_isTriangleAlive.size(); t++)
+		{
+			if (m_isTriangleAlive[t]) indices.insert(indices.end(), m_corners.begin() + t * 3, m_corners.begin() + t * 3 + 3);
+		}
+	}
+
+	size_t getTrianglesCount() const { return m_aliveTriangles; }
+
+private:
+	typedef std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > CollapsesQueue;
+
+	const std::vector<vector3>& m_positions;
+	const std::vector<unsigned int>& m_positionIds;
+	const std::vector<unsigned int>& m_positionVerticesOffsets;
+	const std::vector<unsigned int>& m_positionVertices;
+	const std::vector<vector3>& m_normals;
+	const std::vector<vector2>& m_uvs;
+
+	std::vector<unsigned int> m_localIds;
+	std::vector<unsigned int> m_corners;
+	std::vector<unsigned int> m_triangles;
+	std::vector<char> m_isTriangleAlive;
+	size_t m_aliveTriangles;
+
+	std::vector<Quadric> m_quadrics;
+	std::vector<unsigned int> m_versions;
+	std::vector<char> m_isVertexAlive;
+	std::vector<std::vector<unsigned int> > m_vertexTriangles;
+	CollapsesQueue m_collapses;
+
+	static unsigned long long getEdgeKey(unsigned int v1, unsigned int v2)
+	{
+		if (v1 > v2) std::swap(v1, v2);
+		return ((unsigned long long)v1 << 32) | v2;
+	}
+
+	const vector3& getPosition(unsigned int localId) const
+	{
+		return m_positions[m_localIds[localId]];
+	}
+
+	vector3 getTriangleNormal(unsigned int v1, unsigned int v2, unsigned int v3) const
+	{
+		return (getPosition(v2) - getPosition(v1)) * (getPosition(v3) - getPosition(v1));
+	}
+
+	void addCollapses(unsigned int v1, unsigned int v2)
+	{
+		Quadric q = m_quadrics[v1];
+		q.add(m_quadrics[v2]);
+
+		Collapse c;
+		c.from = v1;
+		c.to = v2;
+		c.fromVersion = m_versions[v1];
+		c.toVersion = m_versions[v2];
+		c.cost = q.evaluate(getPosition(v2));
+		m_collapses.push(c);
+
+		std::swap(c.from, c.to);
+		std::swap(c.fromVersion, c.toVersion);
+		c.cost = q.evaluate(getPosition(v1));
+		m_collapses.push(c);
+	}
+
+	bool canCollapse(unsigned int from, unsigned int to) const
+	{
+		// triangles must not flip
+		const std::vector<unsigned int>& triangles = m_vertexTriangles[from];
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			unsigned int t = triangles[i];
+			if (!m_isTriangleAlive[t]) continue;
+			const unsigned int* tri = m_triangles.data() + t * 3;
+			if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+			unsigned int newTri[3] = { tri[0], tri[1], tri[2] };
+			for (int k = 0; k < 3; k++)
+			{
+				if (newTri[k] == from) newTri[k] = to;
+			}
+			vector3 n1 = getTriangleNormal(tri[0], tri[1], tri[2]);
+			vector3 n2 = getTriangleNormal(newTri[0], newTri[1], newTri[2]);
+			if (n1 % n2 <= 0.0f) return false;
+		}
+		return true;
+	}
+
+	void collapse(unsigned int from, unsigned int to)
+	{
+		std::vector<unsigned int>& toTriangles = m_vertexTriangles[to];
+		const std::vector<unsigned int>& fromTriangles = m_vertexTriangles[from];
+		for (size_t i = 0; i < fromTriangles.size(); i++)
+		{
+			unsigned int t = fromTriangles[i];
+			if (!m_isTriangleAlive[t]) continue;
+
+			unsigned int* tri = m_triangles.data() + t * 3;
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+			{
+				m_isTriangleAlive[t] = 0;
+				m_aliveTriangles--;
+				continue;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				if (tri[k] != from) continue;
+				tri[k] = to;
+				m_corners[t * 3 + k] = findClosestVertex(m_corners[t * 3 + k], m_localIds[to]);
+			}
+			toTriangles.push_back(t);
+		}
+
+		m_quadrics[to].add(m_quadrics[from]);
+		m_isVertexAlive[from] = 0;
+		m_vertexTriangles[from].clear();
+		m_versions[to]++;
+
+		// remove dead triangles and update collapses of the neighbours
+		toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&](unsigned int t)
+		{
+			return !m_isTriangleAlive[t];
+		}), toTriangles.end());
+
+		std::vector<unsigned int> neighbours;
+		for (size_t i = 0; i < toTriangles.size(); i++)
+		{
+			const unsigned int* tri = m_triangles.data() + toTriangles[i] * 3;
+			for (int k = 0; k < 3; k++)
+			{
+				if (tri[k] != to) neighbours.push_back(tri[k]);
+			}
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (size_t i = 0; i < neighbours.size(); i++)
+		{
+			addCollapses(to, neighbours[i]);
+		}
+	}
+
+	// finds a vertex in the position with attributes which are the closest to attributes of the vertex
+	unsigned int findClosestVertex(unsigned int vertex, unsigned int positionId) const
+	{
+		unsigned int result = m_positionVertices[m_positionVerticesOffsets[positionId]];
+		float minDistance = std::numeric_limits<float>::max();
+		for (unsigned int i = m_positionVerticesOffsets[positionId]; i < m_positionVerticesOffsets[positionId + 1]; i++)
+		{
+			unsigned int v = m_positionVertices[i];
+			vector3 dn = m_normals[v] - m_normals[vertex];
+			vector2 duv = m_uvs[v] - m_uvs[vertex];
+			float distance = dn % dn + duv.x * duv.x + duv.y * duv.y;
+			if (distance < minDistance)
+			{
+				minDistance = distance;
+				result = v;
+			}
+		}
+		return result;
+	}
+};
+
+Data MeshSimplifier::generateLods(const Data& data, const LodGenerationInfo& info)
+{
+	if (!data.isCorrect()) return data;
+
+	Data result;
+	DataWriter writer(&result);
+	writer.getMeshesRef() = data.getMeshes();
+	writer.copyVertexDeclaration(data);
+	writer.getVerticesCountRef() = data.getVerticesCount();
+	writer.getBoundingBoxRef() = data.getBoundingBox();
+	writer.getVertexBufferRef().assign(data.getVertexData(), data.getVertexData() + data.getVertexDataSize());
+
+	size_t verticesCount = data.getVerticesCount();
+	const unsigned int* indices = data.getIndexData();
+	for (size_t i = 0; i < data.getIndicesCount(); i++)
+	{
+		if (indices[i] >= verticesCount)
+		{
+			writer.getLastErrorRef() = "LOD generation error (index is out of range)";
+			return result;
+		}
+	}
+
+	// vertex attributes
+	Data fullData = VertexFormatConverter::convert(data, Data::VERTEX_FORMAT_FULL, Data::COMPONENTS_ALL);
+	size_t fullVertexSize = fullData.getVertexSize();
+	std::vector<vector3> positions(verticesCount);
+	std::vector<vector3> normals(verticesCount);
+	std::vector<vector2> uvs(verticesCount);
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		const Data::Vertex* vertex = reinterpret_cast<const Data::Vertex*>(fullData.getVertexData() + v * fullVertexSize);
+		positions[v] = vertex->position;
+		normals[v] = vertex->normal;
+		uvs[v] = vertex->texCoord0;
+	}
+
+	// weld vertices with equal positions
+	std::vector<unsigned int> sortedVertices(verticesCount);
+	for (size_t v = 0; v < verticesCount; v++) sortedVertices[v] = (unsigned int)v;
+	std::sort(sortedVertices.begin(), sortedVertices.end(), [&](unsigned int v1, unsigned int v2)
+	{
+		const vector3& p1 = positions[v1];
+		const vector3& p2 = positions[v2];
+		if (p1.x != p2.x) return p1.x < p2.x;
+		if (p1.y != p2.y) return p1.y < p2.y;
+		if (p1.z != p2.z) return p1.z < p2.z;
+		return v1 < v2;
+	});
+	std::vector<vector3> uniquePositions;
+	std::vector<unsigned int> positionIds(verticesCount);
+	std::vector<unsigned int> positionVerticesOffsets;
+	for (size_t i = 0; i < verticesCount; i++)
+	{
+		unsigned int v = sortedVertices[i];
+		if (i == 0 || !(positions[v].x == uniquePositions.back().x && positions[v].y == uniquePositions.back().y &&
+						positions[v].z == uniquePositions.back().z))
+		{
+			uniquePositions.push_back(positions[v]);
+			positionVerticesOffsets.push_back((unsigned int)i);
+		}
+		positionIds[v] = (unsigned int)(uniquePositions.size() - 1);
+	}
+	positionVerticesOffsets.push_back((unsigned int)verticesCount);
+
+	bbox3 bbox;
+	bbox.begin_extend();
+	for (size_t i = 0; i < uniquePositions.size(); i++) bbox.extend(uniquePositions[i]);
+	float maxError = info.maxError * bbox.diagonal_size();
+	float errorScale = bbox.diagonal_size() > 0.0f ? 1.0f / bbox.diagonal_size() : 0.0f;
+
+	// every mesh is followed by its LODs in the new index buffer
+	QuadricSimplifier simplifier(uniquePositions, positionIds, positionVerticesOffsets, sortedVertices, normals, uvs);
+	std::vector<unsigned int>& indexBuffer = writer.getIndexBufferRef();
+	Data::Meshes& meshes = writer.getMeshesRef();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		Data::Mesh& mesh = meshes[m];
+		mesh.lods.clear();
+		if (mesh.offsetInIB + mesh.indicesCount > data.getIndicesCount())
+		{
+			writer.getLastErrorRef() = "LOD generation error (mesh is out of index buffer)";
+			return result;
+		}
+
+		const unsigned int* meshIndices = indices + mesh.offsetInIB;
+		for (size_t c = 0; c < mesh.clusters.size(); c++)
+		{
+			mesh.clusters[c].offsetInIB = mesh.clusters[c].offsetInIB - mesh.offsetInIB + indexBuffer.size();
+		}
+		mesh.offsetInIB = indexBuffer.size();
+		indexBuffer.insert(indexBuffer.end(), meshIndices, meshIndices + mesh.indicesCount);
+
+		simplifier.init(meshIndices, mesh.indicesCount);
+		size_t trianglesCount = mesh.indicesCount / 3;
+		float error = 0.0f;
+		for (size_t lod = 0; lod < info.lodsCount; lod++)
+		{
+			size_t targetTrianglesCount = (size_t)((float)trianglesCount * info.reductionRatio);
+			error = std::max(error, simplifier.simplify(targetTrianglesCount, maxError));
+			if (simplifier.getTrianglesCount() == 0 || simplifier.getTrianglesCount() >= trianglesCount) break;
+
+			trianglesCount = simplifier.getTrianglesCount();
+			Data::Lod meshLod;
+			meshLod.offsetInIB = indexBuffer.size();
+			meshLod.indicesCount = trianglesCount * 3;
+			meshLod.error = error * errorScale;
+			simplifier.getIndices(indexBuffer);
+			mesh.lods.push_back(meshLod);
+
+			// maximum error is reached
+			if (trianglesCount > targetTrianglesCount) break;
+		}
+	}
+
+	return result;
+}
+
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MESH_SIMPLIFIER_H__
+#define __MESH_SIMPLIFIER_H__
+
+namespace geom
+{
+
+struct LodGenerationInfo
+{
+	// number of LODs besides the source mesh
+	size_t lodsCount;
+	// ratio of triangles count in the next LOD to triangles count in the previous one
+	float reductionRatio;
+	// maximum geometric error relative to the diagonal of the bounding box
+	float maxError;
+
+	LodGenerationInfo() : lodsCount(3), reductionRatio(0.5f), maxError(0.05f){}
+};
+
+class MeshSimplifier
+{
+public:
+	// Generates LODs of every mesh by edge collapses driven by quadric error metrics.
+	// Vertices collapse onto existing vertices, so LODs share the vertex buffer with
+	// the source meshes and only their indices are added to the index buffer.
+	static Data generateLods(const Data& data, const LodGenerationInfo& info = LodGenerationInfo());
+};
+
+}
+
+#endif
@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "objloader.h"
+#include "textparser.h"
+#include "meshbuilder.h"
+
+namespace geom
+{
+
+namespace
+{
+	// files are split into chunks of at least this size for parallel parsing
+	const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	// 1-based absolute or negative relative index to 0-based absolute one
+	bool resolveIndex(int index, size_t base, size_t parsedCount, size_t totalCount, int& result)
+	{
+		long long resolved = index > 0 ? (long long)index - 1 : (long long)(base + parsedCount) + index;
+		if (index == 0 || resolved < 0 || resolved >= (long long)totalCount) return false;
+		result = (int)resolved;
+		return true;
+	}
+
+	std::string parseName(const char* ptr, const char* end)
+	{
+		ptr = TextParser::skipSpaces(ptr, end);
+		const char* nameEnd = TextParser::skipLine(ptr, end);
+		while (nameEnd > ptr && (nameEnd[-1] == '\n' || nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) nameEnd--;
+		return std::string(ptr, nameEnd);
+	}
+
+	// texture statements may contain options (-bm 0.5 ...), the file name is the last token
+	std::string parseTextureName(const char* ptr, const char* end)
+	{
+		std::string name = parseName(ptr, end);
+		size_t p = name.find_last_of(" \t");
+		if (p != std::string::npos) name = name.substr(p + 1);
+		return utils::Utils::trimExtention(utils::Utils::getFilename(name));
+	}
+}
+
+Data ObjLoader::load(const std::string& filename)
+{
+	Data data;
+	DataWriter writer(&data);
+
+	std::shared_ptr<utils::MemoryMappedFile> file;
+	const unsigned char* fileData = 0;
+	size_t fileSize = 0;
+	if (utils::Archive::instance().find(filename, fileData, fileSize))
+	{
+		file = utils::Archive::instance().getMappedFile();
+	}
+	else
+	{
+		file.reset(new utils::MemoryMappedFile());
+		if (!file->open(filename))
+		{
+			writer.getLastErrorRef() = std::string("Could not open file '") + filename + "'";
+			return data;
+		}
+		fileData = file->getData();
+		fileSize = file->getSize();
+	}
+	const char* text = (const char*)fileData;
+
+	size_t chunksCount = fileSize / MIN_CHUNK_SIZE + 1;
+	if (chunksCount > utils::Parallel::getThreadsCount()) chunksCount = utils::Parallel::getThreadsCount();
+	std::vector<size_t> offsets = TextParser::splitLines(text, fileSize, chunksCount);
+	std::vector<Chunk> chunks(chunksCount);
+
+	// the first pass counts elements to resolve indices of the second pass
+	utils::Parallel::forRange(chunksCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++) countElements(text + offsets[i], text + offsets[i + 1], chunks[i]);
+	});
+	std::vector<Totals> totals(chunksCount);
+	Totals total = {};
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		totals[i].positionsBase = total.positionsCount;
+		totals[i].uvsBase = total.uvsCount;
+		totals[i].normalsBase = total.normalsCount;
+		total.positionsCount += chunks[i].positionsCount;
+		total.uvsCount += chunks[i].uvsCount;
+		total.normalsCount += chunks[i].normalsCount;
+	}
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		totals[i].positionsCount = total.positionsCount;
+		totals[i].uvsCount = total.uvsCount;
+		totals[i].normalsCount = total.normalsCount;
+	}
+
+	utils::Parallel::forRange(chunksCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++) parseChunk(text + offsets[i], text + offsets[i + 1], totals[i], chunks[i]);
+	});
+	file.reset();
+
+	size_t trianglesCount = 0, uvCornersCount = 0, normalCornersCount = 0;
+	std::string materialLibrary;
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		if (!chunks[i].error.empty())
+		{
+			writer.getLastErrorRef() = chunks[i].error;
+			return data;
+		}
+		trianglesCount += chunks[i].corners.size() / 3;
+		uvCornersCount += chunks[i].uvCornersCount;
+		normalCornersCount += chunks[i].normalCornersCount;
+		if (materialLibrary.empty()) materialLibrary = chunks[i].materialLibrary;
+	}
+	if (trianglesCount == 0)
+	{
+		writer.getLastErrorRef() = "Obj-file does not contain faces";
+		return data;
+	}
+
+	// ranges of triangles of each chunk using the same material, the material at 
+	// the beginning of a chunk is the last material of the previous chunk
+	std::map<std::string, size_t> materialIndices;
+	std::vector<std::string> materialNames(1);
+	materialIndices[""] = 0;
+	std::vector<std::vector<std::pair<size_t, size_t> > > runs(chunksCount);
+	size_t currentMaterial = 0;
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		runs[i].push_back(std::make_pair((size_t)0, currentMaterial));
+		for (size_t j = 0; j < chunks[i].materials.size(); j++)
+		{
+			auto it = materialIndices.find(chunks[i].materials[j].second);
+			if (it == materialIndices.end())
+			{
+				it = materialIndices.insert(std::make_pair(chunks[i].materials[j].second, materialNames.size())).first;
+				materialNames.push_back(chunks[i].materials[j].second);
+			}
+			currentMaterial = it->second;
+			if (runs[i].back().first == chunks[i].materials[j].first) runs[i].back().second = currentMaterial;
+			else runs[i].push_back(std::make_pair(chunks[i].materials[j].first, currentMaterial));
+		}
+	}
+
+	// triangles are grouped by materials, keeping their order within a material
+	size_t materialsCount = materialNames.size();
+	std::vector<size_t> destinations(chunksCount * materialsCount, 0);
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		for (size_t r = 0; r < runs[i].size(); r++)
+		{
+			size_t runEnd = r + 1 < runs[i].size() ? runs[i][r + 1].first : chunks[i].corners.size() / 3;
+			destinations[i * materialsCount + runs[i][r].second] += runEnd - runs[i][r].first;
+		}
+	}
+	std::map<std::string, Data::Material> materials;
+	if (!materialLibrary.empty()) loadMaterials(utils::Utils::getPath(filename) + materialLibrary, materials);
+
+	MeshBuilder::Input input;
+	size_t offset = 0;
+	for (size_t m = 0; m < materialsCount; m++)
+	{
+		size_t meshOffset = offset;
+		for (size_t i = 0; i < chunksCount; i++)
+		{
+			size_t count = destinations[i * materialsCount + m];
+			destinations[i * materialsCount + m] = offset;
+			offset += count;
+		}
+		if (offset == meshOffset) continue;
+
+		Data::Mesh mesh;
+		mesh.offsetInIB = meshOffset * 3;
+		mesh.indicesCount = (offset - meshOffset) * 3;
+		auto it = materials.find(materialNames[m]);
+		if (it != materials.end()) mesh.material = it->second;
+		input.meshes.push_back(mesh);
+	}
+
+	std::vector<Corner> corners(trianglesCount * 3);
+	utils::Parallel::forRange(chunksCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			for (size_t r = 0; r < runs[i].size(); r++)
+			{
+				size_t runEnd = r + 1 < runs[i].size() ? runs[i][r + 1].first : chunks[i].corners.size() / 3;
+				size_t& destination = destinations[i * materialsCount + runs[i][r].second];
+				if (runEnd == runs[i][r].first) continue;
+				memcpy(&corners[destination * 3], &chunks[i].corners[runs[i][r].first * 3], (runEnd - runs[i][r].first) * 3 * sizeof(Corner));
+				destination += runEnd - runs[i][r].first;
+			}
+			std::vector<Corner>().swap(chunks[i].corners);
+		}
+	});
+
+	std::vector<vector3> positions, normals;
+	std::vector<vector2> uvs;
+	positions.reserve(total.positionsCount);
+	uvs.reserve(total.uvsCount);
+	normals.reserve(total.normalsCount);
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+		uvs.insert(uvs.end(), chunks[i].uvs.begin(), chunks[i].uvs.end());
+		normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+	}
+	chunks.clear();
+
+	// normals are used only if all corners have them, otherwise they are calculated
+	bool hasUVs = uvCornersCount > 0;
+	bool hasNormals = normalCornersCount == corners.size();
+	input.indices.resize(corners.size());
+	if (!hasUVs && !hasNormals)
+	{
+		for (size_t i = 0; i < corners.size(); i++) input.indices[i] = (unsigned int)corners[i].position;
+		input.positions.swap(positions);
+		MeshBuilder::build(input, writer);
+		return data;
+	}
+
+	// vertices with the same position are chained, they appear in the order of the first reference
+	std::vector<int> firstVertex(positions.size(), -1);
+	std::vector<int> nextVertex;
+	std::vector<Corner> vertices;
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		Corner key = corners[i];
+		if (!hasUVs) key.uv = -1;
+		if (!hasNormals) key.normal = -1;
+		int v = firstVertex[key.position];
+		for (; v >= 0; v = nextVertex[v])
+		{
+			if (vertices[v].uv == key.uv && vertices[v].normal == key.normal) break;
+		}
+		if (v < 0)
+		{
+			v = (int)vertices.size();
+			vertices.push_back(key);
+			nextVertex.push_back(firstVertex[key.position]);
+			firstVertex[key.position] = v;
+		}
+		input.indices[i] = (unsigned int)v;
+	}
+	std::vector<Corner>().swap(corners);
+
+	input.positions.resize(vertices.size());
+	if (hasUVs) input.uvs.resize(vertices.size());
+	if (hasNormals) input.normals.resize(vertices.size());
+	utils::Parallel::forRange(vertices.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			input.positions[v] = positions[vertices[v].position];
+			if (hasUVs) input.uvs[v] = vertices[v].uv >= 0 ? uvs[vertices[v].uv] : vector2(0, 0);
+			if (hasNormals) input.normals[v] = normals[vertices[v].normal];
+		}
+	});
+
+	MeshBuilder::build(input, writer);
+	return data;
+}
+
+bool ObjLoader::isKeyword(const char* ptr, const char* end, const char* keyword)
+{
+	for (; *keyword != 0; ptr++, keyword++)
+	{
+		if (ptr == end || *ptr != *keyword) return false;
+	}
+	return ptr < end && (*ptr == ' ' || *ptr == '\t');
+}
+
+void ObjLoader::countElements(const char* begin, const char* end, Chunk& chunk)
+{
+	for (const char* ptr = begin; ptr < end; ptr = TextParser::skipLine(ptr, end))
+	{
+		ptr = TextParser::skipSpaces(ptr, end);
+		if (end - ptr < 2 || ptr[0] != 'v') continue;
+		if (ptr[1] == ' ' || ptr[1] == '\t') chunk.positionsCount++;
+		else if (isKeyword(ptr, end, "vt")) chunk.uvsCount++;
+		else if (isKeyword(ptr, end, "vn")) chunk.normalsCount++;
+	}
+}
+
+void ObjLoader::parseChunk(const char* begin, const char* end, const Totals& totals, Chunk& chunk)
+{
+	chunk.positions.reserve(chunk.positionsCount);
+	chunk.uvs.reserve(chunk.uvsCount);
+	chunk.normals.reserve(chunk.normalsCount);
+
+	std::vector<Corner> polygon;
+	for (const char* ptr = begin; ptr < end; ptr = TextParser::skipLine(ptr, end))
+	{
+		ptr = TextParser::skipSpaces(ptr, end);
+		if (ptr == end) break;
+
+		bool isCorrect = true;
+		if (isKeyword(ptr, end, "v"))
+		{
+			vector3 position;
+			ptr = TextParser::skipSpaces(ptr + 1, end);
+			isCorrect = TextParser::parseFloat(ptr, end, position.x);
+			ptr = TextParser::skipSpaces(ptr, end);
+			isCorrect = isCorrect && TextParser::parseFloat(ptr, end, position.y);
+			ptr = TextParser::skipSpaces(ptr, end);
+			isCorrect = isCorrect && TextParser::parseFloat(ptr, end, position.z);
+			chunk.positions.push_back(position);
+		}
+		else if (isKeyword(ptr, end, "vt"))
+		{
+			vector2 uv(0, 0);
+			ptr = TextParser::skipSpaces(ptr + 2, end);
+			isCorrect = TextParser::parseFloat(ptr, end, uv.x);
+			ptr = TextParser::skipSpaces(ptr, end);
+			TextParser::parseFloat(ptr, end, uv.y);
+			chunk.uvs.push_back(uv);
+		}
+		else if (isKeyword(ptr, end, "vn"))
+		{
+			vector3 normal;
+			ptr = TextParser::skipSpaces(ptr + 2, end);
+			isCorrect = TextParser::parseFloat(ptr, end, normal.x);
+			ptr = TextParser::skipSpaces(ptr, end);
+			isCorrect = isCorrect && TextParser::parseFloat(ptr, end, normal.y);
+			ptr = TextParser::skipSpaces(ptr, end);
+			isCorrect = isCorrect && TextParser::parseFloat(ptr, end, normal.z);
+			chunk.normals.push_back(normal);
+		}
+		else if (isKeyword(ptr, end, "f"))
+		{
+			polygon.clear();
+			ptr = TextParser::skipSpaces(ptr + 1, end);
+			while (isCorrect && ptr < end && *ptr != '\n' && *ptr != '#')
+			{
+				Corner corner;
+				isCorrect = parseCorner(ptr, end, totals, chunk, corner);
+				polygon.push_back(corner);
+				ptr = TextParser::skipSpaces(ptr, end);
+			}
+			isCorrect = isCorrect && polygon.size() >= 3;
+
+			// polygons are triangulated as fans
+			for (size_t i = 2; isCorrect && i < polygon.size(); i++)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i - 1]);
+				chunk.corners.push_back(polygon[i]);
+				for (size_t j = 0; j < 3; j++)
+				{
+					const Corner& c = chunk.corners[chunk.corners.size() - 1 - j];
+					if (c.uv >= 0) chunk.uvCornersCount++;
+					if (c.normal >= 0) chunk.normalCornersCount++;
+				}
+			}
+		}
+		else if (isKeyword(ptr, end, "usemtl"))
+		{
+			chunk.materials.push_back(std::make_pair(chunk.corners.size() / 3, parseName(ptr + 6, end)));
+		}
+		else if (isKeyword(ptr, end, "mtllib"))
+		{
+			if (chunk.materialLibrary.empty()) chunk.materialLibrary = parseName(ptr + 6, end);
+		}
+
+		if (!isCorrect)
+		{
+			chunk.error = "Incorrect format of obj-file (line '" + parseName(ptr, end) + "')";
+			return;
+		}
+	}
+}
+
+bool ObjLoader::parseCorner(const char*& ptr, const char* end, const Totals& totals, const Chunk& chunk, Corner& corner)
+{
+	corner.uv = -1;
+	corner.normal = -1;
+
+	int index = 0;
+	if (!TextParser::parseInt(ptr, end, index) || 
+		!resolveIndex(index, totals.positionsBase, chunk.positions.size(), totals.positionsCount, corner.position))
+	{
+		return false;
+	}
+	if (ptr == end || *ptr != '/') return true;
+	ptr++;
+	if (ptr < end && *ptr != '/')
+	{
+		if (!TextParser::parseInt(ptr, end, index) || 
+			!resolveIndex(index, totals.uvsBase, chunk.uvs.size(), totals.uvsCount, corner.uv))
+		{
+			return false;
+		}
+	}
+	if (ptr == end || *ptr != '/') return true;
+	ptr++;
+	return TextParser::parseInt(ptr, end, index) && 
+		   resolveIndex(index, totals.normalsBase, chunk.normals.size(), totals.normalsCount, corner.normal);
+}
+
+void ObjLoader::loadMaterials(const std::string& filename, std::map<std::string, Data::Material>& materials)
+{
+	std::string text;
+	if (!utils::Utils::readFileToString(filename, text)) return;
+
+	const char* end = text.c_str() + strlen(text.c_str());
+	Data::Material* material = 0;
+	for (const char* ptr = text.c_str(); ptr < end; ptr = TextParser::skipLine(ptr, end))
+	{
+		ptr = TextParser::skipSpaces(ptr, end);
+		if (isKeyword(ptr, end, "newmtl"))
+		{
+			material = &materials[parseName(ptr + 6, end)];
+		}
+		else if (material == 0)
+		{
+			continue;
+		}
+		else if (isKeyword(ptr, end, "map_Kd"))
+		{
+			material->diffuseMapFilename = parseTextureName(ptr + 6, end);
+		}
+		else if (isKeyword(ptr, end, "map_Ks"))
+		{
+			material->specularMapFilename = parseTextureName(ptr + 6, end);
+		}
+		else if (isKeyword(ptr, end, "map_Bump") || isKeyword(ptr, end, "map_bump") || isKeyword(ptr, end, "bump") || isKeyword(ptr, end, "norm"))
+		{
+			const char* name = ptr;
+			while (name < end && *name != ' ' && *name != '\t') name++;
+			material->normalMapFilename = parseTextureName(name, end);
+		}
+	}
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __OBJ_LOADER_H__
+#define __OBJ_LOADER_H__
+
+namespace geom
+{
+
+// Loader of Wavefront OBJ files. The file is memory-mapped and parsed in chunks 
+// of lines on several threads, polygons are triangulated as fans, vertices with
+// equal position, texture coordinates and normal indices are welded. Every material
+// (usemtl) makes a mesh, texture names are taken from the .mtl library.
+class ObjLoader : public GeometryLoader
+{
+public:
+	ObjLoader(){}
+	virtual ~ObjLoader(){}
+
+	virtual Data load(const std::string& filename);
+
+private:
+	// indices of attributes of a polygon vertex, -1 means absent
+	struct Corner
+	{
+		int position;
+		int uv;
+		int normal;
+	};
+
+	struct Chunk
+	{
+		size_t positionsCount;
+		size_t uvsCount;
+		size_t normalsCount;
+
+		std::vector<vector3> positions;
+		std::vector<vector2> uvs;
+		std::vector<vector3> normals;
+		// 3 corners per triangle
+		std::vector<Corner> corners;
+		// (first triangle, material name), the material before the first usemtl comes from previous chunks
+		std::vector<std::pair<size_t, std::string> > materials;
+		std::string materialLibrary;
+		std::string error;
+		// numbers of corners with texture coordinates and normals
+		size_t uvCornersCount;
+		size_t normalCornersCount;
+
+		Chunk() : positionsCount(0), uvsCount(0), normalsCount(0), uvCornersCount(0), normalCornersCount(0) {}
+	};
+
+	struct Totals
+	{
+		size_t positionsBase;
+		size_t uvsBase;
+		size_t normalsBase;
+		size_t positionsCount;
+		size_t uvsCount;
+		size_t normalsCount;
+	};
+
+	static void countElements(const char* begin, const char* end, Chunk& chunk);
+	static void parseChunk(const char* begin, const char* end, const Totals& totals, Chunk& chunk);
+	static bool parseCorner(const char*& ptr, const char* end, const Totals& totals, const Chunk& chunk, Corner& corner);
+	static bool isKeyword(const char* ptr, const char* end, const char* keyword);
+	static void loadMaterials(const std::string& filename, std::map<std::string, Data::Material>& materials);
+};
+
+}
+
+#endif
@@ -58,7 +58,7 @@ Data PlaneGenerator::generate()
 	writer.getMeshesRef()[0].indicesCount = m_info.segments[0] * m_info.segments[1] * 6;
 
 	writer.getVerticesCountRef() = verticesCount;
-	writer.getAdditionalUVsCountRef() = 0;
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, 0);
 	writer.getBoundingBoxRef().vmin = vector3(-0.5f * m_info.size.x, -0.1f, -0.5f * m_info.size.y);
 	writer.getBoundingBoxRef().vmax = vector3(0.5f * m_info.size.x, 0.1f, 0.5f * m_info.size.y);
 
@@ -0,0 +1,553 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "plyloader.h"
+#include "textparser.h"
+#include "meshbuilder.h"
+
+namespace geom
+{
+
+namespace
+{
+	// ascii data is split into chunks of at least this size for parallel parsing
+	const size_t MIN_CHUNK_SIZE = 1 << 20;
+	// binary triangles are split into ranges of at least this size
+	const size_t MIN_FACES_PER_RANGE = 16384;
+
+	std::vector<std::string> splitTokens(const char* begin, const char* end)
+	{
+		std::vector<std::string> tokens;
+		const char* ptr = TextParser::skipSpaces(begin, end);
+		while (ptr < end && *ptr != '\n')
+		{
+			const char* tokenEnd = ptr;
+			while (tokenEnd < end && *tokenEnd != ' ' && *tokenEnd != '\t' && *tokenEnd != '\r' && *tokenEnd != '\n') tokenEnd++;
+			tokens.push_back(std::string(ptr, tokenEnd));
+			ptr = TextParser::skipSpaces(tokenEnd, end);
+		}
+		return tokens;
+	}
+
+	template<typename T> T readValue(const unsigned char* ptr, bool bigEndian)
+	{
+		unsigned char bytes[sizeof(T)];
+		for (size_t i = 0; i < sizeof(T); i++) bytes[i] = ptr[bigEndian ? sizeof(T) - 1 - i : i];
+		T value;
+		memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+}
+
+Data PlyLoader::load(const std::string& filename)
+{
+	Data data;
+	DataWriter writer(&data);
+
+	std::shared_ptr<utils::MemoryMappedFile> file;
+	const unsigned char* fileData = 0;
+	size_t fileSize = 0;
+	if (utils::Archive::instance().find(filename, fileData, fileSize))
+	{
+		file = utils::Archive::instance().getMappedFile();
+	}
+	else
+	{
+		file.reset(new utils::MemoryMappedFile());
+		if (!file->open(filename))
+		{
+			writer.getLastErrorRef() = std::string("Could not open file '") + filename + "'";
+			return data;
+		}
+		fileData = file->getData();
+		fileSize = file->getSize();
+	}
+
+	Header header;
+	if (!parseHeader((const char*)fileData, fileSize, header))
+	{
+		writer.getLastErrorRef() = "Incorrect format of ply-file (header)";
+		return data;
+	}
+
+	MeshBuilder::Input input;
+	bool isParsed = false;
+	if (header.format == FORMAT_ASCII)
+	{
+		isParsed = parseAscii((const char*)fileData + header.dataOffset, (const char*)fileData + fileSize, header, input);
+	}
+	else
+	{
+		isParsed = parseBinary(fileData + header.dataOffset, fileData + fileSize, header, input);
+	}
+	file.reset();
+	if (!isParsed)
+	{
+		writer.getLastErrorRef() = "Incorrect format of ply-file (data)";
+		return data;
+	}
+	if (input.indices.empty())
+	{
+		writer.getLastErrorRef() = "Ply-file does not contain faces";
+		return data;
+	}
+
+	Data::Mesh mesh;
+	mesh.offsetInIB = 0;
+	mesh.indicesCount = input.indices.size();
+	input.meshes.push_back(mesh);
+
+	MeshBuilder::build(input, writer);
+	return data;
+}
+
+bool PlyLoader::parseHeader(const char* text, size_t size, Header& header)
+{
+	const char* end = text + size;
+	const char* ptr = text;
+	std::vector<std::string> tokens = splitTokens(ptr, end);
+	if (tokens.size() != 1 || tokens[0] != "ply") return false;
+
+	bool hasFormat = false;
+	for (ptr = TextParser::skipLine(ptr, end); ptr < end; ptr = TextParser::skipLine(ptr, end))
+	{
+		tokens = splitTokens(ptr, end);
+		if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info") continue;
+
+		if (tokens[0] == "end_header")
+		{
+			header.dataOffset = (size_t)(TextParser::skipLine(ptr, end) - text);
+			return hasFormat && !header.elements.empty();
+		}
+		else if (tokens[0] == "format" && tokens.size() == 3)
+		{
+			if (tokens[1] == "ascii") header.format = FORMAT_ASCII;
+			else if (tokens[1] == "binary_little_endian") header.format = FORMAT_BINARY_LITTLE_ENDIAN;
+			else if (tokens[1] == "binary_big_endian") header.format = FORMAT_BINARY_BIG_ENDIAN;
+			else return false;
+			hasFormat = true;
+		}
+		else if (tokens[0] == "element" && tokens.size() == 3)
+		{
+			Element element;
+			element.name = tokens[1];
+			int count = 0;
+			const char* countPtr = tokens[2].c_str();
+			if (!TextParser::parseInt(countPtr, countPtr + tokens[2].size(), count) || count < 0) return false;
+			element.count = (size_t)count;
+			element.stride = 0;
+			header.elements.push_back(element);
+		}
+		else if (tokens[0] == "property" && !header.elements.empty())
+		{
+			Element& element = header.elements.back();
+			Property property;
+			property.isList = tokens.size() == 5 && tokens[1] == "list";
+			if (property.isList)
+			{
+				property.countType = getType(tokens[2]);
+				property.type = getType(tokens[3]);
+				property.name = tokens[4];
+				if (property.countType == TYPE_FLOAT32 || property.countType == TYPE_FLOAT64) return false;
+			}
+			else if (tokens.size() == 3)
+			{
+				property.type = getType(tokens[1]);
+				property.countType = TYPE_UNKNOWN;
+				property.name = tokens[2];
+			}
+			else
+			{
+				return false;
+			}
+			if (property.type == TYPE_UNKNOWN || (property.isList && property.countType == TYPE_UNKNOWN)) return false;
+
+			bool isFixed = element.properties.empty() || element.stride != 0;
+			property.offset = element.stride;
+			element.stride = (isFixed && !property.isList) ? element.stride + getTypeSize(property.type) : 0;
+			element.properties.push_back(property);
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+PlyLoader::Type PlyLoader::getType(const std::string& name)
+{
+	if (name == "char" || name == "int8") return TYPE_INT8;
+	if (name == "uchar" || name == "uint8") return TYPE_UINT8;
+	if (name == "short" || name == "int16") return TYPE_INT16;
+	if (name == "ushort" || name == "uint16") return TYPE_UINT16;
+	if (name == "int" || name == "int32") return TYPE_INT32;
+	if (name == "uint" || name == "uint32") return TYPE_UINT32;
+	if (name == "float" || name == "float32") return TYPE_FLOAT32;
+	if (name == "double" || name == "float64") return TYPE_FLOAT64;
+	return TYPE_UNKNOWN;
+}
+
+size_t PlyLoader::getTypeSize(Type type)
+{
+	static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+	return sizes[type];
+}
+
+double PlyLoader::readBinary(const unsigned char* ptr, Type type, bool bigEndian)
+{
+	switch (type)
+	{
+	case TYPE_INT8: return (double)(signed char)ptr[0];
+	case TYPE_UINT8: return (double)ptr[0];
+	case TYPE_INT16: return (double)readValue<short>(ptr, bigEndian);
+	case TYPE_UINT16: return (double)readValue<unsigned short>(ptr, bigEndian);
+	case TYPE_INT32: return (double)readValue<int>(ptr, bigEndian);
+	case TYPE_UINT32: return (double)readValue<unsigned int>(ptr, bigEndian);
+	case TYPE_FLOAT32: return (double)readValue<float>(ptr, bigEndian);
+	case TYPE_FLOAT64: return readValue<double>(ptr, bigEndian);
+	default: return 0.0;
+	}
+}
+
+bool PlyLoader::getVertexLayout(const Element& element, VertexLayout& layout)
+{
+	static const char* positionNames[] = { "x", "y", "z" };
+	static const char* normalNames[] = { "nx", "ny", "nz" };
+	static const char* uvNames[][2] = { { "u", "v" }, { "s", "t" }, { "texture_u", "texture_v" } };
+
+	for (int i = 0; i < 3; i++) layout.position[i] = layout.normal[i] = -1;
+	layout.uv[0] = layout.uv[1] = -1;
+	for (size_t p = 0; p < element.properties.size(); p++)
+	{
+		const Property& property = element.properties[p];
+		if (property.isList) return false;
+		for (int i = 0; i < 3; i++)
+		{
+			if (property.name == positionNames[i]) layout.position[i] = (int)p;
+			if (property.name == normalNames[i]) layout.normal[i] = (int)p;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			if (property.name == uvNames[i][0]) layout.uv[0] = (int)p;
+			if (property.name == uvNames[i][1]) layout.uv[1] = (int)p;
+		}
+	}
+	return layout.position[0] >= 0 && layout.position[1] >= 0 && layout.position[2] >= 0;
+}
+
+int PlyLoader::getFaceProperty(const Element& element)
+{
+	for (size_t p = 0; p < element.properties.size(); p++)
+	{
+		const Property& property = element.properties[p];
+		if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) return (int)p;
+	}
+	return -1;
+}
+
+void PlyLoader::resizeVertices(size_t count, const VertexLayout& layout, MeshBuilder::Input& input)
+{
+	input.positions.resize(count);
+	if (layout.hasNormals()) input.normals.resize(count);
+	if (layout.hasUVs()) input.uvs.resize(count);
+}
+
+bool PlyLoader::addPolygon(const std::vector<unsigned int>& polygon, size_t verticesCount, std::vector<unsigned int>& indices)
+{
+	if (polygon.size() < 3) return polygon.empty();
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		if (polygon[i] >= verticesCount) return false;
+	}
+
+	// polygons are triangulated as fans
+	for (size_t i = 2; i < polygon.size(); i++)
+	{
+		indices.push_back(polygon[0]);
+		indices.push_back(polygon[i - 1]);
+		indices.push_back(polygon[i]);
+	}
+	return true;
+}
+
+bool PlyLoader::parseBinary(const unsigned char* begin, const unsigned char* end, const Header& header, MeshBuilder::Input& input)
+{
+	bool bigEndian = header.format == FORMAT_BINARY_BIG_ENDIAN;
+	size_t verticesCount = 0;
+	for (size_t e = 0; e < header.elements.size(); e++)
+	{
+		if (header.elements[e].name == "vertex") verticesCount = header.elements[e].count;
+	}
+
+	const unsigned char* ptr = begin;
+	std::vector<unsigned int> polygon;
+	bool hasVertices = false;
+	for (size_t e = 0; e < header.elements.size(); e++)
+	{
+		const Element& element = header.elements[e];
+		VertexLayout layout;
+		if (element.name == "vertex" && !hasVertices)
+		{
+			if (!getVertexLayout(element, layout) || element.stride == 0) return false;
+			if ((size_t)(end - ptr) / element.stride < element.count) return false;
+
+			resizeVertices(element.count, layout, input);
+			utils::Parallel::forRange(element.count, [&](size_t rangeBegin, size_t rangeEnd, size_t)
+			{
+				for (size_t v = rangeBegin; v < rangeEnd; v++)
+				{
+					const unsigned char* vertex = ptr + v * element.stride;
+					#define READ_PROPERTY(index) (float)readBinary(vertex + element.properties[index].offset, element.properties[index].type, bigEndian)
+					input.positions[v] = vector3(READ_PROPERTY(layout.position[0]), READ_PROPERTY(layout.position[1]), READ_PROPERTY(layout.position[2]));
+					if (layout.hasNormals()) input.normals[v] = vector3(READ_PROPERTY(layout.normal[0]), READ_PROPERTY(layout.normal[1]), READ_PROPERTY(layout.normal[2]));
+					if (layout.hasUVs()) input.uvs[v] = vector2(READ_PROPERTY(layout.uv[0]), READ_PROPERTY(layout.uv[1]));
+					#undef READ_PROPERTY
+				}
+			}, 4096);
+			ptr += element.count * element.stride;
+			hasVertices = true;
+			continue;
+		}
+
+		if (element.stride != 0)
+		{
+			if ((size_t)(end - ptr) / element.stride < element.count) return false;
+			ptr += element.count * element.stride;
+			continue;
+		}
+
+		// elements with lists are parsed sequentially unless they are triangles
+		int faceProperty = element.name == "face" ? getFaceProperty(element) : -1;
+		if (faceProperty >= 0 && parseBinaryTriangles(ptr, end, element, faceProperty, bigEndian, verticesCount, input.indices)) continue;
+		for (size_t i = 0; i < element.count; i++)
+		{
+			for (size_t p = 0; p < element.properties.size(); p++)
+			{
+				const Property& property = element.properties[p];
+				size_t typeSize = getTypeSize(property.type);
+				if (!property.isList)
+				{
+					if ((size_t)(end - ptr) < typeSize) return false;
+					ptr += typeSize;
+					continue;
+				}
+
+				size_t countSize = getTypeSize(property.countType);
+				if ((size_t)(end - ptr) < countSize) return false;
+				double count = readBinary(ptr, property.countType, bigEndian);
+				ptr += countSize;
+				if (count < 0 || (size_t)(end - ptr) / typeSize < (size_t)count) return false;
+				if ((int)p == faceProperty)
+				{
+					polygon.resize((size_t)count);
+					for (size_t j = 0; j < polygon.size(); j++)
+					{
+						double index = readBinary(ptr + j * typeSize, property.type, bigEndian);
+						polygon[j] = index >= 0 ? (unsigned int)index : 0xffffffff;
+					}
+					if (!addPolygon(polygon, verticesCount, input.indices)) return false;
+				}
+				ptr += (size_t)count * typeSize;
+			}
+		}
+	}
+	return hasVertices;
+}
+
+bool PlyLoader::parseBinaryTriangles(const unsigned char*& ptr, const unsigned char* end, const Element& element, int faceProperty,
+									 bool bigEndian, size_t verticesCount, std::vector<unsigned int>& indices)
+{
+	// the size of a face is found from the first one, the face list must be the only list
+	size_t listOffset = 0, faceSize = 0;
+	for (size_t p = 0; p < element.properties.size(); p++)
+	{
+		const Property& property = element.properties[p];
+		if (property.isList && (int)p != faceProperty) return false;
+		if ((int)p == faceProperty)
+		{
+			listOffset = faceSize;
+			faceSize += getTypeSize(property.countType) + 3 * getTypeSize(property.type);
+		}
+		else
+		{
+			faceSize += getTypeSize(property.type);
+		}
+	}
+	const Property& property = element.properties[faceProperty];
+	const size_t countSize = getTypeSize(property.countType);
+	const size_t typeSize = getTypeSize(property.type);
+	if (element.count == 0 || (size_t)(end - ptr) / faceSize < element.count) return false;
+	if (readBinary(ptr + listOffset, property.countType, bigEndian) != 3.0) return false;
+
+	// every face is checked, the sequential parsing reports errors
+	const size_t firstIndex = indices.size();
+	indices.resize(firstIndex + element.count * 3);
+	std::atomic<bool> isCorrect(true);
+	utils::Parallel::forRange(element.count, [&](size_t rangeBegin, size_t rangeEnd, size_t)
+	{
+		for (size_t f = rangeBegin; f < rangeEnd && isCorrect; f++)
+		{
+			const unsigned char* list = ptr + f * faceSize + listOffset;
+			if (readBinary(list, property.countType, bigEndian) != 3.0)
+			{
+				isCorrect = false;
+				return;
+			}
+			for (size_t j = 0; j < 3; j++)
+			{
+				double index = readBinary(list + countSize + j * typeSize, property.type, bigEndian);
+				if (index < 0 || index >= (double)verticesCount)
+				{
+					isCorrect = false;
+					return;
+				}
+				indices[firstIndex + f * 3 + j] = (unsigned int)index;
+			}
+		}
+	}, MIN_FACES_PER_RANGE);
+
+	if (!isCorrect)
+	{
+		indices.resize(firstIndex);
+		return false;
+	}
+	ptr += element.count * faceSize;
+	return true;
+}
+
+bool PlyLoader::parseAscii(const char* begin, const char* end, const Header& header, MeshBuilder::Input& input)
+{
+	// every element occupies a line, lines are counted in parallel to find the first element of each chunk
+	size_t chunksCount = (size_t)(end - begin) / MIN_CHUNK_SIZE + 1;
+	if (chunksCount > utils::Parallel::getThreadsCount()) chunksCount = utils::Parallel::getThreadsCount();
+	std::vector<size_t> offsets = TextParser::splitLines(begin, (size_t)(end - begin), chunksCount);
+	std::vector<size_t> firstLines(chunksCount + 1, 0);
+	utils::Parallel::forRange(chunksCount, [&](size_t rangeBegin, size_t rangeEnd, size_t)
+	{
+		for (size_t i = rangeBegin; i < rangeEnd; i++)
+		{
+			const char* chunkEnd = begin + offsets[i + 1];
+			size_t count = 0;
+			for (const char* ptr = begin + offsets[i]; ptr < chunkEnd; ptr = TextParser::skipLine(ptr, chunkEnd)) count++;
+			firstLines[i + 1] = count;
+		}
+	});
+	for (size_t i = 0; i < chunksCount; i++) firstLines[i + 1] += firstLines[i];
+
+	std::vector<size_t> firstElementLines(header.elements.size() + 1, 0);
+	size_t verticesCount = 0;
+	int vertexElement = -1;
+	std::vector<VertexLayout> layouts(header.elements.size());
+	std::vector<int> faceProperties(header.elements.size(), -1);
+	for (size_t e = 0; e < header.elements.size(); e++)
+	{
+		const Element& element = header.elements[e];
+		firstElementLines[e + 1] = firstElementLines[e] + element.count;
+		if (element.name == "vertex" && vertexElement < 0)
+		{
+			if (!getVertexLayout(element, layouts[e])) return false;
+			vertexElement = (int)e;
+			verticesCount = element.count;
+		}
+		else if (element.name == "face")
+		{
+			faceProperties[e] = getFaceProperty(element);
+		}
+	}
+	if (vertexElement < 0 || firstLines[chunksCount] < firstElementLines.back()) return false;
+
+	resizeVertices(verticesCount, layouts[vertexElement], input);
+	std::vector<std::vector<unsigned int> > chunkIndices(chunksCount);
+	std::vector<char> isCorrect(chunksCount, 1);
+	utils::Parallel::forRange(chunksCount, [&](size_t rangeBegin, size_t rangeEnd, size_t)
+	{
+		std::vector<float> values;
+		std::vector<unsigned int> polygon;
+		for (size_t i = rangeBegin; i < rangeEnd; i++)
+		{
+			const char* chunkEnd = begin + offsets[i + 1];
+			size_t line = firstLines[i];
+			size_t e = 0;
+			for (const char* ptr = begin + offsets[i]; ptr < chunkEnd && isCorrect[i]; ptr = TextParser::skipLine(ptr, chunkEnd), line++)
+			{
+				while (e < header.elements.size() && line >= firstElementLines[e + 1]) e++;
+				if (e == header.elements.size()) break;
+
+				const Element& element = header.elements[e];
+				bool isVertex = (int)e == vertexElement;
+				if (!isVertex && faceProperties[e] < 0) continue;
+
+				values.resize(element.properties.size());
+				for (size_t p = 0; p < element.properties.size() && isCorrect[i]; p++)
+				{
+					ptr = TextParser::skipSpaces(ptr, chunkEnd);
+					if (!element.properties[p].isList)
+					{
+						isCorrect[i] = TextParser::parseFloat(ptr, chunkEnd, values[p]);
+						continue;
+					}
+
+					int count = 0;
+					isCorrect[i] = TextParser::parseInt(ptr, chunkEnd, count) && count >= 0;
+					polygon.resize(isCorrect[i] ? (size_t)count : 0);
+					for (size_t j = 0; j < polygon.size() && isCorrect[i]; j++)
+					{
+						int index = 0;
+						ptr = TextParser::skipSpaces(ptr, chunkEnd);
+						isCorrect[i] = TextParser::parseInt(ptr, chunkEnd, index);
+						polygon[j] = index >= 0 ? (unsigned int)index : 0xffffffff;
+					}
+					if (isCorrect[i] && (int)p == faceProperties[e])
+					{
+						isCorrect[i] = addPolygon(polygon, verticesCount, chunkIndices[i]);
+					}
+				}
+				if (!isVertex || !isCorrect[i]) continue;
+
+				const VertexLayout& layout = layouts[e];
+				size_t v = line - firstElementLines[e];
+				input.positions[v] = vector3(values[layout.position[0]], values[layout.position[1]], values[layout.position[2]]);
+				if (layout.hasNormals()) input.normals[v] = vector3(values[layout.normal[0]], values[layout.normal[1]], values[layout.normal[2]]);
+				if (layout.hasUVs()) input.uvs[v] = vector2(values[layout.uv[0]], values[layout.uv[1]]);
+			}
+		}
+	});
+
+	size_t indicesCount = 0;
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		if (!isCorrect[i]) return false;
+		indicesCount += chunkIndices[i].size();
+	}
+	input.indices.reserve(indicesCount);
+	for (size_t i = 0; i < chunksCount; i++)
+	{
+		input.indices.insert(input.indices.end(), chunkIndices[i].begin(), chunkIndices[i].end());
+	}
+	return true;
+}
+
+}
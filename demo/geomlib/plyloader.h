@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __PLY_LOADER_H__
+#define __PLY_LOADER_H__
+
+namespace geom
+{
+
+// Loader of Stanford PLY files (ascii, binary_little_endian and binary_big_endian).
+// Positions, normals and texture coordinates of vertices and vertex indices of faces 
+// are imported, other elements and properties are skipped. Vertices (and binary triangles) 
+// are parsed on several threads, faces are triangulated as fans.
+class PlyLoader : public GeometryLoader
+{
+public:
+	PlyLoader(){}
+	virtual ~PlyLoader(){}
+
+	virtual Data load(const std::string& filename);
+
+private:
+	enum Format
+	{
+		FORMAT_ASCII = 0,
+		FORMAT_BINARY_LITTLE_ENDIAN,
+		FORMAT_BINARY_BIG_ENDIAN
+	};
+
+	enum Type
+	{
+		TYPE_INT8 = 0,
+		TYPE_UINT8,
+		TYPE_INT16,
+		TYPE_UINT16,
+		TYPE_INT32,
+		TYPE_UINT32,
+		TYPE_FLOAT32,
+		TYPE_FLOAT64,
+		TYPE_UNKNOWN
+	};
+
+	struct Property
+	{
+		std::string name;
+		Type type;
+		bool isList;
+		Type countType;
+		// offset in a binary element without lists
+		size_t offset;
+	};
+
+	struct Element
+	{
+		std::string name;
+		size_t count;
+		std::vector<Property> properties;
+		// size of a binary element, 0 if the element contains lists
+		size_t stride;
+	};
+
+	struct Header
+	{
+		Format format;
+		std::vector<Element> elements;
+		size_t dataOffset;
+	};
+
+	// indices of vertex properties, -1 means absent
+	struct VertexLayout
+	{
+		int position[3];
+		int normal[3];
+		int uv[2];
+		bool hasNormals() const { return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0; }
+		bool hasUVs() const { return uv[0] >= 0 && uv[1] >= 0; }
+	};
+
+	static bool parseHeader(const char* text, size_t size, Header& header);
+	static Type getType(const std::string& name);
+	static size_t getTypeSize(Type type);
+	static double readBinary(const unsigned char* ptr, Type type, bool bigEndian);
+	static bool getVertexLayout(const Element& element, VertexLayout& layout);
+	static int getFaceProperty(const Element& element);
+	static void resizeVertices(size_t count, const VertexLayout& layout, MeshBuilder::Input& input);
+	static bool addPolygon(const std::vector<unsigned int>& polygon, size_t verticesCount, std::vector<unsigned int>& indices);
+
+	static bool parseBinary(const unsigned char* begin, const unsigned char* end, const Header& header, MeshBuilder::Input& input);
+	// Binary faces which are all triangles have a constant size, so they are parsed on several threads.
+	// Returns false (ptr and indices are not changed) if the element doesn't match, faces are parsed sequentially then.
+	static bool parseBinaryTriangles(const unsigned char*& ptr, const unsigned char* end, const Element& element, int faceProperty,
+									 bool bigEndian, size_t verticesCount, std::vector<unsigned int>& indices);
+	static bool parseAscii(const char* begin, const char* end, const Header& header, MeshBuilder::Input& input);
+};
+
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "stdafx.h"
+#include "staticbatcher.h"
+
+namespace geom
+{
+
+namespace
+{
+	vector3 transformDirection(const matrix44& m, const vector3& v)
+	{
+		return vector3(m.M11 * v.x + m.M21 * v.y + m.M31 * v.z,
+					   m.M12 * v.x + m.M22 * v.y + m.M32 * v.z,
+					   m.M13 * v.x + m.M23 * v.y + m.M33 * v.z);
+	}
+
+	// normals are transformed by the inverse transpose matrix
+	vector3 transformNormal(const matrix44& inverse, const vector3& v)
+	{
+		return vector3(inverse.M11 * v.x + inverse.M12 * v.y + inverse.M13 * v.z,
+					   inverse.M21 * v.x + inverse.M22 * v.y + inverse.M23 * v.z,
+					   inverse.M31 * v.x + inverse.M32 * v.y + inverse.M33 * v.z);
+	}
+
+	void transformUnitVector(float* ptr, const vector3& v)
+	{
+		vector3 result = v;
+		if (result.lensquared() > 0.0f) result.norm();
+		memcpy(ptr, &result.x, sizeof(vector3));
+	}
+}
+
+Data StaticBatcher::merge(const std::vector<const Data*>& sources, const std::vector<BatchInstance>& instances)
+{
+	Data result;
+	DataWriter writer(&result);
+	if (instances.empty())
+	{
+		writer.getLastErrorRef() = "Static batching error: there are no instances";
+		return result;
+	}
+
+	const Data* firstSource = instances[0].sourceIndex < sources.size() ? sources[instances[0].sourceIndex] : 0;
+	if (firstSource == 0 || !firstSource->isCorrect())
+	{
+		writer.getLastErrorRef() = "Static batching error: incorrect source geometry";
+		return result;
+	}
+
+	unsigned int componentsMask = 0;
+	std::vector<char> isUsed(sources.size(), 0);
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		size_t s = instances[i].sourceIndex;
+		if (s >= sources.size() || sources[s] == 0 || !sources[s]->isCorrect())
+		{
+			writer.getLastErrorRef() = "Static batching error: incorrect source geometry";
+			return result;
+		}
+		if (sources[s]->getAdditionalUVsCount() != firstSource->getAdditionalUVsCount())
+		{
+			writer.getLastErrorRef() = "Static batching error: sources have different numbers of texture coordinates";
+			return result;
+		}
+		componentsMask |= sources[s]->getVertexComponentsMask();
+		isUsed[s] = 1;
+	}
+
+	// sources are transformed in the full format with the common set of components
+	std::vector<Data> converted(sources.size());
+	utils::Parallel::forRange(sources.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t s = begin; s < end; s++)
+		{
+			if (isUsed[s]) converted[s] = VertexFormatConverter::convert(*sources[s], Data::VERTEX_FORMAT_FULL, componentsMask);
+		}
+	});
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, firstSource->getAdditionalUVsCount(), componentsMask);
+	size_t vertexSize = result.getVertexSize();
+
+	std::vector<size_t> firstVertices(instances.size() + 1, 0);
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		firstVertices[i + 1] = firstVertices[i] + converted[instances[i].sourceIndex].getVerticesCount();
+	}
+	if (firstVertices.back() > 0xffffffff)
+	{
+		writer.getLastErrorRef() = "Static batching error: too many vertices for 32-bit indices";
+		return result;
+	}
+
+	// meshes are grouped by materials in the order of their first appearance
+	std::map<std::tuple<std::string, std::string, std::string>, size_t> groupIndices;
+	std::vector<Data::Material> groupMaterials;
+	std::vector<size_t> groupSizes;
+	std::vector<std::vector<size_t> > meshGroups(sources.size());
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		size_t s = instances[i].sourceIndex;
+		const Data::Meshes& meshes = converted[s].getMeshes();
+		if (meshGroups[s].size() != meshes.size())
+		{
+			meshGroups[s].resize(meshes.size());
+			for (size_t m = 0; m < meshes.size(); m++)
+			{
+				const Data::Material& material = meshes[m].material;
+				auto key = std::make_tuple(material.diffuseMapFilename, material.normalMapFilename, material.specularMapFilename);
+				auto it = groupIndices.find(key);
+				if (it == groupIndices.end())
+				{
+					it = groupIndices.insert(std::make_pair(key, groupMaterials.size())).first;
+					groupMaterials.push_back(material);
+					groupSizes.push_back(0);
+				}
+				meshGroups[s][m] = it->second;
+			}
+		}
+		for (size_t m = 0; m < meshes.size(); m++) groupSizes[meshGroups[s][m]] += meshes[m].indicesCount;
+	}
+
+	std::vector<size_t> groupCursors(groupMaterials.size(), 0);
+	size_t indicesCount = 0;
+	for (size_t g = 0; g < groupMaterials.size(); g++)
+	{
+		Data::Mesh mesh;
+		mesh.offsetInIB = indicesCount;
+		mesh.indicesCount = groupSizes[g];
+		mesh.material = groupMaterials[g];
+		writer.getMeshesRef().push_back(mesh);
+		groupCursors[g] = indicesCount;
+		indicesCount += groupSizes[g];
+	}
+
+	// destinations of meshes of instances in the index buffer
+	std::vector<size_t> firstMeshes(instances.size() + 1, 0);
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		firstMeshes[i + 1] = firstMeshes[i] + converted[instances[i].sourceIndex].getMeshes().size();
+	}
+	std::vector<size_t> destinations(firstMeshes.back());
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		size_t s = instances[i].sourceIndex;
+		const Data::Meshes& meshes = converted[s].getMeshes();
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			destinations[firstMeshes[i] + m] = groupCursors[meshGroups[s][m]];
+			groupCursors[meshGroups[s][m]] += meshes[m].indicesCount;
+		}
+	}
+
+	int positionComponent = result.findVertexComponent(Data::SEMANTIC_POSITION);
+	int normalComponent = result.findVertexComponent(Data::SEMANTIC_NORMAL);
+	int tangentComponent = result.findVertexComponent(Data::SEMANTIC_TANGENT);
+	int binormalComponent = result.findVertexComponent(Data::SEMANTIC_BINORMAL);
+	size_t positionOffset = result.getVertexComponentOffset(positionComponent);
+
+	writer.getVerticesCountRef() = firstVertices.back();
+	writer.getVertexBufferRef().resize(firstVertices.back() * vertexSize);
+	writer.getIndexBufferRef().resize(indicesCount);
+	std::vector<bbox3> boxes(instances.size());
+	utils::Parallel::forRange(instances.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Data& source = converted[instances[i].sourceIndex];
+			const matrix44& transform = instances[i].transform;
+			matrix44 inverse = transform;
+			inverse.invert();
+			vector3 xAxis = transformDirection(transform, vector3(1, 0, 0));
+			vector3 yAxis = transformDirection(transform, vector3(0, 1, 0));
+			vector3 zAxis = transformDirection(transform, vector3(0, 0, 1));
+			bool isMirrored = ((xAxis * yAxis) % zAxis) < 0.0f;
+
+			unsigned char* vertices = writer.getVertexBufferRef().data() + firstVertices[i] * vertexSize;
+			memcpy(vertices, source.getVertexData(), source.getVerticesCount() * vertexSize);
+			boxes[i].begin_extend();
+			for (size_t v = 0; v < source.getVerticesCount(); v++)
+			{
+				unsigned char* vertex = vertices + v * vertexSize;
+				vector3 position;
+				memcpy(&position.x, vertex + positionOffset, sizeof(vector3));
+				position = transform.transform_coord(position);
+				memcpy(vertex + positionOffset, &position.x, sizeof(vector3));
+				boxes[i].extend(position);
+
+				float* normal = normalComponent >= 0 ? (float*)(vertex + result.getVertexComponentOffset(normalComponent)) : 0;
+				if (normal != 0) transformUnitVector(normal, transformNormal(inverse, vector3(normal[0], normal[1], normal[2])));
+				float* tangent = tangentComponent >= 0 ? (float*)(vertex + result.getVertexComponentOffset(tangentComponent)) : 0;
+				if (tangent != 0) transformUnitVector(tangent, transformDirection(transform, vector3(tangent[0], tangent[1], tangent[2])));
+				float* binormal = binormalComponent >= 0 ? (float*)(vertex + result.getVertexComponentOffset(binormalComponent)) : 0;
+				if (binormal != 0) transformUnitVector(binormal, transformDirection(transform, vector3(binormal[0], binormal[1], binormal[2])));
+			}
+			boxes[i].end_extend();
+
+			const unsigned int* sourceIndices = source.getIndexData();
+			unsigned int* indices = writer.getIndexBufferRef().data();
+			unsigned int firstVertex = (unsigned int)firstVertices[i];
+			const Data::Meshes& meshes = source.getMeshes();
+			for (size_t m = 0; m < meshes.size(); m++)
+			{
+				unsigned int* destination = indices + destinations[firstMeshes[i] + m];
+				const unsigned int* meshIndices = sourceIndices + meshes[m].offsetInIB;
+				for (size_t k = 0; k < meshes[m].indicesCount; k++) destination[k] = meshIndices[k] + firstVertex;
+				for (size_t k = 0; isMirrored && k + 2 < meshes[m].indicesCount; k += 3) std::swap(destination[k + 1], destination[k + 2]);
+			}
+		}
+	});
+
+	writer.getBoundingBoxRef().begin_extend();
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		if (converted[instances[i].sourceIndex].getVerticesCount() != 0) writer.getBoundingBoxRef().extend(boxes[i]);
+	}
+	writer.getBoundingBoxRef().end_extend();
+	BoundsCalculator::calculate(writer);
+
+	if (firstSource->getVertexFormat() != Data::VERTEX_FORMAT_FULL)
+	{
+		return VertexFormatConverter::convert(result, firstSource->getVertexFormat(), componentsMask);
+	}
+	return result;
+}
+
+}
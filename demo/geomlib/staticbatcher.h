@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef __STATIC_BATCHER_H__
+#define __STATIC_BATCHER_H__
+
+namespace geom
+{
+
+struct BatchInstance
+{
+	// index of the source geometry
+	size_t sourceIndex;
+	// world transform (row vectors, translation in M41-M43)
+	matrix44 transform;
+
+	BatchInstance() : sourceIndex(0) {}
+	BatchInstance(size_t sourceIndex, const matrix44& transform) : sourceIndex(sourceIndex), transform(transform) {}
+};
+
+class StaticBatcher
+{
+public:
+	// Pre-transforms vertices of instances of the source geometries and merges meshes with 
+	// equal materials, so every material is rendered by one draw call. Indices are rebased
+	// into the common 32-bit index buffer, triangles of mirroring transforms are flipped.
+	// Vertices keep the format of the first source and the union of components of all sources.
+	// LODs and clusters are not merged, they have to be regenerated for the result.
+	static Data merge(const std::vector<const Data*>& sources, const std::vector<BatchInstance>& instances);
+};
+
+}
+
+#endif
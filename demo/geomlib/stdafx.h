@@ -29,20 +29,47 @@
 #include <memory>
 #include <string>
 #include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <limits>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <tuple>
 
 #include "vector.h"
 #include "bbox.h"
 
 #include "utils.h"
+#include "memorymappedfile.h"
+#include "archive.h"
+#include "parallel.h"
+#include "threadpool.h"
 
 #include "geomformat.h"
 #include "data.h"
+#include "datawriter.h"
 
 #include "geometrysaver.h"
 #include "geometryloader.h"
 
 #include "geomsaver.h"
 #include "geomloader.h"
+#include "vertexformat.h"
+#include "meshoptimizer.h"
+#include "meshsimplifier.h"
+#include "clusterbuilder.h"
+#include "bvh.h"
+#include "boundscalculator.h"
+#include "blockcompressor.h"
+#include "tangentframecalculator.h"
+#include "textparser.h"
+#include "meshbuilder.h"
+#include "objloader.h"
+#include "plyloader.h"
+#include "staticbatcher.h"
 #ifdef _USE_FBX
 #include <fbxsdk.h>
 #include "fbxloader.h"
@@ -51,6 +78,8 @@
 #include "geometrygenerator.h"
 #include "planegenerator.h"
 #include "terraingenerator.h"
+#include "heightfield.h"
+#include "terraintilegenerator.h"
 
 #include "geometry.h"
 
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "stdafx.h"
+#include "tangentframecalculator.h"
+
+namespace geom
+{
+
+namespace
+{
+	const size_t MIN_TRIANGLES_PER_RANGE = 4096;
+	const size_t MIN_VERTICES_PER_RANGE = 4096;
+
+	const unsigned int NOT_SPLIT = std::numeric_limits<unsigned int>::max();
+
+	// contribution of a triangle to a vertex
+	struct Corner
+	{
+		vector3 tangent;
+		// the angle of the triangle
+		float weight;
+		// orientation of texture coordinates: 1, -1 for mirrored triangles, 0 for degenerate ones
+		float orientation;
+	};
+
+	vector3 projectOnPlane(const vector3& v, const vector3& normal)
+	{
+		vector3 result = v - normal * (normal % v);
+		float length = result.len();
+		return length > 0.0f ? result * (1.0f / length) : vector3(0.0f, 0.0f, 0.0f);
+	}
+}
+
+Data TangentFrameCalculator::calculate(const Data& data)
+{
+	unsigned int requiredMask = Data::COMPONENTS_NORMAL | Data::COMPONENTS_TEXCOORD0;
+	if (!data.isCorrect() || (data.getVertexComponentsMask() & requiredMask) != requiredMask)
+	{
+		Data result;
+		DataWriter(&result).getLastErrorRef() = "Tangent frames calculation requires normals and texture coordinates";
+		return result;
+	}
+
+	unsigned int componentsMask = data.getVertexComponentsMask() | Data::COMPONENTS_TANGENT_FRAME;
+	Data result = VertexFormatConverter::convert(data, Data::VERTEX_FORMAT_FULL, componentsMask);
+	DataWriter writer(&result);
+
+	// conversion returns the source itself if it is in the full format already, mapped data is copied
+	if (result.isMapped())
+	{
+		writer.getVertexBufferRef().assign(data.getVertexData(), data.getVertexData() + data.getVertexDataSize());
+		writer.getIndexBufferRef().assign(data.getIndexData(), data.getIndexData() + data.getIndicesCount());
+		result.releaseMapping();
+	}
+
+	calculate(writer);
+	if (data.getVertexFormat() != Data::VERTEX_FORMAT_FULL)
+	{
+		return VertexFormatConverter::convert(result, data.getVertexFormat(), componentsMask);
+	}
+	return result;
+}
+
+bool TangentFrameCalculator::calculate(DataWriter& writer)
+{
+	std::vector<size_t> meshes(writer.getData().getMeshes().size());
+	for (size_t m = 0; m < meshes.size(); m++) meshes[m] = m;
+	return calculate(writer, meshes);
+}
+
+bool TangentFrameCalculator::calculate(DataWriter& writer, const std::vector<size_t>& meshes)
+{
+	const Data& data = writer.getData();
+	int positionComponent = data.findVertexComponent(Data::SEMANTIC_POSITION);
+	int normalComponent = data.findVertexComponent(Data::SEMANTIC_NORMAL);
+	int uvComponent = data.findVertexComponent(Data::SEMANTIC_TEXCOORD);
+	int tangentComponent = data.findVertexComponent(Data::SEMANTIC_TANGENT);
+	int binormalComponent = data.findVertexComponent(Data::SEMANTIC_BINORMAL);
+	if (!data.isCorrect() || data.isMapped() || data.getVertexFormat() != Data::VERTEX_FORMAT_FULL || 
+		normalComponent < 0 || uvComponent < 0 || tangentComponent < 0 || binormalComponent < 0)
+	{
+		return false;
+	}
+
+	size_t vertexSize = data.getVertexSize();
+	size_t positionOffset = data.getVertexComponentOffset(positionComponent);
+	size_t normalOffset = data.getVertexComponentOffset(normalComponent);
+	size_t uvOffset = data.getVertexComponentOffset(uvComponent);
+	size_t tangentOffset = data.getVertexComponentOffset(tangentComponent);
+	size_t binormalOffset = data.getVertexComponentOffset(binormalComponent);
+	unsigned char* vertices = writer.getVertexBufferRef().data();
+	unsigned int* indices = writer.getIndexBufferRef().data();
+	size_t verticesCount = data.getVerticesCount();
+
+	// triangles of the meshes
+	std::vector<size_t> firstCorners(meshes.size() + 1, 0);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i] >= data.getMeshes().size()) return false;
+		firstCorners[i + 1] = firstCorners[i] + data.getMeshes()[meshes[i]].indicesCount / 3 * 3;
+	}
+	std::vector<unsigned int*> meshIndices(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++) meshIndices[i] = indices + data.getMeshes()[meshes[i]].offsetInIB;
+	size_t cornersCount = firstCorners.back();
+	size_t trianglesCount = cornersCount / 3;
+	auto getIndex = [&](size_t corner, size_t& mesh) -> unsigned int&
+	{
+		while (corner >= firstCorners[mesh + 1]) mesh++;
+		return meshIndices[mesh][corner - firstCorners[mesh]];
+	};
+
+	#define VERTEX_VECTOR3(index, offset) (*reinterpret_cast<const vector3*>(vertices + (size_t)(index) * vertexSize + (offset)))
+	#define VERTEX_VECTOR2(index, offset) (*reinterpret_cast<const vector2*>(vertices + (size_t)(index) * vertexSize + (offset)))
+
+	// uv edges of a triangle and the orientation of texture coordinates (see Corner)
+	auto getOrientation = [&](const unsigned int* index, vector2& t1, vector2& t2) -> float
+	{
+		const vector2& uv0 = VERTEX_VECTOR2(index[0], uvOffset);
+		t1 = VERTEX_VECTOR2(index[1], uvOffset) - uv0;
+		t2 = VERTEX_VECTOR2(index[2], uvOffset) - uv0;
+		float signedArea = t1.x * t2.y - t1.y * t2.x;
+		return signedArea > 0.0f ? 1.0f : (signedArea < 0.0f ? -1.0f : 0.0f);
+	};
+
+	// contributions of triangles to their vertices
+	std::vector<Corner> corners(cornersCount);
+	std::vector<unsigned int> cornerVertices(cornersCount);
+	utils::Parallel::forRange(trianglesCount, [&](size_t begin, size_t end, size_t)
+	{
+		size_t mesh = 0;
+		for (size_t t = begin; t < end; t++)
+		{
+			unsigned int index[3];
+			for (size_t k = 0; k < 3; k++)
+			{
+				index[k] = getIndex(t * 3 + k, mesh);
+				cornerVertices[t * 3 + k] = index[k];
+			}
+			Corner* triangleCorners = &corners[t * 3];
+			for (size_t k = 0; k < 3; k++) triangleCorners[k].weight = triangleCorners[k].orientation = 0.0f;
+			if (index[0] >= verticesCount || index[1] >= verticesCount || index[2] >= verticesCount) continue;
+
+			const vector3& p0 = VERTEX_VECTOR3(index[0], positionOffset);
+			vector3 d1 = VERTEX_VECTOR3(index[1], positionOffset) - p0;
+			vector3 d2 = VERTEX_VECTOR3(index[2], positionOffset) - p0;
+			vector2 t1, t2;
+			float orientation = getOrientation(index, t1, t2);
+			vector3 tangent = d1 * t2.y - d2 * t1.y;
+			float tangentLength = tangent.len();
+			if (orientation == 0.0f || tangentLength == 0.0f) continue;
+			tangent *= (orientation / tangentLength);
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				const vector3& normal = VERTEX_VECTOR3(index[k], normalOffset);
+				const vector3& position = VERTEX_VECTOR3(index[k], positionOffset);
+				vector3 edge1 = projectOnPlane(VERTEX_VECTOR3(index[(k + 1) % 3], positionOffset) - position, normal);
+				vector3 edge2 = projectOnPlane(VERTEX_VECTOR3(index[(k + 2) % 3], positionOffset) - position, normal);
+				float cosAngle = edge1 % edge2;
+				cosAngle = cosAngle > 1.0f ? 1.0f : (cosAngle < -1.0f ? -1.0f : cosAngle);
+
+				triangleCorners[k].tangent = projectOnPlane(tangent, normal);
+				triangleCorners[k].weight = acosf(cosAngle);
+				triangleCorners[k].orientation = orientation;
+			}
+		}
+	}, MIN_TRIANGLES_PER_RANGE);
+
+	// corners of every vertex in the order of triangles, so sums don't depend on threads
+	std::vector<unsigned int> firstVertexCorners(verticesCount + 1, 0);
+	for (size_t c = 0; c < cornersCount; c++)
+	{
+		if (cornerVertices[c] < verticesCount) firstVertexCorners[cornerVertices[c] + 1]++;
+	}
+	for (size_t v = 0; v < verticesCount; v++) firstVertexCorners[v + 1] += firstVertexCorners[v];
+	std::vector<unsigned int> vertexCorners(firstVertexCorners.back());
+	{
+		std::vector<unsigned int> cursors(firstVertexCorners.begin(), firstVertexCorners.end() - 1);
+		for (size_t c = 0; c < cornersCount; c++)
+		{
+			if (cornerVertices[c] < verticesCount) vertexCorners[cursors[cornerVertices[c]]++] = (unsigned int)c;
+		}
+	}
+	std::vector<unsigned int>().swap(cornerVertices);
+
+	// vertices shared by triangles of both orientations are split, mirrored triangles get copies
+	// which are appended in the order of vertices, so the result doesn't depend on threads
+	std::vector<unsigned int> splitVertices(verticesCount, NOT_SPLIT);
+	utils::Parallel::forRange(verticesCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			bool hasDirect = false, hasMirrored = false;
+			for (unsigned int c = firstVertexCorners[v]; c < firstVertexCorners[v + 1]; c++)
+			{
+				float orientation = corners[vertexCorners[c]].orientation;
+				hasDirect = hasDirect || orientation > 0.0f;
+				hasMirrored = hasMirrored || orientation < 0.0f;
+			}
+			if (hasDirect && hasMirrored) splitVertices[v] = 0;
+		}
+	}, MIN_VERTICES_PER_RANGE);
+	size_t newVerticesCount = verticesCount;
+	for (size_t v = 0; v < verticesCount; v++)
+	{
+		if (splitVertices[v] != NOT_SPLIT) splitVertices[v] = (unsigned int)newVerticesCount++;
+	}
+	if (newVerticesCount != verticesCount)
+	{
+		writer.getVertexBufferRef().resize(newVerticesCount * vertexSize);
+		writer.getVerticesCountRef() = newVerticesCount;
+		vertices = writer.getVertexBufferRef().data();
+		for (size_t v = 0; v < verticesCount; v++)
+		{
+			if (splitVertices[v] != NOT_SPLIT) memcpy(vertices + splitVertices[v] * vertexSize, vertices + v * vertexSize, vertexSize);
+		}
+
+		utils::Parallel::forRange(trianglesCount, [&](size_t begin, size_t end, size_t)
+		{
+			size_t mesh = 0;
+			for (size_t c = begin * 3; c < end * 3; c++)
+			{
+				unsigned int& index = getIndex(c, mesh);
+				if (corners[c].orientation < 0.0f && splitVertices[index] != NOT_SPLIT) index = splitVertices[index];
+			}
+		}, MIN_TRIANGLES_PER_RANGE);
+
+		// LODs follow the orientations of their own triangles
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const Data::Lods& lods = data.getMeshes()[meshes[i]].lods;
+			for (size_t lod = 0; lod < lods.size(); lod++)
+			{
+				unsigned int* lodIndices = indices + lods[lod].offsetInIB;
+				for (size_t t = 0; t + 2 < lods[lod].indicesCount; t += 3)
+				{
+					unsigned int* index = lodIndices + t;
+					vector2 t1, t2;
+					if (index[0] >= verticesCount || index[1] >= verticesCount || index[2] >= verticesCount || 
+						getOrientation(index, t1, t2) >= 0.0f) continue;
+					for (size_t k = 0; k < 3; k++)
+					{
+						if (splitVertices[index[k]] != NOT_SPLIT) index[k] = splitVertices[index[k]];
+					}
+				}
+			}
+		}
+	}
+
+	#undef VERTEX_VECTOR3
+	#undef VERTEX_VECTOR2
+
+	utils::Parallel::forRange(verticesCount, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			unsigned int first = firstVertexCorners[v], last = firstVertexCorners[v + 1];
+			if (first == last) continue;
+
+			vector3 tangents[2] = { vector3(0, 0, 0), vector3(0, 0, 0) };
+			float weights[2] = { 0.0f, 0.0f };
+			for (unsigned int c = first; c < last; c++)
+			{
+				const Corner& corner = corners[vertexCorners[c]];
+				size_t group = corner.orientation < 0.0f ? 1 : 0;
+				tangents[group] += corner.tangent * corner.weight;
+				weights[group] += corner.weight;
+			}
+
+			// a vertex which is not split takes the frame of its only orientation
+			size_t groups[2] = { weights[1] > weights[0] ? 1u : 0u, 1 };
+			size_t outputVertices[2] = { v, splitVertices[v] };
+			size_t outputsCount = splitVertices[v] != NOT_SPLIT ? 2 : 1;
+			if (outputsCount == 2) groups[0] = 0;
+			for (size_t i = 0; i < outputsCount; i++)
+			{
+				unsigned char* vertex = vertices + outputVertices[i] * vertexSize;
+				const vector3& normal = *reinterpret_cast<const vector3*>(vertex + normalOffset);
+				vector3 tangent = projectOnPlane(tangents[groups[i]], normal);
+				if (tangent.lensquared() == 0.0f) tangent = projectOnPlane(normal.findortho(), normal);
+				vector3 binormal = (normal * tangent) * (groups[i] == 0 ? 1.0f : -1.0f);
+				memcpy(vertex + tangentOffset, &tangent.x, sizeof(vector3));
+				memcpy(vertex + binormalOffset, &binormal.x, sizeof(vector3));
+			}
+		}
+	}, MIN_VERTICES_PER_RANGE);
+
+	return true;
+}
+
+}
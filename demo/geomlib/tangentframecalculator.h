@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef __TANGENT_FRAME_CALCULATOR_H__
+#define __TANGENT_FRAME_CALCULATOR_H__
+
+namespace geom
+{
+
+// Calculates tangents and binormals following MikkTSpace: tangents of triangles (dP/du) are 
+// projected onto the tangent planes of vertices and weighted by angles of triangles at vertices,
+// the sign of binormal = sign * cross(normal, tangent) is given by the orientation of texture 
+// coordinates. Vertices shared by triangles of both orientations are split, copies for mirrored triangles
+// are appended to the vertex buffer and indices of the meshes (and their LODs) are remapped. Triangles and
+// vertices are processed on several threads, the result doesn't depend on the number of threads.
+class TangentFrameCalculator
+{
+public:
+	// Returns data with the same vertex format and the tangent frame, normals and 
+	// texture coordinates are required.
+	static Data calculate(const Data& data);
+	// In-place calculation for VERTEX_FORMAT_FULL with normals, texture coordinates and the tangent frame,
+	// only vertices of the meshes are changed (split vertices are appended). Returns false if data doesn't meet the requirements.
+	static bool calculate(DataWriter& writer);
+	static bool calculate(DataWriter& writer, const std::vector<size_t>& meshes);
+};
+
+}
+
+#endif
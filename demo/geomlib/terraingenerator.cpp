@@ -27,6 +27,8 @@
 namespace geom
 {
 
+const size_t MIN_ROWS_PER_THREAD = 64;
+
 void TerrainGenerator::setTerrainGenerationInfo(const TerrainGenerationInfo& info)
 {
 	m_info = info;
@@ -37,13 +39,39 @@ Data TerrainGenerator::generate()
 	Data data;
 	DataWriter writer(&data);
 
-	m_terrainWidth = (m_info.heightmapWidth % 2 == 0) ? m_info.heightmapWidth : m_info.heightmapWidth - 1;
-	m_terrainHeight = (m_info.heightmapHeight % 2 == 0) ? m_info.heightmapHeight : m_info.heightmapHeight - 1;
-	if (m_terrainWidth < 2 || m_terrainHeight < 2)
+	m_chunks = TerrainChunks();
+	if (m_info.heightmap.size() < m_info.heightmapWidth * m_info.heightmapHeight * getHeightmapSampleSize(m_info.heightmapFormat))
 	{
-		writer.getLastErrorRef() = "Heightmap size must be more than 2x2";
+		writer.getLastErrorRef() = "Heightmap data is smaller than the size of the heightmap";
 		return data;
 	}
+	if (m_info.chunkSize != 0)
+	{
+		if ((m_info.chunkSize & (m_info.chunkSize - 1)) != 0)
+		{
+			writer.getLastErrorRef() = "Size of a terrain chunk must be a power of two";
+			return data;
+		}
+		if (m_info.heightmapWidth <= m_info.chunkSize || m_info.heightmapHeight <= m_info.chunkSize)
+		{
+			writer.getLastErrorRef() = "Heightmap size must be more than size of a terrain chunk";
+			return data;
+		}
+		m_chunks.m_chunksX = (m_info.heightmapWidth - 1) / m_info.chunkSize;
+		m_chunks.m_chunksY = (m_info.heightmapHeight - 1) / m_info.chunkSize;
+		m_terrainWidth = (int)(m_chunks.m_chunksX * m_info.chunkSize + 1);
+		m_terrainHeight = (int)(m_chunks.m_chunksY * m_info.chunkSize + 1);
+	}
+	else
+	{
+		m_terrainWidth = (m_info.heightmapWidth % 2 == 0) ? m_info.heightmapWidth : m_info.heightmapWidth - 1;
+		m_terrainHeight = (m_info.heightmapHeight % 2 == 0) ? m_info.heightmapHeight : m_info.heightmapHeight - 1;
+		if (m_terrainWidth < 2 || m_terrainHeight < 2)
+		{
+			writer.getLastErrorRef() = "Heightmap size must be more than 2x2";
+			return data;
+		}
+	}
 
 	int verticesCount = m_terrainWidth * m_terrainHeight;
 
@@ -52,107 +80,336 @@ Data TerrainGenerator::generate()
 	writer.getMeshesRef()[0].indicesCount = (m_terrainWidth - 1)* (m_terrainHeight - 1) * 6;
 
 	writer.getVerticesCountRef() = verticesCount;
-	writer.getAdditionalUVsCountRef() = 0;
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, 0);
 	writer.getBoundingBoxRef().vmin = vector3(-0.5f * m_info.size.x, -0.5f * m_info.size.z, -0.5f * m_info.size.y);
 	writer.getBoundingBoxRef().vmax = vector3(0.5f * m_info.size.x, 0.5f * m_info.size.z, 0.5f * m_info.size.y);
 
 	writer.getVertexBufferRef().resize(verticesCount * sizeof(Data::Vertex));
+	Data::Vertex* vertices = reinterpret_cast<Data::Vertex*>(writer.getVertexBufferRef().data());
 	
-	for (int y = 0; y < m_terrainHeight; y++)
+	// positions must be ready for all rows before tangent space calculation
+	utils::Parallel::forRange((size_t)m_terrainHeight, [this, vertices](size_t begin, size_t end, size_t)
 	{
-		for (int x = 0; x < m_terrainWidth; x++)
+		for (int y = (int)begin; y < (int)end; y++)
 		{
-			int i = y * m_terrainWidth + x;
-			Data::Vertex* vertex = reinterpret_cast<Data::Vertex*>(writer.getVertexBufferRef().data() + i * sizeof(Data::Vertex));
-			vertex->position = getPoint(x, y);
-			calculateTangentSpace(x, y, vertex->normal, vertex->tangent, vertex->binormal);
-			vertex->texCoord0 = vector2(float(x) * m_info.uvSize.x / float(m_terrainWidth - 1), float(y) * m_info.uvSize.y / float(m_terrainHeight - 1));
+			for (int x = 0; x < m_terrainWidth; x++)
+			{
+				calculateVertex(m_info.size, m_info.uvSize, m_terrainWidth, m_terrainHeight, x, y, 
+								m_info.getSample(x, y), vertices[y * m_terrainWidth + x]);
+			}
 		}
-	}
+	}, MIN_ROWS_PER_THREAD);
 
-	writer.getIndexBufferRef().resize(writer.getMeshesRef()[0].indicesCount);
-	unsigned int currentIndex = 0;
-	for (int y = 0; y < m_terrainHeight - 1; y++)
+	utils::Parallel::forRange((size_t)m_terrainHeight, [this, vertices](size_t begin, size_t end, size_t)
 	{
-		unsigned int offset = (unsigned int)y * (unsigned int)m_terrainWidth;
-		for (int x = 0; x < m_terrainWidth - 1; x++)
+		std::vector<vector3> edgesBuffer(m_terrainWidth * 3);
+		for (int y = (int)begin; y < (int)end; y++)
 		{
-			writer.getIndexBufferRef()[currentIndex++] = offset + (unsigned int)x;
-			writer.getIndexBufferRef()[currentIndex++] = offset + (unsigned int)(x + m_terrainWidth);
-			writer.getIndexBufferRef()[currentIndex++] = offset + (unsigned int)(x + m_terrainWidth + 1);
-			writer.getIndexBufferRef()[currentIndex++] = offset + (unsigned int)(x + m_terrainWidth + 1);
-			writer.getIndexBufferRef()[currentIndex++] = offset + (unsigned int)(x + 1);
-			writer.getIndexBufferRef()[currentIndex++] = offset + (unsigned int)x;
+			calculateTangentSpace(vertices, m_terrainWidth, m_terrainHeight, y, edgesBuffer.data());
 		}
+	}, MIN_ROWS_PER_THREAD);
+
+	writer.getIndexBufferRef().resize(writer.getMeshesRef()[0].indicesCount);
+	unsigned int* indices = writer.getIndexBufferRef().data();
+	utils::Parallel::forRange((size_t)(m_terrainHeight - 1), [this, indices](size_t begin, size_t end, size_t)
+	{
+		calculateIndices(m_terrainWidth, (int)begin, (int)end, indices + begin * (m_terrainWidth - 1) * 6);
+	}, MIN_ROWS_PER_THREAD);
+
+	if (m_info.chunkSize != 0)
+	{
+		generateChunks(writer);
 	}
 
 	return data;
 }
 
-vector3 TerrainGenerator::getPoint(int x, int y)
+void TerrainGenerator::generateChunks(DataWriter& writer)
 {
-	vector3 pnt;
-	pnt.x = m_info.size.x * (float(x) / float(m_terrainWidth - 1) - 0.5f);
-	pnt.z = m_info.size.y * (float(y) / float(m_terrainHeight - 1) - 0.5f);
+	const size_t chunkSize = m_info.chunkSize;
+	m_chunks.m_lodsCount = 1;
+	while ((chunkSize >> (m_chunks.m_lodsCount - 1)) > 1) m_chunks.m_lodsCount++;
+
+	std::vector<unsigned int>& indexBuffer = m_chunks.m_indices;
+	m_chunks.m_patterns.resize(m_chunks.m_lodsCount * TerrainChunks::STITCH_VARIANTS_COUNT);
+	std::vector<unsigned int> pattern;
+	for (size_t lod = 0; lod < m_chunks.m_lodsCount; lod++)
+	{
+		for (int sides = 0; sides < TerrainChunks::STITCH_VARIANTS_COUNT; sides++)
+		{
+			pattern.clear();
+			generateChunkPattern((int)lod, sides, pattern);
+			Data::Lod& p = m_chunks.m_patterns[lod * TerrainChunks::STITCH_VARIANTS_COUNT + sides];
+			p.offsetInIB = indexBuffer.size();
+			p.indicesCount = pattern.size();
+			indexBuffer.insert(indexBuffer.end(), pattern.begin(), pattern.end());
+		}
+	}
+
+	m_chunks.m_chunks.resize(m_chunks.m_chunksX * m_chunks.m_chunksY);
+	const Data::Vertex* vertices = reinterpret_cast<const Data::Vertex*>(writer.getVertexBufferRef().data());
+	utils::Parallel::forRange(m_chunks.m_chunks.size(), [this, vertices, chunkSize](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			TerrainChunk& chunk = m_chunks.m_chunks[i];
+			size_t cx = i % m_chunks.m_chunksX;
+			size_t cy = i / m_chunks.m_chunksX;
+			chunk.baseVertex = cy * chunkSize * m_terrainWidth + cx * chunkSize;
 
-	int index = y * m_info.heightmapWidth + x;
-	int h = m_info.heightmap[index];
-	pnt.y = m_info.size.z * (float(h) / 255.0f - 0.5f);
+			chunk.boundingBox.begin_extend();
+			for (size_t y = 0; y <= chunkSize; y++)
+			{
+				for (size_t x = 0; x <= chunkSize; x++)
+				{
+					chunk.boundingBox.extend(vertices[chunk.baseVertex + y * m_terrainWidth + x].position);
+				}
+			}
 
-	return pnt;
+			// coarser LODs can't be more precise than finer ones
+			chunk.lodErrors.resize(m_chunks.m_lodsCount);
+			chunk.lodErrors[0] = 0.0f;
+			for (size_t lod = 1; lod < m_chunks.m_lodsCount; lod++)
+			{
+				chunk.lodErrors[lod] = std::max(chunk.lodErrors[lod - 1], calculateChunkError(vertices, chunk.baseVertex, (int)lod));
+			}
+		}
+	});
 }
 
-void TerrainGenerator::calculateTangentSpace(int x, int y, vector3& normal, vector3& tangent, vector3& binormal)
+void TerrainGenerator::generateChunkPattern(int lod, int stitchSides, std::vector<unsigned int>& indices) const
 {
-	vector3 center = getPoint(x, y);
+	// vertices of a stitched side which are absent in the coarser neighbour
+	// are moved to the previous vertex, degenerate triangles are skipped
+	const int chunkSize = (int)m_info.chunkSize;
+	const int step = 1 << lod;
+	auto snap = [step](int c) { return ((c / step) % 2 != 0) ? c - step : c; };
+	auto index = [&](int x, int y)
+	{
+		if ((stitchSides & TerrainChunks::STITCH_LEFT) != 0 && x == 0) y = snap(y);
+		if ((stitchSides & TerrainChunks::STITCH_RIGHT) != 0 && x == chunkSize) y = snap(y);
+		if ((stitchSides & TerrainChunks::STITCH_TOP) != 0 && y == 0) x = snap(x);
+		if ((stitchSides & TerrainChunks::STITCH_BOTTOM) != 0 && y == chunkSize) x = snap(x);
+		return (unsigned int)(y * m_terrainWidth + x);
+	};
+	auto addTriangle = [&indices](unsigned int i1, unsigned int i2, unsigned int i3)
+	{
+		if (i1 == i2 || i2 == i3 || i1 == i3) return;
+		indices.push_back(i1);
+		indices.push_back(i2);
+		indices.push_back(i3);
+	};
 
-	if (x + 1 < m_terrainWidth)
+	for (int y = 0; y < chunkSize; y += step)
 	{
-		if (y + 1 < m_terrainHeight)
+		for (int x = 0; x < chunkSize; x += step)
 		{
-			vector3 a = getPoint(x, y + 1) - center;
-			a.norm();
-			tangent += a;
-			vector3 b = getPoint(x + 1, y) - center;
-			b.norm();
-			normal += (a * b);
+			addTriangle(index(x, y), index(x, y + step), index(x + step, y + step));
+			addTriangle(index(x + step, y + step), index(x + step, y), index(x, y));
 		}
-		if (y - 1 >= 0)
+	}
+}
+
+float TerrainGenerator::calculateChunkError(const Data::Vertex* vertices, size_t baseVertex, int lod) const
+{
+	const int chunkSize = (int)m_info.chunkSize;
+	const int step = 1 << lod;
+	auto height = [&](int x, int y) { return vertices[baseVertex + y * m_terrainWidth + x].position.y; };
+
+	float error = 0.0f;
+	for (int y = 0; y < chunkSize; y += step)
+	{
+		for (int x = 0; x < chunkSize; x += step)
 		{
-			vector3 a = getPoint(x + 1, y) - center;
-			a.norm();
-			vector3 b = getPoint(x, y - 1) - center;
-			b.norm();
-			tangent -= b;
-			normal += (a * b);
+			float h00 = height(x, y);
+			float h10 = height(x + step, y);
+			float h01 = height(x, y + step);
+			float h11 = height(x + step, y + step);
+			for (int dy = 0; dy <= step; dy++)
+			{
+				for (int dx = 0; dx <= step; dx++)
+				{
+					// the cell is split by the diagonal (x, y) - (x + step, y + step)
+					float fx = float(dx) / float(step);
+					float fy = float(dy) / float(step);
+					float h = (fy >= fx) ? h00 + fy * (h01 - h00) + fx * (h11 - h01) :
+										   h00 + fx * (h10 - h00) + fy * (h11 - h10);
+					float deviation = height(x + dx, y + dy) - h;
+					error = std::max(error, n_abs(deviation));
+				}
+			}
 		}
 	}
-	if (x - 1 >= 0)
+	return error;
+}
+
+void TerrainChunks::select(const vector3& cameraPosition, const matrix44& viewProjection, float pixelsPerUnit, float maxPixelError,
+						   std::vector<TerrainDrawCall>& drawCalls) const
+{
+	drawCalls.clear();
+	if (m_chunks.empty()) return;
+
+	std::vector<int> lods(m_chunks.size());
+	for (size_t i = 0; i < m_chunks.size(); i++)
 	{
-		if (y + 1 < m_terrainHeight)
+		const TerrainChunk& chunk = m_chunks[i];
+		vector3 nearest(n_clamp(cameraPosition.x, chunk.boundingBox.vmin.x, chunk.boundingBox.vmax.x),
+						n_clamp(cameraPosition.y, chunk.boundingBox.vmin.y, chunk.boundingBox.vmax.y),
+						n_clamp(cameraPosition.z, chunk.boundingBox.vmin.z, chunk.boundingBox.vmax.z));
+		float distance = (nearest - cameraPosition).len();
+		int lod = 0;
+		while (lod + 1 < (int)m_lodsCount && chunk.lodErrors[lod + 1] * pixelsPerUnit <= maxPixelError * distance) lod++;
+		lods[i] = lod;
+	}
+
+	// stitching works between neighbouring LODs only, so coarse chunks are refined 
+	// until LODs of neighbours differ by one at most
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t cy = 0; cy < m_chunksY; cy++)
 		{
-			vector3 a = getPoint(x - 1, y) - center;
-			a.norm();
-			vector3 b = getPoint(x, y + 1) - center;
-			b.norm();
-			tangent += b;
-			normal += (a * b);
+			for (size_t cx = 0; cx < m_chunksX; cx++)
+			{
+				int& lod = lods[cy * m_chunksX + cx];
+				int limit = lod;
+				if (cx > 0) limit = std::min(limit, lods[cy * m_chunksX + cx - 1] + 1);
+				if (cx + 1 < m_chunksX) limit = std::min(limit, lods[cy * m_chunksX + cx + 1] + 1);
+				if (cy > 0) limit = std::min(limit, lods[(cy - 1) * m_chunksX + cx] + 1);
+				if (cy + 1 < m_chunksY) limit = std::min(limit, lods[(cy + 1) * m_chunksX + cx] + 1);
+				if (limit != lod)
+				{
+					lod = limit;
+					changed = true;
+				}
+			}
 		}
-		if (y - 1 >= 0)
+	}
+
+	drawCalls.reserve(m_chunks.size());
+	for (size_t cy = 0; cy < m_chunksY; cy++)
+	{
+		for (size_t cx = 0; cx < m_chunksX; cx++)
 		{
-			vector3 a = getPoint(x, y - 1) - center;
-			a.norm();
-			tangent -= a;
-			vector3 b = getPoint(x - 1, y) - center;
-			b.norm();
-			normal += (a * b);
+			size_t i = cy * m_chunksX + cx;
+			if (m_chunks[i].boundingBox.clipstatus(viewProjection) == bbox3::Outside) continue;
+
+			int lod = lods[i];
+			int sides = 0;
+			if (cx > 0 && lods[i - 1] > lod) sides |= STITCH_LEFT;
+			if (cx + 1 < m_chunksX && lods[i + 1] > lod) sides |= STITCH_RIGHT;
+			if (cy > 0 && lods[i - m_chunksX] > lod) sides |= STITCH_TOP;
+			if (cy + 1 < m_chunksY && lods[i + m_chunksX] > lod) sides |= STITCH_BOTTOM;
+
+			const Data::Lod& pattern = m_patterns[lod * STITCH_VARIANTS_COUNT + sides];
+			TerrainDrawCall drawCall;
+			drawCall.offsetInIB = pattern.offsetInIB;
+			drawCall.indicesCount = pattern.indicesCount;
+			drawCall.baseVertex = m_chunks[i].baseVertex;
+			drawCalls.push_back(drawCall);
 		}
 	}
+}
 
-	normal.norm();
-	tangent.norm();
+void TerrainChunks::selectLod(size_t lod, std::vector<TerrainDrawCall>& drawCalls) const
+{
+	drawCalls.clear();
+	if (m_chunks.empty()) return;
+
+	const Data::Lod& pattern = m_patterns[std::min(lod, m_lodsCount - 1) * STITCH_VARIANTS_COUNT];
+	drawCalls.resize(m_chunks.size());
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		drawCalls[i].offsetInIB = pattern.offsetInIB;
+		drawCalls[i].indicesCount = pattern.indicesCount;
+		drawCalls[i].baseVertex = m_chunks[i].baseVertex;
+	}
+}
 
-	binormal = normal * tangent;
+void TerrainGenerator::calculateVertex(const vector3& size, const vector2& uvSize, int width, int height, int x, int y, 
+									   float sample, Data::Vertex& vertex)
+{
+	vertex.position.x = size.x * (float(x) / float(width - 1) - 0.5f);
+	vertex.position.z = size.y * (float(y) / float(height - 1) - 0.5f);
+	vertex.position.y = size.z * (sample - 0.5f);
+	vertex.texCoord0 = vector2(float(x) * uvSize.x / float(width - 1), float(y) * uvSize.y / float(height - 1));
+}
+
+void TerrainGenerator::calculateIndices(int width, int beginRow, int endRow, unsigned int* indices)
+{
+	for (int y = beginRow; y < endRow; y++)
+	{
+		unsigned int offset = (unsigned int)y * (unsigned int)width;
+		for (int x = 0; x < width - 1; x++)
+		{
+			*indices++ = offset + (unsigned int)x;
+			*indices++ = offset + (unsigned int)(x + width);
+			*indices++ = offset + (unsigned int)(x + width + 1);
+			*indices++ = offset + (unsigned int)(x + width + 1);
+			*indices++ = offset + (unsigned int)(x + 1);
+			*indices++ = offset + (unsigned int)x;
+		}
+	}
+}
+
+void TerrainGenerator::calculateTangentSpace(Data::Vertex* vertices, int width, int height, int y, vector3* edgesBuffer)
+{
+	// normalized edges to the right, up and down neighbours, edges to the left are opposite 
+	// to the right edges of the previous vertices (negation of a normalized vector is exact)
+	vector3* right = edgesBuffer;
+	vector3* up = edgesBuffer + width;
+	vector3* down = edgesBuffer + width * 2;
+	const Data::Vertex* row = vertices + y * width;
+	for (int x = 0; x < width; x++)
+	{
+		const vector3& center = row[x].position;
+		if (x + 1 < width) { right[x] = row[x + 1].position - center; right[x].norm(); }
+		if (y + 1 < height) { up[x] = row[x + width].position - center; up[x].norm(); }
+		if (y - 1 >= 0) { down[x] = row[x - width].position - center; down[x].norm(); }
+	}
+
+	// the order of summation is the same as in the per-vertex calculation
+	for (int x = 0; x < width; x++)
+	{
+		vector3 normal(0, 0, 0);
+		vector3 tangent(0, 0, 0);
+		if (x + 1 < width)
+		{
+			if (y + 1 < height)
+			{
+				tangent += up[x];
+				normal += (up[x] * right[x]);
+			}
+			if (y - 1 >= 0)
+			{
+				tangent -= down[x];
+				normal += (right[x] * down[x]);
+			}
+		}
+		if (x - 1 >= 0)
+		{
+			vector3 left = -right[x - 1];
+			if (y + 1 < height)
+			{
+				tangent += up[x];
+				normal += (left * up[x]);
+			}
+			if (y - 1 >= 0)
+			{
+				tangent -= down[x];
+				normal += (down[x] * left);
+			}
+		}
+
+		normal.norm();
+		tangent.norm();
+
+		Data::Vertex& vertex = vertices[y * width + x];
+		vertex.normal = normal;
+		vertex.tangent = tangent;
+		vertex.binormal = normal * tangent;
+	}
 }
 
 }
\ No newline at end of file
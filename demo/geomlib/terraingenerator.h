@@ -29,15 +29,121 @@
 namespace geom
 {
 
+enum HeightmapFormat
+{
+	// unsigned normalized samples
+	HEIGHTMAP_FORMAT_R8,
+	HEIGHTMAP_FORMAT_R16,
+	// samples in [0; 1]
+	HEIGHTMAP_FORMAT_R32F
+};
+
+inline size_t getHeightmapSampleSize(HeightmapFormat format)
+{
+	return format == HEIGHTMAP_FORMAT_R8 ? 1 : (format == HEIGHTMAP_FORMAT_R16 ? 2 : 4);
+}
+
+// height of a sample in [0; 1], multi-byte samples are little-endian and may be unaligned
+inline float getHeightmapSample(const unsigned char* samples, size_t index, HeightmapFormat format)
+{
+	if (format == HEIGHTMAP_FORMAT_R8)
+	{
+		return float(samples[index]) / 255.0f;
+	}
+	if (format == HEIGHTMAP_FORMAT_R16)
+	{
+		unsigned short sample;
+		memcpy(&sample, samples + index * sizeof(sample), sizeof(sample));
+		return float(sample) / 65535.0f;
+	}
+	float sample;
+	memcpy(&sample, samples + index * sizeof(sample), sizeof(sample));
+	return sample;
+}
+
 struct TerrainGenerationInfo
 {
 	vector3 size;
 	vector2 uvSize;
+	// rows of samples, the size of a sample depends on the format
 	std::vector<unsigned char> heightmap;
+	HeightmapFormat heightmapFormat;
 	size_t heightmapWidth;
 	size_t heightmapHeight;
+	// quads on a side of a chunk (a power of two), 0 means the terrain is not split into chunks.
+	// Chunked terrains use (heightmap size - 1) / chunkSize chunks on a side, the rest of the heightmap is skipped.
+	size_t chunkSize;
+
+	TerrainGenerationInfo() : size(10.0f, 10.0f, 2.0f), uvSize(1.0f, 1.0f), heightmapFormat(HEIGHTMAP_FORMAT_R8), 
+		heightmapWidth(0), heightmapHeight(0), chunkSize(0){}
+
+	float getSample(size_t x, size_t y) const { return getHeightmapSample(heightmap.data(), y * heightmapWidth + x, heightmapFormat); }
+};
+
+struct TerrainChunk
+{
+	bbox3 boundingBox;
+	size_t baseVertex;
+	// maximum height deviation of every LOD from the full-detail surface
+	std::vector<float> lodErrors;
 
-	TerrainGenerationInfo() : size(10.0f, 10.0f, 2.0f), uvSize(1.0f, 1.0f){}
+	TerrainChunk() : baseVertex(0){}
+};
+
+// indices of a draw call are in the index buffer of TerrainChunks, they must be offset by baseVertex
+struct TerrainDrawCall
+{
+	size_t offsetInIB;
+	size_t indicesCount;
+	size_t baseVertex;
+};
+
+// Chunks of a terrain share an index buffer of patterns which is separate from the mesh, so consumers
+// of the mesh (adjacency, saving) see full-detail triangles only. Every LOD has 16 variants of stitching
+// with coarser neighbours (geomipmapping), indices are relative to the first vertex of a chunk.
+class TerrainChunks
+{
+	friend class TerrainGenerator;
+
+public:
+	TerrainChunks() : m_chunksX(0), m_chunksY(0), m_lodsCount(0){}
+
+	bool isEmpty() const { return m_chunks.empty(); }
+	size_t getLodsCount() const { return m_lodsCount; }
+	size_t getChunksCountX() const { return m_chunksX; }
+	size_t getChunksCountY() const { return m_chunksY; }
+	const std::vector<TerrainChunk>& getChunks() const { return m_chunks; }
+	const Data::Lod& getPattern(size_t lod, int stitchSides) const { return m_patterns[lod * STITCH_VARIANTS_COUNT + stitchSides]; }
+	const std::vector<unsigned int>& getIndexBuffer() const { return m_indices; }
+
+	// Selects the coarsest LOD of every chunk which screen-space error 
+	// (error * pixelsPerUnit / distance) does not exceed maxPixelError, LODs of neighbouring chunks 
+	// differ by one at most. The camera and the frustum (viewProjection) are in the space of the terrain,
+	// pixelsPerUnit = 0.5 * screen height * projection.M22. Chunks out of the frustum are skipped.
+	void select(const vector3& cameraPosition, const matrix44& viewProjection, float pixelsPerUnit, float maxPixelError, 
+				std::vector<TerrainDrawCall>& drawCalls) const;
+	// Selects the same LOD (clamped to the coarsest one) for all chunks, e.g. for shadow maps.
+	// Chunks are not stitched, since all of them have the same LOD.
+	void selectLod(size_t lod, std::vector<TerrainDrawCall>& drawCalls) const;
+
+	// stitching with coarser neighbours
+	enum StitchSide
+	{
+		STITCH_LEFT = 1,
+		STITCH_RIGHT = 2,
+		STITCH_TOP = 4,
+		STITCH_BOTTOM = 8,
+		STITCH_VARIANTS_COUNT = 16
+	};
+
+private:
+	size_t m_chunksX;
+	size_t m_chunksY;
+	size_t m_lodsCount;
+	std::vector<TerrainChunk> m_chunks;
+	// [lod * STITCH_VARIANTS_COUNT + stitch sides]
+	std::vector<Data::Lod> m_patterns;
+	std::vector<unsigned int> m_indices;
 };
 
 class TerrainGenerator : public GeometryGenerator
@@ -47,15 +153,31 @@ public:
 	virtual ~TerrainGenerator(){}
 
 	void setTerrainGenerationInfo(const TerrainGenerationInfo& info);
+	// The single mesh of the result contains the whole terrain in full detail.
 	virtual Data generate();
+	const TerrainChunks& getChunks() const { return m_chunks; }
+
+	// Tangent frames of the row y of a grid of vertices (width x height), positions of the neighbouring rows must be
+	// ready. Frames depend only on the neighbours, so parts of a terrain get the same frames as the whole one if
+	// their grids include neighbouring vertices. edgesBuffer must contain 3 * width elements.
+	static void calculateTangentSpace(Data::Vertex* vertices, int width, int height, int y, vector3* edgesBuffer);
+	// The position and texture coordinates of the vertex (x, y) of a grid (width x height) which covers 
+	// the whole terrain, sample is the height in [0; 1].
+	static void calculateVertex(const vector3& size, const vector2& uvSize, int width, int height, int x, int y, 
+								float sample, Data::Vertex& vertex);
+	// Indices of quads of the rows [beginRow; endRow) of a grid of vertices (width x height), 
+	// indices of the row beginRow are written first.
+	static void calculateIndices(int width, int beginRow, int endRow, unsigned int* indices);
 
 private:
 	TerrainGenerationInfo m_info;
 	int m_terrainWidth;
 	int m_terrainHeight;
+	TerrainChunks m_chunks;
 
-	vector3 getPoint(int x, int y);
-	void calculateTangentSpace(int x, int y, vector3& normal, vector3& tangent, vector3& binormal);
+	void generateChunks(DataWriter& writer);
+	void generateChunkPattern(int lod, int stitchSides, std::vector<unsigned int>& indices) const;
+	float calculateChunkError(const Data::Vertex* vertices, size_t baseVertex, int lod) const;
 };
 
 }
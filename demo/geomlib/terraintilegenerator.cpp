@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "terraintilegenerator.h"
+
+namespace geom
+{
+
+void TerrainTileGenerator::setTerrainTileGenerationInfo(const TerrainTileGenerationInfo& info)
+{
+	m_info = info;
+}
+
+size_t TerrainTileGenerator::getTilesCountX() const
+{
+	if (m_info.heightmapWidth < 2 || m_info.tileSize == 0) return 0;
+	return (m_info.heightmapWidth - 2) / m_info.tileSize + 1;
+}
+
+size_t TerrainTileGenerator::getTilesCountY() const
+{
+	if (m_info.heightmapHeight < 2 || m_info.tileSize == 0) return 0;
+	return (m_info.heightmapHeight - 2) / m_info.tileSize + 1;
+}
+
+bool TerrainTileGenerator::generate(const std::string& heightmapFileName, const TileHandler& handler)
+{
+	utils::MemoryMappedFile file;
+	if (!file.open(heightmapFileName))
+	{
+		m_lastError = "Failed to open the heightmap '" + heightmapFileName + "'";
+		return false;
+	}
+	size_t heightmapSize = m_info.heightmapWidth * m_info.heightmapHeight * getHeightmapSampleSize(m_info.heightmapFormat);
+	if (file.getSize() < m_info.heightmapOffset + heightmapSize)
+	{
+		m_lastError = "Heightmap file is smaller than the size of the heightmap";
+		return false;
+	}
+	return generate(file.getData() + m_info.heightmapOffset, handler, &file);
+}
+
+bool TerrainTileGenerator::generate(const unsigned char* heightmap, const TileHandler& handler)
+{
+	return generate(heightmap, handler, nullptr);
+}
+
+bool TerrainTileGenerator::generate(const unsigned char* heightmap, const TileHandler& handler, utils::MemoryMappedFile* file)
+{
+	m_lastError.clear();
+	if (m_info.heightmapWidth < 2 || m_info.heightmapHeight < 2)
+	{
+		m_lastError = "Heightmap size must be at least 2x2";
+		return false;
+	}
+	if (m_info.tileSize == 0)
+	{
+		m_lastError = "Size of a terrain tile must be more than 0";
+		return false;
+	}
+	if ((m_info.tileSize + 1) * (m_info.tileSize + 1) > std::numeric_limits<unsigned int>::max())
+	{
+		m_lastError = "Size of a terrain tile is too large for 32-bit indices";
+		return false;
+	}
+
+	// tiles kept in memory at once are limited by the number of threads
+	const size_t tilesX = getTilesCountX();
+	const size_t tilesY = getTilesCountY();
+	const size_t batchSize = utils::Parallel::getThreadsCount();
+	std::vector<Data> tiles(batchSize);
+	for (size_t tileY = 0; tileY < tilesY; tileY++)
+	{
+		for (size_t batchStart = 0; batchStart < tilesX; batchStart += batchSize)
+		{
+			size_t count = std::min(batchSize, tilesX - batchStart);
+			utils::Parallel::forRange(count, [this, heightmap, &tiles, batchStart, tileY](size_t begin, size_t end, size_t)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					tiles[i] = generateTile(heightmap, batchStart + i, tileY);
+				}
+			}, 1);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				if (!handler(batchStart + i, tileY, tiles[i]))
+				{
+					m_lastError = "Terrain generation has been stopped by the tile handler";
+					return false;
+				}
+			}
+		}
+
+		// the next row of tiles reads samples from the row above it
+		if (file != nullptr)
+		{
+			size_t rowSize = m_info.heightmapWidth * getHeightmapSampleSize(m_info.heightmapFormat);
+			size_t rowsCount = (tileY + 1) * m_info.tileSize - 1;
+			size_t releasedRowsCount = tileY * m_info.tileSize;
+			releasedRowsCount = releasedRowsCount > 0 ? releasedRowsCount - 1 : 0;
+			file->release(m_info.heightmapOffset + releasedRowsCount * rowSize, (rowsCount - releasedRowsCount) * rowSize);
+		}
+	}
+	return true;
+}
+
+Data TerrainTileGenerator::generateTile(const unsigned char* heightmap, size_t tileX, size_t tileY) const
+{
+	Data data;
+	DataWriter writer(&data);
+
+	const size_t width = m_info.heightmapWidth;
+	const size_t height = m_info.heightmapHeight;
+	const size_t x0 = tileX * m_info.tileSize;
+	const size_t y0 = tileY * m_info.tileSize;
+	const size_t x1 = std::min(x0 + m_info.tileSize, width - 1);
+	const size_t y1 = std::min(y0 + m_info.tileSize, height - 1);
+
+	// the window of the grid includes neighbours of the tile to get the same tangent frames as the whole terrain
+	const size_t windowX = x0 > 0 ? x0 - 1 : 0;
+	const size_t windowY = y0 > 0 ? y0 - 1 : 0;
+	const int windowWidth = (int)(std::min(x1 + 1, width - 1) - windowX + 1);
+	const int windowHeight = (int)(std::min(y1 + 1, height - 1) - windowY + 1);
+	std::vector<Data::Vertex> window(windowWidth * windowHeight);
+	for (int y = 0; y < windowHeight; y++)
+	{
+		size_t sy = windowY + y;
+		for (int x = 0; x < windowWidth; x++)
+		{
+			size_t sx = windowX + x;
+			TerrainGenerator::calculateVertex(m_info.size, m_info.uvSize, (int)width, (int)height, (int)sx, (int)sy, 
+											  getHeightmapSample(heightmap, sy * width + sx, m_info.heightmapFormat), 
+											  window[y * windowWidth + x]);
+		}
+	}
+
+	const int tileWidth = (int)(x1 - x0 + 1);
+	const int tileHeight = (int)(y1 - y0 + 1);
+	const int offsetX = (int)(x0 - windowX);
+	const int offsetY = (int)(y0 - windowY);
+	std::vector<vector3> edgesBuffer(windowWidth * 3);
+	for (int y = offsetY; y < offsetY + tileHeight; y++)
+	{
+		TerrainGenerator::calculateTangentSpace(window.data(), windowWidth, windowHeight, y, edgesBuffer.data());
+	}
+
+	writer.getMeshesRef().resize(1);
+	writer.getMeshesRef()[0].offsetInIB = 0;
+	writer.getMeshesRef()[0].indicesCount = (tileWidth - 1) * (tileHeight - 1) * 6;
+	writer.getVerticesCountRef() = tileWidth * tileHeight;
+	writer.setVertexDeclaration(Data::VERTEX_FORMAT_FULL, 0);
+	writer.getVertexBufferRef().resize(tileWidth * tileHeight * sizeof(Data::Vertex));
+	Data::Vertex* vertices = reinterpret_cast<Data::Vertex*>(writer.getVertexBufferRef().data());
+	bbox3& boundingBox = writer.getBoundingBoxRef();
+	boundingBox.begin_extend();
+	for (int y = 0; y < tileHeight; y++)
+	{
+		const Data::Vertex* row = window.data() + (y + offsetY) * windowWidth + offsetX;
+		std::copy(row, row + tileWidth, vertices + y * tileWidth);
+		for (int x = 0; x < tileWidth; x++) boundingBox.extend(row[x].position);
+	}
+
+	writer.getIndexBufferRef().resize(writer.getMeshesRef()[0].indicesCount);
+	TerrainGenerator::calculateIndices(tileWidth, 0, tileHeight - 1, writer.getIndexBufferRef().data());
+
+	return data;
+}
+
+}
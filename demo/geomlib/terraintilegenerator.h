@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __TERRAIN_TILE_GENERATOR_H__
+#define __TERRAIN_TILE_GENERATOR_H__
+
+#include "terraingenerator.h"
+
+namespace geom
+{
+
+struct TerrainTileGenerationInfo
+{
+	vector3 size;
+	vector2 uvSize;
+	HeightmapFormat heightmapFormat;
+	size_t heightmapWidth;
+	size_t heightmapHeight;
+	// bytes before the first sample in a heightmap file (e.g. a header)
+	size_t heightmapOffset;
+	// quads on a side of a tile, tiles on the right and the bottom borders may be smaller
+	size_t tileSize;
+
+	TerrainTileGenerationInfo() : size(10.0f, 10.0f, 2.0f), uvSize(1.0f, 1.0f), heightmapFormat(HEIGHTMAP_FORMAT_R8), 
+		heightmapWidth(0), heightmapHeight(0), heightmapOffset(0), tileSize(256){}
+};
+
+// Generates a terrain from a large heightmap as a grid of tiles without holding the whole heightmap or
+// the whole mesh in memory. Tiles are generated row by row, one tile per thread at once, and every tile
+// reads only its samples and the neighbouring ones. Vertices are in the space of the whole terrain, they
+// are equal to vertices of TerrainGenerator for the same heightmap (if its sizes are even), so tiles 
+// join seamlessly. Every tile contains a single mesh in VERTEX_FORMAT_FULL.
+class TerrainTileGenerator
+{
+public:
+	// receives tiles row by row, returns false to stop the generation
+	typedef std::function<bool(size_t tileX, size_t tileY, const Data& tile)> TileHandler;
+
+	TerrainTileGenerator(){}
+
+	void setTerrainTileGenerationInfo(const TerrainTileGenerationInfo& info);
+	size_t getTilesCountX() const;
+	size_t getTilesCountY() const;
+
+	// The heightmap file contains rows of raw samples, it's memory-mapped. Returns false on errors and 
+	// if the handler stops the generation (see getLastError).
+	bool generate(const std::string& heightmapFileName, const TileHandler& handler);
+	// samples are read on demand, so they can be memory-mapped
+	bool generate(const unsigned char* heightmap, const TileHandler& handler);
+	const std::string& getLastError() const { return m_lastError; }
+
+private:
+	TerrainTileGenerationInfo m_info;
+	std::string m_lastError;
+
+	// rows of the file which are not needed anymore are released (if the file is not null)
+	bool generate(const unsigned char* heightmap, const TileHandler& handler, utils::MemoryMappedFile* file);
+	Data generateTile(const unsigned char* heightmap, size_t tileX, size_t tileY) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __TEXT_PARSER_H__
+#define __TEXT_PARSER_H__
+
+namespace geom
+{
+
+// Parsing of numbers and lines of text source formats (OBJ, ASCII PLY).
+// Parsing functions advance the pointer on success and never read beyond the end.
+class TextParser
+{
+public:
+	static bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// line breaks are not spaces
+	static const char* skipSpaces(const char* ptr, const char* end)
+	{
+		while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r')) ptr++;
+		return ptr;
+	}
+
+	// returns the beginning of the next line
+	static const char* skipLine(const char* ptr, const char* end)
+	{
+		const char* lineEnd = (const char*)memchr(ptr, '\n', (size_t)(end - ptr));
+		return lineEnd != 0 ? lineEnd + 1 : end;
+	}
+
+	static bool parseInt(const char*& ptr, const char* end, int& value)
+	{
+		const char* p = ptr;
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) p++;
+		if (p == end || !isDigit(*p)) return false;
+
+		long long result = 0;
+		for (; p < end && isDigit(*p); p++)
+		{
+			result = result * 10 + (*p - '0');
+			if (result > 0x7fffffff) return false;
+		}
+		value = (int)(negative ? -result : result);
+		ptr = p;
+		return true;
+	}
+
+	// up to 17 significant digits are taken into account, so the result is rounded 
+	// correctly to float (besides very rare cases of double rounding)
+	static bool parseFloat(const char*& ptr, const char* end, float& value)
+	{
+		static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+										 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		const int MAX_EXACT_POWER = 22;
+		const unsigned long long MAX_MANTISSA = 10000000000000000ULL;
+
+		const char* p = ptr;
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) p++;
+
+		unsigned long long mantissa = 0;
+		int exponent = 0;
+		bool hasDigits = false;
+		for (; p < end && isDigit(*p); p++, hasDigits = true)
+		{
+			if (mantissa < MAX_MANTISSA) mantissa = mantissa * 10 + (*p - '0');
+			else exponent++;
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && isDigit(*p); p++, hasDigits = true)
+			{
+				if (mantissa < MAX_MANTISSA) { mantissa = mantissa * 10 + (*p - '0'); exponent--; }
+			}
+		}
+		if (!hasDigits) return false;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			int exponentValue = 0;
+			if (parseInt(e, end, exponentValue))
+			{
+				exponent += exponentValue > 1000 ? 1000 : (exponentValue < -1000 ? -1000 : exponentValue);
+				p = e;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (exponent < 0) result = (exponent >= -MAX_EXACT_POWER) ? result / powers[-exponent] : result * pow(10.0, exponent);
+		else if (exponent > 0) result = (exponent <= MAX_EXACT_POWER) ? result * powers[exponent] : result * pow(10.0, exponent);
+		value = (float)(negative ? -result : result);
+		ptr = p;
+		return true;
+	}
+
+	// splits text into ranges of whole lines for parallel parsing, returns chunksCount + 1 offsets
+	static std::vector<size_t> splitLines(const char* data, size_t size, size_t chunksCount)
+	{
+		std::vector<size_t> offsets(chunksCount + 1, size);
+		offsets[0] = 0;
+		for (size_t i = 1; i < chunksCount; i++)
+		{
+			size_t offset = size / chunksCount * i;
+			if (offset < offsets[i - 1]) offset = offsets[i - 1];
+			offsets[i] = (offset == 0 || offset >= size) ? offset : (size_t)(skipLine(data + offset - 1, data + size) - data);
+		}
+		return offsets;
+	}
+};
+
+}
+
+#endif
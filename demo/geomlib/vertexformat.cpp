@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include "vertexformat.h"
+
+namespace geom
+{
+
+Data VertexFormatConverter::convert(const Data& data, Data::VertexFormat format)
+{
+	return convert(data, format, data.getVertexComponentsMask());
+}
+
+Data VertexFormatConverter::convert(const Data& data, Data::VertexFormat format, unsigned int componentsMask)
+{
+	componentsMask &= Data::COMPONENTS_ALL;
+	if (!data.isCorrect() || (data.getVertexFormat() == format && data.getVertexComponentsMask() == componentsMask)) return data;
+
+	Data result;
+	DataWriter writer(&result);
+	writer.setVertexDeclaration(format, data.getAdditionalUVsCount(), componentsMask);
+	writer.getMeshesRef() = data.getMeshes();
+	writer.getVerticesCountRef() = data.getVerticesCount();
+	writer.getBoundingBoxRef() = data.getBoundingBox();
+	writer.getIndexBufferRef().assign(data.getIndexData(), data.getIndexData() + data.getIndicesCount());
+
+	// quantization range has to contain all positions
+	if (format == Data::VERTEX_FORMAT_COMPACT_QUANTIZED)
+	{
+		for (size_t i = 0; i < data.getVerticesCount(); i++)
+		{
+			writer.getBoundingBoxRef().extend(data.getPosition(i));
+		}
+	}
+
+	size_t vertexSize = result.getVertexSize();
+	writer.getVertexBufferRef().resize(data.getVerticesCount() * vertexSize);
+	std::vector<vector2> additionalUVs(data.getAdditionalUVsCount());
+	for (size_t i = 0; i < data.getVerticesCount(); i++)
+	{
+		Data::Vertex vertex;
+		decodeVertex(data, i, vertex, additionalUVs.data());
+		encodeVertex(result, vertex, additionalUVs.data(), writer.getVertexBufferRef().data() + i * vertexSize);
+	}
+
+	// quantized positions may leave the bounds of meshes
+	if (format == Data::VERTEX_FORMAT_COMPACT_QUANTIZED)
+	{
+		BoundsCalculator::calculate(writer);
+	}
+
+	return result;
+}
+
+unsigned int VertexFormatConverter::packUnitVector(const vector3& v, float w)
+{
+	unsigned int x = (unsigned int)(n_saturate(v.x * 0.5f + 0.5f) * 1023.0f + 0.5f);
+	unsigned int y = (unsigned int)(n_saturate(v.y * 0.5f + 0.5f) * 1023.0f + 0.5f);
+	unsigned int z = (unsigned int)(n_saturate(v.z * 0.5f + 0.5f) * 1023.0f + 0.5f);
+	unsigned int a = (unsigned int)(n_saturate(w) * 3.0f + 0.5f);
+	return x | (y << 10) | (z << 20) | (a << 30);
+}
+
+vector3 VertexFormatConverter::unpackUnitVector(unsigned int packed, float* w)
+{
+	if (w != 0) *w = float(packed >> 30) / 3.0f;
+	return vector3(float(packed & 1023) / 1023.0f * 2.0f - 1.0f,
+				   float((packed >> 10) & 1023) / 1023.0f * 2.0f - 1.0f,
+				   float((packed >> 20) & 1023) / 1023.0f * 2.0f - 1.0f);
+}
+
+unsigned short VertexFormatConverter::packHalf(float value)
+{
+	unsigned int bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int mantissa = bits & 0x007fffff;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+
+	// NaN and infinity
+	if (((bits >> 23) & 0xff) == 0xff)
+	{
+		return (unsigned short)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+	}
+
+	// overflow
+	if (exponent >= 31) return (unsigned short)(sign | 0x7c00);
+
+	// denormalized values and underflow
+	if (exponent <= 0)
+	{
+		if (exponent < -10) return (unsigned short)sign;
+		mantissa |= 0x00800000;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) half++;
+		return (unsigned short)(sign | half);
+	}
+
+	// normalized values, round to nearest even
+	unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0)) half++;
+	return (unsigned short)half;
+}
+
+float VertexFormatConverter::unpackHalf(unsigned short value)
+{
+	unsigned int sign = ((unsigned int)value & 0x8000) << 16;
+	unsigned int exponent = ((unsigned int)value >> 10) & 0x1f;
+	unsigned int mantissa = (unsigned int)value & 0x3ff;
+
+	unsigned int bits = 0;
+	if (exponent == 0)
+	{
+		if (mantissa != 0)
+		{
+			// denormalized value, normalize it
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		else
+		{
+			bits = sign;
+		}
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float result = 0;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void VertexFormatConverter::decodeVertex(const Data& data, size_t index, Data::Vertex& vertex, vector2* additionalUVs)
+{
+	const unsigned char* ptr = data.getVertexData() + index * data.getVertexSize();
+	if (data.getVertexFormat() == Data::VERTEX_FORMAT_FULL && data.getVertexComponentsMask() == Data::COMPONENTS_ALL)
+	{
+		memcpy(&vertex, ptr, sizeof(Data::Vertex));
+		if (data.getAdditionalUVsCount() != 0)
+		{
+			memcpy(additionalUVs, ptr + sizeof(Data::Vertex), data.getAdditionalUVsCount() * sizeof(vector2));
+		}
+		return;
+	}
+
+	// absent components are zeros
+	memset(&vertex, 0, sizeof(vertex));
+	vertex.position = data.getPosition(index);
+	float tangentSign = -1.0f;
+	const Data::VertexDeclaration& declaration = data.getVertexDeclaration();
+	for (size_t c = 1; c < declaration.size(); c++)
+	{
+		const Data::VertexComponent& component = declaration[c];
+		const unsigned char* componentPtr = ptr + component.offset;
+		switch (component.semantic)
+		{
+		case Data::SEMANTIC_NORMAL:
+		case Data::SEMANTIC_TANGENT:
+		case Data::SEMANTIC_BINORMAL:
+			{
+				vector3& v = component.semantic == Data::SEMANTIC_NORMAL ? vertex.normal : 
+							 (component.semantic == Data::SEMANTIC_TANGENT ? vertex.tangent : vertex.binormal);
+				if (component.type == Data::COMPONENT_UNORM_10_10_10_2)
+				{
+					unsigned int packed = 0;
+					memcpy(&packed, componentPtr, sizeof(packed));
+					v = unpackUnitVector(packed, component.semantic == Data::SEMANTIC_TANGENT ? &tangentSign : 0);
+				}
+				else
+				{
+					memcpy(&v, componentPtr, sizeof(v));
+				}
+			}
+			break;
+
+		case Data::SEMANTIC_TEXCOORD:
+			{
+				vector2& uv = component.semanticIndex == 0 ? vertex.texCoord0 : additionalUVs[component.semanticIndex - 1];
+				if (component.type == Data::COMPONENT_HALF)
+				{
+					unsigned short packed[2];
+					memcpy(packed, componentPtr, sizeof(packed));
+					uv = vector2(unpackHalf(packed[0]), unpackHalf(packed[1]));
+				}
+				else
+				{
+					memcpy(&uv, componentPtr, sizeof(uv));
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// binormal is not stored in compact formats
+	if (tangentSign >= 0.0f)
+	{
+		vertex.binormal = (vertex.normal * vertex.tangent) * (tangentSign > 0.5f ? 1.0f : -1.0f);
+	}
+}
+
+void VertexFormatConverter::encodeVertex(const Data& data, const Data::Vertex& vertex, const vector2* additionalUVs, unsigned char* ptr)
+{
+	if (data.getVertexFormat() == Data::VERTEX_FORMAT_FULL && data.getVertexComponentsMask() == Data::COMPONENTS_ALL)
+	{
+		memcpy(ptr, &vertex, sizeof(Data::Vertex));
+		if (data.getAdditionalUVsCount() != 0)
+		{
+			memcpy(ptr + sizeof(Data::Vertex), additionalUVs, data.getAdditionalUVsCount() * sizeof(vector2));
+		}
+		return;
+	}
+
+	const Data::VertexDeclaration& declaration = data.getVertexDeclaration();
+	for (size_t c = 0; c < declaration.size(); c++)
+	{
+		const Data::VertexComponent& component = declaration[c];
+		unsigned char* componentPtr = ptr + component.offset;
+		switch (component.semantic)
+		{
+		case Data::SEMANTIC_POSITION:
+			if (component.type == Data::COMPONENT_UNORM16)
+			{
+				const bbox3& boundingBox = data.getBoundingBox();
+				vector3 extents = boundingBox.size();
+				const float p[3] = { vertex.position.x - boundingBox.vmin.x, vertex.position.y - boundingBox.vmin.y, vertex.position.z - boundingBox.vmin.z };
+				const float s[3] = { extents.x, extents.y, extents.z };
+				unsigned short position[4];
+				for (int i = 0; i < 3; i++)
+				{
+					position[i] = s[i] > 0.0f ? (unsigned short)(n_saturate(p[i] / s[i]) * 65535.0f + 0.5f) : 0;
+				}
+				position[3] = 65535;
+				memcpy(componentPtr, position, sizeof(position));
+			}
+			else
+			{
+				memcpy(componentPtr, &vertex.position, sizeof(vertex.position));
+			}
+			break;
+
+		case Data::SEMANTIC_NORMAL:
+		case Data::SEMANTIC_TANGENT:
+		case Data::SEMANTIC_BINORMAL:
+			{
+				const vector3& v = component.semantic == Data::SEMANTIC_NORMAL ? vertex.normal : 
+								   (component.semantic == Data::SEMANTIC_TANGENT ? vertex.tangent : vertex.binormal);
+				if (component.type == Data::COMPONENT_UNORM_10_10_10_2)
+				{
+					// the sign of binormal is stored in the 2-bit component of tangent
+					float w = 0.0f;
+					if (component.semantic == Data::SEMANTIC_TANGENT)
+					{
+						w = ((vertex.normal * vertex.tangent) % vertex.binormal) >= 0.0f ? 1.0f : 0.0f;
+					}
+					unsigned int packed = packUnitVector(v, w);
+					memcpy(componentPtr, &packed, sizeof(packed));
+				}
+				else
+				{
+					memcpy(componentPtr, &v, sizeof(v));
+				}
+			}
+			break;
+
+		case Data::SEMANTIC_TEXCOORD:
+			{
+				const vector2& uv = component.semanticIndex == 0 ? vertex.texCoord0 : additionalUVs[component.semanticIndex - 1];
+				if (component.type == Data::COMPONENT_HALF)
+				{
+					unsigned short packed[2] = { packHalf(uv.x), packHalf(uv.y) };
+					memcpy(componentPtr, packed, sizeof(packed));
+				}
+				else
+				{
+					memcpy(componentPtr, &uv, sizeof(uv));
+				}
+			}
+			break;
+		}
+	}
+}
+
+}
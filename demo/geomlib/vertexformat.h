@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VERTEX_FORMAT_H__
+#define __VERTEX_FORMAT_H__
+
+namespace geom
+{
+
+class VertexFormatConverter
+{
+public:
+	// Converts vertices of data to the specified format. Conversion to a compact format 
+	// is lossy, conversion back restores binormals from the normal, the tangent and its sign.
+	static Data convert(const Data& data, Data::VertexFormat format);
+	// The same, vertices keep only components of componentsMask (see Data::VertexComponentsMask),
+	// components which are absent in data are filled by zeros.
+	static Data convert(const Data& data, Data::VertexFormat format, unsigned int componentsMask);
+
+	static unsigned int packUnitVector(const vector3& v, float w);
+	static vector3 unpackUnitVector(unsigned int packed, float* w = 0);
+	static unsigned short packHalf(float value);
+	static float unpackHalf(unsigned short value);
+
+private:
+	static void decodeVertex(const Data& data, size_t index, Data::Vertex& vertex, vector2* additionalUVs);
+	// data provides the vertex declaration and the quantization range
+	static void encodeVertex(const Data& data, const Data::Vertex& vertex, const vector2* additionalUVs, unsigned char* ptr);
+};
+
+}
+
+#endif
@@ -438,11 +438,7 @@ public:
 		m_furFinsRendering->setUniform<FurAppUniforms>(UF::DEFAULT_SAMPLER, anisotropicSampler());
 		m_furFinsRendering->setUniform<FurAppUniforms>(UF::ENTITY_DATA, m_entityDataBuffer);
 
-		geometry->applyInputLayout();
-		UINT vertexStride = geometry->getVertexSize();
-		UINT vertexOffset = 0;
-		ID3D11Buffer* vb = geometry->getVertexBuffer();
-		device.context->IASetVertexBuffers(0, 1, &vb, &vertexStride, &vertexOffset);
+		geometry->applyVertexBuffers();
 		device.context->IASetIndexBuffer(entityData.finsIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
 		device.context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST_ADJ);
 		device.context->DrawIndexed(entityData.finsIndexBufferSize, 0, 0);
@@ -20,6 +20,8 @@ DECLARE_UNIFORMS_END()
 // constants
 const std::string SHADERS_PATH = "data/shaders/gl/win32/pssm/";
 const int MAX_SPLITS = 4;
+const size_t TERRAIN_CHUNK_SIZE = 16;
+const float TERRAIN_MAX_PIXEL_ERROR = 2.0f;
 #define PROFILING 0
 
 // application
@@ -39,6 +41,7 @@ public:
 		m_splitShift = 20;
 		m_shadowBlurStep = 1.0f / float(m_shadowMapSize);
 		m_furthestPointInCamera = 0;
+		m_terrainChunksCount = 0;
 
 		m_renderDebug = false;
 		m_increaseBlurStep = false;
@@ -138,8 +141,12 @@ public:
 		terrainInfo.heightmap = framework::LoadHeightmapData("data/media/textures/heightmap1.png", terrainInfo.heightmapWidth, terrainInfo.heightmapHeight);
 		terrainInfo.size = vector3(5000.0f, 5000.0f, 500.0f);
 		terrainInfo.uvSize = vector2(200.0f, 200.0f);
+		terrainInfo.chunkSize = TERRAIN_CHUNK_SIZE;
 		m_terrainGeometry = initEntity(terrainInfo, "data/media/textures/grass.dds", "data/media/textures/grass_bump.dds", "data/media/textures/no_specular.png");
 
+		// the terrain is generated while models are being loaded
+		waitForCompletionHandlers();
+
 		// entities
 		vector3 GROUP_OFFSET[] = { vector3(0, 0, 0), vector3(-1000, 130, 600), vector3(0, -4, 900) };
 		for (int k = 0; k < sizeof(GROUP_OFFSET) / sizeof(GROUP_OFFSET[0]); k++)
@@ -210,15 +217,14 @@ public:
 
 	std::shared_ptr<framework::Geometry3D> initEntity(const std::string& geometry)
 	{
-		std::shared_ptr<framework::Geometry3D> ent(new framework::Geometry3D());
-		if (!ent->init(geometry))
-		{
-			exit();
-		}
-		else
+		// the handler is called after loading, when the shared geometry is already assigned
+		auto weakEnt = std::make_shared<std::weak_ptr<framework::Geometry3D> >();
+		auto ent = framework::GeometryCache::instance().loadAsync(geometry, false, [this, weakEnt](bool loaded)
 		{
-			framework::MaterialManager::instance().initializeMaterial(ent);
-		}
+			if (!loaded) exit();
+			else framework::MaterialManager::instance().initializeMaterial(weakEnt->lock());
+		});
+		*weakEnt = ent;
 
 		return ent;
 	}
@@ -333,6 +339,9 @@ public:
 		
 		for (size_t i = 0; i < geometry->getMeshesCount(); i++)
 		{
+			// submeshes are culled separately, shadow casters out of the camera frustum are kept
+			if (!shadowmap && !geometry->isChunkedTerrain() && !geometry->isMeshVisible(i, entityData.mvp)) continue;
+
 			if (!shadowmap)
 			{
 				auto diffMap = framework::MaterialManager::instance().getTexture(geometry, i, framework::MAT_DIFFUSE_MAP);
@@ -343,10 +352,29 @@ public:
 				m_sceneRendering->setTexture<PSSMAppUniforms>(UF::SPECULAR_MAP, specMap, 3);
 			}
 
-			geometry->renderMesh(i, shadowmap ? entityData.shadowInstancesCount : 1);
+			if (shadowmap)
+			{
+				geometry->renderMeshPositions(i, entityData.shadowInstancesCount);
+			}
+			else if (geometry->isChunkedTerrain())
+			{
+				renderTerrain(geometry, entityData);
+			}
+			else
+			{
+				geometry->renderMesh(i);
+			}
 		}
 	}
 
+	void renderTerrain(const std::shared_ptr<framework::Geometry3D>& geometry, const EntityData& entityData)
+	{
+		// chunks of a terrain are selected by screen-space error
+		matrix44 vp = m_camera.getView() * m_camera.getProjection();
+		float pixelsPerUnit = 0.5f * float(m_info.windowHeight) * m_camera.getProjection().M22;
+		m_terrainChunksCount = geometry->renderTerrain(entityData.model, vp, m_camera.getPosition(), pixelsPerUnit, TERRAIN_MAX_PIXEL_ERROR);
+	}
+
 	void renderDebug()
 	{
 		if (!m_renderDebug) return;
@@ -378,6 +406,7 @@ public:
 			}
 		}
 		stream << "\nRendered to SM objects = " << objectsCount << "\nRendered to SM instances = " << instancesCount;
+		stream << "\nRendered terrain chunks = " << m_terrainChunksCount;
 
 		m_debugLabel->setText(stream.str());
 	}
@@ -669,6 +698,7 @@ private:
 	float m_splitLambda;
 	std::vector<float> m_splitDistances;
 	float m_furthestPointInCamera;
+	size_t m_terrainChunksCount;
 	matrix44 m_shadowViewProjection[MAX_SPLITS];
 	float m_shadowBlurStep;
 
@@ -0,0 +1,1459 @@
+#include <gtest/gtest.h>
+#include "framework.h"
+#include "geomformat.h"
+#include "vertexformat.h"
+#include "meshoptimizer.h"
+#include "meshsimplifier.h"
+#include "clusterbuilder.h"
+#include "bvh.h"
+#include "boundscalculator.h"
+#include "blockcompressor.h"
+#include "tangentframecalculator.h"
+#include "heightfield.h"
+#include "terraintilegenerator.h"
+
+class GeomlibTests : public testing::Test
+{
+public:
+	void SetUp() 
+	{
+	}
+
+	void TearDown() 
+	{
+	}
+
+	geom::Data generatePlane(int segmentsX, int segmentsY)
+	{
+		geom::PlaneGenerationInfo info;
+		info.segments[0] = segmentsX;
+		info.segments[1] = segmentsY;
+		geom::PlaneGenerator generator;
+		generator.setPlaneGenerationInfo(info);
+		return generator.generate();
+	}
+
+	// files written before materials were embedded, the section is turned into an ignored one
+	void saveWithoutMaterials(const geom::Data& data, const std::string& fileName)
+	{
+		ASSERT_TRUE(geom::Geometry::instance().save(data, fileName));
+		std::vector<unsigned char> header(geom::GEOM_HEADER_SIZE);
+		FILE* fp = fopen(fileName.c_str(), "r+b");
+		ASSERT_TRUE(fp != 0);
+		ASSERT_EQ(fread(header.data(), header.size(), 1, fp), 1);
+		unsigned int sectionsCount = header[8] | (header[9] << 8) | (header[10] << 16) | (header[11] << 24);
+		header.resize(geom::GEOM_HEADER_SIZE + sectionsCount * geom::GEOM_SECTION_ENTRY_SIZE);
+		ASSERT_EQ(fread(header.data() + geom::GEOM_HEADER_SIZE, header.size() - geom::GEOM_HEADER_SIZE, 1, fp), 1);
+		for (unsigned int i = 0; i < sectionsCount; i++)
+		{
+			unsigned char* type = header.data() + geom::GEOM_HEADER_SIZE + i * geom::GEOM_SECTION_ENTRY_SIZE;
+			if (type[0] == geom::GEOM_SECTION_MATERIALS) type[0] = geom::GEOM_SECTION_EXTRAS;
+		}
+		fseek(fp, 0, SEEK_SET);
+		ASSERT_EQ(fwrite(header.data(), header.size(), 1, fp), 1);
+		fclose(fp);
+	}
+
+	geom::Data generateTerrain(size_t width, size_t height, size_t chunkSize = 0, geom::TerrainChunks* chunks = nullptr)
+	{
+		geom::TerrainGenerationInfo info;
+		info.heightmapWidth = width;
+		info.heightmapHeight = height;
+		info.chunkSize = chunkSize;
+		info.heightmap.resize(width * height);
+		for (size_t i = 0; i < info.heightmap.size(); i++)
+		{
+			info.heightmap[i] = (unsigned char)(rand() % 256);
+		}
+		geom::TerrainGenerator generator;
+		generator.setTerrainGenerationInfo(info);
+		geom::Data data = generator.generate();
+		if (chunks != nullptr) *chunks = generator.getChunks();
+		return data;
+	}
+
+	// per-vertex tangent space calculation of the terrain generator
+	void calculateTerrainTangentSpaceReference(const geom::Data& data, int width, int height, int x, int y,
+											   vector3& normal, vector3& tangent)
+	{
+		const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+		auto point = [&](int px, int py) { return vertices[py * width + px].position; };
+		vector3 center = point(x, y);
+		normal = vector3(0, 0, 0);
+		tangent = vector3(0, 0, 0);
+		if (x + 1 < width)
+		{
+			if (y + 1 < height)
+			{
+				vector3 a = point(x, y + 1) - center; a.norm();
+				vector3 b = point(x + 1, y) - center; b.norm();
+				tangent += a; normal += (a * b);
+			}
+			if (y - 1 >= 0)
+			{
+				vector3 a = point(x + 1, y) - center; a.norm();
+				vector3 b = point(x, y - 1) - center; b.norm();
+				tangent -= b; normal += (a * b);
+			}
+		}
+		if (x - 1 >= 0)
+		{
+			if (y + 1 < height)
+			{
+				vector3 a = point(x - 1, y) - center; a.norm();
+				vector3 b = point(x, y + 1) - center; b.norm();
+				tangent += b; normal += (a * b);
+			}
+			if (y - 1 >= 0)
+			{
+				vector3 a = point(x, y - 1) - center; a.norm();
+				vector3 b = point(x - 1, y) - center; b.norm();
+				tangent -= a; normal += (a * b);
+			}
+		}
+		normal.norm();
+		tangent.norm();
+	}
+
+	// brute-force search of adjacent triangles
+	std::vector<geom::Data::TriangleAdjacency> calculateAdjacencyReference(const geom::Data& data)
+	{
+		std::vector<geom::Data::TriangleAdjacency> output;
+		const unsigned int* indices = data.getIndexData();
+		size_t trianglesCount = data.getIndicesCount() / 3;
+		output.resize(trianglesCount);
+		for (size_t i = 0; i < trianglesCount; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				output[i].points[k] = indices[i * 3 + k];
+				output[i].adjacentPoints[k] = -1;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				int edge[2] = { output[i].points[k], output[i].points[(k + 1) % 3] };
+				for (size_t j = 0; j < trianglesCount && output[i].adjacentPoints[k] < 0; j++)
+				{
+					if (j == i) continue;
+					int t[3] = { (int)indices[j * 3], (int)indices[j * 3 + 1], (int)indices[j * 3 + 2] };
+					int points[3] = { t[0], t[1], t[2] };
+					int matches = 0;
+					for (int e = 0; e < 2; e++)
+					{
+						int* p = std::find(t, t + 3, edge[e]);
+						if (p != t + 3) { matches++; points[p - t] = -1; }
+					}
+					if (matches < 2) continue;
+					output[i].adjacentPoints[k] = (points[0] != -1) ? points[0] : ((points[1] != -1) ? points[1] : points[2]);
+				}
+			}
+		}
+		return output;
+	}
+
+	void assertEqual(const std::vector<geom::Data::TriangleAdjacency>& a1, const std::vector<geom::Data::TriangleAdjacency>& a2)
+	{
+		ASSERT_EQ(a1.size(), a2.size());
+		for (size_t i = 0; i < a1.size(); i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				ASSERT_EQ(a1[i].points[k], a2[i].points[k]);
+				ASSERT_EQ(a1[i].adjacentPoints[k], a2[i].adjacentPoints[k]);
+			}
+		}
+	}
+
+	void assertEqual(const geom::Data& d1, const geom::Data& d2)
+	{
+		ASSERT_EQ(d1.getVerticesCount(), d2.getVerticesCount());
+		ASSERT_EQ(d1.getAdditionalUVsCount(), d2.getAdditionalUVsCount());
+		ASSERT_EQ(d1.getVertexDataSize(), d2.getVertexDataSize());
+		ASSERT_EQ(memcmp(d1.getVertexData(), d2.getVertexData(), d1.getVertexDataSize()), 0);
+		ASSERT_EQ(d1.getIndicesCount(), d2.getIndicesCount());
+		ASSERT_EQ(memcmp(d1.getIndexData(), d2.getIndexData(), d1.getIndicesCount() * sizeof(unsigned int)), 0);
+		ASSERT_EQ(d1.getMeshes().size(), d2.getMeshes().size());
+		for (size_t i = 0; i < d1.getMeshes().size(); i++)
+		{
+			ASSERT_EQ(d1.getMeshes()[i].offsetInIB, d2.getMeshes()[i].offsetInIB);
+			ASSERT_EQ(d1.getMeshes()[i].indicesCount, d2.getMeshes()[i].indicesCount);
+		}
+		ASSERT_TRUE(d1.getBoundingBox().vmin.isequal(d2.getBoundingBox().vmin, 0.0f));
+		ASSERT_TRUE(d1.getBoundingBox().vmax.isequal(d2.getBoundingBox().vmax, 0.0f));
+	}
+};
+
+TEST_F(GeomlibTests, SaveAndLoad)
+{
+	geom::Data data = generatePlane(10, 7);
+	ASSERT_TRUE(data.isCorrect());
+	ASSERT_TRUE(geom::Geometry::instance().save(data, "geomlibtests.geom"));
+
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	ASSERT_FALSE(loaded.isMapped());
+	assertEqual(data, loaded);
+
+	geom::Data mapped = geom::Geometry::instance().loadMapped("geomlibtests.geom");
+	ASSERT_TRUE(mapped.isCorrect());
+	ASSERT_TRUE(mapped.isMapped());
+	ASSERT_EQ((size_t)mapped.getVertexData() % geom::GEOM_SECTION_ALIGNMENT, 0);
+	assertEqual(data, mapped);
+
+	// hashes depend on the content only (see GeometryCache)
+	ASSERT_EQ(loaded.computeHash(), data.computeHash());
+	ASSERT_EQ(mapped.computeHash(), data.computeHash());
+	ASSERT_NE(generatePlane(7, 10).computeHash(), data.computeHash());
+
+	mapped.releaseMapping();
+	ASSERT_FALSE(mapped.isMapped());
+	ASSERT_EQ(mapped.getIndicesCount(), 0);
+}
+
+
+TEST_F(GeomlibTests, CompactVertexFormats)
+{
+	geom::Data data = generatePlane(10, 7);
+	ASSERT_TRUE(data.isCorrect());
+
+	geom::Data compact = geom::VertexFormatConverter::convert(data, geom::Data::VERTEX_FORMAT_COMPACT);
+	ASSERT_TRUE(compact.isCorrect());
+	ASSERT_EQ(compact.getVertexSize(), 24);
+	ASSERT_EQ(compact.findVertexComponent(geom::Data::SEMANTIC_BINORMAL), -1);
+
+	geom::Data quantized = geom::VertexFormatConverter::convert(data, geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED);
+	ASSERT_TRUE(quantized.isCorrect());
+	ASSERT_EQ(quantized.getVertexSize(), 20);
+	vector3 size = data.getBoundingBox().size();
+	float eps = std::max(std::max(size.x, size.y), size.z) / 65535.0f;
+	for (size_t i = 0; i < data.getVerticesCount(); i++)
+	{
+		ASSERT_TRUE(data.getPosition(i).isequal(quantized.getPosition(i), eps));
+	}
+
+	ASSERT_TRUE(geom::Geometry::instance().save(quantized, "geomlibtests_quantized.geom"));
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_quantized.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	ASSERT_EQ(loaded.getVertexFormat(), geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED);
+	assertEqual(quantized, loaded);
+
+	geom::Data restored = geom::VertexFormatConverter::convert(loaded, geom::Data::VERTEX_FORMAT_FULL);
+	ASSERT_TRUE(restored.isCorrect());
+	ASSERT_EQ(restored.getVertexSize(), data.getVertexSize());
+	const geom::Data::Vertex* v1 = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+	const geom::Data::Vertex* v2 = reinterpret_cast<const geom::Data::Vertex*>(restored.getVertexData());
+	for (size_t i = 0; i < data.getVerticesCount(); i++)
+	{
+		ASSERT_TRUE(v1[i].normal.isequal(v2[i].normal, 1e-2f));
+		ASSERT_TRUE(v1[i].tangent.isequal(v2[i].tangent, 1e-2f));
+		ASSERT_TRUE(v1[i].binormal.isequal(v2[i].binormal, 1e-2f));
+		ASSERT_TRUE(v1[i].texCoord0.isequal(v2[i].texCoord0, 1e-3f));
+	}
+}
+
+
+TEST_F(GeomlibTests, VertexStreams)
+{
+	geom::Data data = generatePlane(10, 7);
+	ASSERT_TRUE(data.isCorrect());
+
+	geom::Data::VertexFormat formats[] = { geom::Data::VERTEX_FORMAT_FULL, geom::Data::VERTEX_FORMAT_COMPACT, 
+										   geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED };
+	const size_t positionSizes[] = { 12, 12, 8 };
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+	{
+		geom::Data d = geom::VertexFormatConverter::convert(data, formats[f]);
+		ASSERT_TRUE(d.isCorrect());
+
+		size_t positionSize = d.getVertexStreamStride(geom::Data::STREAM_POSITIONS);
+		size_t attributesSize = d.getVertexStreamStride(geom::Data::STREAM_ATTRIBUTES);
+		ASSERT_EQ(positionSize, positionSizes[f]);
+		ASSERT_EQ(positionSize + attributesSize, d.getVertexSize());
+		ASSERT_EQ(d.getVertexComponentStream(0), geom::Data::STREAM_POSITIONS);
+		for (size_t c = 1; c < d.getVertexComponentsCount(); c++)
+		{
+			ASSERT_EQ(d.getVertexComponentStream(c), geom::Data::STREAM_ATTRIBUTES);
+			ASSERT_EQ(d.getVertexComponentOffsetInStream(c) + positionSize, d.getVertexComponentOffset(c));
+		}
+
+		std::vector<unsigned char> positions(d.getVerticesCount() * positionSize);
+		std::vector<unsigned char> attributes(d.getVerticesCount() * attributesSize);
+		d.splitVertexStreams(positions.data(), attributes.data());
+		for (size_t i = 0; i < d.getVerticesCount(); i++)
+		{
+			const unsigned char* vertex = d.getVertexData() + i * d.getVertexSize();
+			ASSERT_EQ(memcmp(vertex, positions.data() + i * positionSize, positionSize), 0);
+			ASSERT_EQ(memcmp(vertex + positionSize, attributes.data() + i * attributesSize, attributesSize), 0);
+		}
+	}
+}
+
+
+TEST_F(GeomlibTests, Adjacency)
+{
+	geom::Data data = generateTerrain(64, 64);
+	ASSERT_TRUE(data.isCorrect());
+	assertEqual(data.calculateAdjacency(), calculateAdjacencyReference(data));
+
+	// non-manifold and degenerate triangles
+	geom::DataWriter writer(&data);
+	unsigned int extraIndices[] = { 0, 1, 65, 65, 1, 0, 2, 2, 3, 3, 3, 3, 3, 4, 3, 70, 70, 70 };
+	std::vector<unsigned int>& indexBuffer = writer.getIndexBufferRef();
+	indexBuffer.insert(indexBuffer.end(), extraIndices, extraIndices + sizeof(extraIndices) / sizeof(extraIndices[0]));
+	writer.getMeshesRef()[0].indicesCount = indexBuffer.size();
+	assertEqual(data.calculateAdjacency(), calculateAdjacencyReference(data));
+
+	geom::Data plane = generatePlane(2, 2);
+	assertEqual(plane.calculateAdjacency(), calculateAdjacencyReference(plane));
+}
+
+TEST_F(GeomlibTests, MeshOptimization)
+{
+	geom::Data data = generateTerrain(64, 64);
+	ASSERT_TRUE(data.isCorrect());
+
+	// shuffle triangles to make vertex cache useless
+	geom::DataWriter writer(&data);
+	std::vector<unsigned int>& indices = writer.getIndexBufferRef();
+	for (size_t i = indices.size() / 3 - 1; i > 0; i--)
+	{
+		size_t j = (size_t)rand() % (i + 1);
+		std::swap_ranges(indices.begin() + i * 3, indices.begin() + i * 3 + 3, indices.begin() + j * 3);
+	}
+
+	geom::Data optimized = geom::MeshOptimizer::optimize(data);
+	ASSERT_TRUE(optimized.isCorrect());
+	ASSERT_EQ(optimized.getVerticesCount(), data.getVerticesCount());
+	ASSERT_EQ(optimized.getIndicesCount(), data.getIndicesCount());
+	ASSERT_LT(geom::MeshOptimizer::calculateACMR(optimized), 0.75f);
+	ASSERT_LT(geom::MeshOptimizer::calculateACMR(optimized), geom::MeshOptimizer::calculateACMR(data) * 0.5f);
+
+	// vertices go in order of the first use
+	unsigned int nextIndex = 0;
+	const unsigned int* optimizedIndices = optimized.getIndexData();
+	for (size_t i = 0; i < optimized.getIndicesCount(); i++)
+	{
+		ASSERT_LE(optimizedIndices[i], nextIndex);
+		if (optimizedIndices[i] == nextIndex) nextIndex++;
+	}
+
+	// the same triangles with the same vertices
+	auto getTriangles = [](const geom::Data& d)
+	{
+		std::vector<std::vector<unsigned char> > triangles(d.getIndicesCount() / 3);
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const unsigned char* vertex = d.getVertexData() + d.getIndexData()[t * 3 + k] * d.getVertexSize();
+				triangles[t].insert(triangles[t].end(), vertex, vertex + d.getVertexSize());
+			}
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	};
+	ASSERT_TRUE(getTriangles(data) == getTriangles(optimized));
+}
+
+TEST_F(GeomlibTests, LodGeneration)
+{
+	geom::Data data = generateTerrain(64, 64);
+	ASSERT_TRUE(data.isCorrect());
+
+	geom::LodGenerationInfo info;
+	info.lodsCount = 3;
+	info.maxError = 1.0f;
+	geom::Data lods = geom::MeshSimplifier::generateLods(data, info);
+	ASSERT_TRUE(lods.isCorrect());
+	ASSERT_EQ(lods.getVerticesCount(), data.getVerticesCount());
+	ASSERT_EQ(lods.getMeshes().size(), 1);
+
+	const geom::Data::Mesh& mesh = lods.getMeshes()[0];
+	ASSERT_EQ(mesh.indicesCount, data.getIndicesCount());
+	ASSERT_EQ(memcmp(lods.getIndexData() + mesh.offsetInIB, data.getIndexData(), mesh.indicesCount * sizeof(unsigned int)), 0);
+	ASSERT_EQ(mesh.lods.size(), info.lodsCount);
+
+	size_t trianglesCount = mesh.indicesCount / 3;
+	for (size_t i = 0; i < mesh.lods.size(); i++)
+	{
+		ASSERT_LE(mesh.lods[i].indicesCount / 3, trianglesCount / 2);
+		ASSERT_GT(mesh.lods[i].indicesCount, 0);
+		ASSERT_LE(mesh.lods[i].error, info.maxError);
+		ASSERT_LE(mesh.lods[i].offsetInIB + mesh.lods[i].indicesCount, lods.getIndicesCount());
+		for (size_t j = 0; j < mesh.lods[i].indicesCount; j++)
+		{
+			ASSERT_LT(lods.getIndexData()[mesh.lods[i].offsetInIB + j], lods.getVerticesCount());
+		}
+		trianglesCount = mesh.lods[i].indicesCount / 3;
+	}
+
+	// a flat plane is simplified without error
+	geom::Data plane = geom::MeshSimplifier::generateLods(generatePlane(16, 16), info);
+	ASSERT_TRUE(plane.isCorrect());
+	ASSERT_FALSE(plane.getMeshes()[0].lods.empty());
+	ASSERT_LT(plane.getMeshes()[0].lods[0].error, 1e-5f);
+
+	ASSERT_TRUE(geom::Geometry::instance().save(lods, "geomlibtests_lods.geom"));
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_lods.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	assertEqual(lods, loaded);
+	for (size_t i = 0; i < mesh.lods.size(); i++)
+	{
+		ASSERT_EQ(loaded.getMeshes()[0].lods[i].offsetInIB, mesh.lods[i].offsetInIB);
+		ASSERT_EQ(loaded.getMeshes()[0].lods[i].indicesCount, mesh.lods[i].indicesCount);
+		ASSERT_EQ(loaded.getMeshes()[0].lods[i].error, mesh.lods[i].error);
+	}
+}
+
+TEST_F(GeomlibTests, ClusterBuilding)
+{
+	geom::Data data = generateTerrain(64, 64);
+	ASSERT_TRUE(data.isCorrect());
+
+	geom::ClusterBuildingInfo info;
+	geom::Data clustered = geom::ClusterBuilder::build(data, info);
+	ASSERT_TRUE(clustered.isCorrect());
+	ASSERT_EQ(clustered.getIndicesCount(), data.getIndicesCount());
+	ASSERT_EQ(clustered.getMeshes().size(), 1);
+
+	const geom::Data::Mesh& mesh = clustered.getMeshes()[0];
+	ASSERT_FALSE(mesh.clusters.empty());
+
+	// clusters cover the mesh contiguously and keep the limits
+	size_t offset = mesh.offsetInIB;
+	const unsigned int* indices = clustered.getIndexData();
+	geom::Data fullData = geom::VertexFormatConverter::convert(clustered, geom::Data::VERTEX_FORMAT_FULL);
+	const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(fullData.getVertexData());
+	for (size_t i = 0; i < mesh.clusters.size(); i++)
+	{
+		const geom::Data::Cluster& cluster = mesh.clusters[i];
+		ASSERT_EQ(cluster.offsetInIB, offset);
+		ASSERT_GT(cluster.indicesCount, 0);
+		ASSERT_LE(cluster.indicesCount / 3, info.maxTrianglesCount);
+
+		std::vector<unsigned int> clusterVertices(indices + cluster.offsetInIB, indices + cluster.offsetInIB + cluster.indicesCount);
+		std::sort(clusterVertices.begin(), clusterVertices.end());
+		clusterVertices.erase(std::unique(clusterVertices.begin(), clusterVertices.end()), clusterVertices.end());
+		ASSERT_LE(clusterVertices.size(), info.maxVerticesCount);
+		for (size_t v = 0; v < clusterVertices.size(); v++)
+		{
+			ASSERT_LE((vertices[clusterVertices[v]].position - cluster.center).len(), cluster.radius * 1.001f + 1e-5f);
+		}
+		offset += cluster.indicesCount;
+	}
+	ASSERT_EQ(offset, mesh.offsetInIB + mesh.indicesCount);
+
+	// the same set of triangles
+	auto sortedTriangles = [](const geom::Data& d)
+	{
+		std::vector<std::vector<unsigned int>> triangles(d.getIndicesCount() / 3);
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			triangles[t].assign(d.getIndexData() + t * 3, d.getIndexData() + t * 3 + 3);
+			std::rotate(triangles[t].begin(), std::min_element(triangles[t].begin(), triangles[t].end()), triangles[t].end());
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	};
+	ASSERT_TRUE(sortedTriangles(data) == sortedTriangles(clustered));
+
+	// clusters of a plane are culled from the back side only
+	geom::Data plane = geom::ClusterBuilder::build(generatePlane(16, 16), info);
+	ASSERT_TRUE(plane.isCorrect());
+	for (size_t i = 0; i < plane.getMeshes()[0].clusters.size(); i++)
+	{
+		const geom::Data::Cluster& cluster = plane.getMeshes()[0].clusters[i];
+		ASSERT_GT(cluster.coneAxis.len(), 0.5f);
+		ASSERT_FALSE(geom::ClusterBuilder::isBackfacing(cluster, cluster.center + cluster.coneAxis * 10.0f));
+		ASSERT_TRUE(geom::ClusterBuilder::isBackfacing(cluster, cluster.center - cluster.coneAxis * 10.0f));
+	}
+
+	ASSERT_TRUE(geom::Geometry::instance().save(clustered, "geomlibtests_clusters.geom"));
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_clusters.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	assertEqual(clustered, loaded);
+	ASSERT_EQ(loaded.getMeshes()[0].clusters.size(), mesh.clusters.size());
+	for (size_t i = 0; i < mesh.clusters.size(); i++)
+	{
+		const geom::Data::Cluster& c1 = mesh.clusters[i];
+		const geom::Data::Cluster& c2 = loaded.getMeshes()[0].clusters[i];
+		ASSERT_EQ(c1.offsetInIB, c2.offsetInIB);
+		ASSERT_EQ(c1.indicesCount, c2.indicesCount);
+		ASSERT_TRUE(c1.center.isequal(c2.center, 0.0f));
+		ASSERT_EQ(c1.radius, c2.radius);
+		ASSERT_TRUE(c1.coneAxis.isequal(c2.coneAxis, 0.0f));
+		ASSERT_EQ(c1.coneCutoff, c2.coneCutoff);
+	}
+}
+
+TEST_F(GeomlibTests, AsyncLoading)
+{
+	const size_t FILES_COUNT = 8;
+	std::vector<geom::Data> sources;
+	for (size_t i = 0; i < FILES_COUNT; i++)
+	{
+		sources.push_back(generatePlane((int)i + 1, (int)i + 2));
+		ASSERT_TRUE(geom::Geometry::instance().save(sources.back(), "geomlibtests_async" + std::to_string(i) + ".geom"));
+	}
+
+	std::vector<std::future<geom::Data> > results;
+	for (size_t i = 0; i < FILES_COUNT; i++)
+	{
+		results.push_back(geom::Geometry::instance().loadAsync("geomlibtests_async" + std::to_string(i) + ".geom"));
+	}
+	auto missing = geom::Geometry::instance().loadAsync("geomlibtests_missing.geom");
+
+	for (size_t i = 0; i < FILES_COUNT; i++)
+	{
+		geom::Data loaded = results[i].get();
+		ASSERT_TRUE(loaded.isCorrect());
+		assertEqual(sources[i], loaded);
+	}
+	ASSERT_FALSE(missing.get().isCorrect());
+
+	geom::Geometry::instance().finishAsyncLoading();
+}
+
+TEST_F(GeomlibTests, TerrainGeneration)
+{
+	const size_t sizes[][2] = { { 2, 2 }, { 3, 7 }, { 65, 64 }, { 300, 257 } };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		geom::Data data = generateTerrain(sizes[i][0], sizes[i][1]);
+		ASSERT_TRUE(data.isCorrect());
+
+		int width = (int)(sizes[i][0] & ~1);
+		int height = (int)(sizes[i][1] & ~1);
+		ASSERT_EQ(data.getVerticesCount(), (size_t)(width * height));
+		ASSERT_EQ(data.getIndicesCount(), (size_t)((width - 1) * (height - 1) * 6));
+
+		const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const geom::Data::Vertex& vertex = vertices[y * width + x];
+				vector3 normal, tangent;
+				calculateTerrainTangentSpaceReference(data, width, height, x, y, normal, tangent);
+				ASSERT_TRUE(vertex.normal.isequal(normal, 1e-5f));
+				ASSERT_TRUE(vertex.tangent.isequal(tangent, 1e-5f));
+				ASSERT_TRUE(vertex.binormal.isequal(normal * tangent, 1e-5f));
+			}
+		}
+
+		const unsigned int* indices = data.getIndexData();
+		for (int y = 0; y < height - 1; y++)
+		{
+			for (int x = 0; x < width - 1; x++)
+			{
+				const unsigned int* quad = indices + (y * (width - 1) + x) * 6;
+				unsigned int v = (unsigned int)(y * width + x);
+				ASSERT_EQ(quad[0], v);
+				ASSERT_EQ(quad[1], v + width);
+				ASSERT_EQ(quad[2], v + width + 1);
+				ASSERT_EQ(quad[3], v + width + 1);
+				ASSERT_EQ(quad[4], v + 1);
+				ASSERT_EQ(quad[5], v);
+			}
+		}
+	}
+}
+
+TEST_F(GeomlibTests, ChunkedTerrain)
+{
+	const int chunkSize = 16;
+	geom::TerrainChunks chunks;
+	geom::Data data = generateTerrain(50, 40, chunkSize, &chunks);
+	ASSERT_TRUE(data.isCorrect());
+
+	const int width = 3 * chunkSize + 1;
+	const int height = 2 * chunkSize + 1;
+	ASSERT_EQ(data.getVerticesCount(), (size_t)(width * height));
+	ASSERT_EQ(data.getMeshes().size(), 1);
+	ASSERT_EQ(data.getMeshes()[0].indicesCount, (size_t)((width - 1) * (height - 1) * 6));
+	ASSERT_EQ(chunks.getChunksCountX(), 3);
+	ASSERT_EQ(chunks.getChunksCountY(), 2);
+	ASSERT_EQ(chunks.getLodsCount(), 5);
+
+	// patterns are kept out of the mesh, so whole-buffer consumers see the full-detail triangles only
+	ASSERT_EQ(data.getIndicesCount(), data.getMeshes()[0].indicesCount);
+	assertEqual(data.calculateAdjacency(), calculateAdjacencyReference(data));
+
+	// every pattern covers the chunk by triangles of the same winding, 
+	// stitched sides use vertices of the coarser LOD only
+	const unsigned int* indices = chunks.getIndexBuffer().data();
+	for (size_t lod = 0; lod + 1 < chunks.getLodsCount(); lod++)
+	{
+		const int coarseStep = 2 << lod;
+		for (int sides = 0; sides < geom::TerrainChunks::STITCH_VARIANTS_COUNT; sides++)
+		{
+			const geom::Data::Lod& pattern = chunks.getPattern(lod, sides);
+			ASSERT_EQ(pattern.indicesCount % 3, 0);
+			int area = 0;
+			for (size_t i = 0; i < pattern.indicesCount; i += 3)
+			{
+				int x[3], y[3];
+				for (int j = 0; j < 3; j++)
+				{
+					unsigned int index = indices[pattern.offsetInIB + i + j];
+					x[j] = (int)(index % width);
+					y[j] = (int)(index / width);
+					ASSERT_TRUE(x[j] <= chunkSize && y[j] <= chunkSize);
+					if ((sides & geom::TerrainChunks::STITCH_LEFT) != 0 && x[j] == 0) ASSERT_EQ(y[j] % coarseStep, 0);
+					if ((sides & geom::TerrainChunks::STITCH_RIGHT) != 0 && x[j] == chunkSize) ASSERT_EQ(y[j] % coarseStep, 0);
+					if ((sides & geom::TerrainChunks::STITCH_TOP) != 0 && y[j] == 0) ASSERT_EQ(x[j] % coarseStep, 0);
+					if ((sides & geom::TerrainChunks::STITCH_BOTTOM) != 0 && y[j] == chunkSize) ASSERT_EQ(x[j] % coarseStep, 0);
+				}
+				int doubleArea = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+				ASSERT_LT(doubleArea, 0);
+				area += doubleArea;
+			}
+			ASSERT_EQ(area, -2 * chunkSize * chunkSize);
+		}
+	}
+
+	const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+	for (size_t i = 0; i < chunks.getChunks().size(); i++)
+	{
+		const geom::TerrainChunk& chunk = chunks.getChunks()[i];
+		ASSERT_EQ(chunk.baseVertex, (i / 3) * chunkSize * width + (i % 3) * chunkSize);
+		ASSERT_TRUE(chunk.boundingBox.contains(vertices[chunk.baseVertex + chunkSize * width + chunkSize].position));
+		ASSERT_EQ(chunk.lodErrors[0], 0.0f);
+		for (size_t lod = 1; lod < chunks.getLodsCount(); lod++)
+		{
+			ASSERT_GE(chunk.lodErrors[lod], chunk.lodErrors[lod - 1]);
+		}
+	}
+
+	// the chunk under the camera is in full detail, the neighbours are not coarser than LOD 1, 
+	// everything is visible in the frustum
+	matrix44 viewProjection;
+	viewProjection.scale(vector3(0.01f, 0.01f, 0.01f));
+	vector3 cameraPosition = vertices[0].position;
+	std::vector<geom::TerrainDrawCall> drawCalls;
+	chunks.select(cameraPosition, viewProjection, 1000.0f, 1.0f, drawCalls);
+	ASSERT_EQ(drawCalls.size(), chunks.getChunks().size());
+	ASSERT_EQ(drawCalls[0].baseVertex, 0);
+	ASSERT_EQ(drawCalls[0].indicesCount, (size_t)(chunkSize * chunkSize * 6));
+	for (size_t i = 1; i < drawCalls.size(); i++)
+	{
+		ASSERT_EQ(drawCalls[i].baseVertex, chunks.getChunks()[i].baseVertex);
+	}
+	ASSERT_GE(drawCalls[1].indicesCount, chunks.getPattern(1, geom::TerrainChunks::STITCH_RIGHT).indicesCount);
+
+	// far away camera selects the coarsest LOD
+	chunks.select(vector3(0.0f, 1.0e6f, 0.0f), viewProjection, 1000.0f, 1.0f, drawCalls);
+	ASSERT_EQ(drawCalls.size(), chunks.getChunks().size());
+	for (size_t i = 0; i < drawCalls.size(); i++)
+	{
+		ASSERT_EQ(drawCalls[i].indicesCount, 6);
+	}
+
+	// terrain out of the frustum
+	viewProjection.set_translation(vector3(100.0f, 0.0f, 0.0f));
+	chunks.select(vector3(0.0f, 1.0e6f, 0.0f), viewProjection, 1000.0f, 1.0f, drawCalls);
+	ASSERT_TRUE(drawCalls.empty());
+
+	// the same LOD for all chunks (e.g. shadow maps), LODs are clamped to the coarsest one
+	chunks.selectLod(2, drawCalls);
+	ASSERT_EQ(drawCalls.size(), chunks.getChunks().size());
+	for (size_t i = 0; i < drawCalls.size(); i++)
+	{
+		ASSERT_EQ(drawCalls[i].offsetInIB, chunks.getPattern(2, 0).offsetInIB);
+		ASSERT_EQ(drawCalls[i].indicesCount, (size_t)((chunkSize / 4) * (chunkSize / 4) * 6));
+		ASSERT_EQ(drawCalls[i].baseVertex, chunks.getChunks()[i].baseVertex);
+	}
+	chunks.selectLod(100, drawCalls);
+	ASSERT_EQ(drawCalls.size(), chunks.getChunks().size());
+	ASSERT_EQ(drawCalls[0].indicesCount, 6);
+}
+
+TEST_F(GeomlibTests, BvhQueries)
+{
+	geom::Data terrain = generateTerrain(65, 64);
+	ASSERT_TRUE(terrain.isCorrect());
+	geom::Data quantized = geom::VertexFormatConverter::convert(terrain, geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED);
+	ASSERT_TRUE(quantized.isCorrect());
+
+	const geom::Data* sources[] = { &terrain, &quantized };
+	for (size_t s = 0; s < sizeof(sources) / sizeof(sources[0]); s++)
+	{
+		const geom::Data& data = *sources[s];
+		geom::Bvh bvh;
+		ASSERT_TRUE(bvh.build(data));
+		ASSERT_EQ(bvh.getTrianglesCount(), data.getIndicesCount() / 3);
+		ASSERT_TRUE(bvh.getDepth() > 1);
+		bbox3 box = bvh.getBoundingBox();
+		ASSERT_TRUE(box.vmin.isequal(data.getBoundingBox().vmin, 1e-3f));
+		ASSERT_TRUE(box.vmax.isequal(data.getBoundingBox().vmax, 1e-3f));
+
+		// results of queries are compared with the brute-force search
+		const unsigned int* indices = data.getIndexData();
+		size_t trianglesCount = data.getIndicesCount() / 3;
+		vector3 center = box.center();
+		vector3 size = box.size();
+		size_t hitsCount = 0;
+		for (int r = 0; r < 200; r++)
+		{
+			auto randomPoint = [&](float scale)
+			{
+				return center + vector3(size.x * (float(rand()) / RAND_MAX - 0.5f) * scale,
+										size.y * (float(rand()) / RAND_MAX - 0.5f) * scale,
+										size.z * (float(rand()) / RAND_MAX - 0.5f) * scale);
+			};
+			line3 line(randomPoint(3.0f), randomPoint(1.0f));
+			if (r % 4 == 0) line = line3(randomPoint(1.0f), randomPoint(1.0f));
+
+			float closestT = std::numeric_limits<float>::max();
+			for (size_t t = 0; t < trianglesCount; t++)
+			{
+				vector3 v0 = data.getPosition(indices[t * 3]);
+				vector3 e1 = data.getPosition(indices[t * 3 + 1]) - v0;
+				vector3 e2 = data.getPosition(indices[t * 3 + 2]) - v0;
+				vector3 p = line.m * e2;
+				float det = e1 % p;
+				if (det == 0.0f) continue;
+				vector3 sv = line.b - v0;
+				float u = (sv % p) / det;
+				vector3 q = sv * e1;
+				float v = (line.m % q) / det;
+				float hitT = (e2 % q) / det;
+				if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && hitT >= 0.0f && hitT <= 1.0f) closestT = std::min(closestT, hitT);
+			}
+
+			geom::BvhHit hit;
+			bool found = bvh.findClosestHit(line, hit);
+			ASSERT_EQ(found, closestT <= 1.0f);
+			ASSERT_EQ(bvh.findAnyHit(line), found);
+			if (!found) continue;
+
+			hitsCount++;
+			ASSERT_NEAR(hit.t, closestT, 1e-5f);
+			ASSERT_EQ(hit.meshIndex, 0);
+			ASSERT_TRUE(hit.triangleIndex < trianglesCount);
+			vector3 v0 = data.getPosition(indices[hit.triangleIndex * 3]);
+			vector3 v1 = data.getPosition(indices[hit.triangleIndex * 3 + 1]);
+			vector3 v2 = data.getPosition(indices[hit.triangleIndex * 3 + 2]);
+			vector3 point = v0 + (v1 - v0) * hit.u + (v2 - v0) * hit.v;
+			ASSERT_TRUE(point.isequal(line.ipol(hit.t), 1e-3f * size.len()));
+		}
+		ASSERT_TRUE(hitsCount > 0);
+	}
+}
+
+TEST_F(GeomlibTests, MeshBounds)
+{
+	// corners of a cube and degenerate sets of points
+	vector3 center;
+	float radius = 0.0f;
+	std::vector<vector3> points;
+	for (int i = 0; i < 8; i++)
+	{
+		points.push_back(vector3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f) + vector3(5.0f, 0.0f, 0.0f));
+	}
+	geom::BoundsCalculator::calculateBoundingSphere(points, center, radius);
+	ASSERT_TRUE(center.isequal(vector3(5.0f, 0.0f, 0.0f), 1e-5f));
+	ASSERT_NEAR(radius, sqrtf(3.0f), 1e-5f);
+
+	points.clear();
+	for (int i = 0; i <= 10; i++) points.push_back(vector3(0.0f, (float)i, 0.0f));
+	geom::BoundsCalculator::calculateBoundingSphere(points, center, radius);
+	ASSERT_TRUE(center.isequal(vector3(0.0f, 5.0f, 0.0f), 1e-5f));
+	ASSERT_NEAR(radius, 5.0f, 1e-5f);
+
+	points.clear();
+	for (int i = 0; i < 64; i++)
+	{
+		float angle = float(i) * 2.0f * 3.14159265f / 64.0f;
+		points.push_back(vector3(3.0f * cosf(angle), 1.0f, 3.0f * sinf(angle)));
+		points.push_back(vector3(1.5f * cosf(angle), 1.0f, 1.5f * sinf(angle)));
+	}
+	geom::BoundsCalculator::calculateBoundingSphere(points, center, radius);
+	ASSERT_TRUE(center.isequal(vector3(0.0f, 1.0f, 0.0f), 1e-4f));
+	ASSERT_NEAR(radius, 3.0f, 1e-4f);
+
+	// random points in a ball, the sphere is not larger than the one around the center of the bounding box
+	points.clear();
+	bbox3 pointsBox;
+	pointsBox.begin_extend();
+	for (int i = 0; i < 2000; i++)
+	{
+		vector3 p(float(rand() % 2001 - 1000), float(rand() % 2001 - 1000), float(rand() % 2001 - 1000));
+		if (p.len() > 1000.0f) continue;
+		points.push_back(p * 0.01f);
+		pointsBox.extend(points.back());
+	}
+	pointsBox.end_extend();
+	geom::BoundsCalculator::calculateBoundingSphere(points, center, radius);
+	float boxSphereRadius = 0.0f;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		ASSERT_LE((points[i] - center).len(), radius);
+		boxSphereRadius = std::max(boxSphereRadius, (points[i] - pointsBox.center()).len());
+	}
+	ASSERT_LE(radius, boxSphereRadius);
+	ASSERT_LE(radius, 10.0f);
+
+	// the plane is split into two meshes, every mesh is bounded by its own vertices
+	geom::Data data = generatePlane(16, 16);
+	ASSERT_TRUE(data.isCorrect());
+	ASSERT_FALSE(data.getMeshes()[0].hasBounds());
+	geom::DataWriter writer(&data);
+	writer.getMeshesRef().resize(2);
+	writer.getMeshesRef()[0].indicesCount = data.getIndicesCount() / 2;
+	writer.getMeshesRef()[1].offsetInIB = data.getIndicesCount() / 2;
+	writer.getMeshesRef()[1].indicesCount = data.getIndicesCount() / 2;
+	geom::BoundsCalculator::calculate(writer);
+	auto isInside = [](const vector3& p, const bbox3& box)
+	{
+		return p.x >= box.vmin.x && p.y >= box.vmin.y && p.z >= box.vmin.z &&
+			   p.x <= box.vmax.x && p.y <= box.vmax.y && p.z <= box.vmax.z;
+	};
+	for (size_t m = 0; m < data.getMeshes().size(); m++)
+	{
+		const geom::Data::Mesh& mesh = data.getMeshes()[m];
+		ASSERT_TRUE(mesh.hasBounds());
+		ASSERT_TRUE(isInside(mesh.boundingBox.vmin, data.getBoundingBox()));
+		ASSERT_TRUE(isInside(mesh.boundingBox.vmax, data.getBoundingBox()));
+		ASSERT_LT(mesh.boundingBox.size().len(), data.getBoundingBox().size().len());
+		for (size_t i = mesh.offsetInIB; i < mesh.offsetInIB + mesh.indicesCount; i++)
+		{
+			vector3 p = data.getPosition(data.getIndexData()[i]);
+			ASSERT_TRUE(isInside(p, mesh.boundingBox));
+			ASSERT_LE((p - mesh.boundingSphereCenter).len(), mesh.boundingSphereRadius);
+		}
+	}
+
+	ASSERT_TRUE(geom::Geometry::instance().save(data, "geomlibtests_bounds.geom"));
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_bounds.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	assertEqual(data, loaded);
+	for (size_t m = 0; m < data.getMeshes().size(); m++)
+	{
+		const geom::Data::Mesh& m1 = data.getMeshes()[m];
+		const geom::Data::Mesh& m2 = loaded.getMeshes()[m];
+		ASSERT_TRUE(m1.boundingBox.vmin.isequal(m2.boundingBox.vmin, 0.0f));
+		ASSERT_TRUE(m1.boundingBox.vmax.isequal(m2.boundingBox.vmax, 0.0f));
+		ASSERT_TRUE(m1.boundingSphereCenter.isequal(m2.boundingSphereCenter, 0.0f));
+		ASSERT_EQ(m1.boundingSphereRadius, m2.boundingSphereRadius);
+	}
+
+	// bounds are calculated on loading of files without them
+	geom::Data plane = generatePlane(4, 4);
+	ASSERT_TRUE(geom::Geometry::instance().save(plane, "geomlibtests_bounds.geom"));
+	loaded = geom::Geometry::instance().load("geomlibtests_bounds.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	ASSERT_TRUE(loaded.getMeshes()[0].hasBounds());
+	geom::DataWriter planeWriter(&plane);
+	geom::BoundsCalculator::calculate(planeWriter);
+	ASSERT_TRUE(loaded.getMeshes()[0].boundingBox.vmin.isequal(plane.getMeshes()[0].boundingBox.vmin, 0.0f));
+	ASSERT_TRUE(loaded.getMeshes()[0].boundingBox.vmax.isequal(plane.getMeshes()[0].boundingBox.vmax, 0.0f));
+	ASSERT_EQ(loaded.getMeshes()[0].boundingSphereRadius, plane.getMeshes()[0].boundingSphereRadius);
+
+	// meshes out of the index buffer are rejected before the bounds are calculated
+	geom::Data broken = generatePlane(4, 4);
+	geom::DataWriter(&broken).getMeshesRef()[0].indicesCount = broken.getIndicesCount() + 3;
+	ASSERT_TRUE(geom::Geometry::instance().save(broken, "geomlibtests_bounds.geom"));
+	geom::Data loadedBroken = geom::Geometry::instance().load("geomlibtests_bounds.geom");
+	ASSERT_FALSE(loadedBroken.isCorrect());
+}
+
+TEST_F(GeomlibTests, VertexDeclaration)
+{
+	geom::Data data = generatePlane(8, 8);
+	ASSERT_TRUE(data.isCorrect());
+	ASSERT_EQ(data.getVertexComponentsMask(), geom::Data::COMPONENTS_ALL);
+
+	// the full declaration matches geom::Data::Vertex
+	const geom::Data::VertexDeclaration& full = data.getVertexDeclaration();
+	ASSERT_EQ(full.size(), 5);
+	ASSERT_EQ(data.getVertexSize(), sizeof(geom::Data::Vertex));
+	ASSERT_EQ(full[data.findVertexComponent(geom::Data::SEMANTIC_TANGENT)].offset, offsetof(geom::Data::Vertex, tangent));
+	ASSERT_EQ(full[data.findVertexComponent(geom::Data::SEMANTIC_BINORMAL)].location, 4);
+	ASSERT_EQ(data.findVertexComponent(geom::Data::SEMANTIC_TEXCOORD, 1), -1);
+
+	// compact formats don't store binormals
+	geom::Data compact = geom::VertexFormatConverter::convert(data, geom::Data::VERTEX_FORMAT_COMPACT);
+	ASSERT_EQ(compact.getVertexDeclaration().size(), 4);
+	ASSERT_EQ(compact.findVertexComponent(geom::Data::SEMANTIC_BINORMAL), -1);
+	ASSERT_EQ(compact.getVertexSize(), sizeof(geom::Data::CompactVertex));
+
+	// vertices without texture coordinates and tangent frames
+	geom::Data stripped = geom::VertexFormatConverter::convert(data, geom::Data::VERTEX_FORMAT_FULL, geom::Data::COMPONENTS_NORMAL);
+	ASSERT_TRUE(stripped.isCorrect());
+	ASSERT_EQ(stripped.getVertexComponentsMask(), geom::Data::COMPONENTS_NORMAL);
+	ASSERT_EQ(stripped.getVertexSize(), 2 * sizeof(vector3));
+	ASSERT_EQ(stripped.getVertexDataSize(), stripped.getVerticesCount() * stripped.getVertexSize());
+	ASSERT_EQ(stripped.findVertexComponent(geom::Data::SEMANTIC_TEXCOORD), -1);
+	const geom::Data::VertexComponent& normal = stripped.getVertexDeclaration()[stripped.findVertexComponent(geom::Data::SEMANTIC_NORMAL)];
+	ASSERT_EQ(normal.offset, sizeof(vector3));
+	ASSERT_EQ(normal.offsetInStream, 0);
+	ASSERT_EQ(normal.location, 1);
+	ASSERT_EQ(stripped.getVertexStreamStride(geom::Data::STREAM_ATTRIBUTES), sizeof(vector3));
+
+	geom::Data strippedCompact = geom::VertexFormatConverter::convert(stripped, geom::Data::VERTEX_FORMAT_COMPACT);
+	ASSERT_EQ(strippedCompact.getVertexComponentsMask(), geom::Data::COMPONENTS_NORMAL);
+	ASSERT_EQ(strippedCompact.getVertexSize(), sizeof(vector3) + sizeof(unsigned int));
+
+	ASSERT_TRUE(geom::Geometry::instance().save(stripped, "geomlibtests_stripped.geom"));
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_stripped.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	ASSERT_EQ(loaded.getVertexComponentsMask(), geom::Data::COMPONENTS_NORMAL);
+	assertEqual(stripped, loaded);
+
+	// restored components are zeros
+	geom::Data restored = geom::VertexFormatConverter::convert(loaded, geom::Data::VERTEX_FORMAT_FULL, geom::Data::COMPONENTS_ALL);
+	ASSERT_EQ(restored.getVertexSize(), data.getVertexSize());
+	const geom::Data::Vertex* v1 = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+	const geom::Data::Vertex* v2 = reinterpret_cast<const geom::Data::Vertex*>(restored.getVertexData());
+	for (size_t i = 0; i < data.getVerticesCount(); i++)
+	{
+		ASSERT_TRUE(v1[i].position.isequal(v2[i].position, 0.0f));
+		ASSERT_TRUE(v1[i].normal.isequal(v2[i].normal, 0.0f));
+		ASSERT_TRUE(v2[i].texCoord0.isequal(vector2(0.0f, 0.0f), 0.0f));
+		ASSERT_TRUE(v2[i].tangent.isequal(vector3(0.0f, 0.0f, 0.0f), 0.0f));
+	}
+}
+
+TEST_F(GeomlibTests, EmbeddedMaterials)
+{
+	geom::Data data = generatePlane(4, 4);
+	ASSERT_TRUE(data.isCorrect());
+	geom::DataWriter writer(&data);
+	writer.getMeshesRef()[0].material.diffuseMapFilename = "plane_diff";
+	writer.getMeshesRef()[0].material.normalMapFilename = "plane_normal";
+
+	remove("geomlibtests_materials.material");
+	ASSERT_TRUE(geom::Geometry::instance().save(data, "geomlibtests_materials.geom"));
+
+	// materials are stored in the geom-file only
+	FILE* fp = fopen("geomlibtests_materials.material", "r");
+	ASSERT_TRUE(fp == 0);
+
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_materials.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	ASSERT_EQ(loaded.getMeshes()[0].material.diffuseMapFilename, "plane_diff");
+	ASSERT_EQ(loaded.getMeshes()[0].material.normalMapFilename, "plane_normal");
+	ASSERT_TRUE(loaded.getMeshes()[0].material.specularMapFilename.empty());
+
+	// empty materials are embedded too, a stale .material file is ignored
+	geom::Data legacy = generatePlane(4, 4);
+	ASSERT_TRUE(geom::Geometry::instance().save(legacy, "geomlibtests_legacy.geom"));
+	fp = fopen("geomlibtests_legacy.material", "w");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "[{\"diffuseMap\":\"legacy_diff\",\"normalMap\":\"\",\"specularMap\":\"legacy_spec\"}]");
+	fclose(fp);
+	geom::Data loadedEmpty = geom::Geometry::instance().load("geomlibtests_legacy.geom");
+	ASSERT_TRUE(loadedEmpty.isCorrect());
+	ASSERT_TRUE(loadedEmpty.getMeshes()[0].material.diffuseMapFilename.empty());
+	ASSERT_TRUE(loadedEmpty.getMeshes()[0].material.specularMapFilename.empty());
+
+	// legacy files without embedded materials fall back to .material
+	saveWithoutMaterials(legacy, "geomlibtests_legacy.geom");
+	geom::Data loadedLegacy = geom::Geometry::instance().load("geomlibtests_legacy.geom");
+	remove("geomlibtests_legacy.material");
+	ASSERT_TRUE(loadedLegacy.isCorrect());
+	ASSERT_EQ(loadedLegacy.getMeshes()[0].material.diffuseMapFilename, "legacy_diff");
+	ASSERT_TRUE(loadedLegacy.getMeshes()[0].material.normalMapFilename.empty());
+	ASSERT_EQ(loadedLegacy.getMeshes()[0].material.specularMapFilename, "legacy_spec");
+}
+
+TEST_F(GeomlibTests, CompressedSections)
+{
+	// repetitive and random data, small blocks to have many of them
+	std::vector<unsigned char> source(100000);
+	for (size_t i = 0; i < source.size(); i++) source[i] = (i < 60000) ? (unsigned char)(i % 7) : (unsigned char)(rand() & 0xff);
+	std::vector<unsigned char> compressed;
+	ASSERT_TRUE(geom::BlockCompressor::compress(source.data(), source.size(), compressed, 4096));
+	ASSERT_LT(compressed.size(), source.size());
+	ASSERT_EQ(geom::BlockCompressor::getDecompressedSize(compressed.data(), compressed.size()), source.size());
+	std::vector<unsigned char> decompressed(source.size());
+	ASSERT_TRUE(geom::BlockCompressor::decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()));
+	ASSERT_TRUE(decompressed == source);
+	ASSERT_FALSE(geom::BlockCompressor::decompress(compressed.data(), compressed.size() - 1, decompressed.data(), decompressed.size()));
+
+	// incompressible data is not compressed
+	std::vector<unsigned char> noise(10000);
+	for (size_t i = 0; i < noise.size(); i++) noise[i] = (unsigned char)(rand() & 0xff);
+	ASSERT_FALSE(geom::BlockCompressor::compress(noise.data(), noise.size(), compressed));
+
+	geom::Data data = generatePlane(128, 128);
+	ASSERT_TRUE(data.isCorrect());
+	geom::GeomSaver saver;
+	ASSERT_TRUE(saver.save(data, "geomlibtests_uncompressed.geom"));
+	saver.setCompressionEnabled(true);
+	ASSERT_TRUE(saver.save(data, "geomlibtests_compressed.geom"));
+
+	utils::MemoryMappedFile uncompressedFile, compressedFile;
+	ASSERT_TRUE(uncompressedFile.open("geomlibtests_uncompressed.geom"));
+	ASSERT_TRUE(compressedFile.open("geomlibtests_compressed.geom"));
+	ASSERT_LT(compressedFile.getSize(), uncompressedFile.getSize() / 2);
+	uncompressedFile.close();
+	compressedFile.close();
+
+	geom::Data loaded = geom::Geometry::instance().load("geomlibtests_compressed.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	assertEqual(data, loaded);
+	geom::Data mapped = geom::Geometry::instance().loadMapped("geomlibtests_compressed.geom");
+	ASSERT_TRUE(mapped.isCorrect());
+	assertEqual(data, mapped);
+}
+
+TEST_F(GeomlibTests, ObjAndPlyLoading)
+{
+	FILE* fp = fopen("geomlibtests.mtl", "w");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "newmtl first\nmap_Kd textures/first_diff.png\nmap_Bump -bm 1.0 first_normal.dds\n\nnewmtl second\nmap_Ks second_spec.png\n");
+	fclose(fp);
+
+	// the second face uses relative indices and shares vertices with the first one, 
+	// the third one is split between chunks of materials
+	fp = fopen("geomlibtests.obj", "w");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "# quad\nmtllib geomlibtests.mtl\nv 0 0 0\nv 1 0 0\nv 1.0 0 1e0\nv 0 0 1\n");
+	fprintf(fp, "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 1 0\n");
+	fprintf(fp, "usemtl first\nf 1/1/1 2/2/1 3/3/1 4/4/1\nusemtl second\nf -4/-4/-1 -2/-2/-1 -1/-1/-1\n");
+	fprintf(fp, "usemtl first\nf 1/2/1 2/2/1 3/3/1\n");
+	fclose(fp);
+
+	geom::Data obj = geom::Geometry::instance().load("geomlibtests.obj");
+	remove("geomlibtests.obj");
+	remove("geomlibtests.mtl");
+	ASSERT_TRUE(obj.isCorrect());
+	ASSERT_EQ(obj.getVerticesCount(), 5);
+	ASSERT_EQ(obj.getIndicesCount(), 12);
+	ASSERT_EQ(obj.getMeshes().size(), 2);
+	ASSERT_EQ(obj.getMeshes()[0].indicesCount, 9);
+	ASSERT_EQ(obj.getMeshes()[1].offsetInIB, 9);
+	ASSERT_EQ(obj.getMeshes()[0].material.diffuseMapFilename, "first_diff");
+	ASSERT_EQ(obj.getMeshes()[0].material.normalMapFilename, "first_normal");
+	ASSERT_EQ(obj.getMeshes()[1].material.specularMapFilename, "second_spec");
+	ASSERT_EQ(obj.getVertexComponentsMask(), geom::Data::COMPONENTS_ALL);
+	ASSERT_NEAR(obj.getBoundingBox().vmax.z, 1.0f, 1e-5f);
+	int normalComponent = obj.findVertexComponent(geom::Data::SEMANTIC_NORMAL);
+	ASSERT_GE(normalComponent, 0);
+	for (size_t i = 0; i < obj.getVerticesCount(); i++)
+	{
+		const float* normal = (const float*)(obj.getVertexData() + i * obj.getVertexSize() + obj.getVertexComponentOffset(normalComponent));
+		ASSERT_NEAR(normal[1], 1.0f, 1e-5f);
+	}
+
+	fp = fopen("geomlibtests_invalid.obj", "w");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "v 0 0 0\nv 1 0 0\nv 1 0 1\nf 1 2 4\n");
+	fclose(fp);
+	geom::Data invalid = geom::Geometry::instance().load("geomlibtests_invalid.obj");
+	remove("geomlibtests_invalid.obj");
+	ASSERT_FALSE(invalid.isCorrect());
+
+	fp = fopen("geomlibtests_ascii.ply", "w");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "ply\nformat ascii 1.0\ncomment quad\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n");
+	fprintf(fp, "element face 1\nproperty list uchar int vertex_indices\nend_header\n");
+	fprintf(fp, "0 0 0\n1 0 0\n1 0 1\n0 0 1\n4 0 1 2 3\n");
+	fclose(fp);
+
+	// binary data with an additional element to skip
+	float positions[] = { 0, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1 };
+	unsigned char faceSize = 4;
+	int face[] = { 0, 1, 2, 3 };
+	fp = fopen("geomlibtests_binary.ply", "wb");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n");
+	fprintf(fp, "element face 1\nproperty list uchar int vertex_indices\nelement edge 1\nproperty int vertex1\nproperty int vertex2\nend_header\n");
+	fwrite(positions, sizeof(positions), 1, fp);
+	fwrite(&faceSize, sizeof(faceSize), 1, fp);
+	fwrite(face, sizeof(face), 1, fp);
+	fwrite(face, sizeof(int), 2, fp);
+	fclose(fp);
+
+	geom::Data ascii = geom::Geometry::instance().load("geomlibtests_ascii.ply");
+	geom::Data binary = geom::Geometry::instance().load("geomlibtests_binary.ply");
+	remove("geomlibtests_ascii.ply");
+	remove("geomlibtests_binary.ply");
+	ASSERT_TRUE(ascii.isCorrect());
+	ASSERT_TRUE(binary.isCorrect());
+	ASSERT_EQ(ascii.getVerticesCount(), 4);
+	ASSERT_EQ(ascii.getIndicesCount(), 6);
+	ASSERT_EQ(ascii.getVertexComponentsMask(), geom::Data::COMPONENTS_NORMAL);
+	assertEqual(ascii, binary);
+	normalComponent = ascii.findVertexComponent(geom::Data::SEMANTIC_NORMAL);
+	const float* normal = (const float*)(ascii.getVertexData() + ascii.getVertexComponentOffset(normalComponent));
+	ASSERT_NEAR(fabs(normal[1]), 1.0f, 1e-5f);
+
+	// binary triangles with a property before the list are parsed in parallel
+	fp = fopen("geomlibtests_triangles.ply", "wb");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n");
+	fprintf(fp, "element face 2\nproperty uchar flags\nproperty list uchar int vertex_indices\nend_header\n");
+	fwrite(positions, sizeof(positions), 1, fp);
+	unsigned char triangleHeader[] = { 0, 3 };
+	int triangles[] = { 0, 1, 2, 0, 2, 3 };
+	for (size_t i = 0; i < 2; i++)
+	{
+		fwrite(triangleHeader, sizeof(triangleHeader), 1, fp);
+		fwrite(triangles + i * 3, sizeof(int), 3, fp);
+	}
+	fclose(fp);
+	geom::Data triangulated = geom::Geometry::instance().load("geomlibtests_triangles.ply");
+	remove("geomlibtests_triangles.ply");
+	ASSERT_TRUE(triangulated.isCorrect());
+	assertEqual(ascii, triangulated);
+
+	// an invalid index is still reported
+	fp = fopen("geomlibtests_triangles.ply", "wb");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n");
+	fprintf(fp, "element face 1\nproperty list uchar int vertex_indices\nend_header\n");
+	fwrite(positions, sizeof(positions), 1, fp);
+	int invalidTriangle[] = { 0, 1, 4 };
+	fwrite(&triangleHeader[1], 1, 1, fp);
+	fwrite(invalidTriangle, sizeof(invalidTriangle), 1, fp);
+	fclose(fp);
+	invalid = geom::Geometry::instance().load("geomlibtests_triangles.ply");
+	remove("geomlibtests_triangles.ply");
+	ASSERT_FALSE(invalid.isCorrect());
+}
+
+TEST_F(GeomlibTests, StaticBatching)
+{
+	geom::Data plane = generatePlane(4, 4);
+	geom::Data smallPlane = generatePlane(2, 2);
+	ASSERT_TRUE(plane.isCorrect());
+	ASSERT_TRUE(smallPlane.isCorrect());
+	geom::DataWriter(&plane).getMeshesRef()[0].material.diffuseMapFilename = "grass";
+	geom::DataWriter(&smallPlane).getMeshesRef()[0].material.diffuseMapFilename = "stone";
+
+	matrix44 translation;
+	translation.M41 = 10.0f;
+	matrix44 mirror;
+	mirror.M11 = -1.0f;
+	mirror.M43 = 5.0f;
+	std::vector<const geom::Data*> sources = { &plane, &smallPlane };
+	std::vector<geom::BatchInstance> instances = { geom::BatchInstance(0, matrix44()), 
+												   geom::BatchInstance(1, translation), 
+												   geom::BatchInstance(0, mirror) };
+	geom::Data merged = geom::StaticBatcher::merge(sources, instances);
+	ASSERT_TRUE(merged.isCorrect());
+	ASSERT_EQ(merged.getVertexFormat(), plane.getVertexFormat());
+	ASSERT_EQ(merged.getVerticesCount(), plane.getVerticesCount() * 2 + smallPlane.getVerticesCount());
+	ASSERT_EQ(merged.getIndicesCount(), plane.getIndicesCount() * 2 + smallPlane.getIndicesCount());
+
+	// instances of the same material are merged into one mesh
+	ASSERT_EQ(merged.getMeshes().size(), 2);
+	ASSERT_EQ(merged.getMeshes()[0].material.diffuseMapFilename, "grass");
+	ASSERT_EQ(merged.getMeshes()[0].indicesCount, plane.getIndicesCount() * 2);
+	ASSERT_EQ(merged.getMeshes()[1].material.diffuseMapFilename, "stone");
+	ASSERT_EQ(merged.getMeshes()[1].offsetInIB, plane.getIndicesCount() * 2);
+
+	// indices are rebased, triangles of the mirrored instance are flipped
+	const unsigned int* indices = merged.getIndexData();
+	unsigned int mirroredFirstVertex = (unsigned int)(plane.getVerticesCount() + smallPlane.getVerticesCount());
+	ASSERT_EQ(indices[0], plane.getIndexData()[0]);
+	ASSERT_EQ(indices[plane.getIndicesCount()], plane.getIndexData()[0] + mirroredFirstVertex);
+	ASSERT_EQ(indices[plane.getIndicesCount() + 1], plane.getIndexData()[2] + mirroredFirstVertex);
+	ASSERT_EQ(indices[plane.getIndicesCount() * 2], smallPlane.getIndexData()[0] + plane.getVerticesCount());
+
+	vector3 translated = merged.getPosition(plane.getVerticesCount());
+	ASSERT_NEAR(translated.x, smallPlane.getPosition(0).x + 10.0f, 1e-5f);
+	vector3 mirrored = merged.getPosition(mirroredFirstVertex);
+	ASSERT_NEAR(mirrored.x, -plane.getPosition(0).x, 1e-5f);
+	ASSERT_NEAR(mirrored.z, plane.getPosition(0).z + 5.0f, 1e-5f);
+	ASSERT_NEAR(merged.getBoundingBox().vmax.x, smallPlane.getBoundingBox().vmax.x + 10.0f, 1e-4f);
+
+	instances.push_back(geom::BatchInstance(2, matrix44()));
+	ASSERT_FALSE(geom::StaticBatcher::merge(sources, instances).isCorrect());
+}
+
+TEST_F(GeomlibTests, TangentFrames)
+{
+	geom::Data plane = generatePlane(8, 6);
+	ASSERT_TRUE(plane.isCorrect());
+
+	// tangents follow the U direction and binormals follow the V direction of texture coordinates
+	geom::Data data = geom::TangentFrameCalculator::calculate(plane);
+	ASSERT_TRUE(data.isCorrect());
+	ASSERT_EQ(data.getVertexFormat(), plane.getVertexFormat());
+	ASSERT_EQ(data.getVertexComponentsMask(), plane.getVertexComponentsMask());
+	const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+	for (size_t i = 0; i < data.getVerticesCount(); i++)
+	{
+		ASSERT_TRUE(vertices[i].tangent.isequal(vector3(1.0f, 0.0f, 0.0f), 1e-4f));
+		ASSERT_TRUE(vertices[i].binormal.isequal(vector3(0.0f, 0.0f, 1.0f), 1e-4f));
+	}
+
+	// mirrored texture coordinates flip the tangent and the sign of the binormal
+	geom::Data mirrored = plane;
+	geom::DataWriter writer(&mirrored);
+	geom::Data::Vertex* mirroredVertices = reinterpret_cast<geom::Data::Vertex*>(writer.getVertexBufferRef().data());
+	for (size_t i = 0; i < mirrored.getVerticesCount(); i++)
+	{
+		mirroredVertices[i].texCoord0.x = -mirroredVertices[i].texCoord0.x;
+		mirroredVertices[i].tangent = vector3();
+		mirroredVertices[i].binormal = vector3();
+	}
+	ASSERT_TRUE(geom::TangentFrameCalculator::calculate(writer));
+	for (size_t i = 0; i < mirrored.getVerticesCount(); i++)
+	{
+		ASSERT_TRUE(mirroredVertices[i].tangent.isequal(vector3(-1.0f, 0.0f, 0.0f), 1e-4f));
+		ASSERT_TRUE(mirroredVertices[i].binormal.isequal(vector3(0.0f, 0.0f, 1.0f), 1e-4f));
+		ASSERT_GT(mirroredVertices[i].binormal % (mirroredVertices[i].normal * mirroredVertices[i].tangent), 0.0f);
+		ASSERT_LT(vertices[i].binormal % (vertices[i].normal * vertices[i].tangent), 0.0f);
+	}
+
+	// vertices on the seam between halves of both orientations are split, 
+	// every triangle gets frames of its own orientation
+	geom::Data seam = plane;
+	geom::DataWriter seamWriter(&seam);
+	geom::Data::Vertex* seamVertices = reinterpret_cast<geom::Data::Vertex*>(seamWriter.getVertexBufferRef().data());
+	size_t seamVerticesCount = 0;
+	for (size_t i = 0; i < seam.getVerticesCount(); i++)
+	{
+		seamVertices[i].texCoord0.x = fabs(seamVertices[i].texCoord0.x - 0.5f);
+		if (seamVertices[i].texCoord0.x == 0.0f) seamVerticesCount++;
+	}
+	ASSERT_GT(seamVerticesCount, 0);
+	ASSERT_TRUE(geom::TangentFrameCalculator::calculate(seamWriter));
+	ASSERT_EQ(seam.getVerticesCount(), plane.getVerticesCount() + seamVerticesCount);
+	seamVertices = reinterpret_cast<geom::Data::Vertex*>(seamWriter.getVertexBufferRef().data());
+	const unsigned int* seamIndices = seam.getIndexData();
+	for (size_t i = 0; i < seam.getIndicesCount(); i += 3)
+	{
+		const geom::Data::Vertex* v[3] = { &seamVertices[seamIndices[i]], &seamVertices[seamIndices[i + 1]], &seamVertices[seamIndices[i + 2]] };
+		vector2 t1 = v[1]->texCoord0 - v[0]->texCoord0;
+		vector2 t2 = v[2]->texCoord0 - v[0]->texCoord0;
+		float orientation = t1.x * t2.y - t1.y * t2.x;
+		for (size_t k = 0; k < 3; k++)
+		{
+			float handedness = v[k]->binormal % (v[k]->normal * v[k]->tangent);
+			ASSERT_GT(orientation * handedness, 0.0f);
+		}
+	}
+
+	// tangent frames are orthonormal on curved surfaces and don't depend on the number of threads
+	// (ranges are processed on the calling thread inside tasks of a thread pool)
+	geom::Data terrain = generateTerrain(64, 64);
+	ASSERT_TRUE(terrain.isCorrect());
+	geom::Data terrainFrames = geom::TangentFrameCalculator::calculate(terrain);
+	ASSERT_TRUE(terrainFrames.isCorrect());
+	geom::Data terrainFrames2;
+	{
+		utils::ThreadPool threadPool(1);
+		threadPool.enqueue([&]() { terrainFrames2 = geom::TangentFrameCalculator::calculate(terrain); });
+	}
+	ASSERT_EQ(terrainFrames2.getVertexDataSize(), terrainFrames.getVertexDataSize());
+	ASSERT_EQ(memcmp(terrainFrames.getVertexData(), terrainFrames2.getVertexData(), terrainFrames.getVertexDataSize()), 0);
+	const geom::Data::Vertex* terrainVertices = reinterpret_cast<const geom::Data::Vertex*>(terrainFrames.getVertexData());
+	for (size_t i = 0; i < terrainFrames.getVerticesCount(); i++)
+	{
+		ASSERT_NEAR(terrainVertices[i].tangent.len(), 1.0f, 1e-4f);
+		ASSERT_NEAR(terrainVertices[i].binormal.len(), 1.0f, 1e-4f);
+		ASSERT_NEAR(terrainVertices[i].tangent % terrainVertices[i].normal, 0.0f, 1e-4f);
+		ASSERT_NEAR(terrainVertices[i].binormal % terrainVertices[i].normal, 0.0f, 1e-4f);
+	}
+
+	// compact formats are kept, data without texture coordinates is rejected
+	geom::Data compact = geom::VertexFormatConverter::convert(plane, geom::Data::VERTEX_FORMAT_COMPACT);
+	geom::Data compactFrames = geom::TangentFrameCalculator::calculate(compact);
+	ASSERT_TRUE(compactFrames.isCorrect());
+	ASSERT_EQ(compactFrames.getVertexFormat(), geom::Data::VERTEX_FORMAT_COMPACT);
+	geom::Data noUVs = geom::VertexFormatConverter::convert(plane, geom::Data::VERTEX_FORMAT_FULL, geom::Data::COMPONENTS_NORMAL);
+	ASSERT_FALSE(geom::TangentFrameCalculator::calculate(noUVs).isCorrect());
+}
+
+TEST_F(GeomlibTests, HeightfieldQueries)
+{
+	geom::TerrainGenerationInfo info;
+	info.heightmapWidth = 67;
+	info.heightmapHeight = 40;
+	info.heightmap.resize(info.heightmapWidth * info.heightmapHeight);
+	for (size_t i = 0; i < info.heightmap.size(); i++)
+	{
+		info.heightmap[i] = (unsigned char)(rand() % 256);
+	}
+	geom::TerrainGenerator generator;
+	generator.setTerrainGenerationInfo(info);
+	geom::Data terrain = generator.generate();
+	ASSERT_TRUE(terrain.isCorrect());
+
+	geom::Heightfield heightfield;
+	ASSERT_TRUE(heightfield.init(info));
+	ASSERT_EQ(heightfield.getSamplesCountX() * heightfield.getSamplesCountY(), terrain.getVerticesCount());
+	ASSERT_EQ(heightfield.getLevelsCount(), 8);
+	bbox3 box = heightfield.getBoundingBox();
+	ASSERT_NEAR(box.vmin.x, terrain.getBoundingBox().vmin.x, 1e-5f);
+	ASSERT_NEAR(box.vmax.z, terrain.getBoundingBox().vmax.z, 1e-5f);
+
+	// heights match vertices, between them heights are interpolated, out of the terrain they are clamped
+	for (size_t i = 0; i < terrain.getVerticesCount(); i++)
+	{
+		vector3 p = terrain.getPosition(i);
+		ASSERT_NEAR(heightfield.getHeight(p.x, p.z), p.y, 1e-4f);
+	}
+	vector3 p0 = terrain.getPosition(0);
+	vector3 p1 = terrain.getPosition(1);
+	ASSERT_NEAR(heightfield.getHeight(0.5f * (p0.x + p1.x), p0.z), 0.5f * (p0.y + p1.y), 1e-5f);
+	ASSERT_NEAR(heightfield.getHeight(p0.x - 100.0f, p0.z - 100.0f), p0.y, 1e-5f);
+
+	// batched queries give the same heights
+	std::vector<vector2> points(1003);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i] = vector2(info.size.x * (float(rand()) / RAND_MAX - 0.5f) * 1.2f, info.size.y * (float(rand()) / RAND_MAX - 0.5f) * 1.2f);
+	}
+	std::vector<float> heights(points.size());
+	heightfield.getHeights(points.data(), points.size(), heights.data());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		ASSERT_NEAR(heights[i], heightfield.getHeight(points[i].x, points[i].y), 1e-5f);
+	}
+
+	// ray queries are compared with the BVH of the terrain mesh
+	geom::Bvh bvh;
+	ASSERT_TRUE(bvh.build(terrain));
+	vector3 center = box.center();
+	vector3 size = box.size();
+	size_t hitsCount = 0;
+	for (int r = 0; r < 500; r++)
+	{
+		auto randomPoint = [&](float scale)
+		{
+			return center + vector3(size.x * (float(rand()) / RAND_MAX - 0.5f) * scale,
+									size.y * (float(rand()) / RAND_MAX - 0.5f) * scale,
+									size.z * (float(rand()) / RAND_MAX - 0.5f) * scale);
+		};
+		line3 line(randomPoint(3.0f), randomPoint(1.0f));
+		if (r % 4 == 0) line = line3(randomPoint(1.0f), randomPoint(1.0f));
+		if (r % 4 == 1) line = line3(line.b + vector3(0.0f, size.y * 2.0f, 0.0f), line.b - vector3(0.0f, size.y * 2.0f, 0.0f));
+
+		geom::BvhHit reference;
+		geom::HeightfieldHit hit;
+		bool found = heightfield.findClosestHit(line, hit);
+		ASSERT_EQ(found, bvh.findClosestHit(line, reference));
+		ASSERT_EQ(heightfield.findAnyHit(line), found);
+		if (!found) continue;
+
+		hitsCount++;
+		ASSERT_NEAR(hit.t, reference.t, 1e-4f);
+		ASSERT_NEAR(hit.normal.len(), 1.0f, 1e-4f);
+		ASSERT_TRUE(hit.normal.y > 0.0f);
+	}
+	ASSERT_TRUE(hitsCount > 100);
+
+	geom::TerrainGenerationInfo emptyInfo;
+	ASSERT_FALSE(geom::Heightfield().init(emptyInfo));
+}
+
+TEST_F(GeomlibTests, TerrainTiles)
+{
+	geom::TerrainGenerationInfo info;
+	info.heightmapFormat = geom::HEIGHTMAP_FORMAT_R16;
+	// rows of tiles span several pages of the memory-mapped file
+	info.heightmapWidth = 258;
+	info.heightmapHeight = 50;
+	std::vector<unsigned short> samples(info.heightmapWidth * info.heightmapHeight);
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		samples[i] = (unsigned short)(rand() % 65536);
+	}
+	info.heightmap.resize(samples.size() * sizeof(unsigned short));
+	memcpy(info.heightmap.data(), samples.data(), info.heightmap.size());
+	geom::TerrainGenerator generator;
+	generator.setTerrainGenerationInfo(info);
+	geom::Data terrain = generator.generate();
+	ASSERT_TRUE(terrain.isCorrect());
+	ASSERT_EQ(terrain.getVerticesCount(), samples.size());
+
+	// float heightmaps give the same terrain
+	geom::TerrainGenerationInfo floatInfo = info;
+	floatInfo.heightmapFormat = geom::HEIGHTMAP_FORMAT_R32F;
+	floatInfo.heightmap.resize(samples.size() * sizeof(float));
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		float sample = float(samples[i]) / 65535.0f;
+		memcpy(floatInfo.heightmap.data() + i * sizeof(float), &sample, sizeof(float));
+	}
+	generator.setTerrainGenerationInfo(floatInfo);
+	geom::Data floatTerrain = generator.generate();
+	ASSERT_TRUE(floatTerrain.isCorrect());
+	ASSERT_EQ(memcmp(floatTerrain.getVertexData(), terrain.getVertexData(), terrain.getVertexDataSize()), 0);
+	floatInfo.heightmap.resize(samples.size());
+	generator.setTerrainGenerationInfo(floatInfo);
+	ASSERT_FALSE(generator.generate().isCorrect());
+
+	// tiles are equal to parts of the whole terrain, tiles on the borders are smaller
+	geom::TerrainTileGenerationInfo tileInfo;
+	tileInfo.heightmapFormat = info.heightmapFormat;
+	tileInfo.heightmapWidth = info.heightmapWidth;
+	tileInfo.heightmapHeight = info.heightmapHeight;
+	tileInfo.tileSize = 16;
+	geom::TerrainTileGenerator tileGenerator;
+	tileGenerator.setTerrainTileGenerationInfo(tileInfo);
+	ASSERT_EQ(tileGenerator.getTilesCountX(), 17);
+	ASSERT_EQ(tileGenerator.getTilesCountY(), 4);
+
+	const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(terrain.getVertexData());
+	size_t tilesCount = 0;
+	size_t trianglesCount = 0;
+	auto checkTile = [&](size_t tileX, size_t tileY, const geom::Data& tile)
+	{
+		EXPECT_EQ(tileX, tilesCount % 17);
+		EXPECT_EQ(tileY, tilesCount / 17);
+		EXPECT_TRUE(tile.isCorrect());
+		size_t tileWidth = std::min(tileX * 16 + 16, info.heightmapWidth - 1) - tileX * 16 + 1;
+		size_t tileHeight = std::min(tileY * 16 + 16, info.heightmapHeight - 1) - tileY * 16 + 1;
+		EXPECT_EQ(tile.getVerticesCount(), tileWidth * tileHeight);
+		const geom::Data::Vertex* tileVertices = reinterpret_cast<const geom::Data::Vertex*>(tile.getVertexData());
+		for (size_t y = 0; y < tileHeight; y++)
+		{
+			const geom::Data::Vertex* row = vertices + (tileY * 16 + y) * info.heightmapWidth + tileX * 16;
+			EXPECT_EQ(memcmp(tileVertices + y * tileWidth, row, tileWidth * sizeof(geom::Data::Vertex)), 0);
+		}
+		EXPECT_EQ(tile.getBoundingBox().vmin.x, tileVertices[0].position.x);
+		EXPECT_EQ(tile.getBoundingBox().vmin.z, tileVertices[0].position.z);
+		tilesCount++;
+		trianglesCount += tile.getIndicesCount() / 3;
+		return true;
+	};
+	bool result = tileGenerator.generate(info.heightmap.data(), checkTile);
+	ASSERT_TRUE(result);
+	ASSERT_EQ(tilesCount, 17 * 4);
+	ASSERT_EQ(trianglesCount, terrain.getIndicesCount() / 3);
+
+	// heightmaps are memory-mapped from raw files, rows of the file which have been released 
+	// after a row of tiles are read again by the next one
+	const std::string heightmapFile = "geomlibtests_heightmap.r16";
+	FILE* fp = fopen(heightmapFile.c_str(), "wb");
+	ASSERT_TRUE(fp != 0);
+	const unsigned int header = 0;
+	fwrite(&header, sizeof(header), 1, fp);
+	fwrite(info.heightmap.data(), 1, info.heightmap.size(), fp);
+	fclose(fp);
+	tileInfo.heightmapOffset = sizeof(header);
+	tileGenerator.setTerrainTileGenerationInfo(tileInfo);
+	tilesCount = 0;
+	trianglesCount = 0;
+	result = tileGenerator.generate(heightmapFile, checkTile);
+	ASSERT_TRUE(result);
+	ASSERT_EQ(tilesCount, 17 * 4);
+	ASSERT_EQ(trianglesCount, terrain.getIndicesCount() / 3);
+
+	// the generation can be stopped
+	tilesCount = 0;
+	result = tileGenerator.generate(heightmapFile, [&](size_t, size_t, const geom::Data& tile)
+	{
+		EXPECT_EQ(memcmp(tile.getVertexData(), vertices, sizeof(geom::Data::Vertex)), 0);
+		tilesCount++;
+		return false;
+	});
+	ASSERT_FALSE(result);
+	ASSERT_FALSE(tileGenerator.getLastError().empty());
+	ASSERT_EQ(tilesCount, 1);
+
+	tileInfo.heightmapHeight++;
+	tileGenerator.setTerrainTileGenerationInfo(tileInfo);
+	ASSERT_FALSE(tileGenerator.generate(heightmapFile, [](size_t, size_t, const geom::Data&) { return true; }));
+	ASSERT_FALSE(tileGenerator.getLastError().empty());
+	remove(heightmapFile.c_str());
+}
@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 #include "framework.h"
+#include "geomformat.h"
+#include <atomic>
+#include <condition_variable>
+#include "parallel.h"
+#include "threadpool.h"
 
 class UtilsTests : public testing::Test
 {
@@ -11,6 +16,47 @@ public:
 	void TearDown() 
 	{
 	}
+
+	geom::Data generatePlane(int segmentsX, int segmentsY)
+	{
+		geom::PlaneGenerationInfo info;
+		info.segments[0] = segmentsX;
+		info.segments[1] = segmentsY;
+		geom::PlaneGenerator generator;
+		generator.setPlaneGenerationInfo(info);
+		return generator.generate();
+	}
+
+	// files written before materials were embedded, the section is turned into an ignored one
+	void saveWithoutMaterials(const geom::Data& data, const std::string& fileName)
+	{
+		ASSERT_TRUE(geom::Geometry::instance().save(data, fileName));
+		std::vector<unsigned char> header(geom::GEOM_HEADER_SIZE);
+		FILE* fp = fopen(fileName.c_str(), "r+b");
+		ASSERT_TRUE(fp != 0);
+		ASSERT_EQ(fread(header.data(), header.size(), 1, fp), 1);
+		unsigned int sectionsCount = header[8] | (header[9] << 8) | (header[10] << 16) | (header[11] << 24);
+		header.resize(geom::GEOM_HEADER_SIZE + sectionsCount * geom::GEOM_SECTION_ENTRY_SIZE);
+		ASSERT_EQ(fread(header.data() + geom::GEOM_HEADER_SIZE, header.size() - geom::GEOM_HEADER_SIZE, 1, fp), 1);
+		for (unsigned int i = 0; i < sectionsCount; i++)
+		{
+			unsigned char* type = header.data() + geom::GEOM_HEADER_SIZE + i * geom::GEOM_SECTION_ENTRY_SIZE;
+			if (type[0] == geom::GEOM_SECTION_MATERIALS) type[0] = geom::GEOM_SECTION_EXTRAS;
+		}
+		fseek(fp, 0, SEEK_SET);
+		ASSERT_EQ(fwrite(header.data(), header.size(), 1, fp), 1);
+		fclose(fp);
+	}
+
+	void assertEqual(const geom::Data& d1, const geom::Data& d2)
+	{
+		ASSERT_EQ(d1.getVerticesCount(), d2.getVerticesCount());
+		ASSERT_EQ(d1.getVertexDataSize(), d2.getVertexDataSize());
+		ASSERT_EQ(memcmp(d1.getVertexData(), d2.getVertexData(), d1.getVertexDataSize()), 0);
+		ASSERT_EQ(d1.getIndicesCount(), d2.getIndicesCount());
+		ASSERT_EQ(memcmp(d1.getIndexData(), d2.getIndexData(), d1.getIndicesCount() * sizeof(unsigned int)), 0);
+		ASSERT_EQ(d1.getMeshes().size(), d2.getMeshes().size());
+	}
 };
 
 TEST_F(UtilsTests, Tokenize)
@@ -66,4 +112,96 @@ TEST_F(UtilsTests, Tokenize)
 	ASSERT_EQ(result8.size(), 1);
 	ASSERT_EQ((*result8.begin()).first, 0);
 	ASSERT_EQ((*result8.begin()).second, 2);
+}
+
+TEST_F(UtilsTests, NestedParallelRanges)
+{
+	// nested calls don't spawn threads, every call is processed inline as a single range
+	auto runNested = [](std::atomic<size_t>& nestedRanges)
+	{
+		utils::Parallel::forRange(1000, [&nestedRanges](size_t begin, size_t end, size_t rangeIndex)
+		{
+			nestedRanges++;
+		});
+	};
+
+	const size_t threadsCount = utils::Parallel::getThreadsCount();
+	std::atomic<size_t> rangesCount(0);
+	std::atomic<size_t> nestedRanges(0);
+	utils::Parallel::forRange(threadsCount, [&](size_t begin, size_t end, size_t rangeIndex)
+	{
+		// a single range is processed on the calling thread as a usual loop
+		ASSERT_EQ(utils::Parallel::isWorkerThread(), threadsCount > 1);
+		rangesCount++;
+		runNested(nestedRanges);
+	});
+	ASSERT_EQ(rangesCount, threadsCount);
+	ASSERT_EQ(nestedRanges, threadsCount);
+	ASSERT_FALSE(utils::Parallel::isWorkerThread());
+
+	nestedRanges = 0;
+	{
+		utils::ThreadPool threadPool(2);
+		for (size_t i = 0; i < 4; i++)
+		{
+			threadPool.enqueue([&]()
+			{
+				EXPECT_TRUE(utils::Parallel::isWorkerThread());
+				runNested(nestedRanges);
+			});
+		}
+	}
+	ASSERT_EQ(nestedRanges, 4);
+}
+
+TEST_F(UtilsTests, PackedArchive)
+{
+	ASSERT_EQ(utils::Archive::normalizePath(".\\Data/media/../Shaders//common.h"), "data/shaders/common.h");
+
+	geom::Data data = generatePlane(8, 8);
+	geom::DataWriter writer(&data);
+	writer.getMeshesRef()[0].material.diffuseMapFilename = "plane_diff";
+	ASSERT_TRUE(geom::Geometry::instance().save(data, "utilstests_packed.geom"));
+	geom::Data legacy = generatePlane(4, 4);
+	saveWithoutMaterials(legacy, "utilstests_packed_legacy.geom");
+	FILE* fp = fopen("utilstests_packed_legacy.material", "w");
+	ASSERT_TRUE(fp != 0);
+	fprintf(fp, "[{\"diffuseMap\":\"legacy_diff\"}]");
+	fclose(fp);
+
+	std::vector<std::string> files;
+	files.push_back("utilstests_packed.geom");
+	files.push_back("utilstests_packed_legacy.geom");
+	files.push_back("utilstests_packed_legacy.material");
+	ASSERT_TRUE(utils::Archive::save("utilstests.pack", files));
+	for (size_t i = 0; i < files.size(); i++) remove(files[i].c_str());
+
+	// files are found in the archive only
+	utils::Archive& archive = utils::Archive::instance();
+	ASSERT_TRUE(archive.open("utilstests.pack"));
+	ASSERT_EQ(archive.getFilesCount(), files.size());
+	ASSERT_TRUE(archive.contains("./UTILSTESTS_PACKED.geom"));
+	ASSERT_FALSE(archive.contains("utilstests_packed.material"));
+	const unsigned char* packedData = 0;
+	size_t packedSize = 0;
+	ASSERT_TRUE(archive.find("utilstests_packed.geom", packedData, packedSize));
+	ASSERT_EQ((size_t)(packedData - archive.getMappedFile()->getData()) % utils::ARCHIVE_FILE_ALIGNMENT, 0);
+
+	geom::Data loaded = geom::Geometry::instance().load("utilstests_packed.geom");
+	ASSERT_TRUE(loaded.isCorrect());
+	assertEqual(data, loaded);
+	ASSERT_EQ(loaded.getMeshes()[0].material.diffuseMapFilename, "plane_diff");
+
+	geom::Data loadedLegacy = geom::Geometry::instance().load("utilstests_packed_legacy.geom");
+	ASSERT_TRUE(loadedLegacy.isCorrect());
+	ASSERT_EQ(loadedLegacy.getMeshes()[0].material.diffuseMapFilename, "legacy_diff");
+
+	// mapped data keeps the archive alive
+	geom::Data mapped = geom::Geometry::instance().loadMapped("utilstests_packed.geom");
+	archive.close();
+	ASSERT_TRUE(mapped.isCorrect());
+	assertEqual(data, mapped);
+
+	geom::Data missing = geom::Geometry::instance().load("utilstests_packed.geom");
+	ASSERT_FALSE(missing.isCorrect());
 }
\ No newline at end of file
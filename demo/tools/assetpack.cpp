@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+
+#include "vector.h"
+#include "quaternion.h"
+
+#include "logger.h"
+#include "utils.h"
+#include "memorymappedfile.h"
+#include "archive.h"
+
+using namespace std;
+
+// packs all files of the directories into an archive, paths are stored as they are found,
+// so the tool has to be run from the working directory of demos (e.g. "assetpack data")
+int main(int argc, const char ** argv)
+{
+	std::string output = "data.pack";
+	std::vector<std::string> directories;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--output" && i + 1 < argc) output = argv[++i];
+		else directories.push_back(option);
+	}
+	if (directories.empty())
+	{
+		cout << "assetpack error: Command line arguments are incorrect. You have to call [assetpack [--output data.pack] directory ...].\n";
+		return -1;
+	}
+
+	std::vector<std::string> files;
+	for (size_t i = 0; i < directories.size(); i++)
+	{
+		if (!utils::Utils::isDirectory(directories[i]))
+		{
+			cout << "assetpack error: Directory '" << directories[i] << "' has not been found.\n";
+			return -1;
+		}
+		auto found = utils::Utils::findFilesRecursively(directories[i], "");
+		files.insert(files.end(), found.begin(), found.end());
+	}
+
+	// the archive must not pack itself
+	std::string normalizedOutput = utils::Archive::normalizePath(output);
+	files.erase(std::remove_if(files.begin(), files.end(), [&normalizedOutput](const std::string& file)
+	{
+		return utils::Archive::normalizePath(file) == normalizedOutput;
+	}), files.end());
+	std::sort(files.begin(), files.end());
+
+	utils::Logger::setOutputFlags(utils::Logger::CONSOLE);
+	if (!utils::Archive::save(output, files))
+	{
+		cout << "assetpack error: Failed to write archive '" << output << "'.\n";
+		return -1;
+	}
+
+	cout << "assetpack: " << files.size() << " files are packed into '" << output << "'.\n";
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <condition_variable>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "vector.h"
+#include "bbox.h"
+
+#include "utils.h"
+#include "parallel.h"
+#include "threadpool.h"
+#include "geometry.h"
+#include "geomformat.h"
+#include "staticbatcher.h"
+
+using namespace std;
+
+// Merges instances of geometries listed in a scene file into a single geom-file with one mesh
+// per material. Every line of the scene file is "filename.geom x y z [yaw in degrees [scale]]", 
+// lines beginning with '#' are comments. Texture names are kept, so the output is intended 
+// to be placed next to textures of the sources.
+int main(int argc, const char ** argv)
+{
+	std::string output = "batch.geom";
+	std::string scene;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--output" && i + 1 < argc) output = argv[++i];
+		else scene = option;
+	}
+	std::ifstream sceneFile(scene);
+	if (scene.empty() || !sceneFile.is_open())
+	{
+		cout << "geombatch error: Command line arguments are incorrect. You have to call [geombatch [--output batch.geom] scene.txt].\n";
+		return -1;
+	}
+
+	std::map<std::string, size_t> sourceIndices;
+	std::vector<std::string> sourceFiles;
+	std::vector<geom::BatchInstance> instances;
+	std::string line;
+	for (size_t lineIndex = 1; std::getline(sceneFile, line); lineIndex++)
+	{
+		if (line.empty() || line[0] == '#') continue;
+		std::istringstream stream(line);
+		std::string filename;
+		vector3 position;
+		float yaw = 0.0f, scale = 1.0f;
+		if (!(stream >> filename >> position.x >> position.y >> position.z))
+		{
+			cout << "geombatch error: Line " << lineIndex << " of the scene file is incorrect.\n";
+			return -1;
+		}
+		stream >> yaw >> scale;
+
+		auto it = sourceIndices.find(filename);
+		if (it == sourceIndices.end())
+		{
+			it = sourceIndices.insert(std::make_pair(filename, sourceFiles.size())).first;
+			sourceFiles.push_back(filename);
+		}
+		geom::BatchInstance instance;
+		instance.sourceIndex = it->second;
+		instance.transform.scale(vector3(scale, scale, scale));
+		instance.transform.rotate_y(n_deg2rad(yaw));
+		instance.transform.translate(position);
+		instances.push_back(instance);
+	}
+
+	std::vector<geom::Data> sources(sourceFiles.size());
+	std::vector<const geom::Data*> sourcePointers(sourceFiles.size());
+	for (size_t i = 0; i < sourceFiles.size(); i++)
+	{
+		sources[i] = geom::Geometry::instance().load(sourceFiles[i]);
+		if (!sources[i].isCorrect())
+		{
+			cout << "geombatch error: " << sources[i].getLastError() << " (" << sourceFiles[i] << ").\n";
+			return -1;
+		}
+		sourcePointers[i] = &sources[i];
+	}
+
+	geom::Data result = geom::StaticBatcher::merge(sourcePointers, instances);
+	if (!result.isCorrect())
+	{
+		cout << "geombatch error: " << result.getLastError() << ".\n";
+		return -1;
+	}
+	if (!geom::Geometry::instance().save(result, output))
+	{
+		cout << "geombatch error: Failed to write '" << output << "'.\n";
+		return -1;
+	}
+
+	cout << "geombatch: " << instances.size() << " instances of " << sourceFiles.size() << " geometries are merged into " 
+		 << result.getMeshes().size() << " meshes ('" << output << "').\n";
+	return 0;
+}
@@ -0,0 +1,724 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <future>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+
+#include "vector.h"
+#include "bbox.h"
+
+#include "utils.h"
+#include "timer.h"
+#include "parallel.h"
+#include "memorymappedfile.h"
+#include "geometry.h"
+#include "terraingenerator.h"
+#include "heightfield.h"
+#include "bvh.h"
+#include "blockcompressor.h"
+#include "tangentframecalculator.h"
+#include "geomformat.h"
+#include "geomsaver.h"
+
+using namespace std;
+
+// brute-force search of adjacent triangles, it was used by geom::Data before
+int getAdjacentIndex(int edge[2], int triangle[3])
+{
+	int pnts_tmp[3] = { triangle[0], triangle[1], triangle[2] };
+	int c = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			if (edge[i] == triangle[j]) { pnts_tmp[j] = -1; c++; break; }
+		}
+	}
+
+	if (c == 2)
+	{
+		if (pnts_tmp[0] != -1) return pnts_tmp[0];
+		else if (pnts_tmp[1] != -1) return pnts_tmp[1];
+		else return pnts_tmp[2];
+	}
+	return -1;
+}
+
+std::vector<geom::Data::TriangleAdjacency> calculateAdjacencyBruteForce(const geom::Data& data)
+{
+	std::vector<geom::Data::TriangleAdjacency> output;
+	const unsigned int* indices = data.getIndexData();
+	size_t trianglesCount = data.getIndicesCount() / 3;
+	output.reserve(trianglesCount);
+
+	geom::Data::TriangleAdjacency t;
+	int edge[2];
+	int triangle[3];
+	for (size_t i = 0; i < trianglesCount; i++)
+	{
+		t.points[0] = indices[i * 3];
+		t.points[1] = indices[i * 3 + 1];
+		t.points[2] = indices[i * 3 + 2];
+		t.adjacentPoints[0] = -1;
+		t.adjacentPoints[1] = -1;
+		t.adjacentPoints[2] = -1;
+
+		for (size_t j = 0; j < trianglesCount; j++)
+		{
+			if (j == i) continue;
+
+			triangle[0] = indices[j * 3];
+			triangle[1] = indices[j * 3 + 1];
+			triangle[2] = indices[j * 3 + 2];
+
+			for (int k = 0; k < 3; k++)
+			{
+				if (t.adjacentPoints[k] != -1) continue;
+				edge[0] = t.points[k]; edge[1] = t.points[(k + 1) % 3];
+				t.adjacentPoints[k] = getAdjacentIndex(edge, triangle);
+			}
+
+			if (t.adjacentPoints[0] != -1 && t.adjacentPoints[1] != -1 && t.adjacentPoints[2] != -1) break;
+		}
+
+		output.push_back(t);
+	}
+
+	return output;
+}
+
+// single-threaded per-vertex terrain generation, it was used by geom::TerrainGenerator before
+struct TerrainReference
+{
+	const geom::TerrainGenerationInfo& info;
+	int width;
+	int height;
+
+	TerrainReference(const geom::TerrainGenerationInfo& info) : info(info)
+	{
+		width = (int)(info.heightmapWidth & ~1);
+		height = (int)(info.heightmapHeight & ~1);
+	}
+
+	vector3 getPoint(int x, int y) const
+	{
+		vector3 pnt;
+		pnt.x = info.size.x * (float(x) / float(width - 1) - 0.5f);
+		pnt.z = info.size.y * (float(y) / float(height - 1) - 0.5f);
+		pnt.y = info.size.z * (float(info.heightmap[y * info.heightmapWidth + x]) / 255.0f - 0.5f);
+		return pnt;
+	}
+
+	void calculateTangentSpace(int x, int y, vector3& normal, vector3& tangent) const
+	{
+		vector3 center = getPoint(x, y);
+		normal = vector3(0, 0, 0);
+		tangent = vector3(0, 0, 0);
+		if (x + 1 < width)
+		{
+			if (y + 1 < height)
+			{
+				vector3 a = getPoint(x, y + 1) - center; a.norm();
+				vector3 b = getPoint(x + 1, y) - center; b.norm();
+				tangent += a; normal += (a * b);
+			}
+			if (y - 1 >= 0)
+			{
+				vector3 a = getPoint(x + 1, y) - center; a.norm();
+				vector3 b = getPoint(x, y - 1) - center; b.norm();
+				tangent -= b; normal += (a * b);
+			}
+		}
+		if (x - 1 >= 0)
+		{
+			if (y + 1 < height)
+			{
+				vector3 a = getPoint(x - 1, y) - center; a.norm();
+				vector3 b = getPoint(x, y + 1) - center; b.norm();
+				tangent += b; normal += (a * b);
+			}
+			if (y - 1 >= 0)
+			{
+				vector3 a = getPoint(x, y - 1) - center; a.norm();
+				vector3 b = getPoint(x - 1, y) - center; b.norm();
+				tangent -= a; normal += (a * b);
+			}
+		}
+		normal.norm();
+		tangent.norm();
+	}
+
+	std::vector<geom::Data::Vertex> generate(std::vector<unsigned int>& indices) const
+	{
+		std::vector<geom::Data::Vertex> vertices(width * height);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				geom::Data::Vertex& vertex = vertices[y * width + x];
+				vertex.position = getPoint(x, y);
+				calculateTangentSpace(x, y, vertex.normal, vertex.tangent);
+				vertex.binormal = vertex.normal * vertex.tangent;
+				vertex.texCoord0 = vector2(float(x) * info.uvSize.x / float(width - 1), float(y) * info.uvSize.y / float(height - 1));
+			}
+		}
+
+		indices.resize((width - 1) * (height - 1) * 6);
+		unsigned int currentIndex = 0;
+		for (int y = 0; y < height - 1; y++)
+		{
+			unsigned int offset = (unsigned int)(y * width);
+			for (int x = 0; x < width - 1; x++)
+			{
+				indices[currentIndex++] = offset + x;
+				indices[currentIndex++] = offset + x + width;
+				indices[currentIndex++] = offset + x + width + 1;
+				indices[currentIndex++] = offset + x + width + 1;
+				indices[currentIndex++] = offset + x + 1;
+				indices[currentIndex++] = offset + x;
+			}
+		}
+		return vertices;
+	}
+};
+
+geom::TerrainGenerationInfo generateTerrainInfo(size_t size)
+{
+	geom::TerrainGenerationInfo info;
+	info.heightmapWidth = size;
+	info.heightmapHeight = size;
+	info.heightmap.resize(size * size);
+	for (size_t i = 0; i < info.heightmap.size(); i++)
+	{
+		info.heightmap[i] = (unsigned char)(rand() % 256);
+	}
+	return info;
+}
+
+// time of terrain generation and maximum difference from the per-vertex generation
+int benchmarkTerrainGeneration(utils::Timer& timer)
+{
+	cout << "Terrain\tPer-vertex, ms\tRows, ms\tMax difference\n";
+	const size_t sizes[] = { 1024, 2048, 4096 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		geom::TerrainGenerationInfo info = generateTerrainInfo(sizes[i]);
+
+		double t = timer.getTime();
+		std::vector<unsigned int> referenceIndices;
+		std::vector<geom::Data::Vertex> reference = TerrainReference(info).generate(referenceIndices);
+		double referenceTime = (timer.getTime() - t) * 1000.0;
+
+		t = timer.getTime();
+		geom::TerrainGenerator generator;
+		generator.setTerrainGenerationInfo(info);
+		geom::Data data = generator.generate();
+		double generationTime = (timer.getTime() - t) * 1000.0;
+		if (!data.isCorrect() || data.getVerticesCount() != reference.size())
+		{
+			cout << "geombench error: Failed to generate terrain. Reason: " << data.getLastError() << ".\n";
+			return -1;
+		}
+
+		if (memcmp(data.getIndexData(), referenceIndices.data(), referenceIndices.size() * sizeof(unsigned int)) != 0)
+		{
+			cout << "geombench error: Index buffers of terrains are different.\n";
+			return -1;
+		}
+
+		float maxDifference = 0.0f;
+		const geom::Data::Vertex* vertices = reinterpret_cast<const geom::Data::Vertex*>(data.getVertexData());
+		for (size_t v = 0; v < reference.size(); v++)
+		{
+			const float* v1 = reinterpret_cast<const float*>(&vertices[v]);
+			const float* v2 = reinterpret_cast<const float*>(&reference[v]);
+			for (size_t k = 0; k < sizeof(geom::Data::Vertex) / sizeof(float); k++)
+			{
+				maxDifference = std::max(maxDifference, fabs(v1[k] - v2[k]));
+			}
+		}
+
+		cout << sizes[i] << "x" << sizes[i] << "\t" << referenceTime << "\t" << generationTime << "\t" << maxDifference << "\n";
+	}
+	return 0;
+}
+
+geom::Data generateTerrain(size_t size)
+{
+	geom::TerrainGenerationInfo info = generateTerrainInfo(size);
+	geom::TerrainGenerator generator;
+	generator.setTerrainGenerationInfo(info);
+	return generator.generate();
+}
+
+bool isEqual(const std::vector<geom::Data::TriangleAdjacency>& a1, const std::vector<geom::Data::TriangleAdjacency>& a2)
+{
+	if (a1.size() != a2.size()) return false;
+	for (size_t i = 0; i < a1.size(); i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (a1[i].points[k] != a2[i].points[k] || a1[i].adjacentPoints[k] != a2[i].adjacentPoints[k]) return false;
+		}
+	}
+	return true;
+}
+
+bool isEqual(const geom::Data& d1, const geom::Data& d2)
+{
+	if (d1.getVertexDataSize() != d2.getVertexDataSize() || d1.getIndicesCount() != d2.getIndicesCount() ||
+		d1.getMeshes().size() != d2.getMeshes().size()) return false;
+	if (memcmp(d1.getVertexData(), d2.getVertexData(), d1.getVertexDataSize()) != 0) return false;
+	if (memcmp(d1.getIndexData(), d2.getIndexData(), d1.getIndicesCount() * sizeof(unsigned int)) != 0) return false;
+	for (size_t i = 0; i < d1.getMeshes().size(); i++)
+	{
+		if (d1.getMeshes()[i].offsetInIB != d2.getMeshes()[i].offsetInIB || d1.getMeshes()[i].indicesCount != d2.getMeshes()[i].indicesCount) return false;
+	}
+	return true;
+}
+
+// loading time of source files, the result is compared with the converted .geom file beside
+int benchmarkLoading(int argc, const char ** argv, utils::Timer& timer)
+{
+	const int RUNS_COUNT = 3;
+	cout << "File\tTriangles\tLoading, ms\tResult\n";
+	for (int i = 2; i < argc; i++)
+	{
+		geom::Data data;
+		double bestTime = 0.0;
+		for (int run = 0; run < RUNS_COUNT; run++)
+		{
+			double t = timer.getTime();
+			data = geom::Geometry::instance().load(argv[i]);
+			double loadingTime = (timer.getTime() - t) * 1000.0;
+			if (run == 0 || loadingTime < bestTime) bestTime = loadingTime;
+		}
+		if (!data.isCorrect())
+		{
+			cout << argv[i] << "\t-\t-\t" << data.getLastError() << "\n";
+			continue;
+		}
+
+		std::string geomFile = utils::Utils::trimExtention(argv[i]) + ".geom";
+		geom::Data reference = geom::Geometry::instance().load(geomFile);
+		const char* result = "-";
+		if (reference.isCorrect() && reference.getVertexFormat() == geom::Data::VERTEX_FORMAT_FULL)
+		{
+			result = isEqual(data, reference) ? "equal to .geom" : "DIFFERENT from .geom";
+		}
+		cout << argv[i] << "\t" << data.getIndicesCount() / 3 << "\t" << bestTime << "\t" << result << "\n";
+	}
+	return 0;
+}
+
+// build time of BVH and throughput of ray queries, rays are random segments through the bounding box
+int benchmarkBvh(int argc, const char ** argv, utils::Timer& timer)
+{
+	const size_t RAYS_COUNT = 1000000;
+	cout << "Threads: " << utils::Parallel::getThreadsCount() << "\n";
+	cout << "File\tTriangles\tNodes\tDepth\tBuilding, ms\tClosest hit, Mrays/s\tAny hit, Mrays/s\tHits, %\n";
+	for (int i = 2; i < argc; i++)
+	{
+		geom::Data data = geom::Geometry::instance().load(argv[i]);
+		if (!data.isCorrect())
+		{
+			cout << argv[i] << "\t-\t-\t-\t-\t-\t-\t" << data.getLastError() << "\n";
+			continue;
+		}
+
+		geom::Bvh bvh;
+		double t = timer.getTime();
+		bvh.build(data);
+		double buildingTime = (timer.getTime() - t) * 1000.0;
+
+		srand(1);
+		bbox3 box = bvh.getBoundingBox();
+		vector3 center = box.center();
+		vector3 size = box.size();
+		auto randomPoint = [&](float scale)
+		{
+			return center + vector3(size.x * (float(rand()) / RAND_MAX - 0.5f) * scale,
+									size.y * (float(rand()) / RAND_MAX - 0.5f) * scale,
+									size.z * (float(rand()) / RAND_MAX - 0.5f) * scale);
+		};
+		std::vector<line3> lines(RAYS_COUNT);
+		for (size_t r = 0; r < RAYS_COUNT; r++)
+		{
+			vector3 start = randomPoint(3.0f);
+			lines[r] = line3(start, start + (randomPoint(1.0f) - start) * 2.0f);
+		}
+
+		std::vector<size_t> hitsCounts(utils::Parallel::getThreadsCount(), 0);
+		t = timer.getTime();
+		utils::Parallel::forRange(RAYS_COUNT, [&](size_t begin, size_t end, size_t rangeIndex)
+		{
+			geom::BvhHit hit;
+			for (size_t r = begin; r < end; r++)
+			{
+				if (bvh.findClosestHit(lines[r], hit)) hitsCounts[rangeIndex]++;
+			}
+		});
+		double closestHitTime = timer.getTime() - t;
+
+		t = timer.getTime();
+		utils::Parallel::forRange(RAYS_COUNT, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t r = begin; r < end; r++) bvh.findAnyHit(lines[r]);
+		});
+		double anyHitTime = timer.getTime() - t;
+
+		size_t hitsCount = 0;
+		for (size_t k = 0; k < hitsCounts.size(); k++) hitsCount += hitsCounts[k];
+		cout << argv[i] << "\t" << bvh.getTrianglesCount() << "\t" << bvh.getNodesCount() << "\t" << bvh.getDepth() << "\t" 
+			 << buildingTime << "\t" << double(RAYS_COUNT) / closestHitTime * 1e-6 << "\t" << double(RAYS_COUNT) / anyHitTime * 1e-6 << "\t"
+			 << 100.0 * double(hitsCount) / double(RAYS_COUNT) << "\n";
+	}
+	return 0;
+}
+
+// compression ratio of geom-files, throughput of compression of vertex and index buffers
+// and loading time of uncompressed and compressed files
+int benchmarkCompression(int argc, const char ** argv, utils::Timer& timer)
+{
+	const int RUNS_COUNT = 5;
+	const std::string uncompressedFile = "geombench_uncompressed.geom";
+	const std::string compressedFile = "geombench_compressed.geom";
+	cout << "Threads: " << utils::Parallel::getThreadsCount() << "\n";
+	cout << "File\tSize, KB\tCompressed, KB\tRatio\tCompression, MB/s\tDecompression, MB/s\tLoading, ms\tLoading compressed, ms\n";
+	for (int i = 2; i < argc; i++)
+	{
+		geom::Data data = geom::Geometry::instance().load(argv[i]);
+		if (!data.isCorrect())
+		{
+			cout << argv[i] << "\t-\t-\t-\t-\t-\t-\t" << data.getLastError() << "\n";
+			continue;
+		}
+
+		geom::GeomSaver saver;
+		bool saved = saver.save(data, uncompressedFile);
+		saver.setCompressionEnabled(true);
+		saved = saved && saver.save(data, compressedFile);
+		utils::MemoryMappedFile file;
+		size_t uncompressedSize = (saved && file.open(uncompressedFile)) ? file.getSize() : 0;
+		size_t compressedSize = (saved && file.open(compressedFile)) ? file.getSize() : 0;
+		file.close();
+		if (uncompressedSize == 0 || compressedSize == 0)
+		{
+			cout << argv[i] << "\t-\t-\t-\t-\t-\t-\tFailed to save temporary files\n";
+			continue;
+		}
+
+		// buffers are measured separately, because they are compressed as separate sections
+		const unsigned char* buffers[] = { data.getVertexData(), reinterpret_cast<const unsigned char*>(data.getIndexData()) };
+		size_t buffersSizes[] = { data.getVertexDataSize(), data.getIndicesCount() * sizeof(unsigned int) };
+		double compressionTime = 0.0, decompressionTime = 0.0;
+		size_t buffersSize = 0;
+		for (size_t b = 0; b < 2; b++)
+		{
+			std::vector<unsigned char> compressed;
+			double bestTime = 0.0;
+			bool isCompressed = false;
+			for (int run = 0; run < RUNS_COUNT; run++)
+			{
+				double t = timer.getTime();
+				isCompressed = geom::BlockCompressor::compress(buffers[b], buffersSizes[b], compressed);
+				double time = timer.getTime() - t;
+				if (run == 0 || time < bestTime) bestTime = time;
+			}
+			if (!isCompressed) continue;
+			compressionTime += bestTime;
+
+			std::vector<unsigned char> decompressed(buffersSizes[b]);
+			for (int run = 0; run < RUNS_COUNT; run++)
+			{
+				double t = timer.getTime();
+				geom::BlockCompressor::decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+				double time = timer.getTime() - t;
+				if (run == 0 || time < bestTime) bestTime = time;
+			}
+			decompressionTime += bestTime;
+			buffersSize += buffersSizes[b];
+		}
+
+		double loadingTimes[2] = { 0.0, 0.0 };
+		const std::string* files[] = { &uncompressedFile, &compressedFile };
+		bool isEqualData = true;
+		for (size_t f = 0; f < 2; f++)
+		{
+			for (int run = 0; run < RUNS_COUNT; run++)
+			{
+				double t = timer.getTime();
+				geom::Data loaded = geom::Geometry::instance().load(*files[f]);
+				double time = (timer.getTime() - t) * 1000.0;
+				if (run == 0 || time < loadingTimes[f]) loadingTimes[f] = time;
+				if (run == 0) isEqualData = isEqualData && loaded.isCorrect() && isEqual(data, loaded);
+			}
+		}
+		remove(uncompressedFile.c_str());
+		remove(compressedFile.c_str());
+
+		double megabytes = double(buffersSize) / (1024.0 * 1024.0);
+		cout << argv[i] << "\t" << uncompressedSize / 1024 << "\t" << compressedSize / 1024 << "\t" << double(uncompressedSize) / double(compressedSize) << "\t";
+		if (buffersSize != 0) cout << megabytes / compressionTime << "\t" << megabytes / decompressionTime << "\t";
+		else cout << "-\t-\t";
+		cout << loadingTimes[0] << "\t" << loadingTimes[1] << (isEqualData ? "" : "\tDIFFERENT") << "\n";
+	}
+	return 0;
+}
+
+// throughput of tangent frames calculation, every geometry is processed twice to check that results don't depend on threads scheduling
+int benchmarkTangentFrames(int argc, const char ** argv, utils::Timer& timer)
+{
+	const int RUNS_COUNT = 3;
+	std::vector<std::string> names;
+	std::vector<geom::Data> geometries;
+	if (argc == 2)
+	{
+		const size_t sizes[] = { 512, 1024, 2048 };
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		{
+			names.push_back(std::to_string(sizes[i]) + "x" + std::to_string(sizes[i]));
+			geometries.push_back(generateTerrain(sizes[i]));
+		}
+	}
+	for (int i = 2; i < argc; i++)
+	{
+		names.push_back(argv[i]);
+		geometries.push_back(geom::Geometry::instance().load(argv[i]));
+	}
+
+	cout << "Threads: " << utils::Parallel::getThreadsCount() << "\n";
+	cout << "Geometry\tTriangles\tCalculation, ms\tMtriangles/s\tResult\n";
+	for (size_t i = 0; i < geometries.size(); i++)
+	{
+		geom::Data result;
+		double bestTime = 0.0;
+		bool isDeterministic = true;
+		for (int run = 0; run < RUNS_COUNT; run++)
+		{
+			double t = timer.getTime();
+			geom::Data data = geom::TangentFrameCalculator::calculate(geometries[i]);
+			double time = (timer.getTime() - t) * 1000.0;
+			if (!data.isCorrect())
+			{
+				result = data;
+				break;
+			}
+			if (run == 0 || time < bestTime) bestTime = time;
+			if (run != 0)
+			{
+				isDeterministic = isDeterministic && data.getVertexDataSize() == result.getVertexDataSize() &&
+				                  memcmp(data.getVertexData(), result.getVertexData(), data.getVertexDataSize()) == 0;
+			}
+			result = data;
+		}
+		if (!result.isCorrect())
+		{
+			cout << names[i] << "\t-\t-\t-\t" << result.getLastError() << "\n";
+			continue;
+		}
+
+		size_t trianglesCount = result.getIndicesCount() / 3;
+		cout << names[i] << "\t" << trianglesCount << "\t" << bestTime << "\t" << double(trianglesCount) / (bestTime * 1000.0) << "\t" <<
+		        (isDeterministic ? "deterministic" : "NOT DETERMINISTIC") << "\n";
+	}
+	return 0;
+}
+
+// building time of heightfields of generated terrains, throughput of height queries (one by one, in a single batch
+// and in small batches) and ray queries, rays are random segments through the bounding box
+int benchmarkHeightfield(utils::Timer& timer)
+{
+	const size_t POINTS_COUNT = 4000000;
+	const size_t SMALL_BATCH_SIZE = 4096;
+	const size_t RAYS_COUNT = 1000000;
+	cout << "Threads: " << utils::Parallel::getThreadsCount() << "\n";
+	cout << "Terrain\tLevels\tBuilding, ms\tHeights, Mpoints/s\tBatched heights, Mpoints/s\tBatches of " << SMALL_BATCH_SIZE << ", Mpoints/s\tClosest hit, Mrays/s\tAny hit, Mrays/s\tHits, %\n";
+
+	const size_t sizes[] = { 512, 1024, 2048 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		geom::TerrainGenerationInfo info = generateTerrainInfo(sizes[i]);
+		geom::Heightfield heightfield;
+		double t = timer.getTime();
+		heightfield.init(info);
+		double buildingTime = (timer.getTime() - t) * 1000.0;
+
+		srand(1);
+		bbox3 box = heightfield.getBoundingBox();
+		vector3 center = box.center();
+		vector3 size = box.size();
+		std::vector<vector2> points(POINTS_COUNT);
+		for (size_t p = 0; p < POINTS_COUNT; p++)
+		{
+			points[p] = vector2(center.x + size.x * (float(rand()) / RAND_MAX - 0.5f), center.z + size.z * (float(rand()) / RAND_MAX - 0.5f));
+		}
+		std::vector<float> heights(POINTS_COUNT);
+		t = timer.getTime();
+		for (size_t p = 0; p < POINTS_COUNT; p++) heights[p] = heightfield.getHeight(points[p].x, points[p].y);
+		double heightsTime = timer.getTime() - t;
+		t = timer.getTime();
+		heightfield.getHeights(points.data(), POINTS_COUNT, heights.data());
+		double batchedHeightsTime = timer.getTime() - t;
+		t = timer.getTime();
+		for (size_t p = 0; p < POINTS_COUNT; p += SMALL_BATCH_SIZE)
+		{
+			heightfield.getHeights(points.data() + p, std::min(SMALL_BATCH_SIZE, POINTS_COUNT - p), heights.data() + p);
+		}
+		double smallBatchesTime = timer.getTime() - t;
+
+		auto randomPoint = [&](float scale)
+		{
+			return center + vector3(size.x * (float(rand()) / RAND_MAX - 0.5f) * scale,
+									size.y * (float(rand()) / RAND_MAX - 0.5f) * scale,
+									size.z * (float(rand()) / RAND_MAX - 0.5f) * scale);
+		};
+		std::vector<line3> lines(RAYS_COUNT);
+		for (size_t r = 0; r < RAYS_COUNT; r++)
+		{
+			vector3 start = randomPoint(3.0f);
+			lines[r] = line3(start, start + (randomPoint(1.0f) - start) * 2.0f);
+		}
+
+		std::vector<size_t> hitsCounts(utils::Parallel::getThreadsCount(), 0);
+		t = timer.getTime();
+		utils::Parallel::forRange(RAYS_COUNT, [&](size_t begin, size_t end, size_t rangeIndex)
+		{
+			geom::HeightfieldHit hit;
+			for (size_t r = begin; r < end; r++)
+			{
+				if (heightfield.findClosestHit(lines[r], hit)) hitsCounts[rangeIndex]++;
+			}
+		});
+		double closestHitTime = timer.getTime() - t;
+
+		t = timer.getTime();
+		utils::Parallel::forRange(RAYS_COUNT, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t r = begin; r < end; r++) heightfield.findAnyHit(lines[r]);
+		});
+		double anyHitTime = timer.getTime() - t;
+
+		size_t hitsCount = 0;
+		for (size_t k = 0; k < hitsCounts.size(); k++) hitsCount += hitsCounts[k];
+		cout << sizes[i] << "x" << sizes[i] << "\t" << heightfield.getLevelsCount() << "\t" << buildingTime << "\t" 
+			 << double(POINTS_COUNT) / heightsTime * 1e-6 << "\t" << double(POINTS_COUNT) / batchedHeightsTime * 1e-6 << "\t"
+			 << double(POINTS_COUNT) / smallBatchesTime * 1e-6 << "\t"
+			 << double(RAYS_COUNT) / closestHitTime * 1e-6 << "\t" << double(RAYS_COUNT) / anyHitTime * 1e-6 << "\t"
+			 << 100.0 * double(hitsCount) / double(RAYS_COUNT) << "\n";
+	}
+	return 0;
+}
+
+int main(int argc, const char ** argv)
+{
+	utils::Timer timer;
+	if (!timer.init())
+	{
+		cout << "geombench error: Failed to initialize timer.\n";
+		return -1;
+	}
+
+	if (argc > 2 && std::string(argv[1]) == "--load")
+	{
+		return benchmarkLoading(argc, argv, timer);
+	}
+	if (argc > 2 && std::string(argv[1]) == "--bvh")
+	{
+		return benchmarkBvh(argc, argv, timer);
+	}
+	if (argc > 2 && std::string(argv[1]) == "--compression")
+	{
+		return benchmarkCompression(argc, argv, timer);
+	}
+	if (argc >= 2 && std::string(argv[1]) == "--tangents")
+	{
+		return benchmarkTangentFrames(argc, argv, timer);
+	}
+	if (argc == 2 && std::string(argv[1]) == "--heightfield")
+	{
+		return benchmarkHeightfield(timer);
+	}
+	if (argc == 2 && std::string(argv[1]) == "--terrain")
+	{
+		return benchmarkTerrainGeneration(timer);
+	}
+
+	// brute-force search is quadratic, so it is skipped for large terrains
+	size_t maxBruteForceTriangles = 40000;
+	if (argc == 2)
+	{
+		maxBruteForceTriangles = (size_t)atoi(argv[1]);
+	}
+	else if (argc > 2)
+	{
+		cout << "geombench error: Command line arguments are incorrect. You have to call [geombench [maxBruteForceTriangles]] or [geombench --load filename ...] or [geombench --bvh filename ...] or [geombench --compression filename ...] or [geombench --tangents [filename ...]] or [geombench --heightfield] or [geombench --terrain].\n";
+		return -1;
+	}
+
+	cout << "Threads: " << utils::Parallel::getThreadsCount() << "\n";
+	cout << "Terrain\tTriangles\tBrute-force, ms\tEdge hash, ms\tResult\n";
+
+	const size_t sizes[] = { 32, 64, 128, 256, 512, 1024, 2048 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		geom::Data data = generateTerrain(sizes[i]);
+		if (!data.isCorrect())
+		{
+			cout << "geombench error: Failed to generate terrain. Reason: " << data.getLastError() << ".\n";
+			return -1;
+		}
+		size_t trianglesCount = data.getIndicesCount() / 3;
+
+		double t = timer.getTime();
+		std::vector<geom::Data::TriangleAdjacency> adjacency = data.calculateAdjacency();
+		double edgeHashTime = (timer.getTime() - t) * 1000.0;
+
+		cout << sizes[i] << "x" << sizes[i] << "\t" << trianglesCount << "\t";
+		if (trianglesCount <= maxBruteForceTriangles)
+		{
+			t = timer.getTime();
+			std::vector<geom::Data::TriangleAdjacency> reference = calculateAdjacencyBruteForce(data);
+			double bruteForceTime = (timer.getTime() - t) * 1000.0;
+
+			cout << bruteForceTime << "\t" << edgeHashTime << "\t" << (isEqual(adjacency, reference) ? "equal" : "DIFFERENT") << "\n";
+		}
+		else
+		{
+			cout << "-\t" << edgeHashTime << "\t-\n";
+		}
+	}
+
+	return 0;
+}
@@ -27,64 +27,423 @@
 #include <memory>
 #include <string>
 #include <algorithm>
+#include <functional>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 #include <stdio.h>
+#include <stdlib.h>
 #include <io.h>
 #include <fcntl.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 
 #include "vector.h"
 #include "bbox.h"
 
+#include "utils.h"
+#include "parallel.h"
+#include "threadpool.h"
 #include "geometry.h"
+#include "geomformat.h"
+#include "geomsaver.h"
+#include "vertexformat.h"
+#include "meshoptimizer.h"
+#include "meshsimplifier.h"
+#include "clusterbuilder.h"
 
 using namespace std;
 
-void convert(const std::string& filename)
+// must be changed when the output of the converter changes for the same options
+const char* CONVERTER_VERSION = "geomconv 4";
+const char* DEFAULT_MANIFEST = "geomconv.manifest";
+const char* BATCH_EXTENTION = "fbx";
+
+struct ConversionOptions
+{
+	geom::Data::VertexFormat format;
+	bool optimize;
+	bool buildClusters;
+	bool stripUnused;
+	bool compress;
+	size_t lodsCount;
+	size_t threadsCount;
+	bool force;
+	std::string manifest;
+	std::list<std::string> inputs;
+
+	ConversionOptions() : format(geom::Data::VERTEX_FORMAT_FULL), optimize(false), buildClusters(false), stripUnused(false), compress(false), lodsCount(0),
+		threadsCount(utils::Parallel::getThreadsCount()), force(false), manifest(DEFAULT_MANIFEST){}
+
+	// options which affect the output
+	std::string getSignature() const
+	{
+		std::stringstream ss;
+		ss << CONVERTER_VERSION << " format=" << (int)format << " optimize=" << optimize << " clusters=" << buildClusters << " strip=" << stripUnused << " compress=" << compress << " lods=" << lodsCount;
+		return ss.str();
+	}
+};
+
+struct ConversionStatistics
+{
+	size_t convertedCount;
+	size_t skippedCount;
+	size_t failedCount;
+	unsigned long long sourceSize;
+	unsigned long long outputSize;
+
+	ConversionStatistics() : convertedCount(0), skippedCount(0), failedCount(0), sourceSize(0), outputSize(0){}
+};
+
+// source file -> hash of the source file and conversion options
+typedef std::map<std::string, unsigned long long> Manifest;
+
+bool parseOptions(int argc, const char ** argv, ConversionOptions& options)
+{
+	if (argc < 2) return false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option.compare(0, 2, "--") != 0) options.inputs.push_back(option);
+		else if (option == "--compact") options.format = geom::Data::VERTEX_FORMAT_COMPACT;
+		else if (option == "--quantize") options.format = geom::Data::VERTEX_FORMAT_COMPACT_QUANTIZED;
+		else if (option == "--optimize") options.optimize = true;
+		else if (option == "--clusters") options.buildClusters = true;
+		else if (option == "--strip-unused") options.stripUnused = true;
+		else if (option == "--compress") options.compress = true;
+		else if (option == "--force") options.force = true;
+		else if (option == "--lods" && i + 1 < argc)
+		{
+			int lodsCount = atoi(argv[++i]);
+			if (lodsCount <= 0) return false;
+			options.lodsCount = (size_t)lodsCount;
+		}
+		else if (option == "--threads" && i + 1 < argc)
+		{
+			int threadsCount = atoi(argv[++i]);
+			if (threadsCount <= 0) return false;
+			options.threadsCount = (size_t)threadsCount;
+		}
+		else if (option == "--manifest" && i + 1 < argc)
+		{
+			options.manifest = argv[++i];
+		}
+		else return false;
+	}
+	return !options.inputs.empty();
+}
+
+// directories are searched recursively, "@list.txt" contains a file per line
+std::vector<std::string> collectFiles(const ConversionOptions& options, bool& isBatch)
+{
+	std::vector<std::string> files;
+	isBatch = false;
+	for (auto it = options.inputs.begin(); it != options.inputs.end(); ++it)
+	{
+		if ((*it)[0] == '@')
+		{
+			isBatch = true;
+			std::ifstream list(it->substr(1));
+			if (!list.is_open())
+			{
+				cout << "geomconv error: Failed to open file list '" << it->substr(1) << "'.\n";
+				continue;
+			}
+			std::string line;
+			while (std::getline(list, line))
+			{
+				line.erase(line.find_last_not_of(" \t\r\n") + 1);
+				line.erase(0, line.find_first_not_of(" \t"));
+				if (!line.empty()) files.push_back(line);
+			}
+		}
+		else if (utils::Utils::isDirectory(*it))
+		{
+			isBatch = true;
+			auto found = utils::Utils::findFilesRecursively(*it, BATCH_EXTENTION);
+			files.insert(files.end(), found.begin(), found.end());
+		}
+		else
+		{
+			files.push_back(*it);
+		}
+	}
+	std::sort(files.begin(), files.end());
+	files.erase(std::unique(files.begin(), files.end()), files.end());
+	if (files.size() > 1) isBatch = true;
+	return files;
+}
+
+std::string getOutputName(const std::string& filename)
+{
+	size_t dot = filename.find_last_of('.');
+	size_t slash = filename.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		return filename + ".geom";
+	}
+	return filename.substr(0, dot + 1) + "geom";
+}
+
+bool readFile(const std::string& filename, std::vector<char>& data)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) return false;
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+unsigned long long getFileSize(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) return 0;
+	return (unsigned long long)file.tellg();
+}
+
+// FNV-1a
+unsigned long long calculateHash(const std::vector<char>& fileData, const std::string& signature)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	auto process = [&hash](const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	process(signature.data(), signature.size());
+	if (!fileData.empty()) process(fileData.data(), fileData.size());
+	return hash;
+}
+
+Manifest loadManifest(const std::string& filename)
 {
-	std::size_t pos = filename.find('.');
-	std::string outname;
-	if (pos == std::string::npos)
+	Manifest manifest;
+	std::ifstream file(filename);
+	std::string line;
+	while (std::getline(file, line))
 	{
-		outname = filename + ".geom";
+		size_t space = line.find(' ');
+		if (space == std::string::npos) continue;
+		manifest[line.substr(space + 1)] = strtoull(line.substr(0, space).c_str(), 0, 16);
 	}
-	else
+	return manifest;
+}
+
+bool saveManifest(const std::string& filename, const Manifest& manifest)
+{
+	std::ofstream file(filename, std::ios::trunc);
+	if (!file.is_open()) return false;
+	for (auto it = manifest.begin(); it != manifest.end(); ++it)
+	{
+		file << std::hex << std::setw(16) << std::setfill('0') << it->second << " " << it->first << "\n";
+	}
+	return true;
+}
+
+void printStatistics(std::ostream& out, const char* title, const geom::Data& data)
+{
+	out << title << ": ACMR = " << geom::MeshOptimizer::calculateACMR(data) 
+		<< ", ATVR = " << geom::MeshOptimizer::calculateATVR(data) << ".\n";
+}
+
+// texture coordinates are used by textured materials only, tangent frames are used by normal maps only
+unsigned int getUsedComponentsMask(const geom::Data& data)
+{
+	unsigned int mask = geom::Data::COMPONENTS_NORMAL;
+	for (size_t i = 0; i < data.getMeshes().size(); i++)
 	{
-		outname = filename.substr(0, pos + 1);
-		outname.append("geom");
+		const geom::Data::Material& material = data.getMeshes()[i].material;
+		if (!material.diffuseMapFilename.empty() || !material.normalMapFilename.empty() || !material.specularMapFilename.empty())
+		{
+			mask |= geom::Data::COMPONENTS_TEXCOORD0;
+		}
+		if (!material.normalMapFilename.empty()) mask |= geom::Data::COMPONENTS_TANGENT_FRAME;
 	}
+	return mask;
+}
+
+bool convert(const std::string& filename, const ConversionOptions& options, std::ostream& out)
+{
+	std::string outname = getOutputName(filename);
 
 	// converting
 	bool result = false;
 	{
 		auto data = geom::Geometry::instance().load(filename);
+		if (data.isCorrect() && options.lodsCount != 0)
+		{
+			geom::LodGenerationInfo info;
+			info.lodsCount = options.lodsCount;
+			data = geom::MeshSimplifier::generateLods(data, info);
+			for (size_t i = 0; i < data.getMeshes().size() && data.isCorrect(); i++)
+			{
+				const geom::Data::Mesh& mesh = data.getMeshes()[i];
+				out << "Mesh " << i << ": " << mesh.indicesCount / 3 << " triangles";
+				for (size_t lod = 0; lod < mesh.lods.size(); lod++)
+				{
+					out << ", LOD " << lod + 1 << " - " << mesh.lods[lod].indicesCount / 3 << " (error " << mesh.lods[lod].error << ")";
+				}
+				out << ".\n";
+			}
+		}
+
+		// clusters must be built before optimization, the optimizer keeps triangles inside of clusters
+		if (data.isCorrect() && options.buildClusters)
+		{
+			data = geom::ClusterBuilder::build(data);
+			size_t clustersCount = 0;
+			for (size_t i = 0; i < data.getMeshes().size(); i++) clustersCount += data.getMeshes()[i].clusters.size();
+			if (data.isCorrect()) out << "Clusters: " << clustersCount << ".\n";
+		}
+
+		if (data.isCorrect() && options.optimize)
+		{
+			printStatistics(out, "Before optimization", data);
+			data = geom::MeshOptimizer::optimize(data);
+			if (data.isCorrect()) printStatistics(out, "After optimization", data);
+		}
+
+		unsigned int componentsMask = options.stripUnused ? getUsedComponentsMask(data) : data.getVertexComponentsMask();
+		if (data.isCorrect() && (options.format != data.getVertexFormat() || componentsMask != data.getVertexComponentsMask()))
+		{
+			size_t vertexSize = data.getVertexSize();
+			data = geom::VertexFormatConverter::convert(data, options.format, componentsMask);
+			if (data.isCorrect()) out << "Vertex size: " << vertexSize << " -> " << data.getVertexSize() << " bytes.\n";
+		}
+
 		if (data.isCorrect())
 		{
-			result = geom::Geometry::instance().save(data, outname);
+			geom::GeomSaver saver;
+			saver.setCompressionEnabled(options.compress);
+			result = saver.save(data, outname);
 			if (!result)
 			{
-				cout << "geomconv error: Failed to save file '" << outname << "'.\n";
+				out << "geomconv error: Failed to save file '" << outname << "'.\n";
 			}
 		}
 		else
 		{
-			cout << "geomconv error: Failed to load file '" << filename << "'. Reason: "<< data.getLastError() << ".\n";
+			out << "geomconv error: Failed to convert file '" << filename << "'. Reason: "<< data.getLastError() << ".\n";
 		}
 	}
 
 	if (result)
 	{
-		cout << "Converting has finished successfully.\n";
+		out << "Converting has finished successfully.\n";
 	}
+	return result;
+}
+
+bool convertBatch(const std::vector<std::string>& files, const ConversionOptions& options)
+{
+	Manifest manifest = loadManifest(options.manifest);
+	std::string signature = options.getSignature();
+	ConversionStatistics statistics;
+	std::mutex mutex;
+	size_t processedCount = 0;
+
+	auto startTime = std::chrono::steady_clock::now();
+	{
+		utils::ThreadPool threadPool(std::min(options.threadsCount, files.size()));
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			const std::string& filename = files[i];
+			threadPool.enqueue([&, filename]()
+			{
+				std::stringstream out;
+				std::vector<char> source;
+				bool isRead = readFile(filename, source);
+				unsigned long long hash = calculateHash(source, signature);
+				source.clear();
+				source.shrink_to_fit();
+
+				bool isUpToDate = false;
+				if (isRead && !options.force)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					auto it = manifest.find(filename);
+					isUpToDate = (it != manifest.end() && it->second == hash);
+				}
+				isUpToDate = isUpToDate && utils::Utils::exists(getOutputName(filename));
+
+				bool result = false;
+				if (!isRead) out << "geomconv error: Failed to read file '" << filename << "'.\n";
+				else if (isUpToDate) out << "Skipped, the output is up to date.\n";
+				else result = convert(filename, options, out);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (isUpToDate)
+				{
+					statistics.skippedCount++;
+				}
+				else if (result)
+				{
+					manifest[filename] = hash;
+					statistics.convertedCount++;
+					statistics.sourceSize += getFileSize(filename);
+					statistics.outputSize += getFileSize(getOutputName(filename));
+				}
+				else
+				{
+					manifest.erase(filename);
+					statistics.failedCount++;
+				}
+				processedCount++;
+				cout << "[" << processedCount << "/" << files.size() << "] " << filename << "\n" << out.str();
+			});
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	if (!saveManifest(options.manifest, manifest))
+	{
+		cout << "geomconv error: Failed to save manifest '" << options.manifest << "'.\n";
+	}
+
+	const double MB = 1024.0 * 1024.0;
+	cout << "\nFiles: " << files.size() << ", converted: " << statistics.convertedCount 
+		 << ", skipped: " << statistics.skippedCount << ", failed: " << statistics.failedCount << ".\n";
+	cout << "Time: " << seconds << " s (" << options.threadsCount << " threads)";
+	if (seconds > 0.0)
+	{
+		cout << ", throughput: " << statistics.convertedCount / seconds << " files/s, " 
+			 << statistics.sourceSize / MB / seconds << " MB/s";
+	}
+	cout << ".\n";
+	cout << "Source size: " << statistics.sourceSize / MB << " MB, output size: " << statistics.outputSize / MB << " MB";
+	if (statistics.sourceSize != 0)
+	{
+		cout << " (" << 100.0 * statistics.outputSize / statistics.sourceSize << "%)";
+	}
+	cout << ".\n";
+
+	return statistics.failedCount == 0;
 }
 
 int main(int argc, const char ** argv)
 {
-	if (argc != 2)
+	ConversionOptions options;
+	if (!parseOptions(argc, argv, options))
 	{
-		cout << "geomconv error: Command line arguments are incorrect. You have to call [geomconv filename.fbx].\n";
+		cout << "geomconv error: Command line arguments are incorrect. You have to call [geomconv [--lods N] [--clusters] [--optimize] [--compact | --quantize] [--strip-unused] [--compress] "
+				"[--threads N] [--manifest filename] [--force] filename.fbx | directory | @list.txt ...].\n";
 		return -1;
 	}
-	convert(std::string(argv[1]));
 
-	return 0;
-}
\ No newline at end of file
+	bool isBatch = false;
+	std::vector<std::string> files = collectFiles(options, isBatch);
+	if (!isBatch)
+	{
+		if (files.empty()) return -1;
+		convert(files.front(), options, cout);
+		return 0;
+	}
+
+	return convertBatch(files, options) ? 0 : -1;
+}
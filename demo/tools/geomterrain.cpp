@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <condition_variable>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+
+#include "vector.h"
+#include "bbox.h"
+
+#include "utils.h"
+#include "parallel.h"
+#include "threadpool.h"
+#include "memorymappedfile.h"
+#include "geometry.h"
+#include "terraintilegenerator.h"
+
+using namespace std;
+
+// Generates a terrain from a raw heightmap (rows of 8-bit, 16-bit or float samples) and saves it as
+// a grid of geom-files "prefix_x_y.geom". The heightmap is memory-mapped and tiles are saved as soon as
+// they are generated, so heightmaps larger than memory can be converted.
+int main(int argc, const char ** argv)
+{
+	geom::TerrainTileGenerationInfo info;
+	std::string output;
+	std::vector<std::string> arguments;
+	bool isCorrect = true;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--format" && i + 1 < argc)
+		{
+			std::string format = argv[++i];
+			if (format == "r8") info.heightmapFormat = geom::HEIGHTMAP_FORMAT_R8;
+			else if (format == "r16") info.heightmapFormat = geom::HEIGHTMAP_FORMAT_R16;
+			else if (format == "r32f") info.heightmapFormat = geom::HEIGHTMAP_FORMAT_R32F;
+			else isCorrect = false;
+		}
+		else if (option == "--offset" && i + 1 < argc) info.heightmapOffset = (size_t)atoll(argv[++i]);
+		else if (option == "--tile" && i + 1 < argc) info.tileSize = (size_t)atoi(argv[++i]);
+		else if (option == "--size" && i + 3 < argc)
+		{
+			info.size.x = (float)atof(argv[++i]);
+			info.size.y = (float)atof(argv[++i]);
+			info.size.z = (float)atof(argv[++i]);
+		}
+		else if (option == "--output" && i + 1 < argc) output = argv[++i];
+		else arguments.push_back(option);
+	}
+	if (!isCorrect || arguments.size() != 3)
+	{
+		cout << "geomterrain error: Command line arguments are incorrect. You have to call [geomterrain [--format r8|r16|r32f] [--offset bytes] "
+			 << "[--tile quads] [--size x z height] [--output prefix] heightmap width height].\n";
+		return -1;
+	}
+	info.heightmapWidth = (size_t)atoi(arguments[1].c_str());
+	info.heightmapHeight = (size_t)atoi(arguments[2].c_str());
+	if (output.empty()) output = utils::Utils::trimExtention(arguments[0]);
+
+	geom::TerrainTileGenerator generator;
+	generator.setTerrainTileGenerationInfo(info);
+	std::string failedFile;
+	bool result = generator.generate(arguments[0], [&output, &failedFile](size_t tileX, size_t tileY, const geom::Data& tile)
+	{
+		std::stringstream fileName;
+		fileName << output << "_" << tileX << "_" << tileY << ".geom";
+		if (geom::Geometry::instance().save(tile, fileName.str())) return true;
+		failedFile = fileName.str();
+		return false;
+	});
+	if (!failedFile.empty())
+	{
+		cout << "geomterrain error: Failed to write '" << failedFile << "'.\n";
+		return -1;
+	}
+	if (!result)
+	{
+		cout << "geomterrain error: " << generator.getLastError() << ".\n";
+		return -1;
+	}
+
+	cout << "geomterrain: " << generator.getTilesCountX() << "x" << generator.getTilesCountY() << " tiles are saved ('" 
+		 << output << "_x_y.geom').\n";
+	return 0;
+}
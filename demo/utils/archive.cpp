@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "stdafx.h"
+#include "archive.h"
+
+namespace utils
+{
+
+namespace
+{
+	const size_t HEADER_SIZE = 32;
+	const size_t BUCKET_SIZE = 4;
+	const size_t FILE_RECORD_SIZE = 32;
+
+	unsigned int readLittleEndian32(const unsigned char* ptr)
+	{
+		return (unsigned int)ptr[0] | ((unsigned int)ptr[1] << 8) | ((unsigned int)ptr[2] << 16) | ((unsigned int)ptr[3] << 24);
+	}
+
+	unsigned long long readLittleEndian64(const unsigned char* ptr)
+	{
+		return (unsigned long long)readLittleEndian32(ptr) | ((unsigned long long)readLittleEndian32(ptr + 4) << 32);
+	}
+
+	void writeLittleEndian32(std::vector<unsigned char>& buffer, unsigned int value)
+	{
+		for (int i = 0; i < 4; i++) buffer.push_back((unsigned char)((value >> (i * 8)) & 0xff));
+	}
+
+	void writeLittleEndian64(std::vector<unsigned char>& buffer, unsigned long long value)
+	{
+		writeLittleEndian32(buffer, (unsigned int)(value & 0xffffffff));
+		writeLittleEndian32(buffer, (unsigned int)(value >> 32));
+	}
+
+	// 64-bit FNV-1a
+	unsigned long long hashPath(const char* path, size_t length)
+	{
+		unsigned long long hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= (unsigned char)path[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	size_t alignFileOffset(size_t offset)
+	{
+		return (offset + ARCHIVE_FILE_ALIGNMENT - 1) & ~(ARCHIVE_FILE_ALIGNMENT - 1);
+	}
+}
+
+Archive& Archive::instance()
+{
+	static Archive archive;
+	return archive;
+}
+
+Archive::Archive() :
+	m_filesCount(0),
+	m_bucketsCount(0),
+	m_buckets(0),
+	m_files(0),
+	m_names(0),
+	m_namesSize(0)
+{
+}
+
+bool Archive::open(const std::string& fileName)
+{
+	close();
+
+	std::shared_ptr<MemoryMappedFile> file(new MemoryMappedFile());
+	if (!file->open(fileName)) return false;
+
+	const unsigned char* data = file->getData();
+	size_t size = file->getSize();
+	if (size < HEADER_SIZE || readLittleEndian32(data) != MAGIC_ARCHIVE || readLittleEndian32(data + 4) != ARCHIVE_VERSION)
+	{
+		Logger::toLogWithFormat("Error: file '%s' is not an archive or has an unsupported version.\n", fileName.c_str());
+		return false;
+	}
+
+	size_t filesCount = readLittleEndian32(data + 8);
+	size_t bucketsCount = readLittleEndian32(data + 12);
+	unsigned long long namesOffset = readLittleEndian64(data + 16);
+	unsigned long long namesSize = readLittleEndian64(data + 24);
+	size_t indexSize = HEADER_SIZE + bucketsCount * BUCKET_SIZE + filesCount * FILE_RECORD_SIZE;
+	bool isCorrect = bucketsCount != 0 && (bucketsCount & (bucketsCount - 1)) == 0 && bucketsCount > filesCount &&
+					 indexSize <= size && namesOffset == indexSize && namesOffset + namesSize <= size;
+
+	// records must point inside the archive, so lookups don't need to check it
+	const unsigned char* records = data + HEADER_SIZE + bucketsCount * BUCKET_SIZE;
+	for (size_t i = 0; i < filesCount && isCorrect; i++)
+	{
+		const unsigned char* record = records + i * FILE_RECORD_SIZE;
+		unsigned long long offset = readLittleEndian64(record + 8);
+		unsigned long long fileSize = readLittleEndian64(record + 16);
+		unsigned long long nameOffset = readLittleEndian32(record + 24);
+		unsigned long long nameLength = readLittleEndian32(record + 28);
+		isCorrect = offset <= size && fileSize <= size - offset && nameOffset + nameLength <= namesSize;
+	}
+	for (size_t i = 0; i < bucketsCount && isCorrect; i++)
+	{
+		isCorrect = readLittleEndian32(data + HEADER_SIZE + i * BUCKET_SIZE) <= filesCount;
+	}
+	if (!isCorrect)
+	{
+		Logger::toLogWithFormat("Error: index of archive '%s' is corrupted.\n", fileName.c_str());
+		return false;
+	}
+
+	m_file = file;
+	m_filesCount = filesCount;
+	m_bucketsCount = bucketsCount;
+	m_buckets = data + HEADER_SIZE;
+	m_files = records;
+	m_names = (const char*)(data + namesOffset);
+	m_namesSize = (size_t)namesSize;
+	return true;
+}
+
+void Archive::close()
+{
+	m_file.reset();
+	m_filesCount = 0;
+	m_bucketsCount = 0;
+	m_buckets = 0;
+	m_files = 0;
+	m_names = 0;
+	m_namesSize = 0;
+}
+
+bool Archive::isOpened() const
+{
+	return m_file != 0;
+}
+
+size_t Archive::getFilesCount() const
+{
+	return m_filesCount;
+}
+
+bool Archive::find(const std::string& path, const unsigned char*& data, size_t& size) const
+{
+	if (!isOpened()) return false;
+	return findNormalized(normalizePath(path), data, size);
+}
+
+bool Archive::contains(const std::string& path) const
+{
+	const unsigned char* data = 0;
+	size_t size = 0;
+	return find(path, data, size);
+}
+
+std::shared_ptr<MemoryMappedFile> Archive::getMappedFile() const
+{
+	return m_file;
+}
+
+bool Archive::findNormalized(const std::string& normalizedPath, const unsigned char*& data, size_t& size) const
+{
+	unsigned long long hash = hashPath(normalizedPath.c_str(), normalizedPath.length());
+	size_t mask = m_bucketsCount - 1;
+	for (size_t bucket = (size_t)hash & mask;; bucket = (bucket + 1) & mask)
+	{
+		unsigned int index = readLittleEndian32(m_buckets + bucket * BUCKET_SIZE);
+		if (index == 0) return false;
+
+		const unsigned char* record = m_files + (index - 1) * FILE_RECORD_SIZE;
+		if (readLittleEndian64(record) != hash) continue;
+		size_t nameLength = readLittleEndian32(record + 28);
+		if (nameLength != normalizedPath.length() || 
+			memcmp(m_names + readLittleEndian32(record + 24), normalizedPath.c_str(), nameLength) != 0) continue;
+
+		data = m_file->getData() + readLittleEndian64(record + 8);
+		size = (size_t)readLittleEndian64(record + 16);
+		return true;
+	}
+}
+
+bool Archive::save(const std::string& fileName, const std::vector<std::string>& files)
+{
+	// gather paths and sizes, the hash table is kept at most half full
+	std::vector<std::string> names(files.size());
+	std::vector<unsigned long long> sizes(files.size());
+	std::map<std::string, size_t> uniqueNames;
+	size_t bucketsCount = 2;
+	while (bucketsCount < files.size() * 2) bucketsCount <<= 1;
+	std::string namesTable;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		names[i] = normalizePath(files[i]);
+		if (!uniqueNames.insert(std::make_pair(names[i], i)).second)
+		{
+			Logger::toLogWithFormat("Error: file '%s' is added to the archive twice.\n", files[i].c_str());
+			return false;
+		}
+		namesTable += names[i];
+
+		FILE* fp = fopen(files[i].c_str(), "rb");
+		if (!fp)
+		{
+			Logger::toLogWithFormat("Error: could not open file '%s'.\n", files[i].c_str());
+			return false;
+		}
+		fseek(fp, 0, SEEK_END);
+		sizes[i] = (unsigned long long)ftell(fp);
+		fclose(fp);
+	}
+
+	// index
+	size_t namesOffset = HEADER_SIZE + bucketsCount * BUCKET_SIZE + files.size() * FILE_RECORD_SIZE;
+	std::vector<unsigned char> index;
+	index.reserve(namesOffset + namesTable.size());
+	writeLittleEndian32(index, MAGIC_ARCHIVE);
+	writeLittleEndian32(index, ARCHIVE_VERSION);
+	writeLittleEndian32(index, (unsigned int)files.size());
+	writeLittleEndian32(index, (unsigned int)bucketsCount);
+	writeLittleEndian64(index, namesOffset);
+	writeLittleEndian64(index, namesTable.size());
+
+	std::vector<unsigned int> buckets(bucketsCount, 0);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		size_t mask = bucketsCount - 1;
+		size_t bucket = (size_t)hashPath(names[i].c_str(), names[i].length()) & mask;
+		while (buckets[bucket] != 0) bucket = (bucket + 1) & mask;
+		buckets[bucket] = (unsigned int)i + 1;
+	}
+	for (size_t i = 0; i < bucketsCount; i++) writeLittleEndian32(index, buckets[i]);
+
+	std::vector<size_t> offsets(files.size());
+	size_t offset = alignFileOffset(namesOffset + namesTable.size());
+	size_t nameOffset = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		offsets[i] = offset;
+		writeLittleEndian64(index, hashPath(names[i].c_str(), names[i].length()));
+		writeLittleEndian64(index, offset);
+		writeLittleEndian64(index, sizes[i]);
+		writeLittleEndian32(index, (unsigned int)nameOffset);
+		writeLittleEndian32(index, (unsigned int)names[i].length());
+		offset = alignFileOffset(offset + (size_t)sizes[i]);
+		nameOffset += names[i].length();
+	}
+	index.insert(index.end(), namesTable.begin(), namesTable.end());
+
+	// files data
+	FILE* fp = fopen(fileName.c_str(), "wb");
+	if (!fp)
+	{
+		Logger::toLogWithFormat("Error: could not create file '%s'.\n", fileName.c_str());
+		return false;
+	}
+
+	bool result = fwrite(index.data(), index.size(), 1, fp) == 1;
+	size_t written = index.size();
+	std::vector<char> buffer;
+	static const char padding[ARCHIVE_FILE_ALIGNMENT] = { 0 };
+	for (size_t i = 0; i < files.size() && result; i++)
+	{
+		if (offsets[i] != written)
+		{
+			result = fwrite(padding, offsets[i] - written, 1, fp) == 1;
+			written = offsets[i];
+		}
+		if (!result || sizes[i] == 0) continue;
+
+		FILE* input = fopen(files[i].c_str(), "rb");
+		buffer.resize((size_t)sizes[i]);
+		result = input != 0 && fread(buffer.data(), buffer.size(), 1, input) == 1 && fwrite(buffer.data(), buffer.size(), 1, fp) == 1;
+		if (input != 0) fclose(input);
+		if (!result) Logger::toLogWithFormat("Error: could not pack file '%s'.\n", files[i].c_str());
+		written += buffer.size();
+	}
+
+	fclose(fp);
+	return result;
+}
+
+std::string Archive::normalizePath(const std::string& path)
+{
+	std::string str = path;
+	std::replace(str.begin(), str.end(), '\\', '/');
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+
+	std::vector<std::string> segments;
+	auto tokens = Utils::tokenize<std::string>(str, '/');
+	for (auto it = tokens.begin(); it != tokens.end(); ++it)
+	{
+		std::string segment = str.substr(it->first, it->second - it->first + 1);
+		if (segment == ".") continue;
+		if (segment == ".." && !segments.empty() && segments.back() != "..") segments.pop_back();
+		else segments.push_back(segment);
+	}
+
+	std::string result;
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		if (i != 0) result.push_back('/');
+		result += segments[i];
+	}
+	return result;
+}
+
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ARCHIVE_H__
+#define __ARCHIVE_H__
+
+namespace utils
+{
+
+class MemoryMappedFile;
+
+// Archive format description (all fields are little-endian):
+//
+// header:
+//		4 bytes	- magic number
+//		4 bytes	- format version
+//		4 bytes	- number of files
+//		4 bytes	- number of buckets in the hash table (power of 2)
+//		8 bytes	- offset of the names table from the beginning of the archive (in bytes)
+//		8 bytes	- size of the names table (in bytes)
+// for each bucket:
+//		4 bytes	- index of a file + 1, 0 means the bucket is empty
+// for each file:
+//		8 bytes	- hash of the normalized path
+//		8 bytes	- offset of the file from the beginning of the archive (in bytes)
+//		8 bytes	- size of the file (in bytes)
+//		4 bytes	- offset of the normalized path in the names table
+//		4 bytes	- length of the normalized path
+// names table, normalized paths without terminating zeros
+// files data, each file starts at the offset aligned to ARCHIVE_FILE_ALIGNMENT
+//
+// Collisions are resolved by linear probing, paths are compared to confirm a match.
+
+const unsigned int MAGIC_ARCHIVE = 0x4b415044; // 'DPAK'
+const unsigned int ARCHIVE_VERSION = 1;
+const size_t ARCHIVE_FILE_ALIGNMENT = 64;
+
+// Read-only archive of files packed by assetpack. The whole archive is mapped 
+// into the address space once, files are found through the hashed path index 
+// and accessed in-place. Lookups are thread-safe while the archive is not reopened.
+class Archive
+{
+public:
+	static Archive& instance();
+
+	bool open(const std::string& fileName);
+	void close();
+	bool isOpened() const;
+	size_t getFilesCount() const;
+
+	// data stays valid while the archive is opened or the mapped file is referenced
+	bool find(const std::string& path, const unsigned char*& data, size_t& size) const;
+	bool contains(const std::string& path) const;
+	std::shared_ptr<MemoryMappedFile> getMappedFile() const;
+
+	// writes an archive with files, paths are stored as they are passed (normalized)
+	static bool save(const std::string& fileName, const std::vector<std::string>& files);
+
+	// lower case, '/' as a separator, without "." and ".." segments
+	static std::string normalizePath(const std::string& path);
+
+private:
+	Archive();
+	Archive(const Archive&);
+	Archive& operator=(const Archive&);
+
+	bool findNormalized(const std::string& normalizedPath, const unsigned char*& data, size_t& size) const;
+
+	std::shared_ptr<MemoryMappedFile> m_file;
+	size_t m_filesCount;
+	size_t m_bucketsCount;
+	const unsigned char* m_buckets;
+	const unsigned char* m_files;
+	const char* m_names;
+	size_t m_namesSize;
+};
+
+}
+
+#endif
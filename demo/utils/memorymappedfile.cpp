@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include "memorymappedfile.h"
+
+#if !defined _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace utils
+{
+
+MemoryMappedFile::MemoryMappedFile() :
+	m_data(0),
+	m_size(0)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	close();
+}
+
+#if defined _WIN32
+
+bool MemoryMappedFile::open(const std::string& fileName)
+{
+	close();
+
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || (unsigned long long)fileSize.QuadPart > (unsigned long long)((size_t)-1))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL) return false;
+
+	// the view keeps the mapping alive, so handles can be closed right away
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == NULL) return false;
+
+	m_data = (const unsigned char*)view;
+	m_size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MemoryMappedFile::release(size_t offset, size_t size)
+{
+	if (m_data == 0 || offset >= m_size) return;
+
+	// unlocking of pages which are not locked removes them from the working set
+	VirtualUnlock((LPVOID)(m_data + offset), std::min(size, m_size - offset));
+}
+
+void MemoryMappedFile::close()
+{
+	if (m_data != 0)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = 0;
+		m_size = 0;
+	}
+}
+
+#else
+
+bool MemoryMappedFile::open(const std::string& fileName)
+{
+	close();
+
+	int file = ::open(fileName.c_str(), O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat st;
+	if (fstat(file, &st) != 0 || st.st_size == 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	void* view = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (view == MAP_FAILED) return false;
+
+	m_data = (const unsigned char*)view;
+	m_size = (size_t)st.st_size;
+	return true;
+}
+
+void MemoryMappedFile::release(size_t offset, size_t size)
+{
+	if (m_data == 0 || offset >= m_size) return;
+
+	// only whole pages inside the range are released
+	const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+	size_t end = std::min(offset + size, m_size) / pageSize * pageSize;
+	if (begin < end) madvise((void*)(m_data + begin), end - begin, MADV_DONTNEED);
+}
+
+void MemoryMappedFile::close()
+{
+	if (m_data != 0)
+	{
+		munmap((void*)m_data, m_size);
+		m_data = 0;
+		m_size = 0;
+	}
+}
+
+#endif
+
+bool MemoryMappedFile::isOpened() const
+{
+	return m_data != 0;
+}
+
+const unsigned char* MemoryMappedFile::getData() const
+{
+	return m_data;
+}
+
+size_t MemoryMappedFile::getSize() const
+{
+	return m_size;
+}
+
+}
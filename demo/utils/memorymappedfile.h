@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MEMORY_MAPPED_FILE_H__
+#define __MEMORY_MAPPED_FILE_H__
+
+namespace utils
+{
+
+// Read-only view of a whole file mapped into the address space.
+// The view stays valid until close() is called or the object is destroyed.
+class MemoryMappedFile
+{
+public:
+	MemoryMappedFile();
+	~MemoryMappedFile();
+
+	bool open(const std::string& fileName);
+	void close();
+
+	bool isOpened() const;
+	const unsigned char* getData() const;
+	size_t getSize() const;
+
+	// Removes pages of the range from physical memory (they are read from the file again if accessed).
+	// It keeps memory usage bounded while large files are read sequentially.
+	void release(size_t offset, size_t size);
+
+private:
+	MemoryMappedFile(const MemoryMappedFile&);
+	MemoryMappedFile& operator=(const MemoryMappedFile&);
+
+	const unsigned char* m_data;
+	size_t m_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include "parallel.h"
+#include <thread>
+
+namespace utils
+{
+
+namespace
+{
+	thread_local bool isWorker = false;
+}
+
+Parallel::WorkerScope::WorkerScope() :
+	m_wasWorker(isWorker)
+{
+	isWorker = true;
+}
+
+Parallel::WorkerScope::~WorkerScope()
+{
+	isWorker = m_wasWorker;
+}
+
+bool Parallel::isWorkerThread()
+{
+	return isWorker;
+}
+
+size_t Parallel::getThreadsCount()
+{
+	size_t count = (size_t)std::thread::hardware_concurrency();
+	return count != 0 ? count : 1;
+}
+
+void Parallel::forRange(size_t count, const RangeFunction& func, size_t minRangeSize)
+{
+	if (count == 0) return;
+	if (minRangeSize == 0) minRangeSize = 1;
+
+	size_t rangesCount = isWorker ? 1 : std::min(getThreadsCount(), (count + minRangeSize - 1) / minRangeSize);
+	if (rangesCount <= 1)
+	{
+		func(0, count, 0);
+		return;
+	}
+
+	auto workerFunc = [&func](size_t begin, size_t end, size_t rangeIndex)
+	{
+		WorkerScope scope;
+		func(begin, end, rangeIndex);
+	};
+
+	size_t rangeSize = (count + rangesCount - 1) / rangesCount;
+	std::vector<std::thread> threads;
+	threads.reserve(rangesCount - 1);
+	for (size_t i = 1; i < rangesCount; i++)
+	{
+		size_t begin = i * rangeSize;
+		if (begin >= count) break;
+		threads.push_back(std::thread(workerFunc, begin, std::min(count, begin + rangeSize), i));
+	}
+
+	workerFunc(0, std::min(count, rangeSize), 0);
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+}
+
+}
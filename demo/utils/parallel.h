@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+namespace utils
+{
+
+class Parallel
+{
+public:
+	// begin, end, range index
+	typedef std::function<void(size_t, size_t, size_t)> RangeFunction;
+
+	static size_t getThreadsCount();
+
+	// Splits [0; count) into contiguous ranges of at least minRangeSize elements and
+	// processes them on separate threads. Range indices grow with range beginnings and 
+	// never exceed getThreadsCount() - 1, the range with index 0 is processed on the calling thread.
+	// Nested calls (from ranges or from tasks of a ThreadPool) process everything on the calling thread
+	// as a single range, since all cores are busy already.
+	static void forRange(size_t count, const RangeFunction& func, size_t minRangeSize = 1);
+
+	// returns true on threads which process ranges or tasks of a ThreadPool
+	static bool isWorkerThread();
+
+	// marks the current thread as a worker while the object exists
+	class WorkerScope
+	{
+	public:
+		WorkerScope();
+		~WorkerScope();
+
+	private:
+		bool m_wasWorker;
+
+		WorkerScope(const WorkerScope&);
+		WorkerScope& operator=(const WorkerScope&);
+	};
+};
+
+}
+
+#endif
@@ -188,6 +188,9 @@ void Profiler::cleanup()
 		delete it->second;
 	}
 	m_profilingTrees.clear();
+
+	std::lock_guard<std::mutex> lock(m_countersMutex);
+	m_counters.clear();
 }
 
 void Profiler::run()
@@ -227,6 +230,25 @@ std::string Profiler::getProfilingThreadDesc(unsigned int id) const
 	return "unknown";
 }
 
+void Profiler::addToCounter(const std::string& name, long long value)
+{
+	std::lock_guard<std::mutex> lock(m_countersMutex);
+	m_counters[name] += value;
+}
+
+long long Profiler::getCounter(const std::string& name) const
+{
+	std::lock_guard<std::mutex> lock(m_countersMutex);
+	auto it = m_counters.find(name);
+	return it != m_counters.end() ? it->second : 0;
+}
+
+std::map<std::string, long long> Profiler::getCounters() const
+{
+	std::lock_guard<std::mutex> lock(m_countersMutex);
+	return m_counters;
+}
+
 void Profiler::forEachNode(Node* node, ProcessNodeFunc processNode, int depth)
 {
 	if (node == nullptr) return;
@@ -294,6 +316,16 @@ void Profiler::saveToFile()
 					}
 				});
 			}
+
+			std::map<std::string, long long> counters = getCounters();
+			if (!counters.empty())
+			{
+				profilerFile << "Counters:\n";
+				for (auto it = counters.begin(); it != counters.end(); ++it)
+				{
+					profilerFile << "> " << it->first << " = " << it->second << "\n";
+				}
+			}
 			profilerFile.close();
 		}
 	}
@@ -68,6 +68,8 @@ private:
 	};
 
 	std::map<unsigned int, ProfilingTree*> m_profilingTrees;
+	std::map<std::string, long long> m_counters;
+	mutable std::mutex m_countersMutex;
 	bool m_isRun;
 	Timer m_timer;
 	std::string m_filename;
@@ -101,6 +103,11 @@ public:
 	std::vector<int> getProfilingThreads() const;
 	std::string getProfilingThreadDesc(unsigned int id) const;
 
+	// named counters of events (e.g. hits of caches), they are counted even if profiling is not run
+	void addToCounter(const std::string& name, long long value = 1);
+	long long getCounter(const std::string& name) const;
+	std::map<std::string, long long> getCounters() const;
+
 	void setFilename(const std::string& filename);
 	void setHeader(const std::string& header);
 
@@ -38,6 +38,8 @@
 #include <functional>
 #include <time.h>
 #include <chrono>
+#include <thread>
+#include <condition_variable>
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN 1
@@ -55,6 +57,10 @@
 #include "timer.h"
 #include "profiler.h"
 #include "fpscounter.h"
+#include "memorymappedfile.h"
+#include "archive.h"
+#include "parallel.h"
+#include "threadpool.h"
 
 #include "utils.h"
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014 Roman Kuznetsov 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+namespace utils
+{
+
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	explicit ThreadPool(size_t threadsCount = Parallel::getThreadsCount());
+	// waits for all enqueued tasks
+	~ThreadPool();
+
+	// tasks are started in the order of enqueueing
+	void enqueue(const Task& task);
+	size_t getThreadsCount() const { return m_threads.size(); }
+
+private:
+	std::vector<std::thread> m_threads;
+	std::list<Task> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_isStopping;
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	void workerThread();
+};
+
+}
+
+#endif
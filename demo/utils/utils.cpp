@@ -35,6 +35,8 @@ void Utils::init()
 
 bool Utils::exists(const std::string& fileName)
 {
+	if (Archive::instance().contains(fileName)) return true;
+
 #ifdef WIN32
 	DWORD dwAttrib = GetFileAttributesA(fileName.c_str());
 	if (dwAttrib != INVALID_FILE_ATTRIBUTES) return true;
@@ -44,6 +46,15 @@ bool Utils::exists(const std::string& fileName)
 
 bool Utils::readFileToString( const std::string& fileName, std::string& out )
 {
+	const unsigned char* data = 0;
+	size_t dataSize = 0;
+	if (Archive::instance().find(fileName, data, dataSize))
+	{
+		out.assign((const char*)data, dataSize);
+		out.push_back(0);
+		return true;
+	}
+
 	FILE* fp = 0;
 	size_t filesize = 0;
 
@@ -64,6 +75,60 @@ bool Utils::readFileToString( const std::string& fileName, std::string& out )
 	return true;
 }
 
+bool Utils::computeFileHash(const std::string& fileName, unsigned long long& hash)
+{
+	MemoryMappedFile file;
+	const unsigned char* data = 0;
+	size_t dataSize = 0;
+	if (!Archive::instance().find(fileName, data, dataSize))
+	{
+		if (!file.open(fileName)) return false;
+		data = file.getData();
+		dataSize = file.getSize();
+	}
+
+	hash = computeHash(data, dataSize);
+	return true;
+}
+
+unsigned long long Utils::computeHash(const unsigned char* data, size_t dataSize, unsigned long long seed)
+{
+	const unsigned long long PRIME1 = 11400714785074694791ULL;
+	const unsigned long long PRIME2 = 14029467366897019727ULL;
+	const unsigned long long PRIME3 = 1609587929392839161ULL;
+	const size_t LANES_COUNT = 4;
+
+	// independent lanes of 64-bit words hide the latency of multiplications
+	unsigned long long lanes[LANES_COUNT] = { seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1 };
+	size_t blocksCount = dataSize / (LANES_COUNT * sizeof(unsigned long long));
+	for (size_t i = 0; i < blocksCount; i++)
+	{
+		for (size_t l = 0; l < LANES_COUNT; l++)
+		{
+			unsigned long long word;
+			memcpy(&word, data + (i * LANES_COUNT + l) * sizeof(word), sizeof(word));
+			lanes[l] += word * PRIME2;
+			lanes[l] = ((lanes[l] << 31) | (lanes[l] >> 33)) * PRIME1;
+		}
+	}
+
+	unsigned long long result = PRIME3 + (unsigned long long)dataSize;
+	for (size_t l = 0; l < LANES_COUNT; l++)
+	{
+		result = (result ^ lanes[l]) * PRIME1 + PRIME3;
+	}
+	for (size_t i = blocksCount * LANES_COUNT * sizeof(unsigned long long); i < dataSize; i++)
+	{
+		result = (result ^ data[i]) * PRIME1;
+	}
+	result ^= result >> 33;
+	result *= PRIME2;
+	result ^= result >> 29;
+	result *= PRIME3;
+	result ^= result >> 32;
+	return result;
+}
+
 std::string Utils::getExtention(const std::string& fileName)
 {
 	auto tokens = tokenize<std::string>(fileName, '.');
@@ -291,4 +356,44 @@ std::list<std::string> Utils::findFilesInDirectory( const std::string& path, con
 	return files;
 }
 
+std::list<std::string> Utils::findFilesRecursively(const std::string& path, const std::string& extention)
+{
+	std::list<std::string> files;
+	if (path.empty()) return files;
+
+	std::string dir = path;
+	if (dir.back() != '/' && dir.back() != '\\') dir.push_back('/');
+
+	WIN32_FIND_DATA dat;
+	std::string s = dir + "*";
+	HANDLE h = FindFirstFile(s.c_str(), &dat);
+	if (h != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (dat.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) continue;
+			std::string f = dat.cFileName;
+			if (dat.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			{
+				if (f == "." || f == "..") continue;
+				files.splice(files.end(), findFilesRecursively(dir + f, extention));
+			}
+			else if (extention.empty() || getExtention(f) == extention)
+			{
+				files.push_back(dir + f);
+			}
+		}
+		while (FindNextFile(h, &dat));
+		FindClose(h);
+	}
+
+	return files;
+}
+
+bool Utils::isDirectory(const std::string& path)
+{
+	DWORD attributes = GetFileAttributes(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
 }
\ No newline at end of file
@@ -33,12 +33,19 @@ public:
 	static void init();
 	static bool exists(const std::string& fileName);
 	static bool readFileToString(const std::string& fileName, std::string& out);
+	// 64-bit hash of the content of a file (or a file in the opened archive), it is not cryptographic
+	static bool computeFileHash(const std::string& fileName, unsigned long long& hash);
+	// 64-bit hash of a memory block, hashes of several blocks can be chained via the seed
+	static unsigned long long computeHash(const unsigned char* data, size_t dataSize, unsigned long long seed = 0);
 	static std::string getExtention(const std::string& fileName);
 	static std::list<std::string> getExtentions(const std::string& fileName);
 	static std::string trimExtention(const std::string& fileName);
 	static std::string getPath(const std::string& path);
 	static std::string getFilename(const std::string& path);
 	static std::list<std::string> findFilesInDirectory(const std::string& path, const std::string& mask);
+	// returns full paths of files with the extention (or all files if it's empty) in the directory and its subdirectories
+	static std::list<std::string> findFilesRecursively(const std::string& path, const std::string& extention);
+	static bool isDirectory(const std::string& path);
 	static float* convert(const vector4& v);
 	static float* convert(const vector3& v);
 	static float* convert(const vector2& v);